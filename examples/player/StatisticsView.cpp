@@ -53,6 +53,7 @@ QStringList getCommonInfoKeys() {
 QStringList getVideoInfoKeys() {
     return getCommonInfoKeys()
             << QObject::tr("FPS Now") //current display fps
+            << QObject::tr("Present error") // ms. last/mean/max
             << QObject::tr("Pixel format")
             << QObject::tr("Size") //w x h
             << QObject::tr("Coded size") // w x h
@@ -91,6 +92,7 @@ QList<QVariant> getVideoInfoValues(const Statistics& s) {
             << s.video.frames
             << s.video.frame_rate
             << s.video.frame_rate
+            << QString()
             << s.video_only.pix_fmt
             << QString::fromLatin1("%1x%2").arg(s.video_only.width).arg(s.video_only.height)
             << QString::fromLatin1("%1x%2").arg(s.video_only.coded_width).arg(s.video_only.coded_height)
@@ -121,6 +123,7 @@ StatisticsView::StatisticsView(QWidget *parent) :
     QDialog(parent)
   , mTimer(0)
   , mpFPS(0)
+  , mpPresentError(0)
   , mpAudioBitRate(0)
   , mpVideoBitRate(0)
 {
@@ -140,6 +143,7 @@ StatisticsView::StatisticsView(QWidget *parent) :
     mpView->addTopLevelItem(mpMetadata);
     QTreeWidgetItem *item = createNodeWithItems(mpView, QObject::tr("Video"), getVideoInfoKeys(), &mVideoItems);
     mpFPS = item->child(9);
+    mpPresentError = item->child(10);
     //mpVideoBitRate =
     mpVideoMetadata = new QTreeWidgetItem(item);
     mpVideoMetadata->setText(0, QObject::tr("Metadata"));
@@ -214,6 +218,13 @@ void StatisticsView::timerEvent(QTimerEvent *e)
     if (mpFPS) {
         mpFPS->setData(1, Qt::DisplayRole, QString::number(mStatistics.video_only.currentDisplayFPS(), 'f', 2));
     }
+    if (mpPresentError) {
+        const Statistics::VideoOnly &v = mStatistics.video_only;
+        mpPresentError->setData(1, Qt::DisplayRole, QString::fromLatin1("%1/%2/%3 ms")
+                                .arg(v.presentError()*1000.0, 0, 'f', 1)
+                                .arg(v.presentErrorMean()*1000.0, 0, 'f', 1)
+                                .arg(v.presentErrorMax()*1000.0, 0, 'f', 1));
+    }
 }
 
 void StatisticsView::initBaseItems(QList<QTreeWidgetItem *> *items)
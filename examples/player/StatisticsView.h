@@ -56,7 +56,7 @@ private:
     Statistics mStatistics;
     int mTimer;
 
-    QTreeWidgetItem *mpFPS, *mpAudioBitRate, *mpVideoBitRate;
+    QTreeWidgetItem *mpFPS, *mpPresentError, *mpAudioBitRate, *mpVideoBitRate;
     QTreeWidgetItem *mpMetadata, *mpAudioMetadata, *mpVideoMetadata;
 };
 
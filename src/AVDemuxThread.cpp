@@ -24,7 +24,10 @@
 #include "QtAV/AVClock.h"
 #include "QtAV/AVDemuxer.h"
 #include "QtAV/AVDecoder.h"
+#include "QtAV/Statistics.h"
 #include "VideoThread.h"
+#include "StageTimer.h"
+#include "utils/Tracer.h"
 #include <QtCore/QTime>
 #include "utils/Logger.h"
 
@@ -44,6 +47,7 @@ public:
         if (mDemuxThread->isEnd())
             return;
         mDemuxThread->updateBufferState(); // ensure detect buffering immediately
+        mDemuxThread->wakeUp(); // queue is drained at the end of media
         AVThread *thread = mDemuxThread->videoThread();
         //qDebug("try wake up video queue");
         if (thread)
@@ -68,11 +72,13 @@ AVDemuxThread::AVDemuxThread(QObject *parent) :
   , ademuxer(0)
   , audio_thread(0)
   , video_thread(0)
+  , m_wake(false)
   , nb_next_frame(0)
   , clock_type(-1)
+  , m_statistics(0)
 {
-    seek_tasks.setCapacity(1);
-    seek_tasks.blockFull(false);
+    seek_pos = 0;
+    seek_type = AccurateSeek;
 }
 
 AVDemuxThread::AVDemuxThread(AVDemuxer *dmx, QObject *parent) :
@@ -83,10 +89,12 @@ AVDemuxThread::AVDemuxThread(AVDemuxer *dmx, QObject *parent) :
   , m_buffer(0)
   , audio_thread(0)
   , video_thread(0)
+  , m_wake(false)
+  , m_statistics(0)
 {
     setDemuxer(dmx);
-    seek_tasks.setCapacity(1);
-    seek_tasks.blockFull(false);
+    seek_pos = 0;
+    seek_type = AccurateSeek;
 }
 
 void AVDemuxThread::setDemuxer(AVDemuxer *dmx)
@@ -115,6 +123,7 @@ void AVDemuxThread::setAVThread(AVThread*& pOld, AVThread *pNew)
         return;
     pOld->packetQueue()->setEmptyCallback(new QueueEmptyCall(this));
     connect(pOld, SIGNAL(finished()), SLOT(onAVThreadQuit()));
+    wakeUp(); // queue changed
 }
 
 void AVDemuxThread::setAudioThread(AVThread *thread)
@@ -147,27 +156,20 @@ void AVDemuxThread::seek(qint64 pos, SeekType type)
     if (video_thread) {
         video_thread->packetQueue()->clear();
     }
-    class SeekTask : public QRunnable {
-    public:
-        SeekTask(AVDemuxThread *dt, qint64 t, SeekType st)
-            : demux_thread(dt)
-            , type(st)
-            , position(t)
-        {}
-        void run() {
-            demux_thread->seekInternal(position, type);
-        }
-    private:
-        AVDemuxThread *demux_thread;
-        SeekType type;
-        qint64 position;
-    };
-    newSeekRequest(new SeekTask(this, pos, type));
+    while (!seek_lock.testAndSetAcquire(0, 1))
+        QThread::yieldCurrentThread();
+    seek_pos = pos;
+    seek_type = type;
+    Tracer::instant("seek request", qreal(pos)/1000.0);
+    seek_pending.fetchAndStoreOrdered(1); // an older request is overwritten
+    seek_lock.fetchAndStoreRelease(0);
+    wakeUp(); // paused or at the end
 }
 
 void AVDemuxThread::seekInternal(qint64 pos, SeekType type)
 {
     AVThread* av[] = { audio_thread, video_thread};
+    TraceScope trace("seek", qreal(pos)/1000.0);
     qDebug("seek to %s %lld ms (%f%%)", QTime(0, 0, 0).addMSecs(pos).toString().toUtf8().constData(), pos, double(pos - demuxer->startTime())/double(demuxer->duration())*100.0);
     demuxer->setSeekType(type);
     demuxer->seek(pos);
@@ -176,6 +178,7 @@ void AVDemuxThread::seekInternal(qint64 pos, SeekType type)
         ademuxer->seek(pos);
     }
     AVThread *watch_thread = 0;
+    clearCache();
     // TODO: why queue may not empty?
     for (size_t i = 0; i < sizeof(av)/sizeof(av[0]); ++i) {
         AVThread *t = av[i];
@@ -203,31 +206,26 @@ void AVDemuxThread::seekInternal(qint64 pos, SeekType type)
     }
 }
 
-void AVDemuxThread::newSeekRequest(QRunnable *r)
-{
-    if (seek_tasks.size() >= seek_tasks.capacity()) {
-        QRunnable *r = seek_tasks.take();
-        if (r->autoDelete())
-            delete r;
-    }
-    seek_tasks.put(r);
-}
-
 void AVDemuxThread::processNextSeekTask()
 {
-    if (seek_tasks.isEmpty())
+    if (!atomic_load_acquire(seek_pending))
         return;
-    QRunnable *task = seek_tasks.take();
-    if (!task)
-        return;
-    task->run();
-    if (task->autoDelete())
-        delete task;
+    while (!seek_lock.testAndSetAcquire(0, 1))
+        QThread::yieldCurrentThread();
+    const qint64 pos = seek_pos;
+    const SeekType type = seek_type;
+    seek_pending.fetchAndStoreOrdered(0);
+    seek_lock.fetchAndStoreRelease(0);
+    seekInternal(pos, type);
 }
 
 void AVDemuxThread::pauseInternal(bool value)
 {
+    QMutexLocker lock(&wait_mutex);
+    Q_UNUSED(lock);
     paused = value;
+    if (!paused)
+        cond.wakeAll();
 }
 
 bool AVDemuxThread::isPaused() const
@@ -245,6 +243,33 @@ PacketBuffer* AVDemuxThread::buffer()
     return m_buffer;
 }
 
+void AVDemuxThread::setStatistics(Statistics *s)
+{
+    m_statistics = s;
+}
+
+/*
+ * stream data may be group by group: aaaaaaavvvvvvvaaaaaaaavvvvvvvvvaaaaaa.
+ * If we block on the full video queue here, audio queue will starve and audio output underruns.
+ * So the queues block when full, except that video packets are parked in the video cache and reading goes on while the
+ * audio queue is not enough. If the cache is too large, the queue stops blocking and grows instead.
+ */
+void AVDemuxThread::enqueue(int index, PacketBuffer *queue, const Packet &pkt, PacketBuffer *other)
+{
+    InterleaveCache &cache = m_cache[index];
+    if (!cache.put(queue, pkt, other) || !m_statistics)
+        return;
+    Statistics::Common &st = index == kAudioCache ? m_statistics->audio : m_statistics->video;
+    st.reordered_packets++;
+    st.max_reorder_depth = qMax(st.max_reorder_depth, cache.size());
+}
+
+void AVDemuxThread::clearCache()
+{
+    for (int i = 0; i < 2; ++i)
+        m_cache[i].clear();
+}
+
 void AVDemuxThread::updateBufferState()
 {
     if (!m_buffer)
@@ -255,6 +280,7 @@ void AVDemuxThread::updateBufferState()
     if (m_buffering == m_buffer->isBuffering())
         return;
     m_buffering = m_buffer->isBuffering();
+    Tracer::instant(m_buffering ? "buffering" : "buffered");
     Q_EMIT mediaStatusChanged(m_buffering ? QtAV::BufferingMedia : QtAV::BufferedMedia);
     // state change to buffering, report progress immediately. otherwise we have to wait to read 1 packet.
     if (m_buffering) {
@@ -281,20 +307,24 @@ void AVDemuxThread::stop()
         }
     }
     pause(false);
-    cond.wakeAll();
     qDebug("all avthread finished. try to exit demux thread<<<<<<");
     end = true;
+    wakeUp();
 }
 
 void AVDemuxThread::pause(bool p, bool wait)
 {
-    if (paused == p)
-        return;
-    paused = p;
-    user_paused = paused;
-    if (!paused)
-        cond.wakeAll();
-    else {
+    {
+        QMutexLocker lock(&wait_mutex);
+        Q_UNUSED(lock);
+        if (paused == p)
+            return;
+        paused = p;
+        user_paused = paused;
+        if (!paused)
+            cond.wakeAll();
+    }
+    if (p) {
         if (wait) {
             // block until current loop finished
             buffer_mutex.lock();
@@ -389,6 +419,7 @@ void AVDemuxThread::onAVThreadQuit()
             return;
     }
     end = true; //(!audio_thread || !audio_thread->isRunning()) &&
+    wakeUp();
 }
 
 void AVDemuxThread::run()
@@ -419,7 +450,8 @@ void AVDemuxThread::run()
         vqueue->setBlocking(true);
     }
     connect(thread, SIGNAL(seekFinished(qint64)), this, SIGNAL(seekFinished(qint64)), Qt::DirectConnection);
-    seek_tasks.clear();
+    seek_pending.fetchAndStoreOrdered(0);
+    clearCache();
     bool was_end = false;
     if (ademuxer) {
         ademuxer->seek(0LL);
@@ -428,7 +460,17 @@ void AVDemuxThread::run()
         processNextSeekTask();
         //vthread maybe changed by AVPlayer.setPriority() from no dec case
         vqueue = video_thread ? video_thread->packetQueue() : 0;
+        // cached packets were read earlier than the current one
+        if (aqueue && !m_cache[kAudioCache].isEmpty())
+            m_cache[kAudioCache].flush(aqueue, false);
+        if (vqueue && !m_cache[kVideoCache].isEmpty())
+            m_cache[kVideoCache].flush(vqueue, false);
         if (demuxer->atEnd()) {
+            // eof packet must be the last one
+            if (aqueue)
+                m_cache[kAudioCache].flush(aqueue, true);
+            if (vqueue)
+                m_cache[kVideoCache].flush(vqueue, true);
             // if avthread may skip 1st eof packet because of a/v sync
             if (aqueue && (!was_end || aqueue->isEmpty())) {
                 aqueue->put(Packet::createEOF());
@@ -439,10 +481,11 @@ void AVDemuxThread::run()
                 vqueue->blockEmpty(false);
             }
             m_buffering = false;
+            Tracer::instant("end of stream");
             Q_EMIT mediaStatusChanged(QtAV::BufferedMedia);
             was_end = true;
-            // wait for a/v thread finished
-            msleep(100);
+            // wait for a/v thread finished, a seek request or a drained queue (eof may be skipped)
+            waitEvent();
             continue;
         }
         was_end = false;
@@ -450,7 +493,15 @@ void AVDemuxThread::run()
             continue; //the queue is empty and will block
         }
         updateBufferState();
-        if (!demuxer->readFrame()) {
+        StageTimer read_timer(m_statistics, Statistics::DemuxRead);
+        Tracer::begin("readFrame");
+        const bool read_ok = demuxer->readFrame();
+        if (read_ok)
+            Tracer::end("readFrame", demuxer->packet().pts);
+        else
+            Tracer::end("readFrame");
+        read_timer.stop();
+        if (!read_ok) {
             continue;
         }
         stream = demuxer->stream();
@@ -493,7 +544,7 @@ void AVDemuxThread::run()
          * stream data: aaaaaaavvvvvvvaaaaaaaavvvvvvvvvaaaaaa, it happens
          * stream data: aavavvavvavavavavavavavavvvaavavavava, it's ok
          */
-        //TODO: use cache queue, take from cache queue if not empty?
+        // badly interleaved streams are handled by the side cache. see enqueue()
         const bool a_internal = stream == demuxer->audioStream();
         if (a_internal || a_ext > 0) {//apkt.isValid()) {
             if (a_internal && !a_ext) // internal is always read even if external audio used
@@ -504,17 +555,17 @@ void AVDemuxThread::run()
             if (aqueue) {
                 if (!audio_thread || !audio_thread->isRunning()) {
                     aqueue->clear();
+                    m_cache[kAudioCache].clear();
                     continue;
                 }
                 // must ensure bufferValue set correctly before continue
                 if (m_buffer != aqueue)
                     aqueue->setBufferValue(m_buffer->isBuffering() ? std::numeric_limits<qint64>::max() : buf2);
-                // always block full if no vqueue because empty callback may set false
-                // attached picture is cover for song, 1 frame
-                aqueue->blockFull(!video_thread || !video_thread->isRunning() || !vqueue || audio_has_pic);
+                // empty callback may set false. enqueue() does not block while the video queue is starving
+                aqueue->blockFull(true);
                 // external audio: a_ext < 0, stream = audio_idx=>put invalid packet
                 if (a_ext >= 0)
-                    aqueue->put(apkt); //affect video_thread
+                    enqueue(kAudioCache, aqueue, apkt, video_thread && video_thread->isRunning() && !audio_has_pic ? vqueue : 0); //affect video_thread
             }
         }
         // always check video stream if use external audio
@@ -522,10 +573,11 @@ void AVDemuxThread::run()
             if (vqueue) {
                 if (!video_thread || !video_thread->isRunning()) {
                     vqueue->clear();
+                    m_cache[kVideoCache].clear();
                     continue;
                 }
-                vqueue->blockFull(!audio_thread || !audio_thread->isRunning() || !aqueue || aqueue->isEnough());
-                vqueue->put(pkt); //affect audio_thread
+                vqueue->blockFull(true);
+                enqueue(kVideoCache, vqueue, pkt, audio_thread && audio_thread->isRunning() && !audio_has_pic ? aqueue : 0); //affect audio_thread
             }
         } else if (demuxer->subtitleStreams().contains(stream)) { //subtitle
             Q_EMIT internalSubtitlePacketRead(demuxer->subtitleStreams().indexOf(stream), pkt);
@@ -535,6 +587,7 @@ void AVDemuxThread::run()
     }
     m_buffering = false;
     m_buffer = 0;
+    clearCache();
     while (audio_thread && audio_thread->isRunning()) {
         qDebug("waiting audio thread.......");
         aqueue->blockEmpty(false); //FIXME: why need this
@@ -550,14 +603,32 @@ void AVDemuxThread::run()
     emit mediaStatusChanged(QtAV::EndOfMedia);
 }
 
-bool AVDemuxThread::tryPause(unsigned long timeout)
+bool AVDemuxThread::tryPause()
 {
     if (!paused)
         return false;
-    QMutexLocker lock(&buffer_mutex);
+    QMutexLocker lock(&wait_mutex);
     Q_UNUSED(lock);
-    cond.wait(&buffer_mutex, timeout);
+    while (paused && !end && !atomic_load_acquire(seek_pending))
+        cond.wait(&wait_mutex);
     return true;
 }
 
+void AVDemuxThread::waitEvent()
+{
+    QMutexLocker lock(&wait_mutex);
+    Q_UNUSED(lock);
+    while (!m_wake && !end && !atomic_load_acquire(seek_pending))
+        cond.wait(&wait_mutex);
+    m_wake = false;
+}
+
+void AVDemuxThread::wakeUp()
+{
+    QMutexLocker lock(&wait_mutex);
+    Q_UNUSED(lock);
+    m_wake = true;
+    cond.wakeAll();
+}
+
 } //namespace QtAV
@@ -27,12 +27,14 @@
 #include <QtCore/QThread>
 #include <QtCore/QRunnable>
 #include "QtAV/CommonTypes.h"
+#include "InterleaveCache.h"
 #include "PacketBuffer.h"
 
 namespace QtAV {
 
 class AVDemuxer;
 class AVThread;
+class Statistics;
 class AVDemuxThread : public QThread
 {
     Q_OBJECT
@@ -51,6 +53,9 @@ public:
     bool isEnd() const;
     PacketBuffer* buffer();
     void updateBufferState();
+    void setStatistics(Statistics *s); // reorder info of side cache
+    // wake up the thread waiting for an event at the end of media, e.g. a queue is drained
+    void wakeUp();
 public slots:
     void stop(); //TODO: remove it?
     void pause(bool p, bool wait = false);
@@ -70,17 +75,24 @@ private slots:
 protected:
     virtual void run();
     /*
-     * If the pause state is true setted by pause(true), then block the thread and wait for pause state changed, i.e. pause(false)
-     * and return true. Otherwise, return false immediatly.
+     * If the pause state is true setted by pause(true), then block the thread and wait for pause state changed, i.e. pause(false),
+     * a seek request or stop, and return true. Otherwise, return false immediatly.
      */
-    bool tryPause(unsigned long timeout = 100);
+    bool tryPause();
+    // block until wakeUp(), a seek request or stop. used at the end of media instead of polling
+    void waitEvent();
 
 private:
     void setAVThread(AVThread *&pOld, AVThread* pNew);
-    void newSeekRequest(QRunnable *r);
     void processNextSeekTask();
     void seekInternal(qint64 pos, SeekType type); //must call in AVDemuxThread
     void pauseInternal(bool value);
+    /*!
+     * put pkt to queue, or to the side cache of the stream if queue is full but other is starving.
+     * index: kAudioCache or kVideoCache
+     */
+    void enqueue(int index, PacketBuffer *queue, const Packet& pkt, PacketBuffer *other);
+    void clearCache();
 
     bool paused;
     bool user_paused;
@@ -92,13 +104,22 @@ private:
     AVThread *audio_thread, *video_thread;
     int audio_stream, video_stream;
     QMutex buffer_mutex;
+    QMutex wait_mutex; // for cond
     QWaitCondition cond;
-    BlockingQueue<QRunnable*> seek_tasks;
+    bool m_wake; // wakeUp() is called. protected by wait_mutex
+    // the latest seek request, only it matters. set in any thread, taken in demux thread. no allocation
+    QAtomicInt seek_lock; // spin lock for seek_pos and seek_type, held for a few instructions
+    QAtomicInt seek_pending;
+    qint64 seek_pos;
+    SeekType seek_type;
 
     QAtomicInt nb_next_frame;
     QMutex next_frame_mutex;
     int clock_type; // change happens in different threads(direct connection)
-    friend class SeekTask;
+    enum { kAudioCache = 0, kVideoCache = 1 };
+    // per stream overflow cache. accessed in demux thread only
+    InterleaveCache m_cache[2];
+    Statistics *m_statistics;
 };
 
 } //namespace QtAV
@@ -22,6 +22,7 @@
 #include "QtAV/AVDemuxer.h"
 #include "QtAV/MediaIO.h"
 #include "QtAV/private/AVCompat.h"
+#include "KeyFrameIndex.h"
 #include <QtCore/QMutex>
 #include <QtCore/QStringList>
 #if QT_VERSION >= QT_VERSION_CHECK(4, 7, 0)
@@ -37,6 +38,26 @@ namespace QtAV {
 static const char kFileScheme[] = "file:";
 extern QString getLocalPath(const QString& fullPath);
 
+/*
+ * A byte seek skips the demuxer's own seek and resyncs from the byte position. It lands on a packet boundary only for
+ * streams which can be resynced anywhere: mpeg ts/ps (AVFMT_TS_DISCONT) and raw elementary streams. For others, e.g.
+ * mkv, avi and mp4, it may land in the middle of a cluster/chunk, so the key frame index is not used.
+ */
+static bool isByteSeekSafe(const AVInputFormat *fmt)
+{
+    if (!fmt || (fmt->flags & AVFMT_NO_BYTE_SEEK))
+        return false;
+    if (fmt->flags & AVFMT_TS_DISCONT)
+        return true;
+    static const char* const kRawFormats[] = { "mpegts", "h264", "hevc", "mpegvideo", "m4v", "cavsvideo", "vc1", 0 };
+    const QList<QByteArray> names(QByteArray(fmt->name).split(','));
+    for (int i = 0; kRawFormats[i]; ++i) {
+        if (names.contains(QByteArray(kRawFormats[i])))
+            return true;
+    }
+    return false;
+}
+
 class AVDemuxer::InterruptHandler : public AVIOInterruptCB
 {
 public:
@@ -205,9 +226,19 @@ public:
         , input(0)
         , seek_unit(SeekByTime)
         , seek_type(AccurateSeek)
+        , kf_mode(AVDemuxer::KeyFrameIndexOnRead)
+        , kf_enabled(false)
+        , kf_persistent(false)
         , dict(0)
         , interrupt_hanlder(0)
-    {}
+    {
+        const QByteArray env = qgetenv("QTAV_KEYFRAME_INDEX").toLower();
+        if (env == "off" || env == "0")
+            kf_mode = AVDemuxer::NoKeyFrameIndex;
+        else if (env == "scan")
+            kf_mode = AVDemuxer::KeyFrameIndexScan;
+        kf_persistent = qgetenv("QTAV_KEYFRAME_INDEX_CACHE") == "1";
+    }
     ~Private() {
         delete interrupt_hanlder;
         if (dict) {
@@ -289,6 +320,10 @@ public:
 
     SeekUnit seek_unit;
     SeekType seek_type;
+    AVDemuxer::KeyFrameIndexMode kf_mode;
+    bool kf_enabled; // index is available for the current media
+    bool kf_persistent;
+    KeyFrameIndex kf_index;
 
     AVDictionary *dict;
     QVariantHash options;
@@ -421,6 +456,8 @@ bool AVDemuxer::readFrame()
     }
     d->pkt = Packet::fromAVPacket(&packet, av_q2d(d->format_ctx->streams[d->stream]->time_base));
     av_free_packet(&packet); //important!
+    if (d->kf_enabled && d->stream == videoStream())
+        d->kf_index.addPacket(qint64(d->pkt.pts*1000.0), d->pkt.position, d->pkt.hasKeyFrame);
     d->eof = false;
     if (d->pkt.pts > qreal(duration())/1000.0) {
         d->max_pts = d->pkt.pts;
@@ -478,11 +515,54 @@ SeekType AVDemuxer::seekType() const
     return d->seek_type;
 }
 
-//TODO: seek by byte
+void AVDemuxer::setKeyFrameIndexMode(KeyFrameIndexMode mode)
+{
+    d->kf_mode = mode;
+}
+
+AVDemuxer::KeyFrameIndexMode AVDemuxer::keyFrameIndexMode() const
+{
+    return d->kf_mode;
+}
+
+void AVDemuxer::setKeyFrameIndexPersistent(bool value)
+{
+    d->kf_persistent = value;
+}
+
+bool AVDemuxer::isKeyFrameIndexPersistent() const
+{
+    return d->kf_persistent;
+}
+
+bool AVDemuxer::seekByByte(qint64 pos)
+{
+    if (d->format_ctx->iformat->flags & AVFMT_NO_BYTE_SEEK)
+        return false;
+    const int ret = av_seek_frame(d->format_ctx, -1, pos, AVSEEK_FLAG_BYTE);
+    if (ret < 0) {
+        qWarning("seek by byte error: %s", av_err2str(ret));
+        return false;
+    }
+    d->eof = false;
+    if (d->kf_enabled)
+        d->kf_index.beginSegment();
+    return true;
+}
+
 bool AVDemuxer::seek(qint64 pos)
 {
     if (!isLoaded())
         return false;
+    if (d->seek_unit == SeekByByte) {
+        if (!seekByByte(pos)) {
+            AVError::ErrorCode ec(AVError::SeekError);
+            QString msg(tr("seek error"));
+            handleError(AVERROR(ENOSYS), &ec, msg);
+            return false;
+        }
+        return true;
+    }
     //duration: unit is us (10^-6 s, AV_TIME_BASE)
     qint64 upos = pos*1000LL;
     if (upos > startTimeUs() + durationUs() || pos < 0LL) {
@@ -496,40 +576,51 @@ bool AVDemuxer::seek(qint64 pos)
         }
     }
     d->eof = false;
-    // no lock required because in AVDemuxThread read and seek are in the same thread
+    // land on the nearest key frame before pos directly, the least frames to decode for accurate seek.
+    // the index is enabled only if byte seek is safe for the format, see load()
+    KeyFrameIndex::Entry e;
+    const bool indexed = d->kf_enabled && d->seek_type != AnyFrameSeek
+            && d->kf_index.find(pos, &e) && e.pos >= 0 && seekByByte(e.pos);
+    if (indexed) {
+        qDebug("seek to indexed key frame %lld ms @%lld for %lld ms", e.pts, e.pos, pos);
+    } else {
+        // no lock required because in AVDemuxThread read and seek are in the same thread
 #if 0
-    //t: unit is s
-    qreal t = q;// * (double)d->format_ctx->duration; //
-    int ret = av_seek_frame(d->format_ctx, -1, (int64_t)(t*AV_TIME_BASE), t > d->pkt.pts ? 0 : AVSEEK_FLAG_BACKWARD);
-    qDebug("[AVDemuxer] seek to %f %f %lld / %lld", q, d->pkt.pts, (int64_t)(t*AV_TIME_BASE), durationUs());
+        //t: unit is s
+        qreal t = q;// * (double)d->format_ctx->duration; //
+        int ret = av_seek_frame(d->format_ctx, -1, (int64_t)(t*AV_TIME_BASE), t > d->pkt.pts ? 0 : AVSEEK_FLAG_BACKWARD);
+        qDebug("[AVDemuxer] seek to %f %f %lld / %lld", q, d->pkt.pts, (int64_t)(t*AV_TIME_BASE), durationUs());
 #else
-    //TODO: d->pkt.pts may be 0, compute manually.
-
-    bool backward = d->seek_type == AccurateSeek || upos <= (int64_t)(d->pkt.pts*AV_TIME_BASE);
-    //qDebug("[AVDemuxer] seek to %f %f %lld / %lld backward=%d", double(upos)/double(durationUs()), d->pkt.pts, upos, durationUs(), backward);
-    //AVSEEK_FLAG_BACKWARD has no effect? because we know the timestamp
-    // FIXME: back flag is opposite? otherwise seek is bad and may crash?
-    /* If stread->inputdex is (-1), a default
-     * stream is selected, and timestamp is automatically converted
-     * from AV_TIME_BASE units to the stream specific time_base.
-     */
-    int seek_flag = (backward ? AVSEEK_FLAG_BACKWARD : 0);
-    if (d->seek_type == AccurateSeek) {
-        seek_flag = AVSEEK_FLAG_BACKWARD;
-    }
-    if (d->seek_type == AnyFrameSeek) {
-        seek_flag = AVSEEK_FLAG_ANY;
-    }
-    //bool seek_bytes = !!(d->format_ctx->iformat->flags & AVFMT_TS_DISCONT) && strcmp("ogg", d->format_ctx->iformat->name);
-    int ret = av_seek_frame(d->format_ctx, -1, upos, seek_flag);
-    //int ret = avformat_seek_file(d->format_ctx, -1, INT64_MIN, upos, upos, seek_flag);
-    //avformat_seek_file()
+        //TODO: d->pkt.pts may be 0, compute manually.
+
+        bool backward = d->seek_type == AccurateSeek || upos <= (int64_t)(d->pkt.pts*AV_TIME_BASE);
+        //qDebug("[AVDemuxer] seek to %f %f %lld / %lld backward=%d", double(upos)/double(durationUs()), d->pkt.pts, upos, durationUs(), backward);
+        //AVSEEK_FLAG_BACKWARD has no effect? because we know the timestamp
+        // FIXME: back flag is opposite? otherwise seek is bad and may crash?
+        /* If stread->inputdex is (-1), a default
+         * stream is selected, and timestamp is automatically converted
+         * from AV_TIME_BASE units to the stream specific time_base.
+         */
+        int seek_flag = (backward ? AVSEEK_FLAG_BACKWARD : 0);
+        if (d->seek_type == AccurateSeek) {
+            seek_flag = AVSEEK_FLAG_BACKWARD;
+        }
+        if (d->seek_type == AnyFrameSeek) {
+            seek_flag = AVSEEK_FLAG_ANY;
+        }
+        //bool seek_bytes = !!(d->format_ctx->iformat->flags & AVFMT_TS_DISCONT) && strcmp("ogg", d->format_ctx->iformat->name);
+        int ret = av_seek_frame(d->format_ctx, -1, upos, seek_flag);
+        //int ret = avformat_seek_file(d->format_ctx, -1, INT64_MIN, upos, upos, seek_flag);
+        //avformat_seek_file()
 #endif
-    if (ret < 0) {
-        AVError::ErrorCode ec(AVError::SeekError);
-        QString msg(tr("seek error"));
-        handleError(ret, &ec, msg);
-        return false;
+        if (ret < 0) {
+            AVError::ErrorCode ec(AVError::SeekError);
+            QString msg(tr("seek error"));
+            handleError(ret, &ec, msg);
+            return false;
+        }
+        if (d->kf_enabled)
+            d->kf_index.beginSegment();
     }
     // TODO: replay
     if (upos <= startTime()) {
@@ -768,6 +859,13 @@ bool AVDemuxer::load()
     d->seekable = d->checkSeekable();
     if (was_seekable != d->seekable)
         emit seekableChanged();
+    if (d->kf_mode != NoKeyFrameIndex && d->seekable && !d->network && !d->input && d->vstream.stream >= 0
+            && isByteSeekSafe(d->format_ctx->iformat)) {
+        d->kf_index.setPersistent(d->kf_persistent);
+        d->kf_enabled = d->kf_index.setFile(d->file);
+        if (d->kf_enabled && d->kf_mode == KeyFrameIndexScan)
+            d->kf_index.scanAsync();
+    }
     qDebug("avfmtctx.flag: %d", d->format_ctx->flags);
     qDebug("AVFMT_NOTIMESTAMPS: %d, AVFMT_TS_DISCONT: %d, AVFMT_NO_BYTE_SEEK:%d"
            , d->format_ctx->flags&AVFMT_NOTIMESTAMPS
@@ -787,6 +885,12 @@ bool AVDemuxer::unload()
         emit seekableChanged();
     }
     */
+    if (d->kf_enabled) {
+        d->kf_index.stopScan();
+        d->kf_index.save();
+        d->kf_index.reset();
+        d->kf_enabled = false;
+    }
     d->network = false;
     d->has_attached_pic = false;
     d->eof = false; // true and set false in load()?
@@ -79,6 +79,7 @@ AVPlayer::AVPlayer(QObject *parent) :
     connect(&d->demuxer, SIGNAL(seekableChanged()), this, SIGNAL(seekableChanged()));
     d->read_thread = new AVDemuxThread(this);
     d->read_thread->setDemuxer(&d->demuxer);
+    d->read_thread->setStatistics(&d->statistics);
     //direct connection can not sure slot order?
     connect(d->read_thread, SIGNAL(finished()), this, SLOT(stopFromDemuxerThread()));
     connect(d->read_thread, SIGNAL(requestClockPause(bool)), masterClock(), SLOT(pause(bool)), Qt::DirectConnection);
@@ -233,6 +234,18 @@ qreal AVPlayer::forcedFrameRate() const
     return d->force_fps;
 }
 
+void AVPlayer::setVideoPipelineDepth(int value)
+{
+    d->video_pipeline_depth = qMax(0, value);
+    if (d->vthread)
+        d->vthread->setPipelineDepth(d->video_pipeline_depth);
+}
+
+int AVPlayer::videoPipelineDepth() const
+{
+    return d->video_pipeline_depth;
+}
+
 const Statistics& AVPlayer::statistics() const
 {
     return d->statistics;
@@ -100,6 +100,7 @@ AVPlayer::Private::Private()
     , seek_type(AccurateSeek)
     , interrupt_timeout(30000)
     , force_fps(0)
+    , video_pipeline_depth(qMax(0, qgetenv("QTAV_VIDEO_PIPELINE").toInt()))
     , notify_interval(-500)
     , status(NoMedia)
 {
@@ -555,6 +556,7 @@ bool AVPlayer::Private::setupVideoThread(AVPlayer *player)
     vthread->setBrightness(brightness);
     vthread->setContrast(contrast);
     vthread->setSaturation(saturation);
+    vthread->setPipelineDepth(video_pipeline_depth);
     updateBufferValue(vthread->packetQueue());
     initVideoStatistics(demuxer.videoStream());
 
@@ -152,6 +152,7 @@ public:
     qint64 interrupt_timeout;
 
     qreal force_fps;
+    int video_pipeline_depth;
     // timerEvent interval in ms. can divide 1000. depends on media duration, fps etc.
     // <0: auto compute internally, |notify_interval| is the real interval
     int notify_interval;
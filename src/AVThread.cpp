@@ -20,6 +20,7 @@
 ******************************************************************************/
 
 #include "AVThread.h"
+#include <limits>
 #include "AVThread_p.h"
 #include "QtAV/AVClock.h"
 #include "QtAV/AVDecoder.h"
@@ -32,13 +33,18 @@ namespace QtAV {
 
 QVariantHash AVThreadPrivate::dec_opt_framedrop;
 QVariantHash AVThreadPrivate::dec_opt_normal;
+QVariantHash AVThreadPrivate::dec_opt_skiplf;
 
 AVThreadPrivate::~AVThreadPrivate() {
-    stop = true;
-    if (!paused) {
-        qDebug("~AVThreadPrivate wake up paused thread");
-        paused = false;
-        next_pause = false;
+    {
+        QMutexLocker lock(&wait_mutex);
+        Q_UNUSED(lock);
+        stop = true;
+        if (!paused) {
+            qDebug("~AVThreadPrivate wake up paused thread");
+            paused = false;
+            next_pause = false;
+        }
         cond.wakeAll();
     }
     ready_cond.wakeAll();
@@ -117,40 +123,60 @@ const QList<Filter*>& AVThread::filters() const
     return d_func().filters;
 }
 
+void AVThread::postCommand(int type, int value)
+{
+    d_func().commands.post(type, value);
+    wakeForTask();
+}
+
+void AVThread::addCommand(int type)
+{
+    d_func().commands.add(type);
+    wakeForTask();
+}
+
 void AVThread::scheduleTask(QRunnable *task)
 {
-    d_func().tasks.put(task);
+    DPTR_D(AVThread);
+    d.tasks.put(task);
+    d.nb_tasks.ref();
+    wakeForTask();
+}
+
+void AVThread::wakeForTask()
+{
+    DPTR_D(AVThread);
+    // the thread may be blocked in tryPause() or OutputSet::pauseThread(). playing thread is never blocked by a lock here
+    if (isPaused()) {
+        QMutexLocker lock(&d.wait_mutex);
+        Q_UNUSED(lock);
+        d.cond.wakeAll();
+    }
+    if (d.outputSet && d.outputSet->canPauseThread())
+        d.outputSet->resumeThread();
 }
 
 void AVThread::scheduleFrameDrop(bool value)
 {
-    class FrameDropTask : public QRunnable {
-        AVDecoder *decoder;
-        bool drop;
-    public:
-        FrameDropTask(AVDecoder *dec, bool value) : decoder(dec), drop(value) {}
-        void run() Q_DECL_OVERRIDE {
-            if (!decoder)
-                return;
-            if (drop)
-                decoder->setOptions(AVThreadPrivate::dec_opt_framedrop);
-            else
-                decoder->setOptions(AVThreadPrivate::dec_opt_normal);
-        }
-    };
-    scheduleTask(new FrameDropTask(decoder(), value));
+    postCommand(CommandFrameDrop, value);
 }
 
 // TODO: shall we close decoder here?
 void AVThread::stop()
 {
     DPTR_D(AVThread);
-    d.stop = true; //stop as soon as possible
+    {
+        QMutexLocker lock(&d.wait_mutex);
+        Q_UNUSED(lock);
+        d.stop = true; //stop as soon as possible
+    }
     QMutexLocker locker(&d.mutex);
     Q_UNUSED(locker);
     d.packets.setBlocking(false); //stop blocking take()
     d.packets.clear();
     pause(false);
+    if (d.outputSet)
+        d.outputSet->resumeThread();
     QMutexLocker lock(&d.ready_mutex);
     d.ready = false;
     //terminate();
@@ -160,6 +186,8 @@ void AVThread::stop()
 void AVThread::pause(bool p)
 {
     DPTR_D(AVThread);
+    QMutexLocker lock(&d.wait_mutex);
+    Q_UNUSED(lock);
     if (d.paused == p)
         return;
     d.paused = p;
@@ -173,6 +201,8 @@ void AVThread::pause(bool p)
 void AVThread::nextAndPause()
 {
     DPTR_D(AVThread);
+    QMutexLocker lock(&d.wait_mutex);
+    Q_UNUSED(lock);
     d.next_pause = true;
     d.paused = true;
     d.cond.wakeAll();
@@ -254,6 +284,8 @@ void AVThread::resetState()
     DPTR_D(AVThread);
     pause(false);
     d.tasks.clear();
+    d.nb_tasks.fetchAndStoreOrdered(0);
+    d.commands.clear(); // commands for the previous playback
     d.render_pts0 = -1;
     d.stop = false;
     d.packets.setBlocking(true);
@@ -263,31 +295,53 @@ void AVThread::resetState()
     d.ready_cond.wakeOne();
 }
 
-bool AVThread::tryPause(unsigned long timeout)
+bool AVThread::tryPause()
 {
     DPTR_D(AVThread);
     if (!isPaused())
         return false;
-    QMutexLocker lock(&d.mutex);
+    QMutexLocker lock(&d.wait_mutex);
     Q_UNUSED(lock);
-    return d.cond.wait(&d.mutex, timeout);
-    qDebug("paused thread waked up!!!");
-    return true;
+    // a task scheduled before locking is not lost: tasks is checked with the lock held
+    while (d.paused && !d.next_pause && !d.stop && d.commands.isEmpty() && atomic_load_acquire(d.nb_tasks) <= 0)
+        d.cond.wait(&d.wait_mutex);
+    if (d.next_pause) { // decode 1 frame then keep paused
+        d.next_pause = false;
+        return true;
+    }
+    return !d.paused || d.stop;
 }
 
 bool AVThread::processNextTask()
 {
     DPTR_D(AVThread);
-    if (d.tasks.isEmpty())
+    const int pending = d.commands.takePending();
+    if (pending)
+        processCommands(pending);
+    if (atomic_load_acquire(d.nb_tasks) <= 0)
         return true;
-    QRunnable *task = d.tasks.take();
-    task->run();
-    if (task->autoDelete()) {
-        delete task;
+    // run all pending tasks with 1 lock round trip
+    const QList<QRunnable*> tasks(d.tasks.takeUpTo(std::numeric_limits<int>::max()));
+    d.nb_tasks.fetchAndAddOrdered(-tasks.size());
+    foreach (QRunnable *task, tasks) {
+        task->run();
+        if (task->autoDelete()) {
+            delete task;
+        }
     }
     return true;
 }
 
+void AVThread::processCommands(int pending)
+{
+    DPTR_D(AVThread);
+    if (pending & (1 << CommandFrameDrop)) {
+        const int drop = d.commands.take(CommandFrameDrop);
+        if (d.dec && drop != d.commands.kNoValue)
+            d.dec->setOptions(drop ? AVThreadPrivate::dec_opt_framedrop : AVThreadPrivate::dec_opt_normal);
+    }
+}
+
 void AVThread::setStatistics(Statistics *statistics)
 {
     DPTR_D(AVThread);
@@ -73,7 +73,18 @@ public:
     bool uninstallFilter(Filter *filter, bool lock = true);
     const QList<Filter *> &filters() const;
 
-    // TODO: resample, resize task etc.
+    /*!
+     * Typed commands, from any thread. No allocation or lock, and only the latest value of a command is processed.
+     * Subclasses add command types from CommandUser and handle them in processCommands().
+     */
+    enum Command {
+        CommandFrameDrop = 0, // value: bool
+        CommandUser,
+        kMaxCommands = 16
+    };
+    void postCommand(int type, int value); // latest value wins
+    void addCommand(int type); // not coalesced, value is the number of requests
+    // rare tasks that can not be a command, e.g. change decoder. the task is allocated and queued
     void scheduleTask(QRunnable *task);
     void scheduleFrameDrop(bool value = true);
 
@@ -94,17 +105,25 @@ protected:
     AVThread(AVThreadPrivate& d, QObject *parent = 0);
     void resetState();
     /*
-     * If the pause state is true setted by pause(true), then block the thread and wait for pause state changed, i.e. pause(false)
-     * and return true. Otherwise, return false immediatly.
+     * If the pause state is true setted by pause(true), then block the thread until pause(false), nextAndPause(), stop() or a new task.
+     * Return true if the thread can go on (resumed, stopped, or 1 frame is requested), false if not paused or still paused
+     * (process pending tasks and try again).
+     * No timeout, so an idle paused thread never wakes up by itself.
+     */
+    bool tryPause();
+    bool processNextTask(); //in AVThread. no lock if no task is scheduled
+    /*!
+     * \brief processCommands
+     * Called by processNextTask() in AVThread. Take values by d.commands.take(type).
+     * \param pending bit (1<<type) is set for posted commands
      */
-    // has timeout so that the pending tasks can be processed
-    bool tryPause(unsigned long timeout = 100);
-    bool processNextTask(); //in AVThread
+    virtual void processCommands(int pending);
     void waitAndCheck(ulong value, qreal pts);
 
     DPTR_DECLARE(AVThread)
 
 private:
+    void wakeForTask(); // wake up if paused
     void setStatistics(Statistics* statistics);
     friend class AVPlayer;
 };
@@ -24,9 +24,13 @@
 
 #include <QtCore/QMutex>
 #include <QtCore/QMutexLocker>
+#include <QtCore/QQueue>
 #include <QtCore/QVariant>
 #include <QtCore/QWaitCondition>
 #include "PacketBuffer.h"
+#include "AVThread.h"
+#include "utils/BlockingQueue.h"
+#include "utils/CommandSlots.h"
 
 class QRunnable;
 namespace QtAV {
@@ -58,9 +62,12 @@ public:
 
         QVariantHash opt;
         opt[QString::fromLatin1("skip_frame")] = 8; // 8 for "avcodec", "NoRef" for "FFmpeg". see AVDiscard
+        opt[QString::fromLatin1("skip_loop_filter")] = 0;
         dec_opt_framedrop[QString::fromLatin1("avcodec")] = opt;
         opt[QString::fromLatin1("skip_frame")] = 0; // 0 for "avcodec", "Default" for "FFmpeg". see AVDiscard
         dec_opt_normal[QString::fromLatin1("avcodec")] = opt; // avcodec need correct string or value in libavcodec
+        opt[QString::fromLatin1("skip_loop_filter")] = 48; // AVDISCARD_ALL
+        dec_opt_skiplf[QString::fromLatin1("avcodec")] = opt;
     }
     virtual ~AVThreadPrivate();
 
@@ -71,18 +78,21 @@ public:
     AVDecoder *dec;
     OutputSet *outputSet;
     QMutex mutex;
-    QWaitCondition cond; //pause
+    QMutex wait_mutex; // for cond. paused, next_pause and stop are changed with it to avoid lost wake up
+    QWaitCondition cond; //pause. woken up by unpause, next frame, stop and new task
     qreal delay;
     QList<Filter*> filters;
     Statistics *statistics; //not obj. Statistics is unique for the player, which is in AVPlayer
     BlockingQueue<QRunnable*> tasks;
+    QAtomicInt nb_tasks; // check tasks without lock. can be < 0 temporarily
+    CommandSlots<AVThread::kMaxCommands> commands;
     QWaitCondition ready_cond;
     QMutex ready_mutex;
     bool ready;
     //only decode video without display or skip decode audio until pts reaches
     qreal render_pts0;
 
-    static QVariantHash dec_opt_framedrop, dec_opt_normal;
+    static QVariantHash dec_opt_framedrop, dec_opt_normal, dec_opt_skiplf;
 };
 
 } //namespace QtAV
@@ -30,6 +30,8 @@
 #include "QtAV/Filter.h"
 #include "output/OutputSet.h"
 #include "QtAV/private/AVCompat.h"
+#include "StageTimer.h"
+#include "utils/Tracer.h"
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDateTime>
 #include "utils/Logger.h"
@@ -95,6 +97,8 @@ void AudioThread::run()
                 continue;
         }
         if (!pkt.isValid() && !pkt.isEOF()) { // can't seek back if eof packet is read
+            StageTimer::addQueueDepth(d.statistics, Statistics::AudioPacketQueue, d.packets.size());
+            StageTimer wait_timer(d.statistics, Statistics::AudioQueueWait);
             pkt = d.packets.take(); //wait to dequeue
         }
         if (pkt.isEOF()) {
@@ -207,7 +211,12 @@ void AudioThread::run()
             qDebug("audio thread stop before decode()");
             break;
         }
-        if (!dec->decode(pkt)) {
+        StageTimer dec_timer(d.statistics, Statistics::AudioDecode);
+        TraceScope dec_trace("audio decode", pkt.pts);
+        const bool dec_ok = dec->decode(pkt);
+        dec_trace.stop();
+        dec_timer.stop();
+        if (!dec_ok) {
             qWarning("Decode audio failed. undecoded: %d", dec->undecodedSize());
             if (pkt.isEOF()) {
                 qDebug("audio decode eof done");
@@ -240,6 +249,7 @@ void AudioThread::run()
                 continue;
             }
             d.render_pts0 = -1.0;
+            Tracer::instant("audio seek finished", frame.timestamp());
             Q_EMIT seekFinished(qint64(frame.timestamp()*1000.0));
         }
         if (has_ao) {
@@ -273,7 +283,9 @@ void AudioThread::run()
             pkt.dts += chunk_delay;
             if (has_ao && ao->isOpen()) {
                 QByteArray decodedChunk = QByteArray::fromRawData(decoded.constData() + decodedPos, chunk);
+                StageTimer write_timer(d.statistics, Statistics::AudioWrite);
                 ao->play(decodedChunk, pkt.pts);
+                write_timer.stop();
                 d.clock->updateValue(ao->timestamp());
             } else {
                 d.clock->updateDelay(delay += chunk_delay);
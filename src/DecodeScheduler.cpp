@@ -0,0 +1,134 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "DecodeScheduler.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QThread>
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+DecodeScheduler& DecodeScheduler::instance()
+{
+    static DecodeScheduler s;
+    return s;
+}
+
+DecodeScheduler::DecodeScheduler()
+    : m_max(0)
+    , m_running(0)
+{
+    const QByteArray env = qgetenv("QTAV_SHARED_DECODING");
+    if (!env.isEmpty())
+        setMaxThreads(env.toInt());
+}
+
+void DecodeScheduler::setMaxThreads(int value)
+{
+    if (value < 0)
+        value = qMax(1, QThread::idealThreadCount());
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (m_max == value)
+        return;
+    qDebug("shared decoding threads: %d => %d", m_max, value);
+    m_max = value;
+    if (m_max == 0) {
+        // waiters will not call release() because acquire() returns false for them
+        foreach (Waiter *w, m_waiters) {
+            w->granted = true;
+            w->cond.wakeAll();
+        }
+        m_waiters.clear();
+        return;
+    }
+    while (!m_waiters.isEmpty() && m_running < m_max)
+        grantNext();
+}
+
+int DecodeScheduler::maxThreads() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_max;
+}
+
+bool DecodeScheduler::acquire(qreal lateness)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (m_max <= 0)
+        return false;
+    if (m_running < m_max && m_waiters.isEmpty()) {
+        m_running++;
+        return true;
+    }
+    Waiter w(lateness);
+    m_waiters.append(&w);
+    while (!w.granted)
+        w.cond.wait(&m_mutex);
+    // not counted if woken up by setMaxThreads(0)
+    return w.counted;
+}
+
+void DecodeScheduler::release()
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (m_running <= 0) {
+        qWarning("DecodeScheduler::release() without acquire()");
+        return;
+    }
+    m_running--;
+    while (!m_waiters.isEmpty() && m_running < m_max)
+        grantNext();
+}
+
+int DecodeScheduler::running() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_running;
+}
+
+int DecodeScheduler::waiting() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_waiters.size();
+}
+
+void DecodeScheduler::grantNext()
+{
+    // the latest stream first. the first waiter wins a tie, so equal streams are served in fifo order
+    int best = 0;
+    for (int i = 1; i < m_waiters.size(); ++i) {
+        if (m_waiters.at(i)->lateness > m_waiters.at(best)->lateness)
+            best = i;
+    }
+    Waiter *w = m_waiters.takeAt(best);
+    w->granted = true;
+    w->counted = true;
+    m_running++;
+    w->cond.wakeOne();
+}
+
+} //namespace QtAV
@@ -0,0 +1,83 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_DECODESCHEDULER_H
+#define QTAV_DECODESCHEDULER_H
+
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+
+namespace QtAV {
+/*!
+ * \brief The DecodeScheduler class
+ * Process wide gate shared by all video threads. When many players run in one process (video wall, multiview),
+ * at most maxThreads() decoders run at the same time, so the cores are not oversubscribed. A thread waiting for
+ * a slot reports how late its next frame is, and a released slot goes to the latest waiter first, i.e.
+ * the stream that is closest to dropping frames is decoded next.
+ * Disabled (maxThreads() == 0) by default, then acquire() returns immediately.
+ * It is a gate, not an executor, so the number of OS threads is NOT reduced: every player still owns its demux, audio
+ * and video threads, which block on their queues, clocks and outputs. Only the number of decoding threads is limited. Running those loops as resumable tasks on a shared pool would need every blocking point
+ * of AVDemuxThread, AudioThread and VideoThread to yield, and is not implemented.
+ * Usage:
+ *   const bool gated = DecodeScheduler::instance().acquire(lateness);
+ *   dec->decode(pkt);
+ *   if (gated) DecodeScheduler::instance().release();
+ */
+class DecodeScheduler
+{
+public:
+    static DecodeScheduler& instance();
+    /*!
+     * \brief setMaxThreads
+     * \param value 0: disable the gate and wake up all waiters. <0: QThread::idealThreadCount()
+     */
+    void setMaxThreads(int value);
+    int maxThreads() const;
+    /*!
+     * \brief acquire
+     * Block until a decode slot is available.
+     * \param lateness in seconds. > 0: the frame is already late. Larger value is scheduled first
+     * \return false if the gate is disabled. release() must be called iff true is returned
+     */
+    bool acquire(qreal lateness = 0);
+    void release();
+    int running() const;
+    int waiting() const;
+
+    DecodeScheduler();
+private:
+    struct Waiter {
+        Waiter(qreal l) : lateness(l), granted(false), counted(false) {}
+        qreal lateness;
+        bool granted;
+        bool counted; // granted a slot, i.e. m_running is increased
+        QWaitCondition cond;
+    };
+    void grantNext(); // lock must be held
+
+    mutable QMutex m_mutex;
+    int m_max;
+    int m_running;
+    QList<Waiter*> m_waiters;
+};
+} //namespace QtAV
+#endif // QTAV_DECODESCHEDULER_H
@@ -61,7 +61,11 @@ int Frame::bytesPerLine(int plane) const
 
 QByteArray Frame::frameData() const
 {
-    return d_func()->data;
+    Q_D(const Frame);
+    // pooled memory is reused after the frame is released, so the result can not refer to it
+    if (d->buffer)
+        return QByteArray((const char*)d->buffer->data(), d->buffer->size());
+    return d->data;
 }
 
 QByteArray Frame::data(int plane) const
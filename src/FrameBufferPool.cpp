@@ -0,0 +1,227 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/FrameBufferPool.h"
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QVector>
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+static const qint64 kDefaultMaxFreeBytes = 256*1024*1024;
+// false after the pool is destroyed at exit, frames released later free the memory directly
+static bool g_pool_alive = false;
+
+// 1/8 steps of the power of 2 below, e.g. a 1920x1080 yuv420p frame (3110400 bytes) uses a 3145728 bytes buffer
+static int sizeClass(int bytes)
+{
+    if (bytes <= 4096)
+        return FrameBufferPool::align(bytes);
+    int p = 4096;
+    while (p <= bytes/2)
+        p <<= 1;
+    const int step = p/8;
+    return (bytes + step - 1)/step*step;
+}
+
+class FrameBufferPoolPrivate : public DPtrPrivate<FrameBufferPool>
+{
+public:
+    FrameBufferPoolPrivate()
+        : max_free(kDefaultMaxFreeBytes)
+        , free_bytes(0)
+        , used_bytes(0)
+        , hits(0)
+        , misses(0)
+    {}
+    void freeAll() {
+        QHash<int, QVector<uchar*> >::iterator it = free_list.begin();
+        for (; it != free_list.end(); ++it) {
+            foreach (uchar* p, it.value())
+                qFreeAligned(p);
+        }
+        free_list.clear();
+        free_bytes = 0;
+    }
+
+    mutable QMutex mutex;
+    QHash<int, QVector<uchar*> > free_list; // size class => free buffers
+    qint64 max_free;
+    qint64 free_bytes;
+    qint64 used_bytes;
+    qint64 hits;
+    qint64 misses;
+};
+
+FrameBuffer::~FrameBuffer()
+{
+    if (g_pool_alive)
+        FrameBufferPool::instance().recycle(m_data, m_capacity);
+    else
+        qFreeAligned(m_data);
+}
+
+FrameBufferPool& FrameBufferPool::instance()
+{
+    static FrameBufferPool pool;
+    return pool;
+}
+
+FrameBufferPool::FrameBufferPool()
+{
+    g_pool_alive = true;
+}
+
+FrameBufferPool::~FrameBufferPool()
+{
+    g_pool_alive = false;
+    DPTR_D(FrameBufferPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.freeAll();
+}
+
+FrameBufferRef FrameBufferPool::get(int bytes)
+{
+    DPTR_D(FrameBufferPool);
+    if (bytes <= 0)
+        return FrameBufferRef();
+    const int capacity = sizeClass(bytes);
+    uchar *p = 0;
+    {
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        QHash<int, QVector<uchar*> >::iterator it = d.free_list.find(capacity);
+        if (it != d.free_list.end() && !it.value().isEmpty()) {
+            p = it.value().last();
+            it.value().pop_back();
+            d.free_bytes -= capacity;
+            ++d.hits;
+        } else {
+            ++d.misses;
+        }
+        d.used_bytes += capacity;
+    }
+    if (!p) {
+        p = (uchar*)qMallocAligned(capacity, Alignment);
+        if (!p) {
+            qWarning("FrameBufferPool: failed to allocate %d bytes", capacity);
+            QMutexLocker lock(&d.mutex);
+            Q_UNUSED(lock);
+            d.used_bytes -= capacity;
+            return FrameBufferRef();
+        }
+    }
+    return FrameBufferRef(new FrameBuffer(p, bytes, capacity));
+}
+
+void FrameBufferPool::recycle(uchar *data, int capacity)
+{
+    DPTR_D(FrameBufferPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.used_bytes -= capacity;
+    if (d.free_bytes + capacity > d.max_free) {
+        lock.unlock();
+        qFreeAligned(data);
+        return;
+    }
+    d.free_list[capacity].append(data);
+    d.free_bytes += capacity;
+}
+
+void FrameBufferPool::setMaxFreeBytes(qint64 value)
+{
+    DPTR_D(FrameBufferPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.max_free = qMax<qint64>(0, value);
+    if (d.free_bytes > d.max_free)
+        d.freeAll();
+}
+
+qint64 FrameBufferPool::maxFreeBytes() const
+{
+    DPTR_D(const FrameBufferPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.max_free;
+}
+
+void FrameBufferPool::clear()
+{
+    DPTR_D(FrameBufferPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.freeAll();
+}
+
+qint64 FrameBufferPool::hits() const
+{
+    DPTR_D(const FrameBufferPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.hits;
+}
+
+qint64 FrameBufferPool::misses() const
+{
+    DPTR_D(const FrameBufferPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.misses;
+}
+
+qreal FrameBufferPool::hitRate() const
+{
+    DPTR_D(const FrameBufferPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    if (d.hits + d.misses == 0)
+        return 0;
+    return qreal(d.hits)/qreal(d.hits + d.misses);
+}
+
+qint64 FrameBufferPool::residentBytes() const
+{
+    DPTR_D(const FrameBufferPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.used_bytes + d.free_bytes;
+}
+
+qint64 FrameBufferPool::freeBytes() const
+{
+    DPTR_D(const FrameBufferPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.free_bytes;
+}
+
+void FrameBufferPool::resetStatistics()
+{
+    DPTR_D(FrameBufferPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.hits = d.misses = 0;
+}
+} //namespace QtAV
@@ -0,0 +1,220 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "FrameDropController.h"
+#include <QtCore/QtGlobal>
+
+namespace QtAV {
+
+void FrameDropController::Ewma::add(qreal x)
+{
+    if (samples++ == 0)
+        value = x;
+    else
+        value += (x - value)/8.0;
+}
+
+FrameDropController::FrameDropController()
+    : m_fps(25.0)
+    , m_pipelined(false)
+    , m_tolerance(0.04)
+    , m_horizon(1.0)
+    , m_max_lateness(2.0)
+    , m_mode(DecodeAll)
+    , m_relax_count(0)
+{
+}
+
+void FrameDropController::reset()
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    for (int i = 0; i < NbDecodeModes; ++i) {
+        m_decode[i][0] = Ewma();
+        m_decode[i][1] = Ewma();
+    }
+    m_filter = Ewma();
+    m_render = Ewma();
+    m_mode = DecodeAll;
+    m_relax_count = 0;
+}
+
+void FrameDropController::setFrameRate(qreal value)
+{
+    m_fps = value > 0 ? value : 25.0;
+}
+
+qreal FrameDropController::frameRate() const
+{
+    return m_fps;
+}
+
+void FrameDropController::setPipelined(bool value)
+{
+    m_pipelined = value;
+}
+
+void FrameDropController::setTolerance(qreal seconds)
+{
+    m_tolerance = seconds;
+}
+
+qreal FrameDropController::tolerance() const
+{
+    return m_tolerance;
+}
+
+void FrameDropController::setHorizon(qreal seconds)
+{
+    m_horizon = seconds;
+}
+
+qreal FrameDropController::horizon() const
+{
+    return m_horizon;
+}
+
+void FrameDropController::setMaxLateness(qreal seconds)
+{
+    m_max_lateness = seconds;
+}
+
+void FrameDropController::addDecodeCost(bool keyFrame, qreal seconds)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_decode[m_mode][keyFrame].add(seconds);
+}
+
+void FrameDropController::addFilterCost(qreal seconds)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_filter.add(seconds);
+}
+
+void FrameDropController::addRenderCost(qreal seconds)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_render.add(seconds);
+}
+
+qreal FrameDropController::decodeCost(DecodeMode mode, bool keyFrame) const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (m_decode[mode][keyFrame].samples > 0)
+        return m_decode[mode][keyFrame].value;
+    // guess from DecodeAll, and from the other frame type if still no sample
+    qreal all = m_decode[DecodeAll][keyFrame].value;
+    if (m_decode[DecodeAll][keyFrame].samples == 0)
+        all = m_decode[DecodeAll][!keyFrame].value;
+    if (mode == DecodeNoLoopFilter)
+        return all*0.75;
+    if (mode == DecodeRefOnly && !keyFrame)
+        return all*0.5;
+    return all;
+}
+
+FrameDropController::DecodeMode FrameDropController::modeOf(Action action)
+{
+    if (action == SkipLoopFilter)
+        return DecodeNoLoopFilter;
+    if (action == SkipNonRef)
+        return DecodeRefOnly;
+    return DecodeAll;
+}
+
+qreal FrameDropController::cost(Action action, bool keyFrame) const
+{
+    if (action == WaitKeyFrame)
+        return 0;
+    const qreal dec = decodeCost(modeOf(action), keyFrame);
+    if (action == SkipRender)
+        return dec;
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    const qreal present = m_filter.value + m_render.value;
+    return m_pipelined ? qMax(dec, present) : dec + present;
+}
+
+qreal FrameDropController::interval() const
+{
+    return 1.0/m_fps;
+}
+
+bool FrameDropController::recovers(Action action, qreal lateness, bool keyFrame) const
+{
+    const qreal c = cost(action, keyFrame);
+    const qreal dt = interval();
+    if (lateness + c - dt <= m_tolerance)
+        return true;
+    if (c >= dt)
+        return false;
+    // frames needed to be on time again
+    const qreal n = (lateness - m_tolerance)/(dt - c);
+    return n*dt <= m_horizon;
+}
+
+FrameDropController::Action FrameDropController::decide(qreal lateness, bool keyFrame)
+{
+    if (!keyFrame && lateness > m_max_lateness)
+        return WaitKeyFrame;
+    static const Action kActions[] = { Render, SkipLoopFilter, SkipRender, SkipNonRef };
+    static const int kNbActions = sizeof(kActions)/sizeof(kActions[0]);
+    Action action = WaitKeyFrame;
+    for (int i = 0; i < kNbActions; ++i) {
+        if (recovers(kActions[i], lateness, keyFrame)) {
+            action = kActions[i];
+            break;
+        }
+    }
+    if (action == WaitKeyFrame) {
+        // can not recover in time. catch up as fast as possible. if even that is too slow, lateness keeps growing and
+        // WaitKeyFrame is returned above once it exceeds max lateness
+        action = kActions[0];
+        for (int i = 1; i < kNbActions; ++i) {
+            if (cost(kActions[i], keyFrame) < cost(action, keyFrame))
+                action = kActions[i];
+        }
+    }
+    const DecodeMode mode = modeOf(action);
+    if (mode > m_mode) {
+        m_mode = mode;
+        m_relax_count = 0;
+    } else if (mode < m_mode) {
+        if (++m_relax_count >= qMax(1, int(m_horizon*m_fps*0.25))) {
+            m_mode = mode;
+            m_relax_count = 0;
+        }
+    } else {
+        m_relax_count = 0;
+    }
+    return action;
+}
+
+FrameDropController::DecodeMode FrameDropController::decodeMode() const
+{
+    return m_mode;
+}
+
+} //namespace QtAV
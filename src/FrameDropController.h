@@ -0,0 +1,116 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_FRAMEDROPCONTROLLER_H
+#define QTAV_FRAMEDROPCONTROLLER_H
+
+#include <QtCore/QMutex>
+
+namespace QtAV {
+/*!
+ * \brief The FrameDropController class
+ * Decides how VideoThread catches up with the clock when video is late. Per frame costs (decoding for each decode
+ * mode and frame type, filtering, rendering) are tracked as EWMA of measured samples, and the lateness after applying
+ * an action is predicted as lateness + n*(cost - frame interval). The first action in Action order that brings the
+ * lateness back within tolerance() in horizon() seconds is chosen. Costs without samples are guessed from the cost of
+ * DecodeAll.
+ * Decode modes are expensive to switch, so a lighter mode is restored only after it is chosen for 1/4 of horizon().
+ * Costs can be added from any thread, other functions are called by the decoding thread.
+ */
+class FrameDropController
+{
+public:
+    enum Action { // ordered by quality loss
+        Render,         // decode and render
+        SkipLoopFilter, // decoder skips the loop filter
+        SkipRender,     // decode but do not filter and render this frame
+        SkipNonRef,     // decoder discards non-reference frames
+        WaitKeyFrame    // discard packets until the next key frame
+    };
+    enum DecodeMode {
+        DecodeAll,
+        DecodeNoLoopFilter,
+        DecodeRefOnly,
+        NbDecodeModes
+    };
+
+    FrameDropController();
+    // forget all costs and decisions, e.g. the decoder is changed
+    void reset();
+    void setFrameRate(qreal value); // <= 0: 25
+    qreal frameRate() const;
+    /*!
+     * \brief setPipelined
+     * If true, filtering and rendering run in parallel with decoding, so the cost of a frame is the max of them instead of the sum
+     */
+    void setPipelined(bool value);
+    void setTolerance(qreal seconds); // lateness not to be dropped for. default 0.04
+    qreal tolerance() const;
+    void setHorizon(qreal seconds); // lateness must be recovered in this time. default 1.0
+    qreal horizon() const;
+    /*!
+     * \brief setMaxLateness
+     * If a non-key frame is later than this, wait for a key frame. default 2.0
+     */
+    void setMaxLateness(qreal seconds);
+
+    // cost samples in seconds. decode cost is added for the current decodeMode()
+    void addDecodeCost(bool keyFrame, qreal seconds);
+    void addFilterCost(qreal seconds);
+    void addRenderCost(qreal seconds);
+    // predicted wall time per frame if action is applied
+    qreal cost(Action action, bool keyFrame) const;
+    qreal decodeCost(DecodeMode mode, bool keyFrame) const;
+
+    /*!
+     * \brief decide
+     * \param lateness in seconds of the frame to be decoded. > 0: late
+     * \param keyFrame the packet contains a key frame. WaitKeyFrame is never returned for a key frame
+     * \return the action for this frame. decodeMode() is updated and should be applied to the decoder before decoding
+     */
+    Action decide(qreal lateness, bool keyFrame);
+    DecodeMode decodeMode() const;
+
+private:
+    static DecodeMode modeOf(Action action);
+    bool recovers(Action action, qreal lateness, bool keyFrame) const;
+    qreal interval() const;
+
+    class Ewma {
+    public:
+        Ewma() : value(0), samples(0) {}
+        void add(qreal x);
+        qreal value;
+        int samples;
+    };
+    mutable QMutex m_mutex; // for costs
+    Ewma m_decode[NbDecodeModes][2]; // [mode][key frame]
+    Ewma m_filter, m_render;
+    qreal m_fps;
+    bool m_pipelined;
+    qreal m_tolerance;
+    qreal m_horizon;
+    qreal m_max_lateness;
+    DecodeMode m_mode;
+    int m_relax_count; // number of continuous decisions for a lighter decode mode
+};
+} //namespace QtAV
+#endif // QTAV_FRAMEDROPCONTROLLER_H
@@ -24,6 +24,7 @@
 #include "QtAV/private/AVCompat.h"
 #include "QtAV/private/factory.h"
 #include "ImageConverter.h"
+#include "utils/spsc_ring.h" // atomic_load_acquire
 #include "utils/Logger.h"
 
 namespace QtAV {
@@ -45,7 +46,23 @@ ImageConverter::~ImageConverter()
 
 QByteArray ImageConverter::outData() const
 {
-    return d_func().data_out;
+    DPTR_D(const ImageConverter);
+    if (!d.data_out.isEmpty() || !d.buf_out)
+        return d.data_out;
+    return QByteArray((const char*)d.buf_out->data(), d.buf_out->size());
+}
+
+FrameBufferRef ImageConverter::outBuffer() const
+{
+    return d_func().buf_out;
+}
+
+FrameBufferRef ImageConverter::takeOutBuffer()
+{
+    DPTR_D(ImageConverter);
+    FrameBufferRef buf(d.buf_out);
+    d.buf_out.reset();
+    return buf;
 }
 
 bool ImageConverter::check() const
@@ -120,6 +137,16 @@ bool ImageConverter::isInterlaced() const
     return d_func().interlaced;
 }
 
+void ImageConverter::setThreads(int value)
+{
+    d_func().threads = qMax(value, 0);
+}
+
+int ImageConverter::threads() const
+{
+    return d_func().threads;
+}
+
 void ImageConverter::setBrightness(int value)
 {
     DPTR_D(ImageConverter);
@@ -190,13 +217,16 @@ bool ImageConverter::prepareData()
     if (d.fmt_out == QTAV_PIX_FMT_C(NONE) || d.w_out <=0 || d.h_out <= 0)
         return false;
     int bytes = avpicture_get_size((AVPixelFormat)d.fmt_out, d.w_out, d.h_out);
-    //if (d.data_out.size() < bytes) {
-        d.data_out.resize(bytes);
-    //}
+    // keep the buffer if no frame refers to it
+    if (!d.buf_out || d.buf_out->size() != bytes || atomic_load_acquire(d.buf_out->ref) > 1) {
+        d.buf_out = FrameBufferPool::instance().get(bytes);
+        if (!d.buf_out)
+            return false;
+    }
     //picture的数据按PIX_FMT格式自动"关联"到 data
     avpicture_fill(
             &d.picture,
-            (uint8_t*)d.data_out.constData(),
+            (uint8_t*)d.buf_out->data(),
             (AVPixelFormat)d.fmt_out,
             d.w_out,
             d.h_out
@@ -25,20 +25,29 @@
 
 #include <QtAV/QtAV_Global.h>
 #include <QtAV/VideoFormat.h>
+#include <QtAV/FrameBufferPool.h>
 #include <QtCore/QVector>
 
 namespace QtAV {
 
 typedef int ImageConverterId;
 class ImageConverterPrivate;
-class ImageConverter //export is not needed
+class Q_AV_PRIVATE_EXPORT ImageConverter // exported for tests
 {
     DPTR_DECLARE_PRIVATE(ImageConverter)
 public:
     ImageConverter();
     virtual ~ImageConverter();
 
+    // a deep copy of the output
     QByteArray outData() const;
+    /*!
+     * \brief outBuffer
+     * The output memory. A frame can keep it, then the next convert() writes to a new buffer.
+     */
+    FrameBufferRef outBuffer() const;
+    // release the output memory to the caller. outPlanes() is valid until the returned buffer is released
+    FrameBufferRef takeOutBuffer();
     // return false if i/o format not supported, or size is not valid.
     virtual bool check() const;
     void setInSize(int width, int height);
@@ -51,6 +60,17 @@ public:
     void setOutFormat(int formate);
     void setInterlaced(bool interlaced);
     bool isInterlaced() const;
+    /*!
+     * \brief setThreads
+     * Split a conversion into horizontal bands converted in parallel. Only used by converters supporting it (FFmpeg).
+     * 0: auto, the default. Large pictures without scaling are split into up to QThread::idealThreadCount() bands.
+     * The result is the same as a single threaded conversion.
+     * 1: convert in the calling thread.
+     * n > 1: up to n bands. Scaling is split too, the rows near a band edge may differ slightly from a
+     * single threaded conversion.
+     */
+    void setThreads(int value);
+    int threads() const;
     /*!
      * brightness, contrast, saturation: -100~100
      * If value changes, setup sws
@@ -105,8 +125,10 @@ public:
 typedef ImageConverterFF ImageConverterSWS;
 
 //ImageConverter* c = ImageConverter::create(ImageConverterId_FF);
-extern ImageConverterId ImageConverterId_FF;
-extern ImageConverterId ImageConverterId_IPP;
+extern Q_AV_PRIVATE_EXPORT ImageConverterId ImageConverterId_FF;
+extern Q_AV_PRIVATE_EXPORT ImageConverterId ImageConverterId_IPP;
+// yuv420p, nv12, yuv422p => BGRA, RGBA. see ImageConverterSIMD.cpp
+extern Q_AV_PRIVATE_EXPORT ImageConverterId ImageConverterId_SIMD;
 
 } //namespace QtAV
 #endif // QTAV_IMAGECONVERTER_H
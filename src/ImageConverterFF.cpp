@@ -24,12 +24,54 @@
 #include "QtAV/private/AVCompat.h"
 #include "QtAV/private/mkid.h"
 #include "QtAV/private/factory.h"
+#include <string.h>
+#include <QtCore/QRunnable>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include "utils/spsc_ring.h" // atomic_load_acquire
 #include "utils/Logger.h"
 
 namespace QtAV {
 ImageConverterId ImageConverterId_FF = mkid::id32base36_6<'F', 'F', 'm', 'p', 'e', 'g'>::value;
 FACTORY_REGISTER(ImageConverter, FF, "FFmpeg")
 
+static const int kMinSliceHeight = 64;
+static const int kMinAutoSlicePixels = 1280*720;
+
+// shared by all converters. the calling thread converts the first band itself
+static QThreadPool* slicePool()
+{
+    static QThreadPool pool;
+    return &pool;
+}
+
+class SliceTask : public QRunnable
+{
+public:
+    SliceTask(SwsContext *ctx, int height, int *result, QSemaphore *done)
+        : m_ctx(ctx), m_height(height), m_result(result), m_done(done)
+    {
+        memset(src, 0, sizeof(src));
+        memset(src_stride, 0, sizeof(src_stride));
+        memset(dst, 0, sizeof(dst));
+        memset(dst_stride, 0, sizeof(dst_stride));
+    }
+    void run() Q_DECL_OVERRIDE {
+        *m_result = sws_scale(m_ctx, src, src_stride, 0, m_height, dst, dst_stride);
+        m_done->release();
+    }
+    const quint8 *src[4];
+    int src_stride[4];
+    quint8 *dst[4];
+    int dst_stride[4];
+private:
+    SwsContext *m_ctx;
+    int m_height;
+    int *m_result;
+    QSemaphore *m_done;
+};
+
 class ImageConverterFFPrivate Q_DECL_FINAL: public ImageConverterPrivate
 {
 public:
@@ -42,13 +84,141 @@ public:
             sws_freeContext(sws_ctx);
             sws_ctx = 0;
         }
+        foreach (SwsContext *ctx, slice_ctx) {
+            sws_freeContext(ctx);
+        }
+        slice_ctx.clear();
     }
     virtual bool setupColorspaceDetails(bool force = true) Q_DECL_FINAL;
+    int swsFlags() const {
+        return (w_in == w_out && h_in == h_out) ? SWS_POINT : SWS_FAST_BILINEAR; //SWS_BICUBIC
+    }
+    // number of bands for the current shape. 1: convert in 1 thread
+    int sliceCount() const;
+    // band boundaries and a sws context for each band
+    bool setupSlices(int n);
+    bool convertSlices(const quint8 *const srcSlice[], const int srcStride[]);
 
     SwsContext *sws_ctx;
     bool update_eq;
+    QVector<SwsContext*> slice_ctx;
+    QVector<int> slice_y_in, slice_y_out; // n+1 row boundaries
 };
 
+int ImageConverterFFPrivate::sliceCount() const
+{
+    // with scaling, the filter of the rows (and subsampled chroma rows) near a band edge can not see the other band
+    const bool scale = w_in != w_out || h_in != h_out;
+    int n = threads;
+    if (n == 0) {
+        if (scale || w_out*h_out < kMinAutoSlicePixels)
+            return 1;
+        n = QThread::idealThreadCount();
+    }
+    n = qMin(n, qMin(h_in, h_out)/kMinSliceHeight);
+    if (n <= 1)
+        return 1;
+    const AVPixFmtDescriptor *din = av_pix_fmt_desc_get((AVPixelFormat)fmt_in);
+    const AVPixFmtDescriptor *dout = av_pix_fmt_desc_get((AVPixelFormat)fmt_out);
+    if (!din || !dout)
+        return 1;
+    // the palette is not a band of rows
+    if ((din->flags & AV_PIX_FMT_FLAG_PAL) || (dout->flags & AV_PIX_FMT_FLAG_PAL))
+        return 1;
+    return n;
+}
+
+bool ImageConverterFFPrivate::setupSlices(int n)
+{
+    const AVPixFmtDescriptor *din = av_pix_fmt_desc_get((AVPixelFormat)fmt_in);
+    const AVPixFmtDescriptor *dout = av_pix_fmt_desc_get((AVPixelFormat)fmt_out);
+    // a band must start at a chroma row
+    const int align_in = 1 << din->log2_chroma_h;
+    const int align_out = 1 << dout->log2_chroma_h;
+    slice_y_in.resize(n+1);
+    slice_y_out.resize(n+1);
+    slice_y_in[0] = slice_y_out[0] = 0;
+    slice_y_in[n] = h_in;
+    slice_y_out[n] = h_out;
+    for (int i = 1; i < n; ++i) {
+        if (h_in == h_out) {
+            const int y = (h_in*i/n) & ~(qMax(align_in, align_out) - 1);
+            slice_y_in[i] = slice_y_out[i] = y;
+        } else {
+            slice_y_out[i] = (h_out*i/n) & ~(align_out - 1);
+            slice_y_in[i] = int((qint64)slice_y_out[i]*h_in/h_out) & ~(align_in - 1);
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        if (slice_y_in[i+1] <= slice_y_in[i] || slice_y_out[i+1] <= slice_y_out[i])
+            return false;
+    }
+    while (slice_ctx.size() > n)
+        sws_freeContext(slice_ctx.takeLast());
+    slice_ctx.resize(n);
+    bool created = false;
+    for (int i = 0; i < n; ++i) {
+        SwsContext *ctx = sws_getCachedContext(slice_ctx[i]
+                , w_in, slice_y_in[i+1] - slice_y_in[i], (AVPixelFormat)fmt_in
+                , w_out, slice_y_out[i+1] - slice_y_out[i], (AVPixelFormat)fmt_out
+                , swsFlags()
+                , NULL, NULL, NULL
+                );
+        created |= ctx != slice_ctx[i];
+        slice_ctx[i] = ctx;
+        if (!ctx) {
+            foreach (SwsContext *c, slice_ctx) {
+                sws_freeContext(c);
+            }
+            slice_ctx.clear();
+            return false;
+        }
+    }
+    // a new context has the default colorspace details
+    setupColorspaceDetails(created);
+    return true;
+}
+
+bool ImageConverterFFPrivate::convertSlices(const quint8 *const srcSlice[], const int srcStride[])
+{
+    const int n = slice_ctx.size();
+    const AVPixFmtDescriptor *din = av_pix_fmt_desc_get((AVPixelFormat)fmt_in);
+    const AVPixFmtDescriptor *dout = av_pix_fmt_desc_get((AVPixelFormat)fmt_out);
+    const int planes_in = av_pix_fmt_count_planes((AVPixelFormat)fmt_in);
+    const int planes_out = av_pix_fmt_count_planes((AVPixelFormat)fmt_out);
+    QSemaphore done;
+    QVector<int> result(n, 0);
+    int *res = result.data();
+    SliceTask *first = 0;
+    for (int i = 0; i < n; ++i) {
+        SliceTask *t = new SliceTask(slice_ctx[i], slice_y_in[i+1] - slice_y_in[i], res + i, &done);
+        for (int p = 0; p < planes_in && p < 4; ++p) {
+            const int y = slice_y_in[i] >> ((p == 1 || p == 2) ? din->log2_chroma_h : 0);
+            t->src[p] = srcSlice[p] + y*srcStride[p];
+            t->src_stride[p] = srcStride[p];
+        }
+        for (int p = 0; p < planes_out && p < 4; ++p) {
+            const int y = slice_y_out[i] >> ((p == 1 || p == 2) ? dout->log2_chroma_h : 0);
+            t->dst[p] = picture.data[p] + y*picture.linesize[p];
+            t->dst_stride[p] = picture.linesize[p];
+        }
+        if (i == 0)
+            first = t;
+        else
+            slicePool()->start(t);
+    }
+    first->run();
+    delete first;
+    done.acquire(n);
+    for (int i = 0; i < n; ++i) {
+        if (res[i] != slice_y_out[i+1] - slice_y_out[i]) {
+            qWarning("convert band %d failed: %d, %d", i, res[i], slice_y_out[i+1] - slice_y_out[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
 ImageConverterFF::ImageConverterFF()
     :ImageConverter(*new ImageConverterFFPrivate())
 {
@@ -79,18 +249,26 @@ bool ImageConverterFF::convert(const quint8 *const srcSlice[], const int srcStri
             return false;
         setOutSize(d.w_in, d.h_in);
     }
+    // the output of the previous convert() is still used by a frame
+    if ((!d.buf_out || atomic_load_acquire(d.buf_out->ref) > 1) && !prepareData())
+        return false;
+    const int slices = d.sliceCount();
+    if (slices > 1 && d.setupSlices(slices))
+        return d.convertSlices(srcSlice, srcStride);
 //TODO: move those code to prepare()
+    SwsContext *ctx = d.sws_ctx;
     d.sws_ctx = sws_getCachedContext(d.sws_ctx
             , d.w_in, d.h_in, (AVPixelFormat)d.fmt_in
             , d.w_out, d.h_out, (AVPixelFormat)d.fmt_out
-            , (d.w_in == d.w_out && d.h_in == d.h_out) ? SWS_POINT : SWS_FAST_BILINEAR //SWS_BICUBIC
+            , d.swsFlags()
             , NULL, NULL, NULL
             );
     //int64_t flags = SWS_CPU_CAPS_SSE2 | SWS_CPU_CAPS_MMX | SWS_CPU_CAPS_MMX2;
     //av_opt_set_int(d.sws_ctx, "sws_flags", flags, 0);
     if (!d.sws_ctx)
         return false;
-    d.setupColorspaceDetails(false);
+    // a new context has the default colorspace details
+    d.setupColorspaceDetails(ctx != d.sws_ctx);
 #if PREPAREDATA_NO_PICTURE //for YUV420 <=> RGB
 #if 0
     struct
@@ -146,7 +324,7 @@ bool ImageConverterFF::convert(const quint8 *const srcSlice[], const int srcStri
 
 bool ImageConverterFFPrivate::setupColorspaceDetails(bool force)
 {
-    if (!sws_ctx) {
+    if (!sws_ctx && slice_ctx.isEmpty()) {
         update_eq = true;
         return false;
     }
@@ -158,14 +336,20 @@ bool ImageConverterFFPrivate::setupColorspaceDetails(bool force)
     // FIXME: how to fill the ranges?
     const int srcRange = 1;
     const int dstRange = 0;
-    // TODO: SWS_CS_DEFAULT?
-    bool supported = sws_setColorspaceDetails(sws_ctx, sws_getCoefficients(SWS_CS_DEFAULT)
+    QVector<SwsContext*> ctxs(slice_ctx);
+    if (sws_ctx)
+        ctxs.append(sws_ctx);
+    bool supported = true;
+    foreach (SwsContext *ctx, ctxs) {
+        // TODO: SWS_CS_DEFAULT?
+        supported &= sws_setColorspaceDetails(ctx, sws_getCoefficients(SWS_CS_DEFAULT)
                              , srcRange, sws_getCoefficients(SWS_CS_DEFAULT)
                              , dstRange
                              , ((brightness << 16) + 50)/100
                              , (((contrast + 100) << 16) + 50)/100
                              , (((saturation + 100) << 16) + 50)/100
                              ) >= 0;
+    }
     //sws_init_context(d.sws_ctx, NULL, NULL);
     update_eq = false;
     return supported;
@@ -0,0 +1,414 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "ImageConverter.h"
+#include "ImageConverter_p.h"
+#include "ImageConverterSIMD_p.h"
+#include "QtAV/ColorTransform.h"
+#include <string.h>
+#include <QtCore/QScopedPointer>
+#include "QtAV/private/AVCompat.h"
+#include "QtAV/private/factory.h"
+#include "QtAV/private/mkid.h"
+extern "C" {
+#include <libavutil/cpu.h>
+}
+#include "utils/spsc_ring.h" // atomic_load_acquire
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+class ImageConverterSIMDPrivate;
+/*!
+ * \brief The ImageConverterSIMD class
+ * SSE2/AVX2 conversion of yuv420p, nv12 and yuv422p to BGRA or RGBA (RGB32 on little endian) at the same size, half
+ * size (2x2 box filter) or double size (pixel repeated). The instruction set is selected at runtime.
+ * Other sizes use a fused pass: bilinear sampling of the planes and a ColorTransform matrix with eq, without
+ * intermediate buffers. eq has the same meaning as in the OpenGL renderers. eq at the same size is a pass over the
+ * rgb rows after the kernels: a lookup table, or an rgb matrix if saturation is not 0. Half and double sizes with eq
+ * use the fused pass. Without SIMD support, the same size is converted by the C rows.
+ * Other formats are converted by ImageConverterFF.
+ * QTAV_SIMD=sse2 or none limits the instruction set, e.g. to compare the kernels.
+ */
+class ImageConverterSIMD : public ImageConverter //Q_AV_EXPORT is not needed
+{
+    DPTR_DECLARE_PRIVATE(ImageConverterSIMD)
+public:
+    ImageConverterSIMD();
+    virtual bool convert(const quint8 *const srcSlice[], const int srcStride[]);
+private:
+    bool convertFallback(const quint8 *const srcSlice[], const int srcStride[]);
+};
+
+ImageConverterId ImageConverterId_SIMD = mkid::id32base36_4<'S', 'I', 'M', 'D'>::value;
+FACTORY_REGISTER(ImageConverter, SIMD, "SIMD")
+
+namespace {
+enum Scale {
+    ScaleUnsupported,
+    ScaleNone, // eq is a pass of the rgb rows
+    ScaleHalf,
+    ScaleDouble,
+    ScaleAny // fused bilinear scale, color transform and eq
+};
+
+struct Kernels {
+    int (*yuv420)(const quint8*, const quint8*, const quint8*, quint8*, int, bool);
+    int (*nv12)(const quint8*, const quint8*, quint8*, int, bool);
+    int (*yuv444)(const quint8*, const quint8*, const quint8*, quint8*, int, bool);
+    int (*half)(const quint8*, const quint8*, quint8*, int);
+    int (*doubled)(const quint32*, quint32*, int);
+};
+} //namespace
+
+// null if no instruction set is supported by both the build and the cpu
+static const Kernels* selectKernels()
+{
+    static const int cpu = av_get_cpu_flags();
+    const QByteArray limit = qgetenv("QTAV_SIMD").toLower();
+    if (limit == "none")
+        return 0;
+#if QTAV_HAVE(AVX2) && defined(AV_CPU_FLAG_AVX2)
+    static const Kernels avx2 = {
+        simd::yuv420_row_avx2, simd::nv12_row_avx2, simd::yuv444_row_avx2, simd::half_row_sse2, simd::double_row_sse2
+    };
+    if ((cpu & AV_CPU_FLAG_AVX2) && limit != "sse2")
+        return &avx2;
+#endif
+#if QTAV_HAVE(SSE2)
+    static const Kernels sse2 = {
+        simd::yuv420_row_sse2, simd::nv12_row_sse2, simd::yuv444_row_sse2, simd::half_row_sse2, simd::double_row_sse2
+    };
+    if (cpu & AV_CPU_FLAG_SSE2)
+        return &sse2;
+#endif
+    Q_UNUSED(cpu);
+    return 0;
+}
+
+// bilinear sample positions of out points in [0, in), in 1/256: pos0, pos1 and the weight of pos1
+static void buildSamples(int in, int out, QVector<int>& pos0, QVector<int>& pos1, QVector<int>& frac)
+{
+    pos0.resize(out);
+    pos1.resize(out);
+    frac.resize(out);
+    for (int i = 0; i < out; ++i) {
+        // center aligned: (i + 0.5)*in/out - 0.5
+        const int s = qMax<int>(0, int(qint64(2*i + 1)*in*256/(2*out)) - 128);
+        pos0[i] = qMin(s >> 8, in - 1);
+        pos1[i] = qMin(pos0[i] + 1, in - 1);
+        frac[i] = s >> 8 >= in - 1 ? 0 : (s & 255);
+    }
+}
+
+// result is in 1/256
+static inline int bilerp(int a, int b, int c, int d, int fx, int fy)
+{
+    const int h0 = (a << 8) + (b - a)*fx;
+    const int h1 = (c << 8) + (d - c)*fx;
+    return ((h0 << 8) + (h1 - h0)*fy + 128) >> 8;
+}
+
+class ImageConverterSIMDPrivate Q_DECL_FINAL: public ImageConverterPrivate
+{
+public:
+    ImageConverterSIMDPrivate()
+        : kernels(selectKernels())
+        , update_matrix(true)
+        , update_eq(true)
+    {
+        color.setInputColorSpace(ColorSpace_BT601);
+        memset(coeff, 0, sizeof(coeff));
+        memset(samples_size, 0, sizeof(samples_size));
+    }
+    virtual bool setupColorspaceDetails(bool force = true) Q_DECL_FINAL {
+        Q_UNUSED(force);
+        update_matrix = true;
+        update_eq = true;
+        return true;
+    }
+    bool hasEq() const { return brightness || contrast || saturation; }
+    Scale scale() const {
+        if (fmt_in != QTAV_PIX_FMT_C(YUV420P) && fmt_in != QTAV_PIX_FMT_C(NV12) && fmt_in != QTAV_PIX_FMT_C(YUV422P))
+            return ScaleUnsupported;
+        if (fmt_out != QTAV_PIX_FMT_C(BGRA) && fmt_out != QTAV_PIX_FMT_C(RGBA))
+            return ScaleUnsupported;
+        if (w_out == w_in && h_out == h_in)
+            return ScaleNone;
+        if (!kernels || hasEq())
+            return ScaleAny;
+        if (w_out*2 == w_in && h_out*2 == h_in)
+            return ScaleHalf;
+        if (w_out == w_in*2 && h_out == h_in*2)
+            return ScaleDouble;
+        return ScaleAny;
+    }
+    // converts row y of the input at the same size. C only if no kernels
+    void convertRow(const quint8 *const src[], const int stride[], int y, quint8 *dst) const {
+        const bool rgba = fmt_out == QTAV_PIX_FMT_C(RGBA);
+        const int cy = fmt_in == QTAV_PIX_FMT_C(YUV422P) ? y : y >> 1;
+        const quint8 *py = src[0] + y*stride[0];
+        if (fmt_in == QTAV_PIX_FMT_C(NV12)) {
+            const quint8 *uv = src[1] + cy*stride[1];
+            simd::nv12_row_c(py, uv, dst, kernels ? kernels->nv12(py, uv, dst, w_in, rgba) : 0, w_in, rgba);
+            return;
+        }
+        const quint8 *u = src[1] + cy*stride[1];
+        const quint8 *v = src[2] + cy*stride[2];
+        simd::yuv420_row_c(py, u, v, dst, kernels ? kernels->yuv420(py, u, v, dst, w_in, rgba) : 0, w_in, rgba);
+    }
+    void setupEq();
+    void eqRow(quint8 *dst) const;
+    void convertHalf(const quint8 *const src[], const int stride[]);
+    void convertDouble(const quint8 *const src[], const int stride[]);
+    void setupFused();
+    void convertFused(const quint8 *const src[], const int stride[]);
+
+    const Kernels *kernels;
+    QScopedPointer<ImageConverter> fallback;
+    QByteArray tmp;
+    // fused pass
+    ColorTransform color;
+    bool update_matrix;
+    int coeff[3][4]; // rgb = coeff*(y, u, v, 1), y, u, v in 1/256, coeff in 1/1024
+    int samples_size[4]; // w_in, h_in, w_out, h_out of the sample tables
+    QVector<int> lx0, lx1, lfx, cx0, cx1, cfx; // luma and chroma columns
+    QVector<int> ly0, ly1, lfy, cy0, cy1, cfy; // rows
+    // eq pass of rgb rows
+    ColorTransform eq_color; // rgb => rgb
+    bool update_eq;
+    int eq_coeff[3][4]; // rgb' = eq_coeff*(r, g, b, 1), in 1/1024
+    quint8 eq_lut[256]; // brightness and contrast only
+};
+
+void ImageConverterSIMDPrivate::setupEq()
+{
+    if (!update_eq)
+        return;
+    update_eq = false;
+    eq_color.setBrightness(qreal(brightness)/100.0);
+    eq_color.setContrast(qreal(contrast)/100.0);
+    eq_color.setSaturation(qreal(saturation)/100.0);
+    const QMatrix4x4 &m = eq_color.matrixRef();
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j)
+            eq_coeff[i][j] = qRound(m(i, j)*1024.0);
+        eq_coeff[i][3] = qRound(m(i, 3)*255.0*1024.0) + 512;
+    }
+    for (int i = 0; i < 256; ++i)
+        eq_lut[i] = simd::clip8((eq_coeff[0][0]*i + eq_coeff[0][3]) >> 10);
+}
+
+void ImageConverterSIMDPrivate::eqRow(quint8 *dst) const
+{
+    if (!saturation) { // the same scale and offset for r, g and b
+        for (int x = 0; x < w_out; ++x, dst += 4) {
+            dst[0] = eq_lut[dst[0]];
+            dst[1] = eq_lut[dst[1]];
+            dst[2] = eq_lut[dst[2]];
+        }
+        return;
+    }
+    const int r = fmt_out == QTAV_PIX_FMT_C(RGBA) ? 0 : 2;
+    const int b = 2 - r;
+    for (int x = 0; x < w_out; ++x, dst += 4) {
+        const int R = dst[r], G = dst[1], B = dst[b];
+        dst[r] = simd::clip8((eq_coeff[0][0]*R + eq_coeff[0][1]*G + eq_coeff[0][2]*B + eq_coeff[0][3]) >> 10);
+        dst[1] = simd::clip8((eq_coeff[1][0]*R + eq_coeff[1][1]*G + eq_coeff[1][2]*B + eq_coeff[1][3]) >> 10);
+        dst[b] = simd::clip8((eq_coeff[2][0]*R + eq_coeff[2][1]*G + eq_coeff[2][2]*B + eq_coeff[2][3]) >> 10);
+    }
+}
+
+void ImageConverterSIMDPrivate::setupFused()
+{
+    if (update_matrix) {
+        color.setBrightness(qreal(brightness)/100.0);
+        color.setContrast(qreal(contrast)/100.0);
+        color.setSaturation(qreal(saturation)/100.0);
+        const QMatrix4x4 &m = color.matrixRef();
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j)
+                coeff[i][j] = qRound(m(i, j)*1024.0);
+            // the offset is in the same unit as the samples, plus 0.5 for rounding.
+            // the matrix centers chroma at 127.5 (0.5 normalized), ImageConverterFF and the kernels at 128
+            coeff[i][3] = qRound((m(i, 3)*255.0 - 0.5*(m(i, 1) + m(i, 2)))*256.0*1024.0) + (1 << 17);
+        }
+        update_matrix = false;
+    }
+    const int s[] = { w_in, h_in, w_out, h_out };
+    if (!memcmp(s, samples_size, sizeof(s)))
+        return;
+    memcpy(samples_size, s, sizeof(s));
+    const int cw = (w_in + 1) >> 1;
+    const int ch = fmt_in == QTAV_PIX_FMT_C(YUV422P) ? h_in : (h_in + 1) >> 1;
+    buildSamples(w_in, w_out, lx0, lx1, lfx);
+    buildSamples(cw, w_out, cx0, cx1, cfx);
+    buildSamples(h_in, h_out, ly0, ly1, lfy);
+    buildSamples(ch, h_out, cy0, cy1, cfy);
+}
+
+void ImageConverterSIMDPrivate::convertFused(const quint8 *const src[], const int stride[])
+{
+    setupFused();
+    const bool nv12 = fmt_in == QTAV_PIX_FMT_C(NV12);
+    const int r = fmt_out == QTAV_PIX_FMT_C(RGBA) ? 0 : 2;
+    const int b = 2 - r;
+    for (int y = 0; y < h_out; ++y) {
+        const quint8 *l0 = src[0] + ly0[y]*stride[0];
+        const quint8 *l1 = src[0] + ly1[y]*stride[0];
+        const quint8 *u0 = src[1] + cy0[y]*stride[1];
+        const quint8 *u1 = src[1] + cy1[y]*stride[1];
+        // nv12: v is the next byte of u
+        const quint8 *v0 = nv12 ? u0 + 1 : src[2] + cy0[y]*stride[2];
+        const quint8 *v1 = nv12 ? u1 + 1 : src[2] + cy1[y]*stride[2];
+        const int cstep = nv12 ? 2 : 1;
+        const int fy = lfy[y], cfy_ = cfy[y];
+        quint8 *dst = picture.data[0] + y*picture.linesize[0];
+        for (int x = 0; x < w_out; ++x) {
+            const int a0 = lx0[x], a1 = lx1[x];
+            const int c0 = cstep*cx0[x], c1 = cstep*cx1[x];
+            const int Y = bilerp(l0[a0], l0[a1], l1[a0], l1[a1], lfx[x], fy);
+            const int U = bilerp(u0[c0], u0[c1], u1[c0], u1[c1], cfx[x], cfy_);
+            const int V = bilerp(v0[c0], v0[c1], v1[c0], v1[c1], cfx[x], cfy_);
+            dst[r] = simd::clip8((coeff[0][0]*Y + coeff[0][1]*U + coeff[0][2]*V + coeff[0][3]) >> 18);
+            dst[1] = simd::clip8((coeff[1][0]*Y + coeff[1][1]*U + coeff[1][2]*V + coeff[1][3]) >> 18);
+            dst[b] = simd::clip8((coeff[2][0]*Y + coeff[2][1]*U + coeff[2][2]*V + coeff[2][3]) >> 18);
+            dst[3] = 255;
+            dst += 4;
+        }
+    }
+}
+
+void ImageConverterSIMDPrivate::convertHalf(const quint8 *const src[], const int stride[])
+{
+    const bool rgba = fmt_out == QTAV_PIX_FMT_C(RGBA);
+    const int w = w_out;
+    tmp.resize(3*w);
+    quint8 *ty = (quint8*)tmp.data();
+    quint8 *tu = ty + w;
+    quint8 *tv = tu + w;
+    for (int y = 0; y < h_out; ++y) {
+        const quint8 *r0 = src[0] + 2*y*stride[0];
+        const quint8 *r1 = r0 + stride[0];
+        simd::half_row_c(r0, r1, ty, kernels->half(r0, r1, ty, w), w);
+        // the chroma plane has the output width
+        const quint8 *u = tu, *v = tv;
+        if (fmt_in == QTAV_PIX_FMT_C(YUV420P)) {
+            u = src[1] + y*stride[1];
+            v = src[2] + y*stride[2];
+        } else if (fmt_in == QTAV_PIX_FMT_C(NV12)) {
+            const quint8 *uv = src[1] + y*stride[1];
+            for (int x = 0; x < w; ++x) {
+                tu[x] = uv[2*x];
+                tv[x] = uv[2*x+1];
+            }
+        } else { // yuv422p: 2 chroma rows
+            const quint8 *u0 = src[1] + 2*y*stride[1], *u1 = u0 + stride[1];
+            const quint8 *v0 = src[2] + 2*y*stride[2], *v1 = v0 + stride[2];
+            for (int x = 0; x < w; ++x) {
+                tu[x] = (u0[x] + u1[x] + 1) >> 1;
+                tv[x] = (v0[x] + v1[x] + 1) >> 1;
+            }
+        }
+        quint8 *dst = picture.data[0] + y*picture.linesize[0];
+        simd::yuv444_row_c(ty, u, v, dst, kernels->yuv444(ty, u, v, dst, w, rgba), w, rgba);
+    }
+}
+
+void ImageConverterSIMDPrivate::convertDouble(const quint8 *const src[], const int stride[])
+{
+    tmp.resize(4*w_in);
+    const quint32 *row = (const quint32*)tmp.constData();
+    for (int y = 0; y < h_in; ++y) {
+        convertRow(src, stride, y, (quint8*)tmp.data());
+        quint8 *dst = picture.data[0] + 2*y*picture.linesize[0];
+        simd::double_row_c(row, (quint32*)dst, kernels->doubled(row, (quint32*)dst, w_in), w_in);
+        memcpy(dst + picture.linesize[0], dst, 4*w_out);
+    }
+}
+
+ImageConverterSIMD::ImageConverterSIMD()
+    : ImageConverter(*new ImageConverterSIMDPrivate())
+{
+}
+
+bool ImageConverterSIMD::convert(const quint8 *const srcSlice[], const int srcStride[])
+{
+    DPTR_D(ImageConverterSIMD);
+    if (d.w_out == 0 || d.h_out == 0) {
+        if (d.w_in == 0 || d.h_in == 0)
+            return false;
+        setOutSize(d.w_in, d.h_in);
+    }
+    const Scale s = d.scale();
+    if (s == ScaleUnsupported)
+        return convertFallback(srcSlice, srcStride);
+    // the output of the previous convert() is still used by a frame
+    if ((!d.buf_out || atomic_load_acquire(d.buf_out->ref) > 1) && !prepareData())
+        return false;
+    if (s == ScaleNone) {
+        const bool eq = d.hasEq();
+        if (eq)
+            d.setupEq();
+        for (int y = 0; y < d.h_in; ++y) {
+            quint8 *dst = d.picture.data[0] + y*d.picture.linesize[0];
+            d.convertRow(srcSlice, srcStride, y, dst);
+            if (eq)
+                d.eqRow(dst); // still in cache
+        }
+    } else if (s == ScaleHalf) {
+        d.convertHalf(srcSlice, srcStride);
+    } else if (s == ScaleDouble) {
+        d.convertDouble(srcSlice, srcStride);
+    } else {
+        d.convertFused(srcSlice, srcStride);
+    }
+    return true;
+}
+
+bool ImageConverterSIMD::convertFallback(const quint8 *const srcSlice[], const int srcStride[])
+{
+    DPTR_D(ImageConverterSIMD);
+    if (!d.fallback)
+        d.fallback.reset(new ImageConverterFF());
+    ImageConverter *c = d.fallback.data();
+    c->setInFormat(d.fmt_in);
+    c->setOutFormat(d.fmt_out);
+    c->setInSize(d.w_in, d.h_in);
+    c->setOutSize(d.w_out, d.h_out);
+    c->setInterlaced(d.interlaced);
+    c->setBrightness(d.brightness);
+    c->setContrast(d.contrast);
+    c->setSaturation(d.saturation);
+    c->setThreads(d.threads);
+    if (!c->convert(srcSlice, srcStride))
+        return false;
+    const QVector<quint8*> planes(c->outPlanes());
+    const QVector<int> line_sizes(c->outLineSizes());
+    d.buf_out = c->takeOutBuffer();
+    for (int i = 0; i < planes.size(); ++i) {
+        d.picture.data[i] = planes[i];
+        d.picture.linesize[i] = line_sizes[i];
+    }
+    return true;
+}
+
+} //namespace QtAV
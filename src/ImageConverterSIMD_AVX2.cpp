@@ -0,0 +1,100 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "ImageConverterSIMD_p.h"
+#include <immintrin.h>
+
+namespace QtAV {
+namespace simd {
+
+// 16 pixels. u, v are centered at 0. results are not clamped
+static inline void yuv2rgb_epi16(__m256i y, __m256i u, __m256i v, __m256i &r, __m256i &g, __m256i &b)
+{
+    const __m256i y64 = _mm256_add_epi16(_mm256_slli_epi16(y, kShift), _mm256_set1_epi16(1 << (kShift - 1)));
+    r = _mm256_srai_epi16(_mm256_add_epi16(y64, _mm256_mullo_epi16(v, _mm256_set1_epi16(kRV))), kShift);
+    g = _mm256_sub_epi16(y64, _mm256_mullo_epi16(u, _mm256_set1_epi16(kGU)));
+    g = _mm256_srai_epi16(_mm256_sub_epi16(g, _mm256_mullo_epi16(v, _mm256_set1_epi16(kGV))), kShift);
+    b = _mm256_srai_epi16(_mm256_add_epi16(y64, _mm256_mullo_epi16(u, _mm256_set1_epi16(kBU))), kShift);
+}
+
+// 16 pixels. u, v: 16 bit chroma of every pixel, centered at 0
+static inline void convert16(const quint8 *y, __m256i u, __m256i v, quint8 *dst, bool rgba)
+{
+    __m256i r, g, b;
+    yuv2rgb_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)y)), u, v, r, g, b);
+    // packus works in 128 bit lanes: [r0~7 g0~7 | r8~15 g8~15] => [r0~15 | g0~15]
+    const __m256i rg = _mm256_permute4x64_epi64(_mm256_packus_epi16(r, g), 0xD8);
+    const __m256i ba = _mm256_permute4x64_epi64(_mm256_packus_epi16(b, _mm256_set1_epi16(0xff)), 0xD8);
+    const __m128i r8 = _mm256_castsi256_si128(rg);
+    const __m128i b8 = _mm256_castsi256_si128(ba);
+    const __m128i c0 = rgba ? r8 : b8;
+    const __m128i c2 = rgba ? b8 : r8;
+    const __m128i g8 = _mm256_extracti128_si256(rg, 1);
+    const __m128i a8 = _mm256_extracti128_si256(ba, 1);
+    // c0 g c2 a of pixel 0~7 in lane 0 and 8~15 in lane 1
+    const __m256i c01_x = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi8(c0, g8)), _mm_unpackhi_epi8(c0, g8), 1);
+    const __m256i c23_x = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi8(c2, a8)), _mm_unpackhi_epi8(c2, a8), 1);
+    const __m256i p0 = _mm256_unpacklo_epi16(c01_x, c23_x); // pixel 0~3 | 8~11
+    const __m256i p1 = _mm256_unpackhi_epi16(c01_x, c23_x); // pixel 4~7 | 12~15
+    _mm256_storeu_si256((__m256i*)dst, _mm256_permute2x128_si256(p0, p1, 0x20));
+    _mm256_storeu_si256((__m256i*)(dst + 32), _mm256_permute2x128_si256(p0, p1, 0x31));
+}
+
+int yuv420_row_avx2(const quint8 *y, const quint8 *u, const quint8 *v, quint8 *dst, int w, bool rgba)
+{
+    const __m256i c128 = _mm256_set1_epi16(128);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        const __m128i u8 = _mm_loadl_epi64((const __m128i*)(u + x/2));
+        const __m128i v8 = _mm_loadl_epi64((const __m128i*)(v + x/2));
+        convert16(y + x, _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(u8, u8)), c128)
+                  , _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(v8, v8)), c128), dst + 4*x, rgba);
+    }
+    return x;
+}
+
+int nv12_row_avx2(const quint8 *y, const quint8 *uv, quint8 *dst, int w, bool rgba)
+{
+    const __m256i c128 = _mm256_set1_epi16(128);
+    const __m128i u_dup = _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, 8, 8, 10, 10, 12, 12, 14, 14);
+    const __m128i v_dup = _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, 9, 9, 11, 11, 13, 13, 15, 15);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        const __m128i uv8 = _mm_loadu_si128((const __m128i*)(uv + x));
+        convert16(y + x, _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_shuffle_epi8(uv8, u_dup)), c128)
+                  , _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_shuffle_epi8(uv8, v_dup)), c128), dst + 4*x, rgba);
+    }
+    return x;
+}
+
+int yuv444_row_avx2(const quint8 *y, const quint8 *u, const quint8 *v, quint8 *dst, int w, bool rgba)
+{
+    const __m256i c128 = _mm256_set1_epi16(128);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        convert16(y + x, _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(u + x))), c128)
+                  , _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(v + x))), c128), dst + 4*x, rgba);
+    }
+    return x;
+}
+
+} //namespace simd
+} //namespace QtAV
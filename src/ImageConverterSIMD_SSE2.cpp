@@ -0,0 +1,135 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "ImageConverterSIMD_p.h"
+#include <emmintrin.h>
+
+namespace QtAV {
+namespace simd {
+
+// 8 pixels. u, v are centered at 0. results are not clamped
+static inline void yuv2rgb_epi16(__m128i y, __m128i u, __m128i v, __m128i &r, __m128i &g, __m128i &b)
+{
+    const __m128i y64 = _mm_add_epi16(_mm_slli_epi16(y, kShift), _mm_set1_epi16(1 << (kShift - 1)));
+    r = _mm_srai_epi16(_mm_add_epi16(y64, _mm_mullo_epi16(v, _mm_set1_epi16(kRV))), kShift);
+    g = _mm_sub_epi16(y64, _mm_mullo_epi16(u, _mm_set1_epi16(kGU)));
+    g = _mm_srai_epi16(_mm_sub_epi16(g, _mm_mullo_epi16(v, _mm_set1_epi16(kGV))), kShift);
+    b = _mm_srai_epi16(_mm_add_epi16(y64, _mm_mullo_epi16(u, _mm_set1_epi16(kBU))), kShift);
+}
+
+// 16 pixels of 8 bit channels to 64 bytes
+static inline void store_rgb(quint8 *dst, __m128i r, __m128i g, __m128i b, bool rgba)
+{
+    const __m128i a = _mm_set1_epi8((char)0xff);
+    const __m128i c0 = rgba ? r : b;
+    const __m128i c2 = rgba ? b : r;
+    const __m128i c01_lo = _mm_unpacklo_epi8(c0, g);
+    const __m128i c01_hi = _mm_unpackhi_epi8(c0, g);
+    const __m128i c23_lo = _mm_unpacklo_epi8(c2, a);
+    const __m128i c23_hi = _mm_unpackhi_epi8(c2, a);
+    _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi16(c01_lo, c23_lo));
+    _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(c01_lo, c23_lo));
+    _mm_storeu_si128((__m128i*)(dst + 32), _mm_unpacklo_epi16(c01_hi, c23_hi));
+    _mm_storeu_si128((__m128i*)(dst + 48), _mm_unpackhi_epi16(c01_hi, c23_hi));
+}
+
+// 16 pixels. chroma of pixel 0~7 and 8~15, centered at 0
+static inline void convert16(const quint8 *y, __m128i u_lo, __m128i u_hi, __m128i v_lo, __m128i v_hi, quint8 *dst, bool rgba)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i y8 = _mm_loadu_si128((const __m128i*)y);
+    __m128i r0, g0, b0, r1, g1, b1;
+    yuv2rgb_epi16(_mm_unpacklo_epi8(y8, zero), u_lo, v_lo, r0, g0, b0);
+    yuv2rgb_epi16(_mm_unpackhi_epi8(y8, zero), u_hi, v_hi, r1, g1, b1);
+    store_rgb(dst, _mm_packus_epi16(r0, r1), _mm_packus_epi16(g0, g1), _mm_packus_epi16(b0, b1), rgba);
+}
+
+int yuv420_row_sse2(const quint8 *y, const quint8 *u, const quint8 *v, quint8 *dst, int w, bool rgba)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c128 = _mm_set1_epi16(128);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        const __m128i u16 = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(u + x/2)), zero), c128);
+        const __m128i v16 = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(v + x/2)), zero), c128);
+        convert16(y + x, _mm_unpacklo_epi16(u16, u16), _mm_unpackhi_epi16(u16, u16)
+                  , _mm_unpacklo_epi16(v16, v16), _mm_unpackhi_epi16(v16, v16), dst + 4*x, rgba);
+    }
+    return x;
+}
+
+int nv12_row_sse2(const quint8 *y, const quint8 *uv, quint8 *dst, int w, bool rgba)
+{
+    const __m128i c128 = _mm_set1_epi16(128);
+    const __m128i mask = _mm_set1_epi16(0xff);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        const __m128i uv8 = _mm_loadu_si128((const __m128i*)(uv + x));
+        const __m128i u16 = _mm_sub_epi16(_mm_and_si128(uv8, mask), c128);
+        const __m128i v16 = _mm_sub_epi16(_mm_srli_epi16(uv8, 8), c128);
+        convert16(y + x, _mm_unpacklo_epi16(u16, u16), _mm_unpackhi_epi16(u16, u16)
+                  , _mm_unpacklo_epi16(v16, v16), _mm_unpackhi_epi16(v16, v16), dst + 4*x, rgba);
+    }
+    return x;
+}
+
+int yuv444_row_sse2(const quint8 *y, const quint8 *u, const quint8 *v, quint8 *dst, int w, bool rgba)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c128 = _mm_set1_epi16(128);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        const __m128i u8 = _mm_loadu_si128((const __m128i*)(u + x));
+        const __m128i v8 = _mm_loadu_si128((const __m128i*)(v + x));
+        convert16(y + x, _mm_sub_epi16(_mm_unpacklo_epi8(u8, zero), c128), _mm_sub_epi16(_mm_unpackhi_epi8(u8, zero), c128)
+                  , _mm_sub_epi16(_mm_unpacklo_epi8(v8, zero), c128), _mm_sub_epi16(_mm_unpackhi_epi8(v8, zero), c128)
+                  , dst + 4*x, rgba);
+    }
+    return x;
+}
+
+int half_row_sse2(const quint8 *r0, const quint8 *r1, quint8 *dst, int w)
+{
+    const __m128i mask = _mm_set1_epi16(0xff);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        const __m128i a0 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(r0 + 2*x)), _mm_loadu_si128((const __m128i*)(r1 + 2*x)));
+        const __m128i a1 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(r0 + 2*x + 16)), _mm_loadu_si128((const __m128i*)(r1 + 2*x + 16)));
+        const __m128i h0 = _mm_avg_epu16(_mm_and_si128(a0, mask), _mm_srli_epi16(a0, 8));
+        const __m128i h1 = _mm_avg_epu16(_mm_and_si128(a1, mask), _mm_srli_epi16(a1, 8));
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(h0, h1));
+    }
+    return x;
+}
+
+int double_row_sse2(const quint32 *src, quint32 *dst, int w)
+{
+    int x = 0;
+    for (; x + 4 <= w; x += 4) {
+        const __m128i s = _mm_loadu_si128((const __m128i*)(src + x));
+        _mm_storeu_si128((__m128i*)(dst + 2*x), _mm_unpacklo_epi32(s, s));
+        _mm_storeu_si128((__m128i*)(dst + 2*x + 4), _mm_unpackhi_epi32(s, s));
+    }
+    return x;
+}
+
+} //namespace simd
+} //namespace QtAV
@@ -0,0 +1,100 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_IMAGECONVERTERSIMD_P_H
+#define QTAV_IMAGECONVERTERSIMD_P_H
+
+#include <QtCore/QtGlobal>
+
+/*
+ * Row kernels of ImageConverterSIMD. Full range BT.601 as ImageConverterFF, with 6 bit fixed point coefficients so
+ * every intermediate value fits 16 bits. The scalar functions are the reference and convert the tail of a row, simd
+ * kernels return the number of pixels converted, a multiple of their vector width.
+ * Output is 4 bytes per pixel, B G R A or R G B A if rgba is true. Alpha is 255.
+ */
+namespace QtAV {
+namespace simd {
+
+enum {
+    kShift = 6,
+    kRV = 90,  // 1.402*64
+    kGU = 22,  // 0.34414*64
+    kGV = 46,  // 0.71414*64
+    kBU = 113  // 1.772*64
+};
+
+inline quint8 clip8(int v) { return v < 0 ? 0 : (v > 255 ? 255 : (quint8)v);}
+
+inline void yuv2rgb(int y, int u, int v, quint8 *d, bool rgba) {
+    u -= 128;
+    v -= 128;
+    const int y64 = (y << kShift) + (1 << (kShift - 1));
+    const quint8 r = clip8((y64 + kRV*v) >> kShift);
+    const quint8 g = clip8((y64 - kGU*u - kGV*v) >> kShift);
+    const quint8 b = clip8((y64 + kBU*u) >> kShift);
+    d[0] = rgba ? r : b;
+    d[1] = g;
+    d[2] = rgba ? b : r;
+    d[3] = 255;
+}
+
+// chroma is horizontally subsampled by 2 (yuv420p, yuv422p). convert pixels [x, w)
+inline void yuv420_row_c(const quint8 *y, const quint8 *u, const quint8 *v, quint8 *dst, int x, int w, bool rgba) {
+    for (; x < w; ++x)
+        yuv2rgb(y[x], u[x>>1], v[x>>1], dst + 4*x, rgba);
+}
+// interleaved chroma (nv12)
+inline void nv12_row_c(const quint8 *y, const quint8 *uv, quint8 *dst, int x, int w, bool rgba) {
+    for (; x < w; ++x)
+        yuv2rgb(y[x], uv[x & ~1], uv[x | 1], dst + 4*x, rgba);
+}
+// chroma of every pixel
+inline void yuv444_row_c(const quint8 *y, const quint8 *u, const quint8 *v, quint8 *dst, int x, int w, bool rgba) {
+    for (; x < w; ++x)
+        yuv2rgb(y[x], u[x], v[x], dst + 4*x, rgba);
+}
+// 2x2 box of 2 rows to w output pixels. rounded as 2 pavgb
+inline void half_row_c(const quint8 *r0, const quint8 *r1, quint8 *dst, int x, int w) {
+    for (; x < w; ++x) {
+        const int a = (r0[2*x] + r1[2*x] + 1) >> 1;
+        const int b = (r0[2*x+1] + r1[2*x+1] + 1) >> 1;
+        dst[x] = (a + b + 1) >> 1;
+    }
+}
+// repeat every 32 bit pixel of src (w pixels) twice
+inline void double_row_c(const quint32 *src, quint32 *dst, int x, int w) {
+    for (; x < w; ++x)
+        dst[2*x] = dst[2*x+1] = src[x];
+}
+
+int yuv420_row_sse2(const quint8 *y, const quint8 *u, const quint8 *v, quint8 *dst, int w, bool rgba);
+int nv12_row_sse2(const quint8 *y, const quint8 *uv, quint8 *dst, int w, bool rgba);
+int yuv444_row_sse2(const quint8 *y, const quint8 *u, const quint8 *v, quint8 *dst, int w, bool rgba);
+int half_row_sse2(const quint8 *r0, const quint8 *r1, quint8 *dst, int w);
+int double_row_sse2(const quint32 *src, quint32 *dst, int w);
+
+int yuv420_row_avx2(const quint8 *y, const quint8 *u, const quint8 *v, quint8 *dst, int w, bool rgba);
+int nv12_row_avx2(const quint8 *y, const quint8 *uv, quint8 *dst, int w, bool rgba);
+int yuv444_row_avx2(const quint8 *y, const quint8 *u, const quint8 *v, quint8 *dst, int w, bool rgba);
+
+} //namespace simd
+} //namespace QtAV
+#endif // QTAV_IMAGECONVERTERSIMD_P_H
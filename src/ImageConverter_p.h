@@ -24,6 +24,7 @@
 #define QTAV_IMAGECONVERTER_P_H
 
 #include "QtAV/private/AVCompat.h"
+#include "QtAV/FrameBufferPool.h"
 #include <QtCore/QByteArray>
 
 namespace QtAV {
@@ -41,6 +42,7 @@ public:
         , brightness(0)
         , contrast(0)
         , saturation(0)
+        , threads(0)
     {}
     virtual bool setupColorspaceDetails(bool force = true) {
         Q_UNUSED(force);
@@ -51,7 +53,9 @@ public:
     int w_in, h_in, w_out, h_out;
     int fmt_in, fmt_out;
     int brightness, contrast, saturation;
-    QByteArray data_out;
+    int threads;
+    QByteArray data_out; // used by IPP
+    FrameBufferRef buf_out;
     AVPicture picture;
 };
 
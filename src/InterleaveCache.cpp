@@ -0,0 +1,86 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "InterleaveCache.h"
+#include "PacketBuffer.h"
+
+namespace QtAV {
+// blocking put() is used if reached
+static const int kMaxPackets = 1024;
+static const qint64 kMaxBytes = 32LL*1024LL*1024LL;
+
+InterleaveCache::InterleaveCache()
+    : m_bytes(0)
+{}
+
+bool InterleaveCache::put(PacketBuffer *queue, const Packet &pkt, PacketBuffer *other)
+{
+    if (!m_packets.isEmpty())
+        flush(queue, false);
+    if (m_packets.isEmpty() && !queue->isFull()) {
+        queue->put(pkt);
+        return false;
+    }
+    // queue is full, or older packets are still waiting (keep order)
+    if (!other || other->isEnough()) { // the other stream can be played. wait for the consumer as usual
+        flush(queue, true);
+        queue->put(pkt);
+        return false;
+    }
+    if (m_packets.size() < kMaxPackets && m_bytes < kMaxBytes) {
+        m_packets.enqueue(pkt);
+        m_bytes += pkt.data.size();
+        return true;
+    }
+    // too many are cached while the other stream is still starving. blocking may deadlock, let queue grow instead
+    queue->blockFull(false);
+    flush(queue, true);
+    queue->put(pkt);
+    return false;
+}
+
+void InterleaveCache::flush(PacketBuffer *queue, bool block)
+{
+    while (!m_packets.isEmpty()) {
+        if (!block && queue->isFull())
+            return;
+        m_bytes -= m_packets.head().data.size();
+        queue->put(m_packets.dequeue());
+    }
+    m_bytes = 0;
+}
+
+void InterleaveCache::clear()
+{
+    m_packets.clear();
+    m_bytes = 0;
+}
+
+bool InterleaveCache::isEmpty() const
+{
+    return m_packets.isEmpty();
+}
+
+int InterleaveCache::size() const
+{
+    return m_packets.size();
+}
+} //namespace QtAV
@@ -0,0 +1,60 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_INTERLEAVECACHE_H
+#define QTAV_INTERLEAVECACHE_H
+
+#include <QtCore/QQueue>
+#include <QtAV/Packet.h>
+
+namespace QtAV {
+class PacketBuffer;
+/*!
+ * \brief The InterleaveCache class
+ * Side cache of one stream for badly interleaved media, e.g. aaaaaaavvvvvvvaaaaaaaavvvvvvvvv. If the queue of this
+ * stream is full while the queue of the other stream is starving, packets are parked here instead of blocking in put(),
+ * so the demuxer can keep reading and feeding the other stream. Used by the demux thread only.
+ */
+class InterleaveCache
+{
+public:
+    InterleaveCache();
+    /*!
+     * \brief put
+     * Put pkt to queue, or to the cache if queue is full and other is not enough. Cached packets are always moved to
+     * queue first. Once other is no longer starving, the cache is flushed (may block) and bypassed again.
+     * If the cache reaches 1024 packets or 32MB while other is still starving, queue->blockFull(false) is called and
+     * the packets are put to queue without blocking, i.e. queue grows beyond its capacity.
+     * \param other the queue of the other stream. 0 if there is no other stream to feed
+     * \return true if pkt is cached
+     */
+    bool put(PacketBuffer *queue, const Packet& pkt, PacketBuffer *other);
+    // move cached packets to queue. if block is false, stop when queue is full
+    void flush(PacketBuffer *queue, bool block);
+    void clear();
+    bool isEmpty() const;
+    int size() const;
+private:
+    QQueue<Packet> m_packets;
+    qint64 m_bytes;
+};
+} //namespace QtAV
+#endif // QTAV_INTERLEAVECACHE_H
@@ -0,0 +1,428 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "KeyFrameIndex.h"
+#include <algorithm>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
+#include "QtAV/QtAV_Global.h"
+#include "QtAV/private/AVCompat.h"
+#include "utils/internal.h"
+#include "utils/spsc_ring.h" // atomic helpers
+#include "utils/Logger.h"
+
+namespace QtAV {
+extern QString getLocalPath(const QString& fullPath);
+
+static const quint32 kMagic = 0x514b4649; // QKFI
+static const quint32 kVersion = 2; // 2: no file path
+static const int kMaxCacheFiles = 128;
+// a larger pts jump in decoding order is a timestamp discontinuity (e.g. mpegts), a new segment starts
+static const qint64 kMaxBackward = 1000;
+static const qint64 kMaxForward = 10000;
+
+static bool entryLessThan(const KeyFrameIndex::Entry& a, const KeyFrameIndex::Entry& b)
+{
+    return a.pts < b.pts;
+}
+
+static bool segmentLessThan(const KeyFrameIndex::Segment& a, const KeyFrameIndex::Segment& b)
+{
+    return a.start < b.start;
+}
+
+// remove the least recently saved files
+static void removeStaleCaches(const QString& dir)
+{
+    const QFileInfoList files = QDir(dir).entryInfoList(QStringList() << QStringLiteral("*.kfi"), QDir::Files, QDir::Time);
+    for (int i = kMaxCacheFiles; i < files.size(); ++i)
+        QFile::remove(files.at(i).absoluteFilePath());
+}
+
+static int scanInterruptCallback(void *opaque)
+{
+    QAtomicInt *cancel = static_cast<QAtomicInt*>(opaque);
+    return atomic_load_acquire(*cancel);
+}
+
+class KeyFrameScanTask : public QRunnable
+{
+public:
+    KeyFrameScanTask(KeyFrameIndex *index, const QString& file) : m_index(index), m_file(file) {}
+    void run() Q_DECL_OVERRIDE {
+        QVector<KeyFrameIndex::Entry> entries;
+        if (scan(&entries) && !atomic_load_acquire(m_index->m_scan_cancel))
+            m_index->setComplete(entries);
+        QMutexLocker lock(&m_index->m_mutex);
+        Q_UNUSED(lock);
+        m_index->m_scanning = false;
+        m_index->m_scan_cond.wakeAll();
+    }
+private:
+    // read video packets only, no decoding
+    bool scan(QVector<KeyFrameIndex::Entry> *entries) {
+        AVFormatContext *ctx = avformat_alloc_context();
+        ctx->interrupt_callback.callback = scanInterruptCallback;
+        ctx->interrupt_callback.opaque = &m_index->m_scan_cancel;
+        if (avformat_open_input(&ctx, m_file.toUtf8().constData(), NULL, NULL) < 0) // ctx is freed
+            return false;
+        if (avformat_find_stream_info(ctx, NULL) < 0) {
+            avformat_close_input(&ctx);
+            return false;
+        }
+        const int vs = av_find_best_stream(ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+        if (vs < 0) {
+            avformat_close_input(&ctx);
+            return false;
+        }
+        for (unsigned i = 0; i < ctx->nb_streams; ++i) {
+            if ((int)i != vs)
+                ctx->streams[i]->discard = AVDISCARD_ALL;
+        }
+        const double tb = av_q2d(ctx->streams[vs]->time_base);
+        qint64 last = -1;
+        bool ok = true;
+        int ret = 0;
+        AVPacket packet;
+        while ((ret = av_read_frame(ctx, &packet)) >= 0) {
+            // the same pts as Packet::fromAVPacket(), without copying the data
+            const int64_t ts = packet.pts != (int64_t)AV_NOPTS_VALUE ? packet.pts : packet.dts;
+            if (packet.stream_index == vs && (packet.flags & AV_PKT_FLAG_KEY) && ts != (int64_t)AV_NOPTS_VALUE) {
+                KeyFrameIndex::Entry e;
+                e.pts = qMax<qint64>(0, qint64(double(ts)*tb*1000.0));
+                e.pos = packet.pos;
+                if (last >= 0 && (e.pts + kMaxBackward < last || e.pts > last + kMaxForward*10)) {
+                    // the whole file can not be indexed by pts
+                    qDebug("key frame scan: timestamp discontinuity at %lld", e.pos);
+                    ok = false;
+                }
+                last = e.pts;
+                entries->append(e);
+            }
+            av_free_packet(&packet);
+            if (!ok || atomic_load_acquire(m_index->m_scan_cancel))
+                break;
+        }
+        if (ret < 0 && ret != AVERROR_EOF) // read error or interrupted
+            ok = false;
+        avformat_close_input(&ctx);
+        std::sort(entries->begin(), entries->end(), entryLessThan);
+        qDebug("key frame scan finished: %d key frames", entries->size());
+        return ok;
+    }
+
+    KeyFrameIndex *m_index;
+    QString m_file;
+};
+
+KeyFrameIndex::KeyFrameIndex()
+    : m_persistent(false)
+    , m_file_size(0)
+    , m_file_mtime(0)
+    , m_complete(false)
+    , m_dirty(false)
+    , m_scanning(false)
+{
+    m_seg.start = m_seg.end = -1;
+}
+
+KeyFrameIndex::~KeyFrameIndex()
+{
+    stopScan();
+    save();
+}
+
+void KeyFrameIndex::setPersistent(bool value)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_persistent = value;
+}
+
+bool KeyFrameIndex::isPersistent() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_persistent;
+}
+
+QString KeyFrameIndex::cacheDir()
+{
+    return Internal::Path::appCacheDir() + QStringLiteral("/keyframes");
+}
+
+bool KeyFrameIndex::setFile(const QString &path)
+{
+    stopScan();
+    reset();
+    const QFileInfo fi(getLocalPath(path));
+    if (!fi.isFile())
+        return false;
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_file = fi.absoluteFilePath();
+    m_file_size = fi.size();
+    m_file_mtime = fi.lastModified().toMSecsSinceEpoch();
+    if (!m_persistent)
+        return true;
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(m_file.toUtf8());
+    hash.addData(QByteArray::number(m_file_size));
+    hash.addData(QByteArray::number(m_file_mtime));
+    m_cache_file = cacheDir() + QStringLiteral("/") + QString::fromLatin1(hash.result().toHex()) + QStringLiteral(".kfi");
+    QFile f(m_cache_file);
+    if (!f.open(QIODevice::ReadOnly))
+        return true;
+    QDataStream ds(&f);
+    quint32 magic = 0, version = 0;
+    qint64 size = 0, mtime = 0;
+    ds >> magic >> version;
+    if (magic != kMagic || version != kVersion)
+        return true;
+    ds >> size >> mtime;
+    if (size != m_file_size || mtime != m_file_mtime)
+        return true;
+    qint32 n = 0;
+    ds >> m_complete >> n;
+    m_entries.resize(qMax(0, n));
+    for (int i = 0; i < m_entries.size(); ++i)
+        ds >> m_entries[i].pts >> m_entries[i].pos;
+    ds >> n;
+    m_segments.resize(qMax(0, n));
+    for (int i = 0; i < m_segments.size(); ++i)
+        ds >> m_segments[i].start >> m_segments[i].end;
+    if (ds.status() != QDataStream::Ok) {
+        qWarning("Corrupt key frame index cache: %s", m_cache_file.toUtf8().constData());
+        m_complete = false;
+        m_entries.clear();
+        m_segments.clear();
+        return true;
+    }
+    qDebug("key frame index cache loaded. %d key frames, complete: %d", m_entries.size(), m_complete);
+    return true;
+}
+
+void KeyFrameIndex::reset()
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_file.clear();
+    m_cache_file.clear();
+    m_file_size = m_file_mtime = 0;
+    m_complete = m_dirty = false;
+    m_entries.clear();
+    m_segments.clear();
+    m_seg.start = m_seg.end = -1;
+}
+
+bool KeyFrameIndex::save()
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (m_cache_file.isEmpty() || !m_dirty)
+        return true;
+    QVector<Segment> segments(m_segments);
+    if (m_seg.start >= 0)
+        segments.append(m_seg);
+    if (!QDir().mkpath(cacheDir()))
+        return false;
+    const QString tmp(m_cache_file + QStringLiteral(".tmp"));
+    QFile f(tmp);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qWarning("Failed to save key frame index: %s", f.errorString().toUtf8().constData());
+        return false;
+    }
+    QDataStream ds(&f);
+    ds << kMagic << kVersion << m_file_size << m_file_mtime << m_complete << qint32(m_entries.size());
+    foreach (const Entry& e, m_entries)
+        ds << e.pts << e.pos;
+    ds << qint32(segments.size());
+    foreach (const Segment& s, segments)
+        ds << s.start << s.end;
+    f.close();
+    QFile::remove(m_cache_file);
+    if (!QFile::rename(tmp, m_cache_file))
+        return false;
+    m_dirty = false;
+    removeStaleCaches(cacheDir());
+    return true;
+}
+
+QString KeyFrameIndex::cacheFile() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_cache_file;
+}
+
+bool KeyFrameIndex::isValid() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return !m_file.isEmpty();
+}
+
+bool KeyFrameIndex::isComplete() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_complete;
+}
+
+int KeyFrameIndex::size() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_entries.size();
+}
+
+void KeyFrameIndex::beginSegment()
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    closeSegment();
+}
+
+void KeyFrameIndex::addPacket(qint64 pts, qint64 pos, bool key)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (m_file.isEmpty() || m_complete)
+        return;
+    if (m_seg.start >= 0 && (pts + kMaxBackward < m_seg.end || pts > m_seg.end + kMaxForward))
+        closeSegment();
+    if (m_seg.start < 0) {
+        if (!key)
+            return;
+        m_seg.start = m_seg.end = pts;
+    }
+    m_seg.end = qMax(m_seg.end, pts);
+    m_dirty = true;
+    if (!key)
+        return;
+    Entry e;
+    e.pts = pts;
+    e.pos = pos;
+    if (m_entries.isEmpty() || m_entries.last().pts < pts) { // usually
+        m_entries.append(e);
+        return;
+    }
+    QVector<Entry>::iterator it = std::lower_bound(m_entries.begin(), m_entries.end(), e, entryLessThan);
+    if (it != m_entries.end() && it->pts == pts)
+        it->pos = pos;
+    else
+        m_entries.insert(it, e);
+}
+
+bool KeyFrameIndex::find(qint64 pts, Entry *entry) const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (m_entries.isEmpty())
+        return false;
+    qint64 start = -1;
+    if (m_complete) {
+        start = m_entries.first().pts;
+    } else if (m_seg.start >= 0 && m_seg.start <= pts && pts <= m_seg.end) {
+        start = m_seg.start;
+    } else {
+        foreach (const Segment& s, m_segments) {
+            if (s.start <= pts && pts <= s.end) {
+                start = s.start;
+                break;
+            }
+        }
+    }
+    if (start < 0)
+        return false;
+    Entry e;
+    e.pts = pts;
+    QVector<Entry>::const_iterator it = std::upper_bound(m_entries.constBegin(), m_entries.constEnd(), e, entryLessThan);
+    if (it == m_entries.constBegin())
+        return false;
+    --it;
+    if (it->pts < start)
+        return false;
+    if (entry)
+        *entry = *it;
+    return true;
+}
+
+void KeyFrameIndex::scanAsync()
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (m_file.isEmpty() || m_complete || m_scanning)
+        return;
+    m_scanning = true;
+    m_scan_cancel.fetchAndStoreOrdered(0);
+    QThreadPool::globalInstance()->start(new KeyFrameScanTask(this, m_file));
+}
+
+void KeyFrameIndex::stopScan()
+{
+    m_scan_cancel.fetchAndStoreOrdered(1);
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    while (m_scanning)
+        m_scan_cond.wait(&m_mutex);
+}
+
+void KeyFrameIndex::closeSegment()
+{
+    if (m_seg.start < 0)
+        return;
+    m_segments.append(m_seg);
+    m_seg.start = m_seg.end = -1;
+    // merge overlapped segments. a gap between segments may have key frames not indexed
+    std::sort(m_segments.begin(), m_segments.end(), segmentLessThan);
+    QVector<Segment> segments;
+    foreach (const Segment& s, m_segments) {
+        if (segments.isEmpty() || s.start > segments.last().end) {
+            segments.append(s);
+            continue;
+        }
+        segments.last().end = qMax(segments.last().end, s.end);
+    }
+    m_segments = segments;
+}
+
+void KeyFrameIndex::setComplete(const QVector<Entry> &entries)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        m_entries = entries;
+        m_segments.clear();
+        m_seg.start = m_seg.end = -1;
+        m_complete = true;
+        m_dirty = true;
+    }
+    save();
+}
+
+} //namespace QtAV
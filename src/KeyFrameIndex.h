@@ -0,0 +1,106 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_KEYFRAMEINDEX_H
+#define QTAV_KEYFRAMEINDEX_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+
+namespace QtAV {
+/*!
+ * \brief The KeyFrameIndex class
+ * Video key frame index of a local file: pts(ms) => byte position.
+ * Built from the packets read by the demuxer, or by a background scan of the whole file which reads packets without decoding.
+ * Packets read after a seek form a segment. A position can be looked up only if it's in a segment, so the key frame found is
+ * the nearest one before the position.
+ * If persistent, the index is saved to a cache file named by a hash of the file identity (path, size and modified time),
+ * and loaded next time. The path itself is not stored. Only the 128 most recently saved files are kept in cacheDir().
+ * All functions are thread safe.
+ */
+class KeyFrameIndex
+{
+public:
+    struct Entry {
+        qint64 pts; // ms
+        qint64 pos; // byte position. <0: unknown
+    };
+    KeyFrameIndex();
+    ~KeyFrameIndex();
+    /*!
+     * \brief setPersistent
+     * Load and save the index cache file. Default is false, the index lives in memory only. Set it before setFile().
+     */
+    void setPersistent(bool value);
+    bool isPersistent() const;
+    /*!
+     * \brief setFile
+     * Reset the index, then load the cache for the file if exists. save() the old index before calling it if needed.
+     * \return false if not a local file. Then the index is disabled
+     */
+    bool setFile(const QString& path);
+    void reset();
+    bool save();
+    QString cacheFile() const; // empty if not persistent or no file
+    bool isValid() const;
+    bool isComplete() const;
+    int size() const;
+    // start a new segment. call it after seek
+    void beginSegment();
+    // add a video packet read by the demuxer in decoding order
+    void addPacket(qint64 pts, qint64 pos, bool key);
+    // nearest key frame whose pts <= pts, in a segment
+    bool find(qint64 pts, Entry* entry) const;
+    // scan the file in QThreadPool if not complete. the result is merged and saved when finished
+    void scanAsync();
+    void stopScan(); // cancel and wait
+
+    // cache dir of all index files
+    static QString cacheDir();
+    struct Segment {
+        qint64 start, end; // pts(ms) of the first key frame and the last packet
+    };
+private:
+    void closeSegment(); // lock must be held
+    void setComplete(const QVector<Entry>& entries);
+    friend class KeyFrameScanTask;
+
+    mutable QMutex m_mutex;
+    QString m_file;
+    QString m_cache_file;
+    bool m_persistent;
+    qint64 m_file_size;
+    qint64 m_file_mtime; // ms since epoch
+    bool m_complete;
+    bool m_dirty;
+    QVector<Entry> m_entries; // sorted by pts
+    QVector<Segment> m_segments;
+    Segment m_seg; // current segment. start < 0: not started, i.e. no key frame after beginSegment()
+    // scan
+    QAtomicInt m_scan_cancel;
+    bool m_scanning;
+    QWaitCondition m_scan_cond;
+};
+} //namespace QtAV
+#endif // QTAV_KEYFRAMEINDEX_H
@@ -20,16 +20,35 @@
 ******************************************************************************/
 
 #include "PacketBuffer.h"
+#include <QtCore/QThread>
 
 namespace QtAV {
 
+// initial physical slots. the logical limit is bufferValue()*bufferMax(), the ring grows if it's not enough
+static const int kRingCapacity = 2048;
+
+static int clampMsecs(qint64 ms)
+{
+    return int(qBound<qint64>(-0x7fffffffLL, ms, 0x7fffffffLL));
+}
+
 PacketBuffer::PacketBuffer()
-    : m_mode(BufferTime)
+    : m_ring(kRingCapacity)
+    , m_consumer(0)
+    , m_bytes(0)
+    , m_head_ms(0)
+    , m_tail_ms(0)
+    , m_block_empty(1)
+    , m_block_full(1)
+    , m_empty_waiting(0)
+    , m_full_waiting(0)
+    , m_empty_callback(0)
+    , m_threshold_callback(0)
+    , m_full_callback(0)
+    , m_mode(BufferTime)
     , m_buffering(true) // in buffering state at the beginning
     , m_max(1.5)
     , m_buffer(0)
-    , m_value0(0)
-    , m_value1(0)
 {
 }
 
@@ -39,16 +58,8 @@ PacketBuffer::~PacketBuffer()
 
 void PacketBuffer::setBufferMode(BufferMode mode)
 {
+    // buffered value is computed from queued packets, so nothing to update
     m_mode = mode;
-    if (queue.isEmpty()) {
-        m_value0 = m_value1 = 0;
-        return;
-    }
-    if (m_mode == BufferTime) {
-        m_value0 = qint64(queue[0].pts*1000.0);
-    } else {
-        m_value0 = 0;
-    }
 }
 
 BufferMode PacketBuffer::bufferMode() const
@@ -82,8 +93,13 @@ qreal PacketBuffer::bufferMax() const
 
 qint64 PacketBuffer::buffered() const
 {
-    Q_ASSERT(m_value1 >= m_value0);
-    return m_value1 - m_value0;
+    if (m_ring.empty())
+        return 0;
+    if (m_mode == BufferTime) // FIXME: what if no pts
+        return qMax<qint64>(0LL, qint64(atomic_load_acquire(m_tail_ms)) - qint64(atomic_load_acquire(m_head_ms)));
+    if (m_mode == BufferBytes)
+        return qMax<qint64>(0LL, atomic_load_relaxed(m_bytes));
+    return m_ring.size();
 }
 
 bool PacketBuffer::isBuffering() const
@@ -97,6 +113,155 @@ qreal PacketBuffer::bufferProgress() const
     return qMax<qreal>(qMin<qreal>(p, 1.0), 0.0);
 }
 
+void PacketBuffer::put(const Packet &t)
+{
+    if (checkFull()) {
+        //qDebug("queue full"); //too frequent
+        if (m_full_callback)
+            m_full_callback->call();
+        if (atomic_load_relaxed(m_block_full))
+            waitFull();
+    }
+    Entry e;
+    e.packet = t;
+    e.msecs = qint64(t.pts*1000.0);
+    m_bytes.fetchAndAddOrdered(t.data.size());
+    if (m_ring.full()) {
+        // never wait for a free slot, otherwise blockFull(false) blocks too. the consumer is excluded while moving
+        lockConsumer();
+        m_ring.reserve(int(m_ring.capacity())*2);
+        unlockConsumer();
+    }
+    const int ms = clampMsecs(e.msecs);
+    atomic_store_release(m_tail_ms, ms);
+    // the consumer only updates the head if not empty
+    if (m_ring.empty())
+        atomic_store_release(m_head_ms, ms);
+    m_ring.push_back(e);
+    if (m_ring.size() == 1)
+        atomic_store_release(m_head_ms, ms);
+    // TODO: compute buffer speed (and auto set the best bufferValue)
+    if (!checkEnough())
+        return;
+    m_buffering = false; //emit buffering finished here
+    wakeEmpty();
+}
+
+Packet PacketBuffer::take()
+{
+    if (!checkEnough()) {
+        wakeFull();
+        if (checkEmpty()) {
+            //qDebug("queue empty!!");
+            if (m_empty_callback)
+                m_empty_callback->call();
+            if (atomic_load_relaxed(m_block_empty))
+                waitEnough(); //block when empty only
+        }
+    }
+    lockConsumer();
+    //TODO: Why still empty?
+    if (m_ring.empty()) {
+        unlockConsumer();
+        qWarning("Queue is still empty");
+        if (m_empty_callback)
+            m_empty_callback->call();
+        return Packet();
+    }
+    Entry &e = m_ring.front();
+    const Packet t(e.packet);
+    e.packet = Packet(); // release the data now, the slot may be reused much later
+    m_ring.pop_front();
+    if (m_ring.empty())
+        m_buffering = true; // start buffering if empty
+    else
+        atomic_store_release(m_head_ms, clampMsecs(m_ring.front().msecs));
+    unlockConsumer();
+    m_bytes.fetchAndAddOrdered(-t.data.size());
+    return t;
+}
+
+void PacketBuffer::setBlocking(bool block)
+{
+    m_block_empty.fetchAndStoreOrdered(block);
+    m_block_full.fetchAndStoreOrdered(block);
+    if (block)
+        return;
+    QMutexLocker lock(&m_park_mutex);
+    Q_UNUSED(lock);
+    m_cond_empty.wakeAll(); //empty still wait. setBlock=>setCapacity(-1)
+    m_cond_full.wakeAll();
+}
+
+void PacketBuffer::blockEmpty(bool block)
+{
+    m_block_empty.fetchAndStoreOrdered(block);
+    if (!block)
+        wakeEmpty();
+}
+
+void PacketBuffer::blockFull(bool block)
+{
+    // called for every packet in demux thread, it's just an atomic store if no one is waiting
+    m_block_full.fetchAndStoreOrdered(block);
+    if (!block)
+        wakeFull();
+}
+
+void PacketBuffer::clear()
+{
+    lockConsumer();
+    while (!m_ring.empty()) {
+        Entry &e = m_ring.front();
+        m_bytes.fetchAndAddOrdered(-e.packet.data.size());
+        e.packet = Packet();
+        m_ring.pop_front();
+    }
+    m_buffering = true;
+    unlockConsumer();
+    wakeFull();
+}
+
+bool PacketBuffer::isEmpty() const
+{
+    return checkEmpty();
+}
+
+bool PacketBuffer::isEnough() const
+{
+    return checkEnough();
+}
+
+bool PacketBuffer::isFull() const
+{
+    return checkFull();
+}
+
+int PacketBuffer::size() const
+{
+    return int(m_ring.size());
+}
+
+void PacketBuffer::setEmptyCallback(StateChangeCallback *call)
+{
+    m_empty_callback.reset(call);
+}
+
+void PacketBuffer::setThresholdCallback(StateChangeCallback *call)
+{
+    m_threshold_callback.reset(call);
+}
+
+void PacketBuffer::setFullCallback(StateChangeCallback *call)
+{
+    m_full_callback.reset(call);
+}
+
+bool PacketBuffer::checkEmpty() const
+{
+    return m_ring.empty();
+}
+
 bool PacketBuffer::checkEnough() const
 {
     return buffered() >= bufferValue();
@@ -107,46 +272,58 @@ bool PacketBuffer::checkFull() const
     return buffered() >= qint64(qreal(bufferValue())*bufferMax());
 }
 
-void PacketBuffer::onPut(const Packet &p)
+void PacketBuffer::lockConsumer()
 {
-    if (m_mode == BufferTime) {
-        m_value1 = qint64(p.pts*1000.0); // FIXME: what if no pts
-        m_value0 = qint64(queue[0].pts*1000.0); // must compute here because it is reset to 0 if take from empty
-        //if (isBuffering())
-          //  qDebug("+buffering progress: %.1f%%=%.1f/%.1f~%.1fs %d-%d", bufferProgress()*100.0, (qreal)buffered()/1000.0, (qreal)bufferValue()/1000.0, qreal(bufferValue())*bufferMax()/1000.0, m_value1, m_value0);
-    } else if (m_mode == BufferBytes) {
-        m_value1 += p.data.size();
-    } else {
-        m_value1++;
-    }
-    // TODO: compute buffer speed (and auto set the best bufferValue)
-    if (!m_buffering)
+    while (!m_consumer.testAndSetAcquire(0, 1))
+        QThread::yieldCurrentThread();
+}
+
+void PacketBuffer::unlockConsumer()
+{
+    atomic_store_release(m_consumer, 0);
+}
+
+/*
+ * A thread sets the waiting flag, then checks the state again before sleeping. The other thread changes
+ * the state, then reads the flag. Both are ordered atomic operations, so a wakeup can not be lost and
+ * the mutex is only touched if someone is (about to be) parked.
+ */
+void PacketBuffer::waitEnough()
+{
+    QMutexLocker lock(&m_park_mutex);
+    Q_UNUSED(lock);
+    m_empty_waiting.fetchAndStoreOrdered(1);
+    if (atomic_load_relaxed(m_block_empty) && !checkEnough())
+        m_cond_empty.wait(&m_park_mutex);
+    m_empty_waiting.fetchAndStoreOrdered(0);
+}
+
+void PacketBuffer::waitFull()
+{
+    QMutexLocker lock(&m_park_mutex);
+    Q_UNUSED(lock);
+    m_full_waiting.fetchAndStoreOrdered(1);
+    if (atomic_load_relaxed(m_block_full) && checkEnough())
+        m_cond_full.wait(&m_park_mutex);
+    m_full_waiting.fetchAndStoreOrdered(0);
+}
+
+void PacketBuffer::wakeEmpty()
+{
+    if (!atomic_load_acquire(m_empty_waiting))
         return;
-    if (checkEnough()) {
-        m_buffering = false;
-    }
+    QMutexLocker lock(&m_park_mutex);
+    Q_UNUSED(lock);
+    m_cond_empty.wakeAll();
 }
 
-void PacketBuffer::onTake(const Packet &p)
+void PacketBuffer::wakeFull()
 {
-    if (checkEmpty()) {
-        m_buffering = true;
-    }
-    if (queue.isEmpty()) {
-        m_value0 = 0;
-        m_value1 = 0;
+    if (!atomic_load_acquire(m_full_waiting))
         return;
-    }
-    if (m_mode == BufferTime) {
-        m_value0 = qint64(queue[0].pts*1000.0);
-        //if (isBuffering())
-          //  qDebug("-buffering progress: %.1f=%.1f/%.1fs", bufferProgress(), (qreal)buffered()/1000.0, (qreal)bufferValue()/1000.0);
-    } else if (m_mode == BufferBytes) {
-        m_value1 -= p.data.size();
-        m_value1 = qMax<qint64>(0LL, m_value1);
-    } else {
-        m_value1--;
-    }
+    QMutexLocker lock(&m_park_mutex);
+    Q_UNUSED(lock);
+    m_cond_full.wakeAll();
 }
 
 } //namespace QtAV
@@ -22,10 +22,12 @@
 #ifndef QTAV_PACKETBUFFER_H
 #define QTAV_PACKETBUFFER_H
 
-#include <QtCore/QQueue>
+#include <QtCore/QMutex>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QWaitCondition>
 #include <QtAV/Packet.h>
 #include "QtAV/CommonTypes.h"
-#include "utils/BlockingQueue.h"
+#include "utils/spsc_ring.h"
 
 namespace QtAV {
 
@@ -34,8 +36,13 @@ namespace QtAV {
  * take enough: start to put more packets
  * put enough: end buffering, end take block
  * put full: stop putting more packets
+ *
+ * Single producer (demux thread) and single consumer (AVThread). put() and take() never lock in the
+ * common case, a thread is parked only if it has to wait: take() from an empty queue or put() to a full one.
+ * The ring grows if more packets are queued than slots, e.g. large BufferPackets values or blockFull(false).
+ * clear() can be called from any thread.
  */
-class PacketBuffer : public BlockingQueue<Packet, QQueue>
+class PacketBuffer
 {
 public:
     PacketBuffer();
@@ -72,25 +79,66 @@ public:
     qreal bufferProgress() const;
     qreal bufferSpeed() const;
 
+    // producer
+    void put(const Packet& t);
+    // consumer
+    Packet take();
+    void setBlocking(bool block); //will wake if false. called when no more data can enqueue
+    void blockEmpty(bool block);
+    void blockFull(bool block);
+    void clear();
+    bool isEmpty() const;
+    bool isEnough() const; //buffered >= bufferValue
+    bool isFull() const; //buffered >= bufferValue*bufferMax
+    int size() const;
+
+    class StateChangeCallback
+    {
+    public:
+        virtual ~StateChangeCallback(){}
+        virtual void call() = 0;
+    };
+    void setEmptyCallback(StateChangeCallback* call);
+    void setThresholdCallback(StateChangeCallback* call);
+    void setFullCallback(StateChangeCallback* call);
+
 protected:
-    bool checkEnough() const Q_DECL_OVERRIDE;
-    bool checkFull() const Q_DECL_OVERRIDE;
-    void onTake(const Packet &) Q_DECL_OVERRIDE;
-    void onPut(const Packet &) Q_DECL_OVERRIDE;
-protected:
-    typedef BlockingQueue<Packet, QQueue> PQ;
-    using PQ::setCapacity;
-    using PQ::setThreshold;
-    using PQ::capacity;
-    using PQ::threshold;
+    bool checkEmpty() const;
+    bool checkEnough() const;
+    bool checkFull() const;
 
 private:
+    void lockConsumer();
+    void unlockConsumer();
+    // park the calling thread. return immediately if nothing to wait
+    void waitEnough();
+    void waitFull();
+    void wakeEmpty();
+    void wakeFull();
+
+    class Entry {
+    public:
+        Entry() : msecs(0) {}
+        Packet packet;
+        qint64 msecs; // pts in ms, only written by producer
+    };
+    spsc_ring<Entry> m_ring;
+    // take() and clear() are both consumers. take() is never contended with itself, clear() is rare
+    QAtomicInt m_consumer;
+    QAtomicInt m_bytes;
+    // pts in ms of the front and back packets, for buffered() from any thread. the slots are not read
+    QAtomicInt m_head_ms, m_tail_ms;
+    QAtomicInt m_block_empty, m_block_full;
+    QAtomicInt m_empty_waiting, m_full_waiting;
+    QMutex m_park_mutex;
+    QWaitCondition m_cond_empty, m_cond_full;
+    QScopedPointer<StateChangeCallback> m_empty_callback, m_threshold_callback, m_full_callback;
+
     BufferMode m_mode;
-    bool m_buffering;
+    volatile bool m_buffering;
     qreal m_max;
     // bytes or count
     qint64 m_buffer;
-    qint64 m_value0, m_value1;
 };
 
 } //namespace QtAV
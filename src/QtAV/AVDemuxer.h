@@ -45,6 +45,11 @@ public:
         VideoStream,
         SubtitleStream,
     };
+    enum KeyFrameIndexMode {
+        NoKeyFrameIndex,
+        KeyFrameIndexOnRead, // default. index the video key frames read by readFrame()
+        KeyFrameIndexScan // also scan the whole file in background. useful for long GOP streams, e.g. broadcast ts
+    };
     /// Supported ffmpeg/libav input protocols(not complete). A static string list
     static const QStringList& supportedProtocols();
 
@@ -101,9 +106,27 @@ public:
     SeekUnit seekUnit() const;
     void setSeekType(SeekType target);
     SeekType seekType() const;
+    /*!
+     * \brief setKeyFrameIndexMode
+     * Key frame index (pts => byte position) of local files whose format can be safely seeked by byte, i.e. mpeg ts/ps
+     * and raw elementary streams. Other formats use their own index.
+     * If the seek target is indexed, seek() goes to the nearest key frame before it by byte, so an accurate seek
+     * decodes the least frames. Set it before load(). The initial value can be set by QTAV_KEYFRAME_INDEX
+     * environment variable: off, read or scan.
+     */
+    void setKeyFrameIndexMode(KeyFrameIndexMode mode);
+    KeyFrameIndexMode keyFrameIndexMode() const;
+    /*!
+     * \brief setKeyFrameIndexPersistent
+     * Save the key frame index in the cache dir and load it next time. Default is false, or true if
+     * QTAV_KEYFRAME_INDEX_CACHE environment variable is 1. The cache file name is a hash, the media path is not stored.
+     * Set it before load().
+     */
+    void setKeyFrameIndexPersistent(bool value);
+    bool isKeyFrameIndexPersistent() const;
     /*!
      * \brief seek
-     * seek to a given position. Only support timestamp seek now.
+     * seek to a given position. pos is in ms if seekUnit() is SeekByTime, in bytes if SeekByByte.
      * Experiment: if pos is out of range (>duration()), do nothing unless a seekable and variableSize MediaIO is used.
      * \return false if fail
      */
@@ -196,6 +219,7 @@ signals:
     void seekableChanged();
 private:
     void setMediaStatus(MediaStatus status);
+    bool seekByByte(qint64 pos);
     // error code (errorCode) and message (msg) may be modified internally
     void handleError(int averr, AVError::ErrorCode* errorCode, QString& msg);
 
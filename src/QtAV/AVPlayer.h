@@ -248,6 +248,7 @@ public:
      * \brief audio
      * AVPlayer always has an AudioOutput instance. You can access or control audio output properties through audio().
      * To disable audio output, set audio()->setBackends(QStringList() << "null") before starting playback
+     * Backend "dummy" discards the data in real time, i.e. audio clock works without a device
      * \return
      */
     AudioOutput* audio();
@@ -285,6 +286,16 @@ public:
      */
     void setFrameRate(qreal value);
     qreal forcedFrameRate() const;
+    /*!
+     * \brief setVideoPipelineDepth
+     * Filter, convert and present video frames in a stage thread, so decoding the next frame overlaps with it.
+     * Call it before playback start.
+     * \param value the max number of decoded frames queued for the stage. 0: no stage thread. Keep it small for hw
+     * decoders, a queued frame may hold a decoder surface. The default value is QTAV_VIDEO_PIPELINE environment
+     * variable, or 0.
+     */
+    void setVideoPipelineDepth(int value);
+    int videoPipelineDepth() const;
     //Statistics& statistics();
     const Statistics& statistics() const;
     /*
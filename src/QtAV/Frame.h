@@ -63,7 +63,7 @@ public:
      * \return line size of plane
      */
     int bytesPerLine(int plane = 0) const;
-    // the whole frame data. may be empty unless clone() or allocate is called
+    // the whole frame data. may be empty unless clone() or allocate is called. a deep copy if the memory is from FrameBufferPool
     QByteArray frameData() const;
     // deep copy 1 plane data
     QByteArray data(int plane = 0) const;
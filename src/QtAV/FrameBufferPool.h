@@ -0,0 +1,100 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_FRAMEBUFFERPOOL_H
+#define QTAV_FRAMEBUFFERPOOL_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QSharedData>
+
+namespace QtAV {
+
+/*!
+ * \brief The FrameBuffer class
+ * Aligned memory from FrameBufferPool. The memory goes back to the pool when the last FrameBufferRef is released.
+ * The content of a new buffer is undefined.
+ */
+class Q_AV_EXPORT FrameBuffer : public QSharedData
+{
+    Q_DISABLE_COPY(FrameBuffer)
+public:
+    ~FrameBuffer();
+    uchar* data() const { return m_data;}
+    // requested size
+    int size() const { return m_size;}
+    // allocated size, >= size()
+    int capacity() const { return m_capacity;}
+private:
+    FrameBuffer(uchar* data, int size, int capacity) : m_data(data), m_size(size), m_capacity(capacity) {}
+    friend class FrameBufferPool;
+    uchar *m_data;
+    int m_size;
+    int m_capacity;
+};
+typedef QExplicitlySharedDataPointer<FrameBuffer> FrameBufferRef;
+
+class FrameBufferPoolPrivate;
+/*!
+ * \brief The FrameBufferPool class
+ * Process wide pool of frame buffers used by VideoFrame::clone(), allocate(), to(), VideoFrameConverter and hardware
+ * decoders copying frames to host memory. Allocating a large frame from the heap is expensive, mostly because new
+ * pages are mapped and zeroed on first touch. Released buffers are kept in size classes (1/8 steps of power of 2,
+ * so at most 12.5% is wasted) and reused by the next request of the same class.
+ * Buffers are aligned to Alignment bytes. All functions are thread safe.
+ */
+class Q_AV_EXPORT FrameBufferPool
+{
+    DPTR_DECLARE_PRIVATE(FrameBufferPool)
+public:
+    enum { Alignment = 64 };
+    static FrameBufferPool& instance();
+    ~FrameBufferPool();
+    // round up to Alignment. use it for plane offsets to get aligned planes
+    static int align(int bytes) { return (bytes + Alignment - 1) & ~(Alignment - 1);}
+    /*!
+     * \brief get
+     * \return a null ref if out of memory
+     */
+    FrameBufferRef get(int bytes);
+    /*!
+     * \brief setMaxFreeBytes
+     * Released buffers are freed if the free buffers in pool exceed the value. 0: disable pooling.
+     * Default is 256MB
+     */
+    void setMaxFreeBytes(qint64 value);
+    qint64 maxFreeBytes() const;
+    // free all released buffers
+    void clear();
+    // statistics
+    qint64 hits() const; // get() reuses a free buffer
+    qint64 misses() const; // get() allocates new memory
+    qreal hitRate() const;
+    qint64 residentBytes() const; // buffers in use + free buffers
+    qint64 freeBytes() const;
+    void resetStatistics();
+private:
+    FrameBufferPool();
+    friend class FrameBuffer;
+    void recycle(uchar* data, int capacity);
+    DPTR_DECLARE(FrameBufferPool)
+};
+} //namespace QtAV
+#endif // QTAV_FRAMEBUFFERPOOL_H
@@ -53,6 +53,8 @@
 #include <QtAV/VideoFormat.h>
 #include <QtAV/VideoFrame.h>
 #include <QtAV/VideoFrameExtractor.h>
+#include <QtAV/ThumbnailCache.h>
+#include <QtAV/StoryboardGenerator.h>
 #include <QtAV/VideoRenderer.h>
 #include <QtAV/VideoOutput.h>
 //The following renderer headers can be removed
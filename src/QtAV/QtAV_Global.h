@@ -68,6 +68,17 @@ Q_AV_EXPORT void setLogLevel(LogLevel value);
 Q_AV_EXPORT LogLevel logLevel();
 /// Default handler is qt message logger. Set environment QTAV_FFMPEG_LOG=0 or setFFmpegLogHandler(0) to disable.
 Q_AV_EXPORT void setFFmpegLogHandler(void(*)(void *, int, const char *, va_list));
+/*!
+ * \brief setSharedDecoding
+ * Limit the number of video threads decoding at the same time in this process. Useful if many players are running (video wall).
+ * A free slot is given to the player whose next frame is the latest.
+ * The number of OS threads is not reduced, each player still has its own demux, audio and video threads, because their
+ * loops block on queues and clocks and can not run as tasks on a shared pool. Only concurrent decoding is limited.
+ * \param maxThreads 0: no limit (default). <0: the number of cpu cores
+ * The initial value can be set by QTAV_SHARED_DECODING environment variable.
+ */
+Q_AV_EXPORT void setSharedDecoding(int maxThreads);
+Q_AV_EXPORT int sharedDecoding();
 } //namespace QtAV
 
 // TODO: internal use. move to a private header
@@ -23,6 +23,7 @@
 #define QTAV_STATISTICS_H
 
 #include <QtAV/QtAV_Global.h>
+#include <QtCore/QAtomicInt>
 #include <QtCore/QHash>
 #include <QtCore/QTime>
 #include <QtCore/QSharedData>
@@ -62,6 +63,12 @@ public:
             video_only video;
         } only;*/
         QHash<QString, QString> metadata;
+        /*!
+         * Packets parked in demuxer's side cache because the queue of this stream was full while another stream
+         * was starving (badly interleaved streams), and the max number of packets ever parked at the same time.
+         */
+        qint64 reordered_packets;
+        int max_reorder_depth;
     } audio, video; //init them
 
     //from AVCodecContext
@@ -91,9 +98,17 @@ public:
         VideoOnly(const VideoOnly&);
         VideoOnly& operator =(const VideoOnly&);
         ~VideoOnly();
-        // compute from pts history
+        // compute from pts history. the history functions are thread safe
         qreal currentDisplayFPS() const;
         qreal pts() const; // last pts
+        /*!
+         * \brief presentError
+         * Present time error of the last frame in seconds: clock value - frame pts when the frame is sent to renderers. > 0: late.
+         * presentErrorMean() and presentErrorMax() are computed from the absolute errors of recent frames.
+         */
+        qreal presentError() const;
+        qreal presentErrorMean() const;
+        qreal presentErrorMax() const;
 
         int width, height;
         /**
@@ -108,10 +123,86 @@ public:
         QString pix_fmt;
         /// return current absolute time (seconds since epcho
         qint64 frameDisplayed(qreal pts); // used to compute currentDisplayFPS()
+        void framePresented(qreal error); // used to compute presentError()
     private:
         class Private;
         QExplicitlySharedDataPointer<Private> d;
     } video_only;
+
+    /*!
+     * \brief The Histogram class
+     * Lock-free histogram of non-negative samples, e.g. microseconds or queue depth. add() can be called from any thread
+     * without locking, results read while adding may be slightly outdated.
+     * There are 4 buckets for each power of 2, so a percentile is accurate to 25%. Values < 4 are exact.
+     */
+    class Q_AV_EXPORT Histogram {
+    public:
+        enum { NbBuckets = 120 };
+        Histogram();
+        void add(qint64 value);
+        void clear();
+        int count() const;
+        qint64 sum() const;
+        qreal mean() const;
+        qint64 max() const;
+        /*!
+         * \brief percentile
+         * \param p [0, 1], e.g. 0.99
+         * \return the upper bound of the bucket containing the percentile, but not greater than max()
+         */
+        qint64 percentile(qreal p) const;
+        int bucketCount(int index) const;
+        static int bucketIndex(qint64 value);
+        static qint64 bucketLowerBound(int index);
+    private:
+        Q_DISABLE_COPY(Histogram)
+        QAtomicInt m_buckets[NbBuckets];
+        QAtomicInt m_count, m_max;
+        QAtomicInt m_sum_lo, m_sum_hi; // sum = m_sum_hi*2^30 + m_sum_lo
+    };
+    enum Stage {
+        DemuxRead, // AVDemuxer::readFrame()
+        VideoQueueWait, // waiting for a video packet
+        VideoDecode,
+        Filter, // video filters
+        Convert, // convert video frames for renderers
+        Deliver, // send video frames to renderers
+        AudioQueueWait, // waiting for an audio packet
+        AudioDecode,
+        AudioWrite, // AudioOutput::play(), including waiting for free buffers
+        NbStages
+    };
+    enum Queue {
+        VideoPacketQueue, // sampled when a packet is taken
+        AudioPacketQueue,
+        VideoFrameQueue, // decoded frames waiting for the filter/convert stage (AVPlayer::setVideoPipelineDepth()). sampled when a frame is queued
+        NbQueues
+    };
+    /*!
+     * \brief The Timings class
+     * Per stage latency histograms in microseconds, and queue depth histograms, collected by demux, video and audio threads.
+     * Disabled by default, then only a flag is checked. Enable it by setEnabled(true) or environment QTAV_STATISTICS_TIMING=1.
+     * Copies share the same data, so AVPlayer::statistics().timings can be copied to enable it and to read the results.
+     */
+    class Q_AV_EXPORT Timings {
+    public:
+        Timings();
+        Timings(const Timings&);
+        Timings& operator =(const Timings&);
+        ~Timings();
+        void setEnabled(bool value);
+        bool isEnabled() const;
+        Histogram& stage(Stage value);
+        const Histogram& stage(Stage value) const;
+        Histogram& queueDepth(Queue value);
+        const Histogram& queueDepth(Queue value) const;
+        void clear(); // clear histograms, enabled state is not changed
+        static const char* stageName(Stage value);
+        static const char* queueName(Queue value);
+    private:
+        class Private;
+        QExplicitlySharedDataPointer<Private> d;
+    } timings;
 };
 
 } //namespace QtAV
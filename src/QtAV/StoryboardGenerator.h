@@ -0,0 +1,122 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_STORYBOARDGENERATOR_H
+#define QTAV_STORYBOARDGENERATOR_H
+
+#include <QtCore/QObject>
+#include <QtCore/QSize>
+#include <QtCore/QStringList>
+#include <QtAV/QtAV_Global.h>
+
+namespace QtAV {
+
+class StoryboardGeneratorPrivate;
+/*!
+ * \brief The StoryboardGenerator class
+ * Generate seek preview sprite sheets of a video, like "ffmpeg -vf fps=1/10,scale,tile".
+ * Frames are sampled every interval(), scaled to tileSize() and tiled into columns() x rows() images named
+ * baseName()_0.jpg, baseName()_1.jpg ... in outputDir(). A WebVTT file baseName().vtt maps each interval to its
+ * tile, e.g. "storyboard_0.jpg#xywh=160,0,160,90", which is the format most web players use for thumbnails.
+ * If interval() is larger than the key frame interval, only the key frame before each sample position is decoded,
+ * otherwise the video is decoded forward once.
+ */
+class Q_AV_EXPORT StoryboardGenerator : public QObject
+{
+    Q_OBJECT
+    DPTR_DECLARE_PRIVATE(StoryboardGenerator)
+public:
+    explicit StoryboardGenerator(QObject *parent = 0);
+    void setSource(const QString& value);
+    QString source() const;
+    /*!
+     * \brief setInterval
+     * Sample interval in ms. Default is 10000
+     */
+    void setInterval(qint64 value);
+    qint64 interval() const;
+    /*!
+     * \brief setTileSize
+     * Default is 160x0. If width or height <= 0, it's computed from the other one and display aspect ratio.
+     */
+    void setTileSize(const QSize& value);
+    QSize tileSize() const;
+    /*!
+     * \brief setColumns, setRows
+     * Tiles per image. Default is 10x10. The last image has less rows if frames are not enough.
+     */
+    void setColumns(int value);
+    int columns() const;
+    void setRows(int value);
+    int rows() const;
+    /*!
+     * \brief setOutputDir
+     * Default is current dir
+     */
+    void setOutputDir(const QString& value);
+    QString outputDir() const;
+    /*!
+     * \brief setBaseName
+     * Default is "storyboard"
+     */
+    void setBaseName(const QString& value);
+    QString baseName() const;
+    /*!
+     * \brief setImageFormat
+     * "jpg" (default), "png" etc., supported by QImageWriter.
+     */
+    void setImageFormat(const QString& value);
+    QString imageFormat() const;
+    /*!
+     * \brief setQuality
+     * \param value 0-100, larger is better quality. -1: default quality
+     */
+    void setQuality(int value);
+    int quality() const;
+    /*!
+     * \brief generate
+     * Block until all images and the vtt file are written or cancel() is called. Can be called in any thread.
+     * \return false if failed or canceled. errorString() is the reason
+     */
+    bool generate();
+    /*!
+     * \brief cancel
+     * Stop generate() in another thread.
+     */
+    void cancel();
+    QString errorString() const;
+    /*!
+     * \brief files
+     * Images and the vtt file written by the last generate()
+     */
+    QStringList files() const;
+Q_SIGNALS:
+    /*!
+     * \brief progress
+     * Emitted in generate() thread for each tile
+     */
+    void progress(int tiles, int total);
+    void imageSaved(const QString& file);
+private:
+    DPTR_DECLARE(StoryboardGenerator)
+};
+} //namespace QtAV
+#endif // QTAV_STORYBOARDGENERATOR_H
@@ -0,0 +1,100 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_THUMBNAILCACHE_H
+#define QTAV_THUMBNAILCACHE_H
+
+#include <QtAV/VideoFrame.h>
+
+namespace QtAV {
+
+class ThumbnailCachePrivate;
+/*!
+ * \brief The ThumbnailCache class
+ * Process wide cache of extracted video frames shared by all VideoFrameExtractor instances, so scrubbing over
+ * the same positions again is served without demuxing and decoding.
+ * A frame is keyed by (source, position/precision, precision, size), i.e. positions in the same precision bucket
+ * share a frame. For a local file the size and the modified time are part of the key, so a replaced file is not
+ * served from either tier. The memory tier is a LRU bounded by maxBytes(). The optional disk tier stores frames in
+ * diskCacheDir() and is checked on memory misses, the oldest written files are removed if diskCacheDir() is
+ * larger than maxDiskBytes().
+ * All functions are thread safe.
+ */
+class Q_AV_EXPORT ThumbnailCache
+{
+    DPTR_DECLARE_PRIVATE(ThumbnailCache)
+public:
+    static ThumbnailCache& instance();
+    ~ThumbnailCache();
+    /*!
+     * \brief setMaxBytes
+     * Memory used by frames in memory. 0: disable the cache (disk tier is not disabled). Default is 32MB
+     */
+    void setMaxBytes(qint64 value);
+    qint64 maxBytes() const;
+    /*!
+     * \brief setDiskCacheEnabled
+     * Default is false.
+     */
+    void setDiskCacheEnabled(bool value);
+    bool isDiskCacheEnabled() const;
+    /*!
+     * \brief setDiskCacheDir
+     * Default is "thumbnails" in application's cache location
+     */
+    void setDiskCacheDir(const QString& value);
+    QString diskCacheDir() const;
+    /*!
+     * \brief setMaxDiskBytes
+     * Default is 256MB
+     */
+    void setMaxDiskBytes(qint64 value);
+    qint64 maxDiskBytes() const;
+    /*!
+     * \brief find
+     * \param size frame size requested. QSize() for original size
+     * \return an invalid frame if not found
+     */
+    VideoFrame find(const QString& source, qint64 position, int precision, const QSize& size = QSize());
+    /*!
+     * \brief insert
+     * A deep copy of the frame is stored. A hardware decoded frame is mapped to host memory first, and is not stored if
+     * its surface interop can not map it in the same format.
+     */
+    void insert(const QString& source, qint64 position, int precision, const QSize& size, const VideoFrame& frame);
+    /*!
+     * \brief clear
+     * Remove the frames in memory. Disk files are kept
+     */
+    void clear();
+    // counters since start or resetCounters()
+    qint64 hits() const;
+    qint64 diskHits() const; // included in hits()
+    qint64 misses() const;
+    void resetCounters();
+    qint64 bytes() const; // memory used
+    int count() const;
+private:
+    ThumbnailCache();
+    DPTR_DECLARE(ThumbnailCache)
+};
+} //namespace QtAV
+#endif // QTAV_THUMBNAILCACHE_H
@@ -25,6 +25,7 @@
 #include <QtAV/QtAV_Global.h>
 #include <QtAV/CommonTypes.h>
 #include <QtAV/Frame.h>
+#include <QtAV/FrameBufferPool.h>
 #include <QtAV/VideoFormat.h>
 #include <QtCore/QSize>
 
@@ -54,6 +55,8 @@ public:
     VideoFrame(int width, int height, const VideoFormat& format);
     //set planes and linesize manually or call init
     VideoFrame(const QByteArray& data, int width, int height, const VideoFormat& format);
+    // set planes and linesize manually or call init. buffer goes back to the pool when the last frame referring to it is destroyed
+    VideoFrame(const FrameBufferRef& buffer, int width, int height, const VideoFormat& format);
     VideoFrame(const QVector<int>& textures, int width, int height, const VideoFormat& format);
     VideoFrame(const QImage& image); // does not copy the image data
     VideoFrame(const VideoFrame &other);
@@ -68,7 +71,8 @@ public:
     VideoFrame clone() const;
     /*!
      * Allocate memory with given format, width and height. planes and bytesPerLine will be set internally.
-     * The memory can be initialized by user
+     * The memory is not initialized: it may be reused from a frame buffer pool, so it can contain old pixels.
+     * The user must write all planes, or clear them.
      */
     virtual int allocate();
     VideoFormat format() const;
@@ -156,8 +160,15 @@ public:
     VideoFrame convert(const VideoFrame& frame, VideoFormat::PixelFormat fmt) const;
     VideoFrame convert(const VideoFrame& frame, QImage::Format fmt) const;
     VideoFrame convert(const VideoFrame& frame, int fffmt) const;
+    /*!
+     * \brief convert
+     * Convert and scale to dstSize (the source size if empty). yuv420p, nv12 and yuv422p to 32 bit rgb with eq or
+     * scaling are converted in a single pass over the planes, eq is the same as eq of the OpenGL renderers.
+     */
+    VideoFrame convert(const VideoFrame& frame, const VideoFormat& fmt, const QSize& dstSize) const;
 private:
     mutable ImageConverter *m_cvt;
+    mutable int m_cvt_id;
     int m_eq[3];
 };
 } //namespace QtAV
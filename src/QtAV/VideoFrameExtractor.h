@@ -37,6 +37,7 @@ class Q_AV_EXPORT VideoFrameExtractor : public QObject
     Q_PROPERTY(bool async READ async WRITE setAsync NOTIFY asyncChanged)
     Q_PROPERTY(int precision READ precision WRITE setPrecision NOTIFY precisionChanged)
     Q_PROPERTY(qint64 position READ position WRITE setPosition NOTIFY positionChanged)
+    Q_PROPERTY(int workers READ workers WRITE setWorkers NOTIFY workersChanged)
 public:
     explicit VideoFrameExtractor(QObject *parent = 0);
     /*!
@@ -66,6 +67,29 @@ public:
     int precision() const;
     void setPosition(qint64 value);
     qint64 position() const;
+    /*!
+     * \brief extractBatch
+     * Extract frames at all the given positions (in ms) in 1 forward pass. Positions are sorted, and the
+     * decoder continues from the previous position instead of seeking if the next one is in the same or the
+     * next GOP, so decoded GOPs are reused. A decoded frame can be used by several positions in precision().
+     * batchFrameExtracted() is emitted for each position as soon as its frame is ready, then batchFinished().
+     * Positions after the end of the video are ignored, and so are positions without a frame in precision().
+     * Frames found in ThumbnailCache are emitted first.
+     * If workers() > 1, positions are split into parts at key frame interval gaps and extracted by
+     * workers in parallel, so frames are not emitted in position order.
+     * In async mode, a new batch or setSource() stops the running one. A pending batch can be replaced by a
+     * new extract() request like other tasks, then batchFinished() is emitted for it. Every call ends with batchFinished().
+     * \param size scale frames to the size if width or height > 0. If one of them <= 0, it's computed from
+     * the other one and display aspect ratio. Frames are not scaled by default.
+     */
+    void extractBatch(const QList<qint64>& positions, const QSize& size = QSize());
+    /*!
+     * \brief setWorkers
+     * Number of demuxer and decoder pairs used by extractBatch(), each one seeks and decodes in its own thread.
+     * \param value 1: default, use the extract thread only. <= 0: QThread::idealThreadCount()
+     */
+    void setWorkers(int value);
+    int workers() const;
 
     virtual bool event(QEvent *e);
 signals:
@@ -80,8 +104,15 @@ signals:
      */
     void positionChanged();
     void precisionChanged();
+    void workersChanged();
 
     void aboutToExtract(qint64 pos);
+    /*!
+     * \brief batchFrameExtracted
+     * \param position the requested position in extractBatch()
+     */
+    void batchFrameExtracted(const QtAV::VideoFrame& frame, qint64 position);
+    void batchFinished();
 
 public slots:
     /*!
@@ -89,10 +120,13 @@ public slots:
      * If last extracted frame can be use, use it.
      * If there is a key frame in [position, position+precision], the nearest key frame
      * before position+precision will be extracted. Otherwise, the given position frame will be extracted.
+     * Extracted frames are stored in ThumbnailCache, and a cached frame is used without decoding.
      */
     void extract();
 private slots:
     void extractInternal(qint64 pos);
+private:
+    void extractBatchInternal(QList<qint64> positions, const QSize& size, int id);
 
 protected:
     //VideoFrameExtractor(VideoFrameExtractorPrivate &d, QObject* parent = 0);
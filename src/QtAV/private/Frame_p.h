@@ -23,6 +23,7 @@
 #define QTAV_FRAME_P_H
 
 #include <QtAV/QtAV_Global.h>
+#include <QtAV/FrameBufferPool.h>
 #include <QtCore/QVector>
 #include <QtCore/QVariant>
 #include <QtCore/QSharedData>
@@ -43,6 +44,7 @@ public:
     QVector<int> line_sizes; //stride
     QVariantMap metadata;
     QByteArray data;
+    FrameBufferRef buffer; // pooled memory used instead of data
     qreal timestamp;
 };
 
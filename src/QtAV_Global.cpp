@@ -25,6 +25,7 @@
 #include <QtCore/QRegExp>
 #include "QtAV/version.h"
 #include "QtAV/private/AVCompat.h"
+#include "DecodeScheduler.h"
 #include "utils/Logger.h"
 
 unsigned QtAV_Version()
@@ -210,6 +211,16 @@ LogLevel logLevel()
     return (LogLevel)Internal::gLogLevel;
 }
 
+void setSharedDecoding(int maxThreads)
+{
+    DecodeScheduler::instance().setMaxThreads(maxThreads);
+}
+
+int sharedDecoding()
+{
+    return DecodeScheduler::instance().maxThreads();
+}
+
 void setFFmpegLogHandler(void (*callback)(void *, int, const char *, va_list))
 {
     // libav does not check null callback
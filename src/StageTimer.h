@@ -0,0 +1,64 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_STAGETIMER_H
+#define QTAV_STAGETIMER_H
+
+#include <QtCore/QElapsedTimer>
+#include "QtAV/Statistics.h"
+
+namespace QtAV {
+/*!
+ * \brief The StageTimer class
+ * Adds the time from construction to stop() or destruction to a stage histogram of Statistics::timings.
+ * If statistics is null or timings are disabled, nothing but the enabled flag is checked.
+ */
+class StageTimer
+{
+public:
+    StageTimer(Statistics *statistics, Statistics::Stage stage)
+        : m_histogram(statistics && statistics->timings.isEnabled() ? &statistics->timings.stage(stage) : 0)
+    {
+        if (m_histogram)
+            m_timer.start();
+    }
+    ~StageTimer() { stop();}
+    void stop() {
+        if (!m_histogram)
+            return;
+        m_histogram->add(m_timer.nsecsElapsed()/1000LL);
+        m_histogram = 0;
+    }
+    // add a time measured by the caller
+    static void add(Statistics *statistics, Statistics::Stage stage, qint64 nsecs) {
+        if (statistics && statistics->timings.isEnabled())
+            statistics->timings.stage(stage).add(nsecs/1000LL);
+    }
+    static void addQueueDepth(Statistics *statistics, Statistics::Queue queue, int depth) {
+        if (statistics && statistics->timings.isEnabled())
+            statistics->timings.queueDepth(queue).add(depth);
+    }
+private:
+    Statistics::Histogram *m_histogram;
+    QElapsedTimer m_timer;
+};
+} //namespace QtAV
+#endif // QTAV_STAGETIMER_H
@@ -20,7 +20,10 @@
 ******************************************************************************/
 
 #include "QtAV/Statistics.h"
+#include <limits>
+#include <QtCore/QMutex>
 #include "utils/ring.h"
+#include "utils/spsc_ring.h" // atomic helpers
 
 namespace QtAV {
 
@@ -29,6 +32,8 @@ Statistics::Common::Common():
   , bit_rate(0)
   , frames(0)
   , frame_rate(0)
+  , reordered_packets(0)
+  , max_reorder_depth(0)
 {
 }
 
@@ -45,9 +50,15 @@ public:
     Private()
         : pts(0)
         , history(ring<qreal>(30))
+        , present_error(0)
+        , present_errors(ring<qreal>(30))
     {}
+    // history and present errors are written by the presenting thread, and read by the decoding thread and gui
+    mutable QMutex mutex;
     qreal pts;
     ring<qreal> history;
+    qreal present_error;
+    ring<qreal> present_errors; // absolute values
 };
 
 Statistics::VideoOnly::VideoOnly():
@@ -87,20 +98,61 @@ Statistics::VideoOnly::~VideoOnly()
 
 qreal Statistics::VideoOnly::pts() const
 {
+    QMutexLocker lock(&d->mutex);
+    Q_UNUSED(lock);
     return d->pts;
 }
 
 qint64 Statistics::VideoOnly::frameDisplayed(qreal pts)
 {
-    d->pts = pts;
     const qint64 msecs = QDateTime::currentMSecsSinceEpoch();
     const qreal t = (double)msecs/1000.0;
+    QMutexLocker lock(&d->mutex);
+    Q_UNUSED(lock);
+    d->pts = pts;
     d->history.push_back(t);
     return msecs;
 }
-// d->history is not thread safe!
+void Statistics::VideoOnly::framePresented(qreal error)
+{
+    QMutexLocker lock(&d->mutex);
+    Q_UNUSED(lock);
+    d->present_error = error;
+    d->present_errors.push_back(qAbs(error));
+}
+
+qreal Statistics::VideoOnly::presentError() const
+{
+    QMutexLocker lock(&d->mutex);
+    Q_UNUSED(lock);
+    return d->present_error;
+}
+
+qreal Statistics::VideoOnly::presentErrorMean() const
+{
+    QMutexLocker lock(&d->mutex);
+    Q_UNUSED(lock);
+    if (d->present_errors.empty())
+        return 0;
+    qreal sum = 0;
+    for (int i = 0; i < (int)d->present_errors.size(); ++i)
+        sum += d->present_errors.at(i);
+    return sum/qreal(d->present_errors.size());
+}
+
+qreal Statistics::VideoOnly::presentErrorMax() const
+{
+    QMutexLocker lock(&d->mutex);
+    Q_UNUSED(lock);
+    qreal m = 0;
+    for (int i = 0; i < (int)d->present_errors.size(); ++i)
+        m = qMax(m, d->present_errors.at(i));
+    return m;
+}
 qreal Statistics::VideoOnly::currentDisplayFPS() const
 {
+    QMutexLocker lock(&d->mutex);
+    Q_UNUSED(lock);
     if (d->history.empty())
         return 0;
     // DO NOT use d->history.last-first
@@ -111,6 +163,203 @@ qreal Statistics::VideoOnly::currentDisplayFPS() const
     return (qreal)d->history.size()/dt;
 }
 
+Statistics::Histogram::Histogram()
+{
+    clear();
+}
+
+int Statistics::Histogram::bucketIndex(qint64 value)
+{
+    if (value < 4)
+        return value < 0 ? 0 : int(value);
+    if (value > std::numeric_limits<int>::max())
+        value = std::numeric_limits<int>::max();
+    int e = 2;
+    while ((value >> (e + 1)) != 0)
+        ++e;
+    // 2 bits below the highest bit select 1 of 4 buckets in [2^e, 2^(e+1))
+    return 4*(e - 1) + int((value >> (e - 2)) & 3);
+}
+
+qint64 Statistics::Histogram::bucketLowerBound(int index)
+{
+    if (index < 4)
+        return index;
+    const int e = index/4 + 1;
+    return qint64(4 + index%4) << (e - 2);
+}
+
+void Statistics::Histogram::add(qint64 value)
+{
+    if (value < 0)
+        value = 0;
+    if (value > std::numeric_limits<int>::max())
+        value = std::numeric_limits<int>::max();
+    const int v = int(value);
+    m_buckets[bucketIndex(v)].fetchAndAddRelaxed(1);
+    m_count.fetchAndAddRelaxed(1);
+    int m = atomic_load_relaxed(m_max);
+    while (v > m && !m_max.testAndSetRelaxed(m, v))
+        m = atomic_load_relaxed(m_max);
+    // m_sum_lo is always < 2^30, so adding a value < 2^30 never overflows
+    static const int kSumCarry = 1 << 30;
+    int carry = v >> 30;
+    const int low = v & (kSumCarry - 1);
+    int lo = atomic_load_relaxed(m_sum_lo);
+    while (true) {
+        const int sum = lo + low;
+        if (m_sum_lo.testAndSetRelaxed(lo, sum >= kSumCarry ? sum - kSumCarry : sum)) {
+            carry += sum >= kSumCarry;
+            break;
+        }
+        lo = atomic_load_relaxed(m_sum_lo);
+    }
+    if (carry)
+        m_sum_hi.fetchAndAddRelaxed(carry);
+}
+
+void Statistics::Histogram::clear()
+{
+    for (int i = 0; i < NbBuckets; ++i)
+        atomic_store_release(m_buckets[i], 0);
+    atomic_store_release(m_count, 0);
+    atomic_store_release(m_max, 0);
+    atomic_store_release(m_sum_lo, 0);
+    atomic_store_release(m_sum_hi, 0);
+}
+
+int Statistics::Histogram::count() const
+{
+    return atomic_load_acquire(m_count);
+}
+
+qint64 Statistics::Histogram::sum() const
+{
+    return (qint64(atomic_load_acquire(m_sum_hi)) << 30) + atomic_load_acquire(m_sum_lo);
+}
+
+qreal Statistics::Histogram::mean() const
+{
+    const int n = count();
+    if (n <= 0)
+        return 0;
+    return qreal(sum())/qreal(n);
+}
+
+qint64 Statistics::Histogram::max() const
+{
+    return atomic_load_acquire(m_max);
+}
+
+qint64 Statistics::Histogram::percentile(qreal p) const
+{
+    int counts[NbBuckets];
+    qint64 total = 0;
+    for (int i = 0; i < NbBuckets; ++i) {
+        counts[i] = atomic_load_acquire(m_buckets[i]);
+        total += counts[i];
+    }
+    if (total == 0)
+        return 0;
+    const qint64 rank = qMax<qint64>(1, qint64(p*qreal(total) + 0.999999));
+    qint64 n = 0;
+    for (int i = 0; i < NbBuckets; ++i) {
+        n += counts[i];
+        if (n >= rank) {
+            if (i + 1 >= NbBuckets)
+                return max();
+            return qMin(max(), bucketLowerBound(i + 1) - 1);
+        }
+    }
+    return max();
+}
+
+int Statistics::Histogram::bucketCount(int index) const
+{
+    if (index < 0 || index >= NbBuckets)
+        return 0;
+    return atomic_load_acquire(m_buckets[index]);
+}
+
+class Statistics::Timings::Private : public QSharedData {
+public:
+    Private() : enabled(qgetenv("QTAV_STATISTICS_TIMING").toInt() > 0) {}
+    QAtomicInt enabled;
+    Histogram stages[NbStages];
+    Histogram queues[NbQueues];
+};
+
+Statistics::Timings::Timings()
+    : d(new Private())
+{
+}
+
+Statistics::Timings::Timings(const Timings& t)
+    : d(t.d)
+{
+}
+
+Statistics::Timings& Statistics::Timings::operator =(const Timings& t)
+{
+    d = t.d;
+    return *this;
+}
+
+Statistics::Timings::~Timings()
+{
+}
+
+void Statistics::Timings::setEnabled(bool value)
+{
+    atomic_store_release(d->enabled, value);
+}
+
+bool Statistics::Timings::isEnabled() const
+{
+    return atomic_load_relaxed(d->enabled);
+}
+
+Statistics::Histogram& Statistics::Timings::stage(Stage value)
+{
+    return d->stages[value];
+}
+
+const Statistics::Histogram& Statistics::Timings::stage(Stage value) const
+{
+    return d->stages[value];
+}
+
+Statistics::Histogram& Statistics::Timings::queueDepth(Queue value)
+{
+    return d->queues[value];
+}
+
+const Statistics::Histogram& Statistics::Timings::queueDepth(Queue value) const
+{
+    return d->queues[value];
+}
+
+void Statistics::Timings::clear()
+{
+    for (int i = 0; i < NbStages; ++i)
+        d->stages[i].clear();
+    for (int i = 0; i < NbQueues; ++i)
+        d->queues[i].clear();
+}
+
+const char* Statistics::Timings::stageName(Stage value)
+{
+    static const char* kNames[] = { "demux read", "video queue wait", "video decode", "filter", "convert", "deliver"
+                                    , "audio queue wait", "audio decode", "audio write" };
+    return value >= 0 && value < NbStages ? kNames[value] : "";
+}
+
+const char* Statistics::Timings::queueName(Queue value)
+{
+    static const char* kNames[] = { "video packets", "audio packets", "video frames" };
+    return value >= 0 && value < NbQueues ? kNames[value] : "";
+}
+
 Statistics::Statistics()
 {
 }
@@ -127,6 +376,7 @@ void Statistics::reset()
     audio_only = AudioOnly();
     video_only = VideoOnly();
     metadata.clear();
+    timings.clear();
 }
 
 } //namespace QtAV
@@ -0,0 +1,440 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/StoryboardGenerator.h"
+#include <string.h>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QTextStream>
+#include <QtGui/QImage>
+#include "QtAV/AVDemuxer.h"
+#include "QtAV/Packet.h"
+#include "QtAV/VideoDecoder.h"
+#include "QtAV/VideoFrame.h"
+#include "ImageConverter.h"
+#include "utils/spsc_ring.h" // atomic helpers
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+// packets older than the sample position by more than this are decoded with non-ref frames dropped
+static const qint64 kFrameDropMargin = 500;
+
+static QString vttTime(qint64 ms)
+{
+    return QString::fromLatin1("%1:%2:%3.%4")
+            .arg(ms/3600000, 2, 10, QLatin1Char('0'))
+            .arg((ms/60000)%60, 2, 10, QLatin1Char('0'))
+            .arg((ms/1000)%60, 2, 10, QLatin1Char('0'))
+            .arg(ms%1000, 3, 10, QLatin1Char('0'));
+}
+
+class StoryboardGeneratorPrivate : public DPtrPrivate<StoryboardGenerator>
+{
+public:
+    StoryboardGeneratorPrivate()
+        : interval(10000)
+        , tile_size(160, 0)
+        , columns(10)
+        , rows(10)
+        , base_name(QStringLiteral("storyboard"))
+        , format(QStringLiteral("jpg"))
+        , quality(-1)
+        , cancel(0)
+        , dec_opt(0)
+    {
+        QVariantHash opt;
+        opt[QString::fromLatin1("skip_frame")] = 32; // AVDISCARD_NONKEY
+        dec_opt_keyonly[QString::fromLatin1("avcodec")] = opt;
+        opt[QString::fromLatin1("skip_frame")] = 8; // AVDISCARD_NONREF
+        dec_opt_framedrop[QString::fromLatin1("avcodec")] = opt;
+        opt[QString::fromLatin1("skip_frame")] = 0;
+        dec_opt_normal[QString::fromLatin1("avcodec")] = opt;
+    }
+    bool open() {
+        demuxer.unload();
+        demuxer.setMedia(source);
+        demuxer.setSeekType(AccurateSeek); // land on the key frame before the position
+        if (!demuxer.load()) {
+            error = QObject::tr("Can not load %1").arg(source);
+            return false;
+        }
+        if (demuxer.videoStreams().isEmpty()) {
+            error = QObject::tr("No video stream");
+            return false;
+        }
+        decoder.reset(VideoDecoder::create("FFmpeg"));
+        if (!decoder) {
+            error = QObject::tr("No video decoder");
+            return false;
+        }
+        decoder->setCodecContext(demuxer.videoCodecContext());
+        if (!decoder->open()) {
+            decoder.reset(0);
+            error = QObject::tr("Failed to open video decoder");
+            return false;
+        }
+        return true;
+    }
+    void close() {
+        decoder.reset(0);
+        demuxer.unload();
+    }
+    // the max key frame interval in the first few key frames. >= limit if less than 2 key frames in limit
+    qint64 probeGop(qint64 limit) {
+        const int vstream = demuxer.videoStream();
+        const qint64 t0 = demuxer.startTime();
+        qint64 gop = 0;
+        qint64 key = -1;
+        int keys = 0;
+        while (keys < 4 && !demuxer.atEnd() && !atomic_load_relaxed(cancel)) {
+            if (!demuxer.readFrame() || demuxer.stream() != vstream)
+                continue;
+            const Packet pkt(demuxer.packet());
+            const qint64 t = pkt.pts*1000.0;
+            if (pkt.hasKeyFrame) {
+                if (key >= 0)
+                    gop = qMax(gop, t - key);
+                key = t;
+                ++keys;
+            }
+            if (t - t0 > limit)
+                break;
+        }
+        if (keys < 2)
+            return limit;
+        return gop;
+    }
+    void setDecodeOptions(QVariantHash *opt) {
+        if (dec_opt == opt)
+            return;
+        dec_opt = opt;
+        decoder->setOptions(*opt);
+    }
+    // seek to the key frame before value and decode it
+    VideoFrame decodeKeyFrame(qint64 value) {
+        demuxer.seek(value);
+        decoder->flush();
+        setDecodeOptions(&dec_opt_keyonly);
+        const int vstream = demuxer.videoStream();
+        while (!demuxer.atEnd() && !atomic_load_relaxed(cancel)) {
+            if (!demuxer.readFrame() || demuxer.stream() != vstream)
+                continue;
+            const Packet pkt(demuxer.packet());
+            if (!pkt.isValid() || !decoder->decode(pkt))
+                continue;
+            const VideoFrame f(decoder->frame());
+            if (f.isValid())
+                return f;
+        }
+        return VideoFrame();
+    }
+    // decode forward until a frame at or after value. last is the previous frame, returned if it's after value
+    VideoFrame decodeForward(qint64 value, const VideoFrame& last) {
+        if (last.isValid() && qint64(last.timestamp()*1000.0) >= value)
+            return last;
+        const int vstream = demuxer.videoStream();
+        VideoFrame frame(last);
+        while (!demuxer.atEnd() && !atomic_load_relaxed(cancel)) {
+            if (!demuxer.readFrame() || demuxer.stream() != vstream)
+                continue;
+            const Packet pkt(demuxer.packet());
+            if (!pkt.isValid())
+                continue;
+            if (qint64(pkt.pts*1000.0) < value - kFrameDropMargin)
+                setDecodeOptions(&dec_opt_framedrop);
+            else
+                setDecodeOptions(&dec_opt_normal);
+            if (!decoder->decode(pkt))
+                continue;
+            const VideoFrame f(decoder->frame());
+            if (!f.isValid())
+                continue;
+            frame = f;
+            if (qint64(frame.timestamp()*1000.0) >= value)
+                break;
+        }
+        // the last frame is used at the end of stream
+        return frame;
+    }
+    bool drawTile(const VideoFrame& frame, QImage *sheet, int x, int y) {
+        conv.setInFormat(frame.pixelFormatFFmpeg());
+        conv.setInSize(frame.width(), frame.height());
+        const quint8 *src[] = { frame.constBits(0), frame.constBits(1), frame.constBits(2), frame.constBits(3) };
+        const int stride[] = { frame.bytesPerLine(0), frame.bytesPerLine(1), frame.bytesPerLine(2), frame.bytesPerLine(3) };
+        if (!conv.convert(src, stride))
+            return false;
+        const quint8 *p = conv.outPlanes().at(0);
+        const int line = conv.outLineSizes().at(0);
+        for (int i = 0; i < tile.height(); ++i)
+            memcpy(sheet->scanLine(y + i) + x*4, p + i*line, tile.width()*4);
+        return true;
+    }
+    bool saveSheet(StoryboardGenerator *q, const QImage& sheet, int index, int tiles) {
+        const int h = ((tiles + columns - 1)/columns)*tile.height();
+        const QString name(QString::fromLatin1("%1_%2.%3").arg(base_name).arg(index).arg(format));
+        const QString file(QDir(output_dir).filePath(name));
+        const QImage img(h < sheet.height() ? sheet.copy(0, 0, sheet.width(), h) : sheet);
+        if (!img.save(file, format.toLatin1().constData(), quality)) {
+            error = QObject::tr("Failed to save %1").arg(file);
+            return false;
+        }
+        files.append(file);
+        emit q->imageSaved(file);
+        return true;
+    }
+
+    QString source;
+    qint64 interval;
+    QSize tile_size;
+    int columns, rows;
+    QString output_dir;
+    QString base_name;
+    QString format;
+    int quality;
+    QAtomicInt cancel;
+    QString error;
+    QStringList files;
+
+    AVDemuxer demuxer;
+    QScopedPointer<VideoDecoder> decoder;
+    ImageConverterSWS conv; // reused by all tiles
+    QSize tile;
+    QVariantHash *dec_opt;
+    QVariantHash dec_opt_keyonly, dec_opt_framedrop, dec_opt_normal;
+};
+
+StoryboardGenerator::StoryboardGenerator(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void StoryboardGenerator::setSource(const QString &value)
+{
+    d_func().source = value;
+}
+
+QString StoryboardGenerator::source() const
+{
+    return d_func().source;
+}
+
+void StoryboardGenerator::setInterval(qint64 value)
+{
+    d_func().interval = value;
+}
+
+qint64 StoryboardGenerator::interval() const
+{
+    return d_func().interval;
+}
+
+void StoryboardGenerator::setTileSize(const QSize &value)
+{
+    d_func().tile_size = value;
+}
+
+QSize StoryboardGenerator::tileSize() const
+{
+    return d_func().tile_size;
+}
+
+void StoryboardGenerator::setColumns(int value)
+{
+    d_func().columns = value;
+}
+
+int StoryboardGenerator::columns() const
+{
+    return d_func().columns;
+}
+
+void StoryboardGenerator::setRows(int value)
+{
+    d_func().rows = value;
+}
+
+int StoryboardGenerator::rows() const
+{
+    return d_func().rows;
+}
+
+void StoryboardGenerator::setOutputDir(const QString &value)
+{
+    d_func().output_dir = value;
+}
+
+QString StoryboardGenerator::outputDir() const
+{
+    return d_func().output_dir;
+}
+
+void StoryboardGenerator::setBaseName(const QString &value)
+{
+    d_func().base_name = value;
+}
+
+QString StoryboardGenerator::baseName() const
+{
+    return d_func().base_name;
+}
+
+void StoryboardGenerator::setImageFormat(const QString &value)
+{
+    d_func().format = value;
+}
+
+QString StoryboardGenerator::imageFormat() const
+{
+    return d_func().format;
+}
+
+void StoryboardGenerator::setQuality(int value)
+{
+    d_func().quality = value;
+}
+
+int StoryboardGenerator::quality() const
+{
+    return d_func().quality;
+}
+
+QString StoryboardGenerator::errorString() const
+{
+    return d_func().error;
+}
+
+QStringList StoryboardGenerator::files() const
+{
+    return d_func().files;
+}
+
+void StoryboardGenerator::cancel()
+{
+    atomic_store_release(d_func().cancel, 1);
+}
+
+bool StoryboardGenerator::generate()
+{
+    DPTR_D(StoryboardGenerator);
+    atomic_store_release(d.cancel, 0);
+    d.error.clear();
+    d.files.clear();
+    d.dec_opt = 0;
+    if (d.interval <= 0 || d.columns <= 0 || d.rows <= 0 || (d.tile_size.width() <= 0 && d.tile_size.height() <= 0)) {
+        d.error = tr("Invalid parameters");
+        return false;
+    }
+    if (!QDir().mkpath(d.output_dir.isEmpty() ? QStringLiteral(".") : d.output_dir)) {
+        d.error = tr("Can not create %1").arg(d.output_dir);
+        return false;
+    }
+    if (!d.open())
+        return false;
+    const qint64 t0 = d.demuxer.startTime();
+    const qint64 duration = d.demuxer.duration();
+    const int total = qMax<int>(1, int((duration + d.interval - 1)/d.interval));
+    const qint64 gop = d.probeGop(2*d.interval);
+    // a seek per sample decodes less than walking through a whole gop
+    const bool key_only = d.interval > gop;
+    qDebug("storyboard: %d tiles, interval %lld, gop %lld, key frames only: %d", total, d.interval, gop, key_only);
+    if (!key_only) {
+        d.demuxer.seek(t0);
+        d.decoder->flush();
+    }
+    QString vtt;
+    QTextStream vs(&vtt);
+    vs << "WEBVTT\n";
+    QImage sheet;
+    VideoFrame frame;
+    int sheet_index = 0;
+    int sheet_tiles = 0;
+    const int tiles_per_sheet = d.columns*d.rows;
+    bool ok = true;
+    for (int i = 0; i < total; ++i) {
+        if (atomic_load_relaxed(d.cancel)) {
+            d.error = tr("Canceled");
+            ok = false;
+            break;
+        }
+        const qint64 t = t0 + i*d.interval;
+        frame = key_only ? d.decodeKeyFrame(t) : d.decodeForward(t, frame);
+        if (!frame.isValid()) {
+            d.error = tr("No frame at %1ms").arg(t);
+            ok = false;
+            break;
+        }
+        if (sheet.isNull()) {
+            if (d.tile.isEmpty()) {
+                qreal dar = frame.displayAspectRatio();
+                if (dar <= 0)
+                    dar = qreal(frame.width())/qreal(frame.height());
+                d.tile = d.tile_size;
+                if (d.tile.width() <= 0)
+                    d.tile.setWidth(qRound(qreal(d.tile.height())*dar));
+                else if (d.tile.height() <= 0)
+                    d.tile.setHeight(qRound(qreal(d.tile.width())/dar));
+                d.conv.setOutFormat(VideoFormat::Format_RGB32);
+                d.conv.setOutSize(d.tile.width(), d.tile.height());
+            }
+            sheet = QImage(d.tile.width()*d.columns, d.tile.height()*d.rows, QImage::Format_RGB32);
+            sheet.fill(0);
+        }
+        const int x = (sheet_tiles%d.columns)*d.tile.width();
+        const int y = (sheet_tiles/d.columns)*d.tile.height();
+        if (!d.drawTile(frame, &sheet, x, y)) {
+            d.error = tr("Failed to scale frame");
+            ok = false;
+            break;
+        }
+        const QString name(QString::fromLatin1("%1_%2.%3").arg(d.base_name).arg(sheet_index).arg(d.format));
+        const qint64 end = qMax<qint64>(i*d.interval + 1, qMin<qint64>((i + 1)*d.interval, duration));
+        vs << "\n" << vttTime(i*d.interval) << " --> " << vttTime(end)
+           << "\n" << name << "#xywh=" << x << "," << y << "," << d.tile.width() << "," << d.tile.height() << "\n";
+        ++sheet_tiles;
+        emit progress(i + 1, total);
+        if (sheet_tiles == tiles_per_sheet || i == total - 1) {
+            if (!d.saveSheet(this, sheet, sheet_index, sheet_tiles)) {
+                ok = false;
+                break;
+            }
+            sheet = QImage();
+            ++sheet_index;
+            sheet_tiles = 0;
+        }
+    }
+    d.close();
+    d.tile = QSize();
+    if (!ok)
+        return false;
+    vs.flush();
+    const QString vtt_file(QDir(d.output_dir).filePath(d.base_name + QStringLiteral(".vtt")));
+    QFile f(vtt_file);
+    if (!f.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+        d.error = tr("Failed to save %1").arg(vtt_file);
+        return false;
+    }
+    f.write(vtt.toUtf8());
+    d.files.append(vtt_file);
+    return true;
+}
+} //namespace QtAV
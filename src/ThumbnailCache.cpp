@@ -0,0 +1,375 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/ThumbnailCache.h"
+#include <QtCore/QCache>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutex>
+#include "utils/internal.h"
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+static const quint32 kMagic = 0x51544643; // QTFC
+static const quint32 kVersion = 1;
+static const qint64 kDefaultMaxBytes = 32*1024*1024;
+static const qint64 kDefaultMaxDiskBytes = 256*1024*1024;
+
+// QCache cost is int, so count in KB
+static int costOf(qint64 bytes)
+{
+    return int((bytes + 1023)/1024);
+}
+
+static qint64 frameBytes(const VideoFrame& frame)
+{
+    qint64 bytes = 0;
+    for (int i = 0; i < frame.planeCount(); ++i)
+        bytes += qint64(frame.bytesPerLine(i))*qint64(frame.planeHeight(i));
+    return bytes;
+}
+
+class ThumbnailCachePrivate : public DPtrPrivate<ThumbnailCache>
+{
+public:
+    ThumbnailCachePrivate()
+        : max_bytes(kDefaultMaxBytes)
+        , disk_enabled(false)
+        , disk_dir(Internal::Path::appCacheDir() + QStringLiteral("/thumbnails"))
+        , max_disk_bytes(kDefaultMaxDiskBytes)
+        , disk_bytes(-1)
+        , tmp_seq(0)
+        , hits(0)
+        , disk_hits(0)
+        , misses(0)
+    {
+        cache.setMaxCost(costOf(max_bytes));
+    }
+    // a local file is identified by its size and modified time too, so frames of a replaced file are not used
+    static QString keyOf(const QString& source, qint64 position, int precision, const QSize& size) {
+        const qint64 bucket = precision > 0 ? position/precision : position;
+        QString key(QStringLiteral("%1|%2|%3|%4x%5").arg(source).arg(bucket).arg(precision).arg(size.width()).arg(size.height()));
+        const QFileInfo fi(source);
+        if (fi.exists())
+            key += QStringLiteral("|%1|%2").arg(fi.size()).arg(fi.lastModified().toMSecsSinceEpoch());
+        return key;
+    }
+    QString diskFile(const QString& key) const {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(key.toUtf8());
+        return disk_dir + QStringLiteral("/") + QString::fromLatin1(hash.result().toHex()) + QStringLiteral(".qtf");
+    }
+    static VideoFrame load(const QString& file) {
+        QFile f(file);
+        if (!f.open(QIODevice::ReadOnly))
+            return VideoFrame();
+        QDataStream ds(&f);
+        quint32 magic = 0, version = 0;
+        qint32 pixfmt = 0, w = 0, h = 0, planes = 0;
+        double ts = 0;
+        float dar = 0;
+        ds >> magic >> version;
+        if (magic != kMagic || version != kVersion)
+            return VideoFrame();
+        ds >> pixfmt >> w >> h >> ts >> dar >> planes;
+        if (ds.status() != QDataStream::Ok || w <= 0 || h <= 0)
+            return VideoFrame();
+        VideoFrame frame(w, h, VideoFormat((VideoFormat::PixelFormat)pixfmt));
+        if (frame.planeCount() != planes || frame.allocate() <= 0)
+            return VideoFrame();
+        for (int i = 0; i < planes; ++i) {
+            const int len = frame.effectiveBytesPerLine(i);
+            uchar *dst = frame.bits(i);
+            for (int y = 0; y < frame.planeHeight(i); ++y) {
+                if (ds.readRawData((char*)dst, len) != len)
+                    return VideoFrame();
+                dst += frame.bytesPerLine(i);
+            }
+        }
+        frame.setTimestamp(ts);
+        frame.setDisplayAspectRatio(dar);
+        return frame;
+    }
+    bool save(const QString& file, const QString& dir, const VideoFrame& frame) {
+        if (!QDir().mkpath(dir))
+            return false;
+        const QString tmp(file + QStringLiteral(".tmp") + QString::number(tmp_seq.fetchAndAddRelaxed(1)));
+        QFile f(tmp);
+        if (!f.open(QIODevice::WriteOnly)) {
+            qWarning("Failed to save thumbnail: %s", f.errorString().toUtf8().constData());
+            return false;
+        }
+        QDataStream ds(&f);
+        ds << kMagic << kVersion << qint32(frame.pixelFormat()) << qint32(frame.width()) << qint32(frame.height())
+           << double(frame.timestamp()) << frame.displayAspectRatio() << qint32(frame.planeCount());
+        for (int i = 0; i < frame.planeCount(); ++i) {
+            const int len = frame.effectiveBytesPerLine(i);
+            const uchar *src = frame.constBits(i);
+            for (int y = 0; y < frame.planeHeight(i); ++y) {
+                ds.writeRawData((const char*)src, len);
+                src += frame.bytesPerLine(i);
+            }
+        }
+        const qint64 size = f.size();
+        f.close();
+        QFile::remove(file);
+        if (!QFile::rename(tmp, file)) {
+            QFile::remove(tmp);
+            return false;
+        }
+        QMutexLocker lock(&disk_mutex);
+        Q_UNUSED(lock);
+        if (disk_bytes < 0) {
+            disk_bytes = 0;
+            foreach (const QFileInfo& fi, QDir(dir).entryInfoList(QStringList() << QStringLiteral("*.qtf"), QDir::Files))
+                disk_bytes += fi.size();
+        } else {
+            disk_bytes += size;
+        }
+        if (disk_bytes <= max_disk_bytes)
+            return true;
+        // remove the oldest files. keep 3/4 of the limit to avoid listing the dir for every frame
+        foreach (const QFileInfo& fi, QDir(dir).entryInfoList(QStringList() << QStringLiteral("*.qtf"), QDir::Files, QDir::Time|QDir::Reversed)) {
+            if (disk_bytes <= max_disk_bytes*3/4)
+                break;
+            if (QFile::remove(fi.absoluteFilePath()))
+                disk_bytes -= fi.size();
+        }
+        return true;
+    }
+
+    mutable QMutex mutex; // memory tier, settings and counters
+    QCache<QString, VideoFrame> cache;
+    qint64 max_bytes;
+    bool disk_enabled;
+    QString disk_dir;
+    qint64 max_disk_bytes;
+    mutable QMutex disk_mutex;
+    qint64 disk_bytes; // < 0: not counted yet
+    QAtomicInt tmp_seq;
+    qint64 hits;
+    qint64 disk_hits;
+    qint64 misses;
+};
+
+ThumbnailCache& ThumbnailCache::instance()
+{
+    static ThumbnailCache cache;
+    return cache;
+}
+
+ThumbnailCache::ThumbnailCache()
+{
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+}
+
+void ThumbnailCache::setMaxBytes(qint64 value)
+{
+    DPTR_D(ThumbnailCache);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.max_bytes = qMax<qint64>(0, value);
+    d.cache.setMaxCost(costOf(d.max_bytes));
+}
+
+qint64 ThumbnailCache::maxBytes() const
+{
+    DPTR_D(const ThumbnailCache);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.max_bytes;
+}
+
+void ThumbnailCache::setDiskCacheEnabled(bool value)
+{
+    DPTR_D(ThumbnailCache);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.disk_enabled = value;
+}
+
+bool ThumbnailCache::isDiskCacheEnabled() const
+{
+    DPTR_D(const ThumbnailCache);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.disk_enabled;
+}
+
+void ThumbnailCache::setDiskCacheDir(const QString &value)
+{
+    DPTR_D(ThumbnailCache);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    if (d.disk_dir == value)
+        return;
+    d.disk_dir = value;
+    QMutexLocker disk_lock(&d.disk_mutex);
+    Q_UNUSED(disk_lock);
+    d.disk_bytes = -1;
+}
+
+QString ThumbnailCache::diskCacheDir() const
+{
+    DPTR_D(const ThumbnailCache);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.disk_dir;
+}
+
+void ThumbnailCache::setMaxDiskBytes(qint64 value)
+{
+    DPTR_D(ThumbnailCache);
+    QMutexLocker lock(&d.disk_mutex);
+    Q_UNUSED(lock);
+    d.max_disk_bytes = qMax<qint64>(0, value);
+}
+
+qint64 ThumbnailCache::maxDiskBytes() const
+{
+    DPTR_D(const ThumbnailCache);
+    QMutexLocker lock(&d.disk_mutex);
+    Q_UNUSED(lock);
+    return d.max_disk_bytes;
+}
+
+VideoFrame ThumbnailCache::find(const QString &source, qint64 position, int precision, const QSize &size)
+{
+    DPTR_D(ThumbnailCache);
+    const QString key(d.keyOf(source, position, precision, size));
+    QString file;
+    {
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        const VideoFrame *f = d.cache.object(key);
+        if (f) {
+            ++d.hits;
+            return *f;
+        }
+        if (!d.disk_enabled) {
+            ++d.misses;
+            return VideoFrame();
+        }
+        file = d.diskFile(key);
+    }
+    // no lock for io
+    const VideoFrame frame(d.load(file));
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    if (!frame.isValid()) {
+        ++d.misses;
+        return frame;
+    }
+    ++d.hits;
+    ++d.disk_hits;
+    if (d.max_bytes > 0)
+        d.cache.insert(key, new VideoFrame(frame), costOf(frameBytes(frame)));
+    return frame;
+}
+
+void ThumbnailCache::insert(const QString &source, qint64 position, int precision, const QSize &size, const VideoFrame &frame)
+{
+    DPTR_D(ThumbnailCache);
+    if (!frame.isValid())
+        return;
+    // decoded frames may share the decoder buffers. clone() uses pooled memory. hw frames are mapped to host memory
+    const VideoFrame f(frame.constBits(0) ? frame.clone() : frame.to(frame.format()));
+    if (!f.isValid() || !f.constBits(0)) // the surface interop can not map it
+        return;
+    const QString key(d.keyOf(source, position, precision, size));
+    QString file, dir;
+    {
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        if (d.max_bytes > 0)
+            d.cache.insert(key, new VideoFrame(f), costOf(frameBytes(f)));
+        if (!d.disk_enabled)
+            return;
+        file = d.diskFile(key);
+        dir = d.disk_dir;
+    }
+    d.save(file, dir, f);
+}
+
+void ThumbnailCache::clear()
+{
+    DPTR_D(ThumbnailCache);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.cache.clear();
+}
+
+qint64 ThumbnailCache::hits() const
+{
+    DPTR_D(const ThumbnailCache);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.hits;
+}
+
+qint64 ThumbnailCache::diskHits() const
+{
+    DPTR_D(const ThumbnailCache);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.disk_hits;
+}
+
+qint64 ThumbnailCache::misses() const
+{
+    DPTR_D(const ThumbnailCache);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.misses;
+}
+
+void ThumbnailCache::resetCounters()
+{
+    DPTR_D(ThumbnailCache);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.hits = d.disk_hits = d.misses = 0;
+}
+
+qint64 ThumbnailCache::bytes() const
+{
+    DPTR_D(const ThumbnailCache);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return qint64(d.cache.totalCost())*1024LL;
+}
+
+int ThumbnailCache::count() const
+{
+    DPTR_D(const ThumbnailCache);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.cache.count();
+}
+} //namespace QtAV
@@ -23,7 +23,9 @@
 #include "QtAV/private/Frame_p.h"
 #include "QtAV/SurfaceInterop.h"
 #include "ImageConverter.h"
+#include <QtCore/QScopedPointer>
 #include <QtCore/QSharedPointer>
+#include <QtCore/QThreadStorage>
 #include <QtGui/QImage>
 #include "QtAV/private/AVCompat.h"
 #include "utils/GPUMemCopy.h"
@@ -65,11 +67,12 @@ VideoFrame VideoFrame::fromGPU(const VideoFormat& fmt, int width, int height, in
         for (int i = 0; i < nb_planes; ++i) {
             yuv_size += pitch[i]*h[i];
         }
-        // additional 15 bytes to ensure 16 bytes aligned
-        QByteArray buf(15 + yuv_size, 0);
-        const int offset_16 = (16 - ((uintptr_t)buf.data() & 0x0f)) & 0x0f;
+        // pooled buffers are aligned
+        const FrameBufferRef buf(FrameBufferPool::instance().get(yuv_size));
+        if (!buf)
+            return VideoFrame();
         // plane 1, 2... is aligned?
-        uchar* plane_ptr = (uchar*)buf.data() + offset_16;
+        uchar* plane_ptr = buf->data();
         QVector<uchar*> dst(nb_planes, 0);
         for (int i = 0; i < nb_planes; ++i) {
             dst[i] = plane_ptr;
@@ -93,6 +96,74 @@ VideoFrame VideoFrame::fromGPU(const VideoFormat& fmt, int width, int height, in
     return frame;
 }
 
+/*
+ * Prepared converters for to(). Creating a converter for every call means a new sws context with the filter tables
+ * built again, so the recently used ones are kept per thread. The result frame takes the output buffer, and the next
+ * convert() gets a new one from FrameBufferPool, so a cached converter holds no frame memory.
+ * QTAV_CONVERTER_CACHE=n: max converters per thread. 0 disables the cache. Default is 8.
+ */
+class ConverterCache
+{
+public:
+    ConverterCache() : m_clock(0) {}
+    ~ConverterCache() {
+        for (int i = 0; i < m_entries.size(); ++i)
+            delete m_entries[i].conv;
+    }
+    static int capacity() {
+        static const int n = qgetenv("QTAV_CONVERTER_CACHE").isEmpty() ? 8 : qgetenv("QTAV_CONVERTER_CACHE").toInt();
+        return n;
+    }
+    static ConverterCache* current() {
+        static QThreadStorage<ConverterCache*> cache;
+        if (!cache.hasLocalData())
+            cache.setLocalData(new ConverterCache());
+        return cache.localData();
+    }
+    // return a converter with given shape. the least recently used one is replaced if the cache is full
+    ImageConverter* get(int fmt_in, int fmt_out, int w_in, int h_in, int w_out, int h_out) {
+        const Key k = { fmt_in, fmt_out, w_in, h_in, w_out, h_out };
+        int lru = 0;
+        for (int i = 0; i < m_entries.size(); ++i) {
+            if (m_entries[i].key == k) {
+                m_entries[i].used = ++m_clock;
+                return m_entries[i].conv;
+            }
+            if (m_entries[i].used < m_entries[lru].used)
+                lru = i;
+        }
+        Entry e;
+        e.key = k;
+        e.used = ++m_clock;
+        e.conv = new ImageConverterSWS();
+        e.conv->setInFormat(fmt_in);
+        e.conv->setOutFormat(fmt_out);
+        e.conv->setInSize(w_in, h_in);
+        e.conv->setOutSize(w_out, h_out);
+        if (m_entries.size() < capacity()) {
+            m_entries.append(e);
+        } else {
+            delete m_entries[lru].conv;
+            m_entries[lru] = e;
+        }
+        return e.conv;
+    }
+private:
+    struct Key {
+        int fmt_in, fmt_out, w_in, h_in, w_out, h_out;
+        bool operator==(const Key& o) const {
+            return fmt_in == o.fmt_in && fmt_out == o.fmt_out && w_in == o.w_in && h_in == o.h_in && w_out == o.w_out && h_out == o.h_out;
+        }
+    };
+    struct Entry {
+        Key key;
+        quint64 used;
+        ImageConverter *conv;
+    };
+    quint64 m_clock;
+    QVector<Entry> m_entries;
+};
+
 class VideoFramePrivate : public FramePrivate
 {
     Q_DISABLE_COPY(VideoFramePrivate)
@@ -151,6 +222,13 @@ VideoFrame::VideoFrame(const QByteArray& data, int width, int height, const Vide
     d->data = data;
 }
 
+VideoFrame::VideoFrame(const FrameBufferRef &buffer, int width, int height, const VideoFormat &format)
+    : Frame(new VideoFramePrivate(width, height, format))
+{
+    Q_D(VideoFrame);
+    d->buffer = buffer;
+}
+
 VideoFrame::VideoFrame(const QVector<int>& textures, int width, int height, const VideoFormat &format)
     : Frame(new VideoFramePrivate(width, height, format))
 {
@@ -219,12 +297,15 @@ VideoFrame VideoFrame::clone() const
         bytes += bytesPerLine(i)*planeHeight(i);
     }
 
-    QByteArray buf(bytes, 0);
-    char *dst = buf.data(); //must before buf is shared, otherwise data will be detached.
+    const FrameBufferRef buf(FrameBufferPool::instance().get(bytes));
+    if (!buf)
+        return VideoFrame();
+    // planes are packed as before, so frameData() layout does not change. the 1st plane is aligned
+    uchar *dst = buf->data();
     VideoFrame f(buf, width(), height(), d->format);
     const int nb_planes = d->format.planeCount();
     for (int i = 0; i < nb_planes; ++i) {
-        f.setBits((quint8*)dst, i);
+        f.setBits(dst, i);
         f.setBytesPerLine(bytesPerLine(i), i);
         const int plane_size = bytesPerLine(i)*planeHeight(i);
         memcpy(dst, constBits(i), plane_size);
@@ -255,8 +336,12 @@ int VideoFrame::allocate()
     return bytes;
 #endif
     int bytes = avpicture_get_size((AVPixelFormat)pixelFormatFFmpeg(), width(), height());
-    if (d->data.size() < bytes) {
-        d->data = QByteArray(bytes, 0);
+    // reuse the memory given in ctor or the previous allocation if possible
+    if (d->data.size() < bytes && (!d->buffer || d->buffer->size() < bytes)) {
+        d->data = QByteArray();
+        d->buffer = FrameBufferPool::instance().get(bytes);
+        if (!d->buffer)
+            return 0;
     }
     init();
     return bytes;
@@ -362,10 +447,23 @@ QImage VideoFrame::toImage(QImage::Format fmt, const QSize& dstSize, const QRect
     VideoFrame f(to(VideoFormat(VideoFormat::pixelFormatFromImageFormat(fmt)), dstSize, roi));
     if (!f)
         return QImage();
-    QImage image((const uchar*)f.frameData().constData(), f.width(), f.height(), f.bytesPerLine(0), fmt);
+    QImage image(f.constBits(0), f.width(), f.height(), f.bytesPerLine(0), fmt);
     return image.copy();
 }
 
+// a frame of the converter output. take: the converter does not keep the output memory
+static VideoFrame outputFrame(ImageConverter *conv, bool take, int w, int h, const VideoFormat& fmt)
+{
+    const QVector<quint8*> planes(conv->outPlanes());
+    const QVector<int> line_sizes(conv->outLineSizes());
+    const FrameBufferRef buf(take ? conv->takeOutBuffer() : conv->outBuffer());
+    // no FrameBuffer if the converter writes to outData(), e.g. IPP
+    VideoFrame f(buf ? VideoFrame(buf, w, h, fmt) : VideoFrame(conv->outData(), w, h, fmt));
+    f.setBits(planes);
+    f.setBytesPerLine(line_sizes);
+    return f;
+}
+
 VideoFrame VideoFrame::to(const VideoFormat &fmt, const QSize& dstSize, const QRectF& roi) const
 {
     if (!isValid() || !constBits(0)) {// hw surface. map to host. only supports rgb packed formats now
@@ -386,26 +484,32 @@ VideoFrame VideoFrame::to(const VideoFormat &fmt, const QSize& dstSize, const QR
         }
         return VideoFrame();
     }
-    if (fmt.pixelFormatFFmpeg() == pixelFormatFFmpeg())
-        return *this;
     Q_D(const VideoFrame);
-    ImageConverterSWS conv;
-    conv.setInFormat(pixelFormatFFmpeg());
-    conv.setOutFormat(fmt.pixelFormatFFmpeg());
-    conv.setInSize(width(), height());
     int w = width(), h = height();
     if (dstSize.width() > 0)
         w = dstSize.width();
     if (dstSize.height() > 0)
         h = dstSize.height();
-    conv.setOutSize(w, h);
-    if (!conv.convert(d->planes.constData(), d->line_sizes.constData())) {
+    if (fmt.pixelFormatFFmpeg() == pixelFormatFFmpeg() && w == width() && h == height())
+        return *this;
+    QScopedPointer<ImageConverter> local_conv;
+    ImageConverter *conv = 0;
+    if (ConverterCache::capacity() > 0) {
+        conv = ConverterCache::current()->get(pixelFormatFFmpeg(), fmt.pixelFormatFFmpeg(), width(), height(), w, h);
+    } else {
+        local_conv.reset(new ImageConverterSWS());
+        conv = local_conv.data();
+        conv->setInFormat(pixelFormatFFmpeg());
+        conv->setOutFormat(fmt.pixelFormatFFmpeg());
+        conv->setInSize(width(), height());
+        conv->setOutSize(w, h);
+    }
+    if (!conv->convert(d->planes.constData(), d->line_sizes.constData())) {
         qWarning() << "VideoFrame::to error: " << format() << "=>" << fmt;
         return VideoFrame();
     }
-    VideoFrame f(conv.outData(), w, h, fmt);
-    f.setBits(conv.outPlanes());
-    f.setBytesPerLine(conv.outLineSizes());
+    // cached converters do not keep the output memory
+    VideoFrame f(outputFrame(conv, true, w, h, fmt));
     if (fmt.isRGB()) {
         f.setColorSpace(fmt.isPlanar() ? ColorSpace_GBR : ColorSpace_RGB);
     } else {
@@ -473,13 +577,15 @@ void VideoFrame::init()
     AVPixelFormat fff = (AVPixelFormat)d->format.pixelFormatFFmpeg();
     //int bytes = avpicture_get_size(fff, width(), height());
     //d->data.resize(bytes);
-    avpicture_fill(&picture, (uint8_t*)d->data.constData(), fff, width(), height());
+    const uint8_t *data = d->data.isEmpty() && d->buffer ? d->buffer->data() : (const uint8_t*)d->data.constData();
+    avpicture_fill(&picture, (uint8_t*)data, fff, width(), height());
     setBits(picture.data);
     setBytesPerLine(picture.linesize);
 }
 
 VideoFrameConverter::VideoFrameConverter()
     : m_cvt(0)
+    , m_cvt_id(0)
 {
     memset(m_eq, 0, sizeof(m_eq));
 }
@@ -519,15 +625,33 @@ VideoFrame VideoFrameConverter::convert(const VideoFrame& frame, QImage::Format
 
 VideoFrame VideoFrameConverter::convert(const VideoFrame &frame, int fffmt) const
 {
-    if (!frame.isValid() || fffmt == QTAV_PIX_FMT_C(NONE))
+    if (fffmt == QTAV_PIX_FMT_C(NONE))
+        return VideoFrame();
+    return convert(frame, VideoFormat(fffmt), QSize());
+}
+
+VideoFrame VideoFrameConverter::convert(const VideoFrame &frame, const VideoFormat &fmt, const QSize &dstSize) const
+{
+    if (!frame.isValid() || !fmt.isValid())
         return VideoFrame();
     if (!frame.constBits(0)) // hw surface
-        return frame.to(VideoFormat::pixelFormatFromFFmpeg(fffmt));
+        return frame.to(fmt, dstSize);
+    const int fffmt = fmt.pixelFormatFFmpeg();
     const VideoFormat format(frame.format());
     //if (fffmt == format.pixelFormatFFmpeg())
       //  return *this;
-    if (!m_cvt) {
-        m_cvt = new ImageConverterSWS();
+    const int w = dstSize.width() > 0 ? dstSize.width() : frame.width();
+    const int h = dstSize.height() > 0 ? dstSize.height() : frame.height();
+    // swscale converts in slices (ImageConverter::setThreads()). SIMD converter: scaling of common formats in a single
+    // pass, or eq at the same size by the row kernels and an eq pass. eq of both has the same meaning as the renderers
+    const bool simd = m_eq[0] || m_eq[1] || m_eq[2] || w != frame.width() || h != frame.height();
+    const int id = simd ? ImageConverterId_SIMD : ImageConverterId_FF;
+    if (!m_cvt || m_cvt_id != id) {
+        delete m_cvt;
+        m_cvt = ImageConverter::create(id);
+        m_cvt_id = id;
+        if (!m_cvt)
+            return VideoFrame();
     }
     m_cvt->setBrightness(m_eq[0]);
     m_cvt->setContrast(m_eq[1]);
@@ -535,7 +659,7 @@ VideoFrame VideoFrameConverter::convert(const VideoFrame &frame, int fffmt) cons
     m_cvt->setInFormat(format.pixelFormatFFmpeg());
     m_cvt->setOutFormat(fffmt);
     m_cvt->setInSize(frame.width(), frame.height());
-    m_cvt->setOutSize(frame.width(), frame.height());
+    m_cvt->setOutSize(w, h);
     QVector<const uchar*> pitch(format.planeCount());
     QVector<int> stride(format.planeCount());
     for (int i = 0; i < format.planeCount(); ++i) {
@@ -545,10 +669,8 @@ VideoFrame VideoFrameConverter::convert(const VideoFrame &frame, int fffmt) cons
     if (!m_cvt->convert(pitch.constData(), stride.constData())) {
         return VideoFrame();
     }
-    const VideoFormat fmt(fffmt);
-    VideoFrame f(m_cvt->outData(), frame.width(), frame.height(), fmt);
-    f.setBits(m_cvt->outPlanes());
-    f.setBytesPerLine(m_cvt->outLineSizes());
+    // the converter uses a new buffer for the next frame if this one is still referenced
+    VideoFrame f(outputFrame(m_cvt, false, w, h, fmt));
     f.setTimestamp(frame.timestamp());
     f.setDisplayAspectRatio(frame.displayAspectRatio());
     // metadata?
@@ -20,17 +20,21 @@
 ******************************************************************************/
 
 #include "QtAV/VideoFrameExtractor.h"
+#include <QtCore/QAtomicInt>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QQueue>
 #include <QtCore/QRunnable>
 #include <QtCore/QScopedPointer>
 #include <QtCore/QStringList>
 #include <QtCore/QThread>
+#include <QtCore/QThreadPool>
 #include "QtAV/VideoCapture.h"
 #include "QtAV/VideoDecoder.h"
 #include "QtAV/AVDemuxer.h"
 #include "QtAV/Packet.h"
+#include "QtAV/ThumbnailCache.h"
 #include "utils/BlockingQueue.h"
+#include "utils/spsc_ring.h" // atomic_load_relaxed
 #include "utils/Logger.h"
 
 // TODO: event and signal do not work
@@ -41,6 +45,11 @@ namespace QtAV {
 
 class ExtractThread : public QThread {
 public:
+    class Task : public QRunnable {
+    public:
+        // called if the task is replaced by a newer one before running
+        virtual void cancel() {}
+    };
     ExtractThread(QObject *parent = 0)
         : QThread(parent)
         , stop(false)
@@ -57,30 +66,27 @@ public:
         wait();
     }
 
-    void addTask(QRunnable* t) {
-        if (tasks.size() >= tasks.capacity()) {
-            QRunnable *task = tasks.take();
-            if (task->autoDelete())
-                delete task;
-        }
+    void addTask(Task* t) {
+        dropPendingTask(true);
         tasks.put(t);
     }
     void scheduleStop() {
-        class StopTask : public QRunnable {
+        class StopTask : public Task {
         public:
             StopTask(ExtractThread* t) : thread(t) {}
             void run() { thread->stop = true;}
         private:
             ExtractThread *thread;
         };
-        addTask(new StopTask(this));
+        dropPendingTask(false); // no signal, the extractor may be being destroyed
+        tasks.put(new StopTask(this));
     }
 
 protected:
     virtual void run() {
 #if ASYNC_TASK
         while (!stop) {
-            QRunnable *task = tasks.take();
+            Task *task = tasks.take();
             if (!task)
                 return;
             task->run();
@@ -94,9 +100,52 @@ protected:
 public:
     volatile bool stop;
 private:
-    BlockingQueue<QRunnable*> tasks;
+    void dropPendingTask(bool cancel) {
+        if (tasks.size() < tasks.capacity())
+            return;
+        Task *task = tasks.take();
+        if (cancel)
+            task->cancel();
+        if (task->autoDelete())
+            delete task;
+    }
+    BlockingQueue<Task*> tasks;
+};
+
+// a demuxer and decoder pair for parallel batch extraction
+class ExtractWorker {
+public:
+    ExtractWorker() : gop(0) {
+        // index cache files are written by the extractor's demuxer
+        demuxer.setKeyFrameIndexMode(AVDemuxer::NoKeyFrameIndex);
+    }
+    ~ExtractWorker() {
+        decoder.reset(0);
+        demuxer.unload();
+    }
+    AVDemuxer demuxer;
+    QScopedPointer<VideoDecoder> decoder;
+    qint64 gop;
 };
 
+// decoded frames share the decoder buffers, so always return a new frame
+static VideoFrame scaledFrame(const VideoFrame& frame, const QSize& size)
+{
+    if (size.width() <= 0 && size.height() <= 0)
+        return frame.clone();
+    QSize s(size);
+    qreal dar = frame.displayAspectRatio();
+    if (dar <= 0)
+        dar = qreal(frame.width())/qreal(frame.height());
+    if (s.width() <= 0)
+        s.setWidth(qRound(qreal(s.height())*dar));
+    else if (s.height() <= 0)
+        s.setHeight(qRound(qreal(s.width())/dar));
+    if (s == frame.size())
+        return frame.clone();
+    return frame.to(frame.format(), s);
+}
+
 // FIXME: avcodec_close() crash
 const int kDefaultPrecision = 500;
 class VideoFrameExtractorPrivate : public DPtrPrivate<VideoFrameExtractor>
@@ -111,6 +160,9 @@ public:
         , seek_count(0)
         , position(-2*kDefaultPrecision)
         , precision(kDefaultPrecision)
+        , batch_id(0)
+        , nb_workers(1)
+        , gop(0)
         , decoder(0)
     {
         QVariantHash opt;
@@ -139,6 +191,7 @@ public:
     ~VideoFrameExtractorPrivate() {
         // stop first before demuxer and decoder close to avoid running new seek task after demuxer is closed.
         thread.waitStop();
+        qDeleteAll(workers);
         // close codec context first.
         decoder.reset(0);
         demuxer.unload();
@@ -173,25 +226,68 @@ public:
             else
                 precision = kDefaultPrecision;
         }
+        decoder.reset(createDecoder(codecs, demuxer));
+        return !!decoder;
+    }
+
+    bool openWorker(ExtractWorker *w) {
+        if (w->demuxer.fileName() == source && w->demuxer.isLoaded() && w->decoder && !w->demuxer.atEnd())
+            return true;
+        w->decoder.reset(0);
+        w->demuxer.unload();
+        w->demuxer.setMedia(source);
+        if (!w->demuxer.load() || w->demuxer.videoStreams().isEmpty())
+            return false;
+        w->decoder.reset(createDecoder(codecs, w->demuxer));
+        return !!w->decoder;
+    }
+
+    static VideoDecoder* createDecoder(const QStringList& codecs, AVDemuxer& demuxer) {
         foreach (const QString& c, codecs) {
             VideoDecoder *vd = VideoDecoder::create(c.toUtf8().constData());
             if (!vd)
                 continue;
-            decoder.reset(vd);
-            decoder->setCodecContext(demuxer.videoCodecContext());
-            if (!decoder->open()) {
-                decoder.reset(0);
+            vd->setCodecContext(demuxer.videoCodecContext());
+            if (!vd->open()) {
+                delete vd;
                 continue;
             }
             QVariantHash opt, va;
             // FIXME: why QStringLiteral can't be used as key for vs<2015 but somewhere else it can?  error C2958: the left bracket '[' found at qstringliteral
             va[QString::fromLatin1("display")] = QString::fromLatin1("X11"); // to support swscale
             opt[QString::fromLatin1("vaapi")] = va;
-            decoder->setOptions(opt);
-            break;
+            vd->setOptions(opt);
+            return vd;
         }
-        return !!decoder;
+        return 0;
+    }
+
+    // split sorted positions into count parts of similar size. a split point is moved forward
+    // to a gap larger than gop if possible, because positions in 1 gop are decoded together
+    static QList<QList<qint64> > partition(const QList<qint64>& positions, int count, qint64 gop) {
+        QList<QList<qint64> > parts;
+        const int n = (positions.size() + count - 1)/count;
+        int i = 0;
+        while (i < positions.size()) {
+            int end = qMin(i + n, positions.size());
+            for (int j = end; j < qMin(end + n/2, positions.size()); ++j) {
+                if (positions.at(j) - positions.at(j-1) > gop) {
+                    end = j;
+                    break;
+                }
+            }
+            parts.append(positions.mid(i, end - i));
+            i = end;
+        }
+        return parts;
+    }
+
+    void emitBatchFrame(VideoFrameExtractor *q, const VideoFrame& frame, const QSize& size, qint64 pos) {
+        const VideoFrame f(scaledFrame(frame, size));
+        ThumbnailCache::instance().insert(source, pos, precision, size, f);
+        emit q->batchFrameExtracted(f, pos);
     }
+    qint64 extractBatch(VideoFrameExtractor *q, AVDemuxer& demuxer, VideoDecoder* decoder, const QList<qint64>& positions, const QSize& size, qint64 gop, int id);
 
     // return the key frame position
     bool extractInPrecision(qint64 value, int range) {
@@ -322,10 +418,13 @@ public:
     void releaseResourceInternal() {
         decoder.reset(0);
         demuxer.unload();
+        qDeleteAll(workers);
+        workers.clear();
+        gop = 0;
     }
 
     void safeReleaseResource() {
-        class Cleaner : public QRunnable {
+        class Cleaner : public ExtractThread::Task {
             VideoFrameExtractorPrivate *p;
         public:
             Cleaner(VideoFrameExtractorPrivate* pri) : p(pri) {}
@@ -345,18 +444,24 @@ public:
     int seek_count;
     qint64 position;
     int precision;
+    QAtomicInt batch_id; // running batch stops if it's changed
+    int nb_workers;
+    qint64 gop; // the max key frame interval seen in batches
     QString source;
     AVDemuxer demuxer;
     QScopedPointer<VideoDecoder> decoder;
     VideoFrame frame;
     QStringList codecs;
     ExtractThread thread;
+    QThreadPool pool; // for workers
+    QList<ExtractWorker*> workers; // reused by batches
     static QVariantHash dec_opt_framedrop, dec_opt_normal;
 };
 
 QVariantHash VideoFrameExtractorPrivate::dec_opt_framedrop;
 QVariantHash VideoFrameExtractorPrivate::dec_opt_normal;
 
+
 VideoFrameExtractor::VideoFrameExtractor(QObject *parent) :
     QObject(parent)
 {
@@ -375,6 +480,7 @@ void VideoFrameExtractor::setSource(const QString value)
     d.has_video = true;
     emit sourceChanged();
     d.frame = VideoFrame();
+    d.batch_id.ref(); // stop running batch
     d.safeReleaseResource();
 }
 
@@ -451,6 +557,20 @@ int VideoFrameExtractor::precision() const
     return d_func().precision;
 }
 
+void VideoFrameExtractor::setWorkers(int value)
+{
+    DPTR_D(VideoFrameExtractor);
+    if (d.nb_workers == value)
+        return;
+    d.nb_workers = value;
+    emit workersChanged();
+}
+
+int VideoFrameExtractor::workers() const
+{
+    return d_func().nb_workers;
+}
+
 bool VideoFrameExtractor::event(QEvent *e)
 {
     //qDebug("event: %d", e->type());
@@ -474,7 +594,7 @@ void VideoFrameExtractor::extract()
     }
 #endif
 #if ASYNC_TASK
-    class ExtractTask : public QRunnable {
+    class ExtractTask : public ExtractThread::Task {
     public:
         ExtractTask(VideoFrameExtractor *e, qint64 t)
             : extractor(e)
@@ -495,9 +615,208 @@ void VideoFrameExtractor::extract()
 #endif //ASYNC_EVENT
 }
 
+void VideoFrameExtractor::extractBatch(const QList<qint64> &positions, const QSize &size)
+{
+    DPTR_D(VideoFrameExtractor);
+    const int id = d.batch_id.fetchAndAddOrdered(1) + 1;
+    if (!d.async) {
+        extractBatchInternal(positions, size, id);
+        return;
+    }
+    class ExtractBatchTask : public ExtractThread::Task {
+    public:
+        ExtractBatchTask(VideoFrameExtractor *e, const QList<qint64>& t, const QSize& s, int i)
+            : extractor(e)
+            , positions(t)
+            , size(s)
+            , id(i)
+        {}
+        void run() {
+            extractor->extractBatchInternal(positions, size, id);
+        }
+        // every extractBatch() call ends with batchFinished()
+        void cancel() {
+            emit extractor->batchFinished();
+        }
+    private:
+        VideoFrameExtractor *extractor;
+        QList<qint64> positions;
+        QSize size;
+        int id;
+    };
+    d.thread.addTask(new ExtractBatchTask(this, positions, size, id));
+}
+
+qint64 VideoFrameExtractorPrivate::extractBatch(VideoFrameExtractor *q, AVDemuxer &demuxer, VideoDecoder *decoder, const QList<qint64> &positions, const QSize &size, qint64 gop, int id)
+{
+    const int range = precision;
+    const qint64 t0 = demuxer.startTime();
+    const int vstream = demuxer.videoStream();
+    QVariantHash *dec_opt = 0;
+    VideoFrame frame; // the latest decoded frame. frames before it are older than any remaining position - range
+    qint64 frame_pts = -1;
+    qint64 read_pts = -1; // pts of the last packet sent to decoder. < 0: seek is required
+    qint64 key_pts = -1;
+    gop = qMax<qint64>(gop, range); // the max key frame interval seen. forward decoding is cheaper than seek in 1 gop
+    bool wait_key = true;
+    bool eof = false;
+    foreach (const qint64 pos, positions) {
+        if (atomic_load_relaxed(batch_id) != id)
+            break;
+        qint64 value = pos;
+        if (value < t0)
+            value += t0;
+        // the frame decoded for a previous position can be reused. out of range frames are not used, like extractInPrecision()
+        if (frame.isValid() && frame_pts >= value - range) {
+            if (frame_pts <= value + range)
+                emitBatchFrame(q, frame, size, pos);
+            continue;
+        }
+        if (eof)
+            break;
+        if (read_pts < 0 || value - read_pts > gop) {
+            demuxer.seek(value);
+            decoder->flush(); // drop old frames
+            frame = VideoFrame();
+            frame_pts = read_pts = key_pts = -1;
+            wait_key = true;
+        }
+        while (atomic_load_relaxed(batch_id) == id) {
+            if (demuxer.atEnd()) {
+                eof = true;
+                break;
+            }
+            if (!demuxer.readFrame())
+                continue;
+            if (demuxer.stream() != vstream)
+                continue;
+            const Packet pkt = demuxer.packet();
+            if (!pkt.isValid())
+                continue;
+            const qint64 t = pkt.pts*1000.0;
+            if (pkt.hasKeyFrame) {
+                if (key_pts >= 0 && t > key_pts)
+                    gop = qMax(gop, t - key_pts);
+                key_pts = t;
+                wait_key = false;
+            } else if (wait_key) {
+                continue;
+            }
+            read_pts = t;
+            QVariantHash *dec_opt_old = dec_opt;
+            if (t < value - range)
+                dec_opt = &dec_opt_framedrop;
+            else
+                dec_opt = &dec_opt_normal;
+            if (dec_opt != dec_opt_old)
+                decoder->setOptions(*dec_opt);
+            if (!decoder->decode(pkt)) {
+                qWarning("VideoFrameExtractor: decode failed @%lld", t);
+                continue;
+            }
+            const VideoFrame f = decoder->frame();
+            if (!f.isValid())
+                continue;
+            frame = f;
+            frame_pts = frame.timestamp()*1000.0;
+            if (frame_pts >= value - range)
+                break;
+        }
+        if (frame.isValid() && frame_pts >= value - range && frame_pts <= value + range)
+            emitBatchFrame(q, frame, size, pos);
+    }
+    if (dec_opt != &dec_opt_normal)
+        decoder->setOptions(dec_opt_normal);
+    return gop;
+}
+
+void VideoFrameExtractor::extractBatchInternal(QList<qint64> positions, const QSize &size, int id)
+{
+    DPTR_D(VideoFrameExtractor);
+    qSort(positions);
+    for (int i = positions.size() - 1; i > 0; --i) {
+        if (positions.at(i) == positions.at(i-1))
+            positions.removeAt(i);
+    }
+    // frames in cache are emitted without opening the decoder
+    QList<qint64> uncached;
+    foreach (const qint64 pos, positions) {
+        const VideoFrame frame(ThumbnailCache::instance().find(d.source, pos, precision(), size));
+        if (frame.isValid())
+            emit batchFrameExtracted(frame, pos);
+        else
+            uncached.append(pos);
+    }
+    positions = uncached;
+    if (positions.isEmpty()) {
+        emit batchFinished();
+        return;
+    }
+    const int precision_old = precision();
+    if (!d.checkAndOpen()) {
+        emit error();
+        emit batchFinished();
+        return;
+    }
+    if (precision_old != precision())
+        emit precisionChanged();
+    const int nb_workers = d.nb_workers > 0 ? d.nb_workers : QThread::idealThreadCount();
+    if (nb_workers <= 1 || positions.size() < 2) {
+        // extractInPrecision() always seeks, so nothing to restore
+        d.gop = d.extractBatch(this, d.demuxer, d.decoder.data(), positions, size, d.gop, id);
+        emit batchFinished();
+        return;
+    }
+    const QList<QList<qint64> > parts = d.partition(positions, nb_workers, qMax<qint64>(d.gop, precision()));
+    class WorkerTask : public QRunnable {
+    public:
+        WorkerTask(VideoFrameExtractor *e, VideoFrameExtractorPrivate *p, ExtractWorker *w, const QList<qint64>& t, const QSize& s, int i)
+            : extractor(e)
+            , d(p)
+            , worker(w)
+            , positions(t)
+            , size(s)
+            , id(i)
+        {}
+        void run() {
+            worker->gop = d->extractBatch(extractor, worker->demuxer, worker->decoder.data(), positions, size, worker->gop, id);
+        }
+    private:
+        VideoFrameExtractor *extractor;
+        VideoFrameExtractorPrivate *d;
+        ExtractWorker *worker;
+        QList<qint64> positions;
+        QSize size;
+        int id;
+    };
+    d.pool.setMaxThreadCount(parts.size());
+    for (int i = 0; i < parts.size(); ++i) {
+        if (d.workers.size() <= i)
+            d.workers.append(new ExtractWorker());
+        ExtractWorker *w = d.workers.at(i);
+        if (!d.openWorker(w)) {
+            qWarning("VideoFrameExtractor: failed to open worker %d", i);
+            continue;
+        }
+        w->gop = d.gop;
+        d.pool.start(new WorkerTask(this, &d, w, parts.at(i), size, id));
+    }
+    d.pool.waitForDone();
+    for (int i = 0; i < parts.size(); ++i)
+        d.gop = qMax(d.gop, d.workers.at(i)->gop);
+    emit batchFinished();
+}
+
 void VideoFrameExtractor::extractInternal(qint64 pos)
 {
     DPTR_D(VideoFrameExtractor);
+    const VideoFrame cached(ThumbnailCache::instance().find(d.source, pos, precision()));
+    if (cached.isValid()) {
+        d.frame = cached;
+        d.extracted = true;
+        emit frameExtracted(d.frame);
+        return;
+    }
     int precision_old = precision();
     if (!d.checkAndOpen()) {
         emit error();
@@ -512,6 +831,7 @@ void VideoFrameExtractor::extractInternal(qint64 pos)
         emit error();
         return;
     }
+    ThumbnailCache::instance().insert(d.source, pos, precision(), QSize(), d.frame);
     emit frameExtracted(d.frame);
 }
 
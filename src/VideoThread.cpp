@@ -30,12 +30,63 @@
 #include "QtAV/Filter.h"
 #include "QtAV/FilterContext.h"
 #include "output/OutputSet.h"
+#include "DecodeScheduler.h"
+#include "FrameDropController.h"
+#include "StageTimer.h"
 #include "QtAV/private/AVCompat.h"
+#include "utils/Tracer.h"
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QFileInfo>
+#include <QtCore/QRunnable>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThreadPool>
 #include "utils/Logger.h"
 
 namespace QtAV {
 
+// converts a frame for a group of renderers in deliverVideoFrame()
+class ConvertTask : public QRunnable
+{
+public:
+    ConvertTask(VideoFrameConverter *conv, const VideoFrame& frame, VideoFormat::PixelFormat fmt, VideoFrame *result, QSemaphore *done)
+        : m_conv(conv), m_frame(frame), m_fmt(fmt), m_result(result), m_done(done)
+    {}
+    void run() Q_DECL_OVERRIDE {
+        *m_result = m_conv->convert(m_frame, m_fmt);
+        m_done->release();
+    }
+private:
+    VideoFrameConverter *m_conv;
+    VideoFrame m_frame;
+    VideoFormat::PixelFormat m_fmt;
+    VideoFrame *m_result;
+    QSemaphore *m_done;
+};
+
+// a decoded frame waiting for the filter/convert stage
+struct StagedFrame
+{
+    StagedFrame() : seeking(false), end(false) {}
+    VideoFrame frame;
+    bool seeking;
+    bool end; // no more frames. the stage thread exits
+};
+
+/*
+ * Filters, converts and presents the frames queued by the decoding loop in VideoThread::run(), so decoding
+ * the next frame overlaps with it. Enabled by setPipelineDepth(n), n is the max number of queued frames.
+ * Keep n small for hw decoders, a queued frame may hold a decoder surface.
+ */
+class VideoStageThread : public QThread
+{
+public:
+    VideoStageThread(VideoThread *vt) : QThread(), m_vt(vt) {}
+    void run() Q_DECL_OVERRIDE;
+private:
+    VideoThread *m_vt;
+};
+
 class VideoThreadPrivate : public AVThreadPrivate
 {
 public:
@@ -44,20 +95,48 @@ public:
       , force_fps(-1)
       , force_dt(-1)
       , last_deliver_time(0)
+      , start_time(0)
+      , v_a(0)
+      , pipeline_depth(0)
       , capture(0)
       , filter_context(0)
     {
+        eq[0] = eq[1] = eq[2] = 0;
     }
     ~VideoThreadPrivate() {
         //not neccesary context is managed by filters.
         filter_context = 0;
+        qDeleteAll(group_conv);
+    }
+    // out of range value means unchanged. see VideoFrameConverter::setEq()
+    void setEq(int b, int c, int s) {
+        QMutexLocker lock(&conv_mutex);
+        Q_UNUSED(lock);
+        conv.setEq(b, c, s);
+        const int v[] = { b, c, s };
+        for (int i = 0; i < 3; ++i) {
+            if (v[i] >= -100 && v[i] <= 100)
+                eq[i] = v[i];
+        }
     }
 
-    VideoFrameConverter conv;
+    VideoFrameConverter conv; // the first format group in prepareVideoFrame()
+    QList<VideoFrameConverter*> group_conv; // the other groups, converted in conv_pool
+    int eq[3];
+    QMutex conv_mutex; // eq can be changed by the decoding thread while the stage thread is converting
+    QThreadPool conv_pool;
+    BlockingQueue<StagedFrame> stage_queue;
+    FrameDropController drop_ctl;
+    // renderers grouped by format and the frames converted for them, waiting to be delivered
+    QList<QList<VideoRenderer*> > present_groups;
+    QVector<VideoFrame> present_frames;
     qreal force_fps; // <=0: ignore
     // not const.
     int force_dt; //unit: ms. force_fps = 1/force_dt.  <=0: ignore
     qint64 last_deliver_time;
+    qint64 start_time;
+    qreal v_a; // video - audio offset measured when presenting. only used by the presenting thread
+    int pipeline_depth; // max frames queued for the stage thread. 0: no stage thread
 
     double pts; //current decoded pts. for capture. TODO: remove
     VideoCapture *capture;
@@ -65,6 +144,20 @@ public:
     VideoFrame displayed_frame;
 };
 
+void VideoStageThread::run()
+{
+    VideoThreadPrivate &d = m_vt->d_func();
+    while (true) {
+        const StagedFrame staged(d.stage_queue.take());
+        if (staged.end)
+            break;
+        if (!staged.frame.isValid()) // nothing taken
+            continue;
+        VideoFrame frame(staged.frame);
+        m_vt->presentFrame(frame, staged.seeking, true);
+    }
+}
+
 VideoThread::VideoThread(QObject *parent) :
     AVThread(*new VideoThreadPrivate(), parent)
 {
@@ -98,22 +191,7 @@ void VideoThread::addCaptureTask()
 {
     if (!isRunning())
         return;
-    class CaptureTask : public QRunnable {
-    public:
-        CaptureTask(VideoThread *vt) : vthread(vt) {}
-        void run() {
-            VideoCapture *vc = vthread->videoCapture();
-            if (!vc)
-                return;
-            VideoFrame frame(vthread->displayedFrame());
-            //vthread->applyFilters(frame);
-            vc->setVideoFrame(frame);
-            vc->start();
-        }
-    private:
-        VideoThread *vthread;
-    };
-    scheduleTask(new CaptureTask(this));
+    addCommand(CommandCapture);
 }
 
 VideoFrame VideoThread::displayedFrame() const
@@ -132,6 +210,16 @@ void VideoThread::setFrameRate(qreal value)
     }
 }
 
+void VideoThread::setPipelineDepth(int value)
+{
+    d_func().pipeline_depth = qMax(0, value);
+}
+
+int VideoThread::pipelineDepth() const
+{
+    return d_func().pipeline_depth;
+}
+
 void VideoThread::setBrightness(int val)
 {
     setEQ(val, 101, 101);
@@ -149,39 +237,44 @@ void VideoThread::setSaturation(int val)
 
 void VideoThread::setEQ(int b, int c, int s)
 {
-    class EQTask : public QRunnable {
-    public:
-        EQTask(VideoFrameConverter *c)
-            : brightness(0)
-            , contrast(0)
-            , saturation(0)
-            , conv(c)
-        {
-            //qDebug("EQTask tid=%p", QThread::currentThread());
-        }
-        void run() {
-            conv->setEq(brightness, contrast, saturation);
-        }
-        int brightness, contrast, saturation;
-    private:
-        VideoFrameConverter *conv;
-    };
+    if (!isRunning()) {
+        d_func().setEq(b, c, s);
+        return;
+    }
+    // out of range value means unchanged. see VideoFrameConverter::setEq()
+    const int eq[] = { b, c, s };
+    for (int i = 0; i < 3; ++i) {
+        if (eq[i] >= -100 && eq[i] <= 100)
+            postCommand(CommandBrightness + i, eq[i]);
+    }
+}
+
+void VideoThread::processCommands(int pending)
+{
     DPTR_D(VideoThread);
-    EQTask *task = new EQTask(&d.conv);
-    task->brightness = b;
-    task->contrast = c;
-    task->saturation = s;
-    if (isRunning()) {
-        scheduleTask(task);
-    } else {
-        task->run();
-        delete task;
+    const int eq_mask = (1 << CommandBrightness) | (1 << CommandContrast) | (1 << CommandSaturation);
+    if (pending & eq_mask) {
+        // kNoValue is out of range: unchanged
+        d.setEq(d.commands.take(CommandBrightness), d.commands.take(CommandContrast), d.commands.take(CommandSaturation));
     }
+    if (pending & (1 << CommandCapture)) {
+        int n = d.commands.take(CommandCapture);
+        VideoCapture *vc = videoCapture();
+        if (vc && n != d.commands.kNoValue) {
+            const VideoFrame frame(displayedFrame());
+            for (; n > 0; --n) {
+                vc->setVideoFrame(frame);
+                vc->start();
+            }
+        }
+    }
+    AVThread::processCommands(pending);
 }
 
 void VideoThread::applyFilters(VideoFrame &frame)
 {
     DPTR_D(VideoThread);
+    TraceScope trace("applyFilters", frame.timestamp());
     QMutexLocker locker(&d.mutex);
     Q_UNUSED(locker);
     if (!d.filters.isEmpty()) {
@@ -196,55 +289,218 @@ void VideoThread::applyFilters(VideoFrame &frame)
     }
 }
 
-// filters on vo will not change video frame, so it's safe to protect frame only in every individual vo
-bool VideoThread::deliverVideoFrame(VideoFrame &frame)
+void VideoThread::prepareVideoFrame(const VideoFrame &frame)
 {
     DPTR_D(VideoThread);
-    /*
-     * TODO: video renderers sorted by preferredPixelFormat() and convert in AVOutputSet.
-     * Convert only once for the renderers has the same preferredPixelFormat().
-     */
+    TraceScope trace("convert", frame.timestamp());
     d.outputSet->lock();
-    QList<AVOutput *> outputs = d.outputSet->outputs();
-    if (outputs.size() > 1) { //FIXME!
-        VideoFrame outFrame(d.conv.convert(frame, VideoFormat::Format_RGB32));
-        if (!outFrame.isValid()) {
-            /*
-             * use VideoFormat::Format_User to deliver user defined frame
-             * renderer may update background but no frame to graw, so flickers
-             * may crash for some renderer(e.g. d2d) without validate and render an invalid frame
-             */
-            d.outputSet->unlock();
-            return false;
+    QMutexLocker conv_lock(&d.conv_mutex);
+    Q_UNUSED(conv_lock);
+    // group the renderers by the format they need, and convert only once for each group
+    QList<VideoFormat::PixelFormat> formats;
+    QList<QList<VideoRenderer*> > &groups = d.present_groups;
+    groups.clear();
+    foreach (AVOutput *output, d.outputSet->outputs()) {
+        if (!output->isAvailable())
+            continue;
+        VideoRenderer *vo = static_cast<VideoRenderer*>(output);
+        VideoFormat::PixelFormat fmt = frame.pixelFormat();
+        if (!vo->isSupported(fmt) || (vo->isPreferredPixelFormatForced() && vo->preferredPixelFormat() != fmt))
+            fmt = vo->preferredPixelFormat();
+        const int i = formats.indexOf(fmt);
+        if (i >= 0) {
+            groups[i].append(vo);
+            continue;
         }
-        frame = outFrame;
-    } else {
-        VideoRenderer *vo = 0;
-        if (!outputs.isEmpty())
-            vo = static_cast<VideoRenderer*>(outputs.first());
-        if (vo && (!vo->isSupported(frame.pixelFormat())
-                || (vo->isPreferredPixelFormatForced() && vo->preferredPixelFormat() != frame.pixelFormat())
-                )) {
-            VideoFrame outFrame(d.conv.convert(frame, vo->preferredPixelFormat()));
-            if (!outFrame.isValid()) {
-                /*
-                 * use VideoFormat::Format_User to deliver user defined frame
-                 * renderer may update background but no frame to graw, so flickers
-                 * may crash for some renderer(e.g. d2d) without validate and render an invalid frame
-                 */
-                d.outputSet->unlock();
-                return false;
-            }
-            frame = outFrame;
+        formats.append(fmt);
+        groups.append(QList<VideoRenderer*>() << vo);
+    }
+    QVector<VideoFrame> &frames = d.present_frames;
+    frames = QVector<VideoFrame>(formats.size());
+    // the first group is converted in this thread, the others concurrently. hw surfaces are copied one by one
+    const bool host = !!frame.constBits(0);
+    QSemaphore done;
+    int pending = 0;
+    for (int i = 0; i < formats.size(); ++i) {
+        if (formats.at(i) == frame.pixelFormat()) {
+            frames[i] = frame;
+            continue;
+        }
+        if (i == 0)
+            continue;
+        while (d.group_conv.size() < i)
+            d.group_conv.append(new VideoFrameConverter());
+        VideoFrameConverter *conv = d.group_conv.at(i - 1);
+        conv->setEq(d.eq[0], d.eq[1], d.eq[2]);
+        if (host) {
+            d.conv_pool.start(new ConvertTask(conv, frame, formats.at(i), &frames[i], &done));
+            ++pending;
+        } else {
+            frames[i] = conv->convert(frame, formats.at(i));
         }
     }
-    d.outputSet->sendVideoFrame(frame); //TODO: group by format, convert group by group
+    if (!formats.isEmpty() && formats.first() != frame.pixelFormat())
+        frames[0] = d.conv.convert(frame, formats.first());
+    done.acquire(pending);
+    conv_lock.unlock();
     d.outputSet->unlock();
+}
 
+// filters on vo will not change video frame, so it's safe to protect frame only in every individual vo
+bool VideoThread::deliverVideoFrame(VideoFrame &frame)
+{
+    DPTR_D(VideoThread);
+    TraceScope trace("deliverVideoFrame", frame.timestamp());
+    d.outputSet->lock();
+    // the outputs may be changed after prepareVideoFrame(), e.g. while waiting for the presentation time
+    const QList<AVOutput*> outputs(d.outputSet->outputs());
+    bool delivered = d.present_groups.isEmpty();
+    for (int i = 0; i < d.present_groups.size(); ++i) {
+        const VideoFrame &f = d.present_frames.at(i);
+        /*
+         * use VideoFormat::Format_User to deliver user defined frame
+         * renderer may update background but no frame to graw, so flickers
+         * may crash for some renderer(e.g. d2d) without validate and render an invalid frame
+         */
+        if (!f.isValid())
+            continue;
+        foreach (VideoRenderer *vo, d.present_groups.at(i)) {
+            if (!outputs.contains(vo) || !vo->isAvailable())
+                continue;
+            vo->receive(f);
+        }
+        if (!delivered)
+            frame = f;
+        delivered = true;
+    }
+    d.outputSet->unlock();
+    // do not hold the frames until the next one
+    d.present_groups.clear();
+    d.present_frames.clear();
+    if (!delivered)
+        return false;
     emit frameDelivered();
     return true;
 }
 
+bool VideoThread::presentFrame(VideoFrame &frame, bool seeking, bool staged)
+{
+    DPTR_D(VideoThread);
+    const qreal pts = frame.timestamp();
+    QElapsedTimer cost_timer; // filter and render cost for d.drop_ctl. waiting is not counted
+    cost_timer.start();
+    applyFilters(frame);
+    d.drop_ctl.addFilterCost(qreal(cost_timer.nsecsElapsed())/1e9);
+    StageTimer::add(d.statistics, Statistics::Filter, cost_timer.nsecsElapsed());
+
+    //while can pause, processNextTask, not call outset.puase which is deperecated
+    // woken up by output resume, new task or stop. no polling
+    while (d.outputSet->canPauseThread() && !d.stop) {
+        d.outputSet->pauseThread();
+        if (!staged)
+            processNextTask();
+    }
+    if (d.force_dt > 0) {
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        const qint64 delta = qint64(d.force_dt) - (now - d.last_deliver_time);
+        if (frame.timestamp() <= 0) {
+            // TODO: what if seek happens during playback?
+            const int msecs_started(now + qMax(0LL, delta) - d.start_time);
+            frame.setTimestamp(qreal(msecs_started)/1000.0);
+            d.statistics->video.current_time = QTime(0, 0, 0).addMSecs(msecs_started); //TODO: is it expensive?
+            clock()->updateValue(frame.timestamp());
+        }
+        if (delta > 0LL) { // limit up bound?
+            //qDebug() << "wait msecs: " << delta;
+            if (staged)
+                waitToPresent((ulong)delta, pts);
+            else
+                waitAndCheck((ulong)delta, pts);
+        }
+        const qreal real_dt = 1000.0/d.statistics->video_only.currentDisplayFPS();
+        // assume max is 120fps, 1 frame error. TODO: kEPS depends on video original fps
+        static const qreal kEPS = 120.0; // error msecs per second
+        if (real_dt > qreal(d.force_dt)) { // real fps < wanted fps. reduce wait time
+            if (d.force_fps * qreal(d.force_dt) >= 1000.0 - kEPS)
+                --d.force_dt;
+        } else { // increase wait time
+            if (d.force_fps * qreal(d.force_dt) <= 1000.0 + kEPS)
+                ++d.force_dt;
+        }
+    }
+    cost_timer.restart();
+    prepareVideoFrame(frame);
+    qint64 render_ns = cost_timer.nsecsElapsed();
+    StageTimer::add(d.statistics, Statistics::Convert, render_ns);
+    if (staged && d.force_dt <= 0) { //FIXME: may block a while when seeking
+        // decoding did not wait for the clock. the converted frame is released at its pts
+        const qreal display_wait = pts - clock()->value() + d.v_a;
+        if (!seeking && display_wait > 0.0) {
+            // wait to pts reaches. TODO: count rendering time
+            //qDebug("wait %f to display for pts %f-%f", display_wait, pts, clock()->value());
+            if (display_wait < 1.0)
+                waitToPresent(display_wait*1000UL, pts);
+        }
+    }
+    if (!seeking && d.force_dt <= 0)
+        d.statistics->video_only.framePresented(d.clock->value() - pts);
+    if (staged)
+        d.clock->updateVideoTime(pts);
+    // no return even if d.stop is true. ensure frame is displayed. otherwise playing an image may be failed to display
+    cost_timer.restart();
+    const bool delivered = deliverVideoFrame(frame);
+    StageTimer::add(d.statistics, Statistics::Deliver, cost_timer.nsecsElapsed());
+    render_ns += cost_timer.nsecsElapsed();
+    d.drop_ctl.addRenderCost(qreal(render_ns)/1e9);
+    if (!delivered)
+        return false;
+    d.last_deliver_time = d.statistics->video_only.frameDisplayed(frame.timestamp());
+    // TODO: store original frame. now the frame is filtered and maybe converted to renderer perferred format
+    d.displayed_frame = frame;
+    if (d.clock->clockType() == AVClock::AudioClock) {
+        qreal &v_a = d.v_a;
+        const qreal v_a_ = frame.timestamp() - d.clock->value();
+        if (!qFuzzyIsNull(v_a_)) {
+            if (v_a_ < -0.1) {
+                if (v_a <= v_a_)
+                    v_a += -0.01;
+                else
+                    v_a = (v_a_ +v_a)*0.5;
+            } else if (v_a_ < -0.002) {
+                v_a += -0.001;
+            } else if (v_a_ < 0.002) {
+            } else if (v_a_ < 0.1) {
+                v_a += 0.001;
+            } else {
+                if (v_a >= v_a_)
+                    v_a += 0.01;
+                else
+                    v_a = (v_a_ +v_a)*0.5;
+            }
+
+            if (v_a < -2 || v_a > 2)
+               v_a /= 2.0;
+        }
+        //qDebug("v_a:%.4f, v_a_: %.4f", v_a, v_a_);
+    }
+    return true;
+}
+
+void VideoThread::waitToPresent(ulong value, qreal pts)
+{
+    DPTR_D(VideoThread);
+    ulong us = value * 1000UL;
+    static const ulong kWaitSlice = 20 * 1000UL; //20ms
+    while (us > kWaitSlice && !d.stop) {
+        usleep(kWaitSlice);
+        us -= kWaitSlice;
+        // the same as the initial wait in presentFrame()
+        us = qMin(us, ulong(qMax<qreal>(0, pts - d.clock->value() + d.v_a)*1000000.0));
+    }
+    if (us > 0 && !d.stop)
+        usleep(us);
+}
+
 //TODO: if output is null or dummy, the use duration to wait
 void VideoThread::run()
 {
@@ -267,34 +523,45 @@ void VideoThread::run()
      * be a key frame for hardware decoding. otherwise may crash
      */
     bool wait_key_frame = false;
-    int nb_dec_slow = 0;
     int nb_dec_fast = 0;
 
     qint32 seek_count = 0; // wm4 says: 1st seek can not use frame drop for decoder
-    // TODO: kNbSlowSkip depends on video fps, ensure slow time <= 2s
-    /* kNbSlowSkip: if video frame slow count >= kNbSlowSkip, skip decoding all frames until next keyframe reaches.
-     * if slow count > kNbSlowSkip/2, skip rendering every 3 or 6 frames
-     */
-    const int kNbSlowSkip = 120; // about 1s for 120fps video
-    // kNbSlowFrameDrop: if video frame slow count > kNbSlowFrameDrop, skip decoding nonref frames. only some of ffmpeg based decoders support it.
-    const int kNbSlowFrameDrop = 10;
     bool sync_audio = d.clock->clockType() == AVClock::AudioClock;
     bool sync_video = d.clock->clockType() == AVClock::VideoClock; // no frame drop
-    const qint64 start_time = QDateTime::currentMSecsSinceEpoch();
-    bool skip_render = false; // keep true if decoded frame does not reach desired time
-    qreal v_a = 0;
+    d.start_time = QDateTime::currentMSecsSinceEpoch();
+    d.v_a = 0;
     const char* pkt_data = NULL; // workaround for libav9 decode fail but error code >= 0
+    // pipelineDepth() n > 0: filter, convert and present in a stage thread, at most n decoded frames are queued.
+    // decoding does not wait for the clock then, the stage waits before presenting
+    QScopedPointer<VideoStageThread> stage;
+    const int stage_size = d.pipeline_depth;
+    if (stage_size > 0) {
+        d.stage_queue.clear();
+        d.stage_queue.setCapacity(stage_size);
+        d.stage_queue.setThreshold(1);
+        d.stage_queue.blockFull(true);
+        stage.reset(new VideoStageThread(this));
+        stage->start();
+    }
+    // decides how to catch up when video is late. skip decoder options are not supported by all decoders
+    d.drop_ctl.reset();
+    d.drop_ctl.setFrameRate(d.statistics->video.frame_rate);
+    d.drop_ctl.setPipelined(!stage.isNull());
+    FrameDropController::Action drop = FrameDropController::Render;
+    QElapsedTimer dec_timer;
     while (true) {
         processNextTask();
         //TODO: why put it at the end of loop then playNextFrame() not work?
-        //processNextTask tryPause(timeout) and  and continue outter loop
+        // tryPause() returns false if a new task is scheduled while paused, then process it and continue outter loop
         if (tryPause()) { //DO NOT continue, or playNextFrame() will fail
 
         } else {
             if (isPaused())
-                continue; //timeout. process pending tasks
+                continue; //new task. process pending tasks
         }
         if(!pkt.isValid() && !pkt.isEOF()) { // can't seek back if eof packet is read
+            StageTimer::addQueueDepth(d.statistics, Statistics::VideoPacketQueue, d.packets.size());
+            StageTimer wait_timer(d.statistics, Statistics::VideoQueueWait);
             pkt = d.packets.take(); //wait to dequeue
         }
         if (pkt.isEOF()) {
@@ -312,6 +579,8 @@ void VideoThread::run()
                 qDebug("Invalid packet! flush video codec context!!!!!!!!!! video packet queue size: %d", d.packets.size());  
                 d.dec->flush(); //d.dec instead of dec because d.dec maybe changed in processNextTask() but dec is not
                 d.render_pts0 = pkt.pts;
+                if (stage)
+                    d.stage_queue.clear(); // frames before seeking
                 continue;
             }
         }
@@ -327,7 +596,7 @@ void VideoThread::run()
         }
         const qreal dts = pkt.dts; //FIXME: pts and dts
         // TODO: delta ref time
-        qreal diff = dts - d.clock->value() + v_a;
+        qreal diff = dts - d.clock->value() + (stage ? 0 : d.v_a);
         if (pkt.isEOF())
             diff = qMin<qreal>(1.0, qMax<qreal>(d.delay, 1.0/d.statistics->video_only.currentDisplayFPS()));
         if (diff < 0 && sync_video)
@@ -338,51 +607,26 @@ void VideoThread::run()
             nb_dec_fast /= 2;
         }
         bool seeking = d.render_pts0 >= 0.0;
-        if (seeking) {
-            nb_dec_slow = 0;
+        if (seeking)
             nb_dec_fast = 0;
-        }
         //qDebug("nb_fast: %d. diff: %f, dts: %f, clock: %f", nb_dec_fast, diff, dts, clock()->value());
-        if (d.delay < -0.5 && d.delay > diff) {
-            if (!seeking) {
-                // ensure video will not later than 2s
-                if (diff < -2 || (nb_dec_slow > kNbSlowSkip && diff < -1.0 && !pkt.hasKeyFrame)) {
-                    qDebug("video is too slow. skip decoding until next key frame.");
-                    // TODO: when to reset so frame drop flag can reset?
-                    nb_dec_slow = 0;
-                    wait_key_frame = true;
-                    pkt = Packet();
-                    // TODO: use discard flag
-                    continue;
-                } else {
-                    nb_dec_slow++;
-                    qDebug("frame slow count: %d. v-a: %.3f", nb_dec_slow, diff);
-                }
-            }
-        } else {
-            if (nb_dec_slow > kNbSlowFrameDrop) {
-                qDebug("decrease 1 slow frame: %d", nb_dec_slow);
-                nb_dec_slow = qMax(0, nb_dec_slow-1); // nb_dec_slow < kNbSlowFrameDrop will reset decoder frame drop flag
-            }
-        }
         // can not change d.delay after! we need it to comapre to next loop
         d.delay = diff;
         /*
          *after seeking forward, a packet may be the old, v packet may be
          *the new packet, then the d.delay is very large, omit it.
         */
-        if (pkt.pts < d.render_pts0) // skip rendering until decoded frame reaches desired pts
-            skip_render = true;
         if (seeking)
             diff = 0; // TODO: here?
         if (!sync_audio && diff > 0) {
             // wait to dts reaches
-            if (d.force_fps < 0.0 && diff < 2.0)
+            if (!stage && d.force_fps < 0.0 && diff < 2.0)
                 waitAndCheck(diff*1000UL, dts); // TODO: count decoding and filter time
             diff = 0; // TODO: can not change delay!
         }
         // update here after wait
-        d.clock->updateVideoTime(dts); // FIXME: dts or pts?
+        if (!stage)
+            d.clock->updateVideoTime(dts); // FIXME: dts or pts?
         if (qAbs(diff) < 0.5) {
             if (diff < -kSyncThreshold) { //Speed up. drop frame?
                 //continue;
@@ -390,30 +634,18 @@ void VideoThread::run()
         } else if (!seeking) { //when to drop off?
             qDebug("delay %fs @%fs", diff, d.clock->value());
             if (diff < 0) {
-                if (!pkt.hasKeyFrame) {
-                    // if continue without decoding, we must wait to the next key frame, then we may skip to many frames
-                    //wait_key_frame = true;
-                    //pkt = Packet();
-                    //continue;
-                }
-                skip_render = !pkt.hasKeyFrame;
-                if (skip_render) {
-                    if (nb_dec_slow < kNbSlowSkip/2) {
-                        skip_render = false;
-                    } else if (nb_dec_slow < kNbSlowSkip) {
-                        const int skip_every = kNbSlowSkip >= 60 ? 2 : 4;
-                        skip_render = nb_dec_slow % skip_every; // skip rendering every 3 frames
-                    }
-                }
+                // late. frames are dropped by d.drop_ctl below
             } else {
                 const double s = qMin<qreal>(0.01*(nb_dec_fast>>1), diff);
-                qWarning("video too fast!!! sleep %.2f s, nb fast: %d, v_a: %.4f", s, nb_dec_fast, v_a);
-                waitAndCheck(s*1000UL, dts);
+                if (!stage) {
+                    qWarning("video too fast!!! sleep %.2f s, nb fast: %d, v_a: %.4f", s, nb_dec_fast, d.v_a);
+                    waitAndCheck(s*1000UL, dts);
+                }
                 diff = 0;
             }
         }
         //audio packet not cleaned up?
-        if (diff > 0 && diff < 1.0 && !seeking) {
+        if (diff > 0 && diff < 1.0 && !seeking && !stage) {
             // can not change d.delay here! we need it to comapre to next loop
             waitAndCheck(diff*1000UL, dts);
         }
@@ -425,23 +657,32 @@ void VideoThread::run()
             }
             wait_key_frame = false;
         }
+        // the cheapest way to catch up with the clock, from the measured decode, filter and render cost
+        drop = FrameDropController::Render;
+        if (!seeking && !sync_video && !pkt.isEOF()) {
+            drop = d.drop_ctl.decide(-d.delay, pkt.hasKeyFrame);
+            if (drop == FrameDropController::WaitKeyFrame) {
+                qDebug("video is too slow. skip decoding until next key frame. v-a: %.3f", d.delay);
+                wait_key_frame = true;
+                pkt = Packet();
+                continue;
+            }
+        }
         QVariantHash *dec_opt_old = dec_opt;
         if (!seeking) { // MAYBE not seeking
-            if (nb_dec_slow < kNbSlowFrameDrop) {
-                if (dec_opt == &d.dec_opt_framedrop) {
-                    qDebug("frame drop normal. nb_dec_slow: %d, line: %d", nb_dec_slow, __LINE__);
-                    dec_opt = &d.dec_opt_normal;
-                }
-            } else {
-                if (dec_opt == &d.dec_opt_normal) {
-                    qDebug("frame drop noref. nb_dec_slow: %d, line: %d", nb_dec_slow, __LINE__);
-                    dec_opt = &d.dec_opt_framedrop;
-                }
+            QVariantHash *opt = &d.dec_opt_normal;
+            if (d.drop_ctl.decodeMode() == FrameDropController::DecodeNoLoopFilter)
+                opt = &d.dec_opt_skiplf;
+            else if (d.drop_ctl.decodeMode() == FrameDropController::DecodeRefOnly)
+                opt = &d.dec_opt_framedrop;
+            if (dec_opt != opt) {
+                qDebug("decode mode: %d. v-a: %.3f, line: %d", d.drop_ctl.decodeMode(), d.delay, __LINE__);
+                dec_opt = opt;
             }
         } else { // seeking
             if (seek_count > 0) {
-                if (dec_opt == &d.dec_opt_normal) {
-                    qDebug("seeking... frame drop noref. nb_dec_slow: %d, line: %d", nb_dec_slow, __LINE__);
+                if (dec_opt != &d.dec_opt_framedrop) {
+                    qDebug("seeking... frame drop noref. line: %d", __LINE__);
                     dec_opt = &d.dec_opt_framedrop;
                 }
             } else {
@@ -452,6 +693,7 @@ void VideoThread::run()
         // decoder maybe changed in processNextTask(). code above MUST use d.dec but not dec
         if (dec != static_cast<VideoDecoder*>(d.dec)) {
             dec = static_cast<VideoDecoder*>(d.dec);
+            d.drop_ctl.reset();
             if (!pkt.hasKeyFrame) {
                 wait_key_frame = true;
                 continue;
@@ -460,7 +702,18 @@ void VideoThread::run()
         }
         if (dec_opt != dec_opt_old)
             dec->setOptions(*dec_opt);
-        if (!dec->decode(pkt)) {
+        // d.delay < 0: late. the latest player decodes first if decoding is shared
+        const bool dec_gated = DecodeScheduler::instance().acquire(-d.delay);
+        dec_timer.start();
+        Tracer::begin("video decode", pkt.pts);
+        const bool dec_ok = dec->decode(pkt);
+        Tracer::end("video decode");
+        if (!seeking)
+            d.drop_ctl.addDecodeCost(pkt.hasKeyFrame, qreal(dec_timer.nsecsElapsed())/1e9);
+        StageTimer::add(d.statistics, Statistics::VideoDecode, dec_timer.nsecsElapsed());
+        if (dec_gated)
+            DecodeScheduler::instance().release();
+        if (!dec_ok) {
             qWarning("Decode video failed. undecoded: %d", dec->undecodedSize());
             if (pkt.isEOF()) {
                 qDebug("decode eof done");
@@ -494,6 +747,7 @@ void VideoThread::run()
                 continue;
             }
             d.render_pts0 = -1;
+            Tracer::instant("video seek finished", pts);
             Q_EMIT seekFinished(qint64(pts*1000.0));
             if (seek_count == -1)
                 seek_count = 1;
@@ -502,78 +756,26 @@ void VideoThread::run()
         }
         Q_ASSERT(d.statistics);
         d.statistics->video.current_time = QTime(0, 0, 0).addMSecs(int(pts * 1000.0)); //TODO: is it expensive?
-        applyFilters(frame);
-
-        //while can pause, processNextTask, not call outset.puase which is deperecated
-        while (d.outputSet->canPauseThread()) {
-            d.outputSet->pauseThread(100);
-            //tryPause(100);
-            processNextTask();
-        }
-        if (d.force_dt > 0) {
-            const qint64 now = QDateTime::currentMSecsSinceEpoch();
-            const qint64 delta = qint64(d.force_dt) - (now - d.last_deliver_time);
-            if (frame.timestamp() <= 0) {
-                // TODO: what if seek happens during playback?
-                const int msecs_started(now + qMax(0LL, delta) - start_time);
-                frame.setTimestamp(qreal(msecs_started)/1000.0);
-                d.statistics->video.current_time = QTime(0, 0, 0).addMSecs(msecs_started); //TODO: is it expensive?
-                clock()->updateValue(frame.timestamp());
-            }
-            if (delta > 0LL) { // limit up bound?
-                //qDebug() << "wait msecs: " << delta;
-                waitAndCheck((ulong)delta, pts);
-            }
-            const qreal real_dt = 1000.0/d.statistics->video_only.currentDisplayFPS();
-            // assume max is 120fps, 1 frame error. TODO: kEPS depends on video original fps
-            static const qreal kEPS = 120.0; // error msecs per second
-            if (real_dt > qreal(d.force_dt)) { // real fps < wanted fps. reduce wait time
-                if (d.force_fps * qreal(d.force_dt) >= 1000.0 - kEPS)
-                    --d.force_dt;
-            } else { // increase wait time
-                if (d.force_fps * qreal(d.force_dt) <= 1000.0 + kEPS)
-                    ++d.force_dt;
-            }
-        } else if (false) { //FIXME: may block a while when seeking
-            const qreal display_wait = pts - clock()->value();
-            if (!seeking && display_wait > 0.0) {
-                // wait to pts reaches. TODO: count rendering time
-                //qDebug("wait %f to display for pts %f-%f", display_wait, pts, clock()->value());
-                if (display_wait < 1.0)
-                    waitAndCheck(display_wait*1000UL, pts); // TODO: count decoding and filter time
-            }
-        }
-        // no return even if d.stop is true. ensure frame is displayed. otherwise playing an image may be failed to display
-        if (!deliverVideoFrame(frame))
+        if (drop == FrameDropController::SkipRender)
+            continue;
+        if (stage) {
+            StagedFrame staged;
+            staged.frame = frame;
+            staged.seeking = seeking;
+            StageTimer::addQueueDepth(d.statistics, Statistics::VideoFrameQueue, d.stage_queue.size());
+            d.stage_queue.put(staged); // blocks if the stage is busy with n frames
             continue;
-        d.last_deliver_time = d.statistics->video_only.frameDisplayed(frame.timestamp());
-        // TODO: store original frame. now the frame is filtered and maybe converted to renderer perferred format
-        d.displayed_frame = frame;
-        if (d.clock->clockType() == AVClock::AudioClock) {
-            const qreal v_a_ = frame.timestamp() - d.clock->value();
-            if (!qFuzzyIsNull(v_a_)) {
-                if (v_a_ < -0.1) {
-                    if (v_a <= v_a_)
-                        v_a += -0.01;
-                    else
-                        v_a = (v_a_ +v_a)*0.5;
-                } else if (v_a_ < -0.002) {
-                    v_a += -0.001;
-                } else if (v_a_ < 0.002) {
-                } else if (v_a_ < 0.1) {
-                    v_a += 0.001;
-                } else {
-                    if (v_a >= v_a_)
-                        v_a += 0.01;
-                    else
-                        v_a = (v_a_ +v_a)*0.5;
-                }
-
-                if (v_a < -2 || v_a > 2)
-                   v_a /= 2.0;
-            }
-            //qDebug("v_a:%.4f, v_a_: %.4f", v_a, v_a_);
         }
+        presentFrame(frame, seeking, false);
+    }
+    if (stage) {
+        if (d.stop)
+            d.stage_queue.clear();
+        StagedFrame end;
+        end.end = true;
+        d.stage_queue.blockFull(false);
+        d.stage_queue.put(end);
+        stage->wait(); // the rest frames are presented
     }
     d.packets.clear();
     d.outputSet->sendVideoFrame(VideoFrame()); // TODO: let user decide what to display
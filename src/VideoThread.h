@@ -35,12 +35,16 @@ class VideoThread : public AVThread
 {
     Q_OBJECT
     DPTR_DECLARE_PRIVATE(VideoThread)
+    friend class VideoStageThread;
 public:
     explicit VideoThread(QObject *parent = 0);
     VideoCapture *setVideoCapture(VideoCapture* cap); //ensure thread safe
     VideoCapture *videoCapture() const;
     VideoFrame displayedFrame() const;
     void setFrameRate(qreal value);
+    // see AVPlayer::setVideoPipelineDepth(). applied when the thread starts
+    void setPipelineDepth(int value);
+    int pipelineDepth() const;
     //virtual bool event(QEvent *event);
     void setBrightness(int val);
     void setContrast(int val);
@@ -50,9 +54,26 @@ public:
 public Q_SLOTS:
     void addCaptureTask();
 protected:
+    enum Command {
+        CommandBrightness = CommandUser, // value: -100~100
+        CommandContrast,
+        CommandSaturation,
+        CommandCapture // value: number of requests
+    };
+    void processCommands(int pending) Q_DECL_OVERRIDE;
     void applyFilters(VideoFrame& frame);
-    // deliver video frame to video renderers. frame may be converted to a suitable format for renderer
+    // convert video frame to a suitable format for each group of renderers. the results are sent by deliverVideoFrame()
+    void prepareVideoFrame(const VideoFrame &frame);
+    // deliver the prepared frames to video renderers. frame is set to the first delivered one
     bool deliverVideoFrame(VideoFrame &frame);
+    /*!
+     * \brief presentFrame
+     * Filter, convert and deliver a decoded frame, then update a/v sync state.
+     * \param staged true if called in the filter/convert stage thread instead of this thread. no task is processed then.
+     */
+    bool presentFrame(VideoFrame &frame, bool seeking, bool staged);
+    // like waitAndCheck() but never processes tasks. used by the stage thread
+    void waitToPresent(ulong value, qreal pts);
     virtual void run();
     // wait for value msec. every usleep is a small time, then process next task and get new delay
 };
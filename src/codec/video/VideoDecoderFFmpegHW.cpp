@@ -292,11 +292,12 @@ VideoFrame VideoDecoderFFmpegHW::copyToFrame(const VideoFormat& fmt, int surface
         for (int i = 0; i < nb_planes; ++i) {
             yuv_size += pitch[i]*h[i];
         }
-        // additional 15 bytes to ensure 16 bytes aligned
-        QByteArray buf(15 + yuv_size, 0);
-        const int offset_16 = (16 - ((uintptr_t)buf.data() & 0x0f)) & 0x0f;
+        // pooled buffers are aligned
+        const FrameBufferRef buf(FrameBufferPool::instance().get(yuv_size));
+        if (!buf)
+            return VideoFrame();
         // plane 1, 2... is aligned?
-        uchar* plane_ptr = (uchar*)buf.data() + offset_16;
+        uchar* plane_ptr = buf->data();
         QVector<uchar*> dst(nb_planes, 0);
         for (int i = 0; i < nb_planes; ++i) {
             dst[i] = plane_ptr;
@@ -29,8 +29,13 @@ config_libcedarv: CONFIG *= neon config_simd #need by qt4 addSimdCompiler(). neo
 ## sse2 sse4_1 may be defined in Qt5 qmodule.pri but is not included. Qt4 defines sse and sse2
 sse4_1|config_sse4_1|contains(TARGET_ARCH_SUB, sse4.1): CONFIG *= sse4_1 config_simd
 sse2|config_sse2|contains(TARGET_ARCH_SUB, sse2): CONFIG *= sse2 config_simd
+## avx2 kernels are selected at runtime, so build them if the compiler supports avx2
+avx2|config_avx2|contains(TARGET_ARCH_SUB, avx2): CONFIG *= avx2 config_simd
+sse2:!isEmpty(QMAKE_CFLAGS_AVX2): CONFIG *= avx2
 
 #release: DEFINES += QT_NO_DEBUG_OUTPUT
+# remove qDebug() in QtAV only
+no_debug_log|config_no_debug_log: DEFINES += QTAV_NO_DEBUG_LOG
 #var with '_' can not pass to pri?
 PROJECTROOT = $$PWD/..
 !include(libQtAV.pri): error("could not find libQtAV.pri")
@@ -83,7 +88,13 @@ sse4_1 {
 sse2 {
   DEFINES += QTAV_HAVE_SSE2=1
   !config_simd: CONFIG *= simd
-  SSE2_SOURCES += utils/CopyFrame_SSE2.cpp
+  SSE2_SOURCES += utils/CopyFrame_SSE2.cpp \
+                  ImageConverterSIMD_SSE2.cpp
+}
+avx2 {
+  DEFINES += QTAV_HAVE_AVX2=1
+  !config_simd: CONFIG *= simd
+  AVX2_SOURCES += ImageConverterSIMD_AVX2.cpp
 }
 
 *msvc* {
@@ -331,6 +342,7 @@ SOURCES += \
     subtitle/SubtitleProcessorFFmpeg.cpp \
     utils/GPUMemCopy.cpp \
     utils/Logger.cpp \
+    utils/Tracer.cpp \
     AudioThread.cpp \
     utils/internal.cpp \
     AVThread.cpp \
@@ -348,6 +360,12 @@ SOURCES += \
     AVMuxer.cpp \
     AVDemuxer.cpp \
     AVDemuxThread.cpp \
+    DecodeScheduler.cpp \
+    FrameDropController.cpp \
+    InterleaveCache.cpp \
+    KeyFrameIndex.cpp \
+    ThumbnailCache.cpp \
+    FrameBufferPool.cpp \
     ColorTransform.cpp \
     Frame.cpp \
     filter/Filter.cpp \
@@ -358,6 +376,7 @@ SOURCES += \
     filter/EncodeFilter.cpp \
     ImageConverter.cpp \
     ImageConverterFF.cpp \
+    ImageConverterSIMD.cpp \
     Packet.cpp \
     PacketBuffer.cpp \
     AVError.cpp \
@@ -388,6 +407,7 @@ SOURCES += \
     codec/video/VideoEncoderFFmpeg.cpp \
     VideoThread.cpp \
     VideoFrameExtractor.cpp \
+    StoryboardGenerator.cpp \
     CommonTypes.cpp
 
 SDK_HEADERS *= \
@@ -412,6 +432,7 @@ SDK_HEADERS *= \
     QtAV/LibAVFilter.h \
     QtAV/EncodeFilter.h \
     QtAV/Frame.h \
+    QtAV/FrameBufferPool.h \
     QtAV/QPainterRenderer.h \
     QtAV/Packet.h \
     QtAV/AVError.h \
@@ -429,6 +450,8 @@ SDK_HEADERS *= \
     QtAV/VideoFormat.h \
     QtAV/VideoFrame.h \
     QtAV/VideoFrameExtractor.h \
+    QtAV/ThumbnailCache.h \
+    QtAV/StoryboardGenerator.h \
     QtAV/FactoryDefine.h \
     QtAV/Statistics.h \
     QtAV/Subtitle.h \
@@ -463,6 +486,11 @@ HEADERS *= \
     $$SDK_PRIVATE_HEADERS \
     AVPlayerPrivate.h \
     AVDemuxThread.h \
+    DecodeScheduler.h \
+    FrameDropController.h \
+    StageTimer.h \
+    InterleaveCache.h \
+    KeyFrameIndex.h \
     AVThread.h \
     AVThread_p.h \
     AudioThread.h \
@@ -470,6 +498,7 @@ HEADERS *= \
     VideoThread.h \
     ImageConverter.h \
     ImageConverter_p.h \
+    ImageConverterSIMD_p.h \
     codec/video/VideoDecoderFFmpegBase.h \
     codec/video/VideoDecoderFFmpegHW.h \
     codec/video/VideoDecoderFFmpegHW_p.h \
@@ -477,10 +506,13 @@ HEADERS *= \
     subtitle/CharsetDetector.h \
     subtitle/PlainText.h \
     utils/BlockingQueue.h \
+    utils/CommandSlots.h \
     utils/GPUMemCopy.h \
     utils/Logger.h \
     utils/SharedPtr.h \
     utils/ring.h \
+    utils/spsc_ring.h \
+    utils/Tracer.h \
     utils/internal.h \
     output/OutputSet.h \
     QtAV/ColorTransform.h
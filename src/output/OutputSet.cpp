@@ -28,6 +28,7 @@ namespace QtAV {
 OutputSet::OutputSet(AVPlayer *player):
     QObject(player)
   , mCanPauseThread(false)
+  , mResume(false)
   , mpPlayer(player)
   , mPauseCount(0)
 {
@@ -120,11 +121,18 @@ bool OutputSet::pauseThread(unsigned long timeout)
 {
     QMutexLocker lock(&mMutex);
     Q_UNUSED(lock);
-    return mCond.wait(&mMutex, timeout);
+    bool ok = true;
+    while (ok && mCanPauseThread && !mResume)
+        ok = mCond.wait(&mMutex, timeout);
+    mResume = false;
+    return ok;
 }
 
 void OutputSet::resumeThread()
 {
+    QMutexLocker lock(&mMutex);
+    Q_UNUSED(lock);
+    mResume = true;
     mCond.wakeAll();
 }
 
@@ -58,11 +58,17 @@ public:
     void notifyPauseChange(AVOutput *output);
     bool canPauseThread() const;
     //in AVThread
-    bool pauseThread(unsigned long timeout = ULONG_MAX); //There are 2 ways to pause AVThread: 1. pause thread directly. 2. pause all outputs
+    /*
+     * There are 2 ways to pause AVThread: 1. pause thread directly. 2. pause all outputs
+     * Block until resumeThread() is called, or the outputs are no longer paused. A resumeThread() call before waiting is not lost.
+     * Return false on timeout.
+     */
+    bool pauseThread(unsigned long timeout = ULONG_MAX);
     /*
      * in user thread when pause count < set size.
      * 1. AVPlayer.pause(false) in player thread then call each output pause(false)
      * 2. shortcut for AVOutput.pause(false)
+     * Also called by AVThread to process new tasks or stop.
      */
     void resumeThread();
 
@@ -72,6 +78,7 @@ public slots:
 
 private:
     volatile bool mCanPauseThread;
+    bool mResume; // resumeThread() is called. protected by mMutex
     AVPlayer *mpPlayer;
     int mPauseCount; //pause AVThread if equals to mOutputs.size()
     QList<AVOutput*> mOutputs;
@@ -30,6 +30,7 @@
 typedef QTime QElapsedTimer;
 #endif
 #include "utils/ring.h"
+#include "utils/Tracer.h"
 #include "utils/Logger.h"
 
 #define AO_USE_TIMER 1
@@ -399,6 +400,7 @@ bool AudioOutput::play(const QByteArray &data, qreal pts)
     DPTR_D(AudioOutput);
     if (!d.backend)
         return false;
+    TraceScope trace("AudioOutput::play", pts);
     receiveData(data, pts);
     return d.backend->play();
 }
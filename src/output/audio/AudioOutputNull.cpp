@@ -22,6 +22,8 @@
 #include "QtAV/private/AudioOutputBackend.h"
 #include "QtAV/private/mkid.h"
 #include "QtAV/private/factory.h"
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QQueue>
 
 namespace QtAV {
 
@@ -48,4 +50,80 @@ AudioOutputNull::AudioOutputNull(QObject *parent)
     : AudioOutputBackend(AudioOutput::DeviceFeatures(), parent)
 {}
 
+static const char kDummyName[] = "dummy";
+/*!
+ * \brief The AudioOutputDummy class
+ * Discards the data but consumes it in real time, so audio clock and a/v sync work as with a real device.
+ * Used by headless tests and benchmarks. "null" can not be opened and disables audio output.
+ */
+class AudioOutputDummy : public AudioOutputBackend
+{
+public:
+    AudioOutputDummy(QObject *parent = 0);
+    QString name() const Q_DECL_OVERRIDE { return QLatin1String(kDummyName);}
+    bool open() Q_DECL_OVERRIDE;
+    bool close() Q_DECL_OVERRIDE;
+    BufferControl bufferControl() const Q_DECL_OVERRIDE { return PlayedCount;}
+    bool write(const QByteArray& data) Q_DECL_OVERRIDE;
+    bool play() Q_DECL_OVERRIDE { return true;}
+    int getPlayedCount() Q_DECL_OVERRIDE;
+private:
+    QElapsedTimer m_timer;
+    qint64 m_credit; // ns not consumed by the played buffers
+    QQueue<int> m_queued; // sizes of the written buffers
+};
+
+typedef AudioOutputDummy AudioOutputBackendDummy;
+static const AudioOutputBackendId AudioOutputBackendId_Dummy = mkid::id32base36_5<'d', 'u', 'm', 'm', 'y'>::value;
+FACTORY_REGISTER(AudioOutputBackend, Dummy, kDummyName)
+
+AudioOutputDummy::AudioOutputDummy(QObject *parent)
+    : AudioOutputBackend(AudioOutput::DeviceFeatures(), parent)
+    , m_credit(0)
+{}
+
+bool AudioOutputDummy::open()
+{
+    m_queued.clear();
+    m_credit = 0;
+    m_timer.start();
+    return true;
+}
+
+bool AudioOutputDummy::close()
+{
+    m_queued.clear();
+    m_timer.invalidate();
+    return true;
+}
+
+bool AudioOutputDummy::write(const QByteArray &data)
+{
+    if (!m_timer.isValid())
+        return false;
+    m_queued.enqueue(data.size());
+    return true;
+}
+
+int AudioOutputDummy::getPlayedCount()
+{
+    if (!m_timer.isValid())
+        return 0;
+    m_credit += m_timer.nsecsElapsed();
+    m_timer.restart();
+    int count = 0;
+    while (!m_queued.isEmpty()) {
+        const qint64 ns = format.durationForBytes(m_queued.head())*1000LL;
+        if (m_credit < ns)
+            break;
+        m_credit -= ns;
+        m_queued.dequeue();
+        ++count;
+    }
+    // underrun. the device does not play ahead
+    if (m_queued.isEmpty())
+        m_credit = 0;
+    return count;
+}
+
 } //namespace QtAV
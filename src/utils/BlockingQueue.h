@@ -23,14 +23,19 @@
 #ifndef QTAV_BLOCKINGQUEUE_H
 #define QTAV_BLOCKINGQUEUE_H
 
-#include <QtCore/QReadWriteLock>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
 #include <QtCore/QScopedPointer>
 #include <QtCore/QWaitCondition>
 
-//TODO: block full and empty condition separately
 template<typename T> class QQueue;
 namespace QtAV {
 
+/*!
+ * put() blocks on not-full condition, take() blocks on not-empty condition. A condition is only
+ * signaled if a thread is waiting on it, and each side only wakes the other side.
+ * putMany() and takeUpTo() move a burst of elements with 1 lock round trip and at most 1 wakeup if there is room.
+ */
 template <typename T, template <typename> class Container = QQueue>
 class BlockingQueue
 {
@@ -47,7 +52,19 @@ public:
     void setThreshold(int min); //wake up and enqueue
 
     void put(const T& t);
+    /*!
+     * \brief putMany
+     * Enqueue all elements in order. If the queue becomes full, wake the consumer and wait like put() until there is
+     * room for the remaining elements. All are enqueued without waiting if blockFull(false)
+     */
+    void putMany(const QList<T>& ts);
     T take();
+    /*!
+     * \brief takeUpTo
+     * Block like take() if the queue is empty, then dequeue at most n elements.
+     * \return empty list if still empty after wait, e.g. not blocking
+     */
+    QList<T> takeUpTo(int n);
     void setBlocking(bool block); //will wake if false. called when no more data can enqueue
     void blockEmpty(bool block);
     void blockFull(bool block);
@@ -89,9 +106,15 @@ protected:
     int cap, thres;
     Container<T> queue;
 private:
-    mutable QReadWriteLock lock; //locker in const func
-    QReadWriteLock block_change_lock;
+    // lock must be held. callbacks are called without lock so they can change blocking state of any queue
+    void waitNotFull(QMutexLocker *locker);
+    void waitNotEmpty(QMutexLocker *locker);
+    void wakeFull();
+    void wakeEmpty();
+
+    mutable QMutex lock; //locker in const func
     QWaitCondition cond_full, cond_empty;
+    int nb_full_waiters, nb_empty_waiters;
     //upto_threshold_callback, downto_threshold_callback
     QScopedPointer<StateChangeCallback> empty_callback, threshold_callback, full_callback;
 };
@@ -102,6 +125,8 @@ private:
 template <typename T, template <typename> class Container>
 BlockingQueue<T, Container>::BlockingQueue()
     :block_empty(true),block_full(true),cap(48),thres(32)
+    , nb_full_waiters(0)
+    , nb_empty_waiters(0)
     , empty_callback(0)
     , threshold_callback(0)
     , full_callback(0)
@@ -112,7 +137,7 @@ template <typename T, template <typename> class Container>
 void BlockingQueue<T, Container>::setCapacity(int max)
 {
     //qDebug("queue capacity==>>%d", max);
-    QWriteLocker locker(&lock);
+    QMutexLocker locker(&lock);
     Q_UNUSED(locker);
     cap = max;
     if (thres > cap)
@@ -123,7 +148,7 @@ template <typename T, template <typename> class Container>
 void BlockingQueue<T, Container>::setThreshold(int min)
 {
     //qDebug("queue threshold==>>%d", min);
-    QWriteLocker locker(&lock);
+    QMutexLocker locker(&lock);
     Q_UNUSED(locker);
     if (min > cap)
         return;
@@ -131,22 +156,67 @@ void BlockingQueue<T, Container>::setThreshold(int min)
 }
 
 template <typename T, template <typename> class Container>
-void BlockingQueue<T, Container>::put(const T& t)
+void BlockingQueue<T, Container>::waitNotFull(QMutexLocker *locker)
 {
-    QWriteLocker locker(&lock);
-    Q_UNUSED(locker);
-    if (checkFull()) {
-        //qDebug("queue full"); //too frequent
-        if (full_callback) {
-            full_callback->call();
-        }
-        if (block_full)
-            cond_full.wait(&lock);
+    if (!checkFull())
+        return;
+    //qDebug("queue full"); //too frequent
+    if (full_callback) {
+        locker->unlock();
+        full_callback->call();
+        locker->relock();
+    }
+    if (!block_full || !checkFull())
+        return;
+    ++nb_full_waiters;
+    cond_full.wait(&lock);
+    --nb_full_waiters;
+}
+
+template <typename T, template <typename> class Container>
+void BlockingQueue<T, Container>::waitNotEmpty(QMutexLocker *locker)
+{
+    if (checkEnough())
+        return;
+    wakeFull();
+    if (!checkEmpty()) //TODO:always block?
+        return;
+    //qDebug("queue empty!!");
+    if (empty_callback) {
+        locker->unlock();
+        empty_callback->call();
+        locker->relock();
     }
+    if (!block_empty || !checkEmpty())
+        return;
+    ++nb_empty_waiters;
+    cond_empty.wait(&lock); //block when empty only
+    --nb_empty_waiters;
+}
+
+template <typename T, template <typename> class Container>
+void BlockingQueue<T, Container>::wakeFull()
+{
+    if (nb_full_waiters > 0)
+        cond_full.wakeAll();
+}
+
+template <typename T, template <typename> class Container>
+void BlockingQueue<T, Container>::wakeEmpty()
+{
+    if (nb_empty_waiters > 0)
+        cond_empty.wakeAll();
+}
+
+template <typename T, template <typename> class Container>
+void BlockingQueue<T, Container>::put(const T& t)
+{
+    QMutexLocker locker(&lock);
+    waitNotFull(&locker);
     queue.enqueue(t);
     onPut(t); // emit bufferProgressChanged here if buffering
     if (checkEnough()) {
-        cond_empty.wakeAll(); //emit buffering finished here
+        wakeEmpty(); //emit buffering finished here
         //qDebug("queue is enough: %d/%d~%d", queue.size(), thres, cap);
     } else {
         //qDebug("buffering: %d/%d~%d", queue.size(), thres, cap);
@@ -154,25 +224,33 @@ void BlockingQueue<T, Container>::put(const T& t)
 }
 
 template <typename T, template <typename> class Container>
-T BlockingQueue<T, Container>::take()
+void BlockingQueue<T, Container>::putMany(const QList<T>& ts)
 {
-    QWriteLocker locker(&lock);
-    Q_UNUSED(locker);
-    if (!checkEnough()) {
-        cond_full.wakeAll();
-        if (checkEmpty()) {//TODO:always block?
-            //qDebug("queue empty!!");
-            if (empty_callback) {
-                empty_callback->call();
-            }
-            if (block_empty)
-                cond_empty.wait(&lock); //block when empty only
-        }
+    QMutexLocker locker(&lock);
+    int i = 0;
+    while (i < ts.size()) {
+        waitNotFull(&locker);
+        // at least 1 element like put(), then until full
+        do {
+            queue.enqueue(ts.at(i));
+            onPut(ts.at(i));
+            ++i;
+        } while (i < ts.size() && (!block_full || !checkFull()));
+        if (checkEnough())
+            wakeEmpty();
     }
+}
+
+template <typename T, template <typename> class Container>
+T BlockingQueue<T, Container>::take()
+{
+    QMutexLocker locker(&lock);
+    waitNotEmpty(&locker);
     //TODO: Why still empty?
     if (checkEmpty()) {
         qWarning("Queue is still empty");
         if (empty_callback) {
+            locker.unlock();
             empty_callback->call();
         }
         return T();
@@ -182,49 +260,60 @@ T BlockingQueue<T, Container>::take()
     return t;
 }
 
+template <typename T, template <typename> class Container>
+QList<T> BlockingQueue<T, Container>::takeUpTo(int n)
+{
+    QList<T> ts;
+    QMutexLocker locker(&lock);
+    waitNotEmpty(&locker);
+    while (ts.size() < n && !checkEmpty()) {
+        ts.append(queue.dequeue());
+        onTake(ts.last());
+    }
+    if (!checkEnough())
+        wakeFull();
+    return ts;
+}
+
 template <typename T, template <typename> class Container>
 void BlockingQueue<T, Container>::setBlocking(bool block)
 {
-    QWriteLocker locker(&lock);
+    QMutexLocker locker(&lock);
     Q_UNUSED(locker);
     block_empty = block_full = block;
     if (!block) {
-        cond_empty.wakeAll(); //empty still wait. setBlock=>setCapacity(-1)
-        cond_full.wakeAll();
+        wakeEmpty(); //empty still wait. setBlock=>setCapacity(-1)
+        wakeFull();
     }
 }
 
 template <typename T, template <typename> class Container>
 void BlockingQueue<T, Container>::blockEmpty(bool block)
 {
-    if (!block) {
-        cond_empty.wakeAll();
-    }
-    QWriteLocker locker(&block_change_lock);
+    QMutexLocker locker(&lock);
     Q_UNUSED(locker);
     block_empty = block;
+    if (!block)
+        wakeEmpty();
 }
 
 template <typename T, template <typename> class Container>
 void BlockingQueue<T, Container>::blockFull(bool block)
 {
-    if (!block) {
-        cond_full.wakeAll();
-    }
-    //DO NOT use the same lock that put() get() use. it may be already locked
-    //this function usualy called in demux thread, so no lock is ok
-    QWriteLocker locker(&block_change_lock);
+    // callbacks are called without lock, so it's safe to call it there
+    QMutexLocker locker(&lock);
     Q_UNUSED(locker);
     block_full = block;
+    if (!block)
+        wakeFull();
 }
 
 template <typename T, template <typename> class Container>
 void BlockingQueue<T, Container>::clear()
 {
-    QWriteLocker locker(&lock);
+    QMutexLocker locker(&lock);
     Q_UNUSED(locker);
-    //cond_empty.wakeAll();
-    cond_full.wakeAll();
+    wakeFull();
     queue.clear();
     //TODO: assert not empty
     onTake(T());
@@ -233,7 +322,7 @@ void BlockingQueue<T, Container>::clear()
 template <typename T, template <typename> class Container>
 bool BlockingQueue<T, Container>::isEmpty() const
 {
-    QReadLocker locker(&lock);
+    QMutexLocker locker(&lock);
     Q_UNUSED(locker);
     return queue.isEmpty();
 }
@@ -241,7 +330,7 @@ bool BlockingQueue<T, Container>::isEmpty() const
 template <typename T, template <typename> class Container>
 bool BlockingQueue<T, Container>::isEnough() const
 {
-    QReadLocker locker(&lock);
+    QMutexLocker locker(&lock);
     Q_UNUSED(locker);
     return queue.size() >= thres;
 }
@@ -249,7 +338,7 @@ bool BlockingQueue<T, Container>::isEnough() const
 template <typename T, template <typename> class Container>
 bool BlockingQueue<T, Container>::isFull() const
 {
-    QReadLocker locker(&lock);
+    QMutexLocker locker(&lock);
     Q_UNUSED(locker);
     return queue.size() >= cap;
 }
@@ -257,7 +346,7 @@ bool BlockingQueue<T, Container>::isFull() const
 template <typename T, template <typename> class Container>
 int BlockingQueue<T, Container>::size() const
 {
-    QReadLocker locker(&lock);
+    QMutexLocker locker(&lock);
     Q_UNUSED(locker);
     return queue.size();
 }
@@ -265,7 +354,7 @@ int BlockingQueue<T, Container>::size() const
 template <typename T, template <typename> class Container>
 int BlockingQueue<T, Container>::threshold() const
 {
-    QReadLocker locker(&lock);
+    QMutexLocker locker(&lock);
     Q_UNUSED(locker);
     return thres;
 }
@@ -273,7 +362,7 @@ int BlockingQueue<T, Container>::threshold() const
 template <typename T, template <typename> class Container>
 int BlockingQueue<T, Container>::capacity() const
 {
-    QReadLocker locker(&lock);
+    QMutexLocker locker(&lock);
     Q_UNUSED(locker);
     return cap;
 }
@@ -281,7 +370,7 @@ int BlockingQueue<T, Container>::capacity() const
 template <typename T, template <typename> class Container>
 void BlockingQueue<T, Container>::setEmptyCallback(StateChangeCallback *call)
 {
-    QWriteLocker locker(&lock);
+    QMutexLocker locker(&lock);
     Q_UNUSED(locker);
     empty_callback.reset(call);
 }
@@ -289,7 +378,7 @@ void BlockingQueue<T, Container>::setEmptyCallback(StateChangeCallback *call)
 template <typename T, template <typename> class Container>
 void BlockingQueue<T, Container>::setThresholdCallback(StateChangeCallback *call)
 {
-    QWriteLocker locker(&lock);
+    QMutexLocker locker(&lock);
     Q_UNUSED(locker);
     threshold_callback.reset(call);
 }
@@ -297,7 +386,7 @@ void BlockingQueue<T, Container>::setThresholdCallback(StateChangeCallback *call
 template <typename T, template <typename> class Container>
 void BlockingQueue<T, Container>::setFullCallback(StateChangeCallback *call)
 {
-    QWriteLocker locker(&lock);
+    QMutexLocker locker(&lock);
     Q_UNUSED(locker);
     full_callback.reset(call);
 }
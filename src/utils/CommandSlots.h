@@ -0,0 +1,81 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_COMMANDSLOTS_H
+#define QTAV_COMMANDSLOTS_H
+
+#include <limits.h>
+#include "utils/spsc_ring.h" // atomic helpers
+
+namespace QtAV {
+
+/*!
+ * \brief The CommandSlots class
+ * Typed commands from any thread to 1 consumer thread, without allocation or lock.
+ * Every command type (0 ~ N-1, N <= 31) has a preallocated slot:
+ *  - post(): only the latest value matters, e.g. EQ, frame drop
+ *  - add(): requests are counted, e.g. capture
+ * The consumer calls takePending() to get the types changed since the last call, then take() each value.
+ * A value posted after takePending() is taken together, and the type is reported again later with kNoValue.
+ */
+template<int N>
+class CommandSlots
+{
+public:
+    enum { kNoValue = INT_MIN };
+    CommandSlots() : m_pending(0) {
+        for (int i = 0; i < N; ++i)
+            m_value[i].fetchAndStoreRelaxed(kNoValue);
+    }
+    // latest value wins
+    void post(int type, int value) {
+        m_value[type].fetchAndStoreOrdered(value);
+        mark(type);
+    }
+    // accumulate 1
+    void add(int type) {
+        int v = atomic_load_relaxed(m_value[type]);
+        while (!m_value[type].testAndSetOrdered(v, v == kNoValue ? 1 : v + 1))
+            v = atomic_load_relaxed(m_value[type]);
+        mark(type);
+    }
+    bool isEmpty() const { return atomic_load_acquire(m_pending) == 0;}
+    // consumer. bit i is set if type i is posted
+    int takePending() { return isEmpty() ? 0 : m_pending.fetchAndStoreOrdered(0);}
+    // consumer. kNoValue if nothing posted
+    int take(int type) { return m_value[type].fetchAndStoreOrdered(kNoValue);}
+    void clear() {
+        m_pending.fetchAndStoreOrdered(0);
+        for (int i = 0; i < N; ++i)
+            take(i);
+    }
+private:
+    void mark(int type) {
+        // Qt4 has no fetchAndOr
+        int m = atomic_load_relaxed(m_pending);
+        while (!m_pending.testAndSetOrdered(m, m | (1 << type)))
+            m = atomic_load_relaxed(m_pending);
+    }
+    QAtomicInt m_pending;
+    QAtomicInt m_value[N];
+};
+} //namespace QtAV
+#endif // QTAV_COMMANDSLOTS_H
@@ -23,8 +23,18 @@
  * DO NOT appear qDebug, qWanring etc in Logger.cpp! They are undefined and redefined to QtAV:Internal::Logger.xxx
  */
 // we need LogLevel so must include QtAV_Global.h
+#include <string.h>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
 #include <QtCore/QString>
+#include <QtCore/QThread>
+#include <QtCore/QThreadStorage>
+#include <QtCore/QWaitCondition>
+#include <QtCore/QtAlgorithms>
 #include "QtAV/QtAV_Global.h"
+#include "utils/spsc_ring.h" // atomic helpers
 #include "Logger.h"
 
 #ifndef QTAV_NO_LOG_LEVEL
@@ -38,7 +48,428 @@ static QString gQtAVLogTag = QString();
 typedef Logger::Context QMessageLogger;
 #endif
 
-static void log_helper(QtMsgType msgType, const QMessageLogger *qlog, const char* msg, va_list ap) {
+/*
+ * Asynchronous backend, enabled by QTAV_LOG_ASYNC=1. The messages are formatted into a lock-free ring of the calling
+ * thread, and a writer thread outputs them with qt_message_output() every kLogInterval ms, so the decoding and
+ * rendering threads never wait for the message handler or stderr. The writer sorts the messages by time and passes
+ * the file, line and function of the caller to the message handler.
+ * A printf style message is formatted at most kLogBurst times per kLogWindow for a format string, the rest are counted
+ * and output by the writer when the window ends. Consecutive identical messages from a thread are output once with
+ * the repeat count. Fatal messages are output synchronously after all queued messages.
+ */
+namespace {
+static const int kLogRingSize = 512;
+static const int kLogTextSize = 232;
+static const int kLogMaxSize = 2048;
+static const int kLogBurst = 8;
+static const qint64 kLogWindow = 1000; // ms
+static const int kLogInterval = 20; // ms
+static const int kLogLimits = 16;
+
+// the strings are literals from the Logger macros
+struct LogContext
+{
+    LogContext(const char* f = 0, int l = 0, const char* fn = 0, const char* c = 0)
+        : file(f), line(l), function(fn), category(c) {}
+    const char *file;
+    int line;
+    const char *function;
+    const char *category;
+};
+
+struct LogRecord
+{
+    qint64 time; // ns
+    QtMsgType type;
+    LogContext context;
+    int size; // -1: long_text
+    char text[kLogTextSize];
+    QByteArray long_text;
+};
+
+class LogRing;
+struct LogItem
+{
+    qint64 time;
+    QtMsgType type;
+    LogContext context;
+    QByteArray text;
+    LogRing *ring;
+    bool operator<(const LogItem& other) const { return time < other.time;}
+};
+
+class LogRing
+{
+public:
+    LogRing() : records(kLogRingSize), repeated(0) {
+        for (int i = 0; i < kLogLimits; ++i) {
+            limits[i].fmt = 0;
+            limits[i].start = 0;
+            limits[i].count = 0;
+            limits[i].suppressed = 0;
+        }
+    }
+    // owner thread. false if the message of the format should be suppressed
+    bool allow(const char* fmt, const LogContext& ctx, qint64 now_ms);
+    // owner thread
+    void push(QtMsgType type, const LogContext& ctx, const char* text, int size);
+    // consumer. append the suppressed counts of the windows ended at now_ms, or of all windows if now_ms < 0
+    void takeSuppressed(qint64 now_ms, qint64 time, QList<LogItem>* items);
+
+    spsc_ring<LogRecord> records;
+    QAtomicInt dropped;
+    QAtomicInt finished;
+    // consumer
+    QByteArray last_text;
+    int repeated;
+private:
+    struct Limit {
+        const char* fmt;
+        LogContext context;
+        qint64 start;
+        int count;
+        int suppressed;
+    } limits[kLogLimits];
+    // the owner thread only contends with takeSuppressed() every kLogInterval
+    QMutex limits_mutex;
+};
+
+class LogRingRef
+{
+public:
+    explicit LogRingRef(LogRing *r) : ring(r) {}
+    ~LogRingRef() { atomic_store_release(ring->finished, 1);}
+    LogRing *ring;
+};
+
+class LogWriter : public QThread
+{
+public:
+    LogWriter() : stop(false) {}
+    void run() Q_DECL_OVERRIDE;
+    QMutex mutex;
+    QWaitCondition cond;
+    bool stop;
+};
+
+// never deleted, threads may log at exit
+class LogBackend
+{
+public:
+    LogBackend() : enabled(qgetenv("QTAV_LOG_ASYNC").toInt() > 0) {
+        timer.start();
+    }
+    bool isEnabled() const { return !!atomic_load_relaxed(enabled);}
+    LogRing* localRing() {
+        if (local.hasLocalData())
+            return local.localData()->ring;
+        QMutexLocker lock(&rings_mutex);
+        Q_UNUSED(lock);
+        LogRing *r = new LogRing();
+        rings.append(r);
+        local.setLocalData(new LogRingRef(r));
+        startWriter();
+        return r;
+    }
+    void drain();
+    // stop the writer and output the queued messages. later messages are output synchronously
+    void stop() {
+        if (!atomic_load_acquire(enabled))
+            return;
+        atomic_store_release(enabled, 0);
+        writer.mutex.lock();
+        writer.stop = true;
+        writer.cond.wakeAll();
+        writer.mutex.unlock();
+        if (writer.isRunning())
+            writer.wait();
+        drain();
+    }
+    QElapsedTimer timer;
+private:
+    void startWriter();
+    QAtomicInt enabled;
+    QMutex rings_mutex; // rings and writer start
+    QList<LogRing*> rings;
+    QThreadStorage<LogRingRef*> local;
+    QMutex drain_mutex;
+    LogWriter writer;
+};
+
+static LogBackend *gLogBackend = 0;
+static LogBackend* logBackend()
+{
+    static LogBackend *b = gLogBackend = new LogBackend();
+    return b;
+}
+
+static void stopLogBackend()
+{
+    if (gLogBackend)
+        gLogBackend->stop();
+}
+
+// output the queued messages if the process exits without QCoreApplication
+class LogFinalizer
+{
+public:
+    ~LogFinalizer() { stopLogBackend();}
+};
+static LogFinalizer sLogFinalizer;
+
+void LogBackend::startWriter()
+{
+    if (writer.isRunning() || writer.stop)
+        return;
+    writer.start();
+    if (QCoreApplication::instance())
+        qAddPostRoutine(stopLogBackend);
+}
+
+static QByteArray suppressed_message(int count, const char* fmt)
+{
+    return "(" + QByteArray::number(count) + " messages suppressed) " + QByteArray(fmt).trimmed();
+}
+
+bool LogRing::allow(const char *fmt, const LogContext &ctx, qint64 now_ms)
+{
+    QMutexLocker lock(&limits_mutex);
+    Q_UNUSED(lock);
+    // linear probing from the hash of the format. a slot is reused when its window ended
+    const int h = (quintptr(fmt) >> 3) % kLogLimits;
+    Limit *l = 0;
+    for (int i = 0; i < kLogLimits; ++i) {
+        Limit &s = limits[(h + i) % kLogLimits];
+        if (s.fmt == fmt) {
+            l = &s;
+            break;
+        }
+        if (!l && (!s.fmt || now_ms - s.start >= kLogWindow))
+            l = &s;
+    }
+    if (!l) // all slots are limiting other formats
+        return true;
+    if (l->fmt != fmt || now_ms - l->start >= kLogWindow) {
+        if (l->suppressed > 0) { // not taken by the writer yet
+            const QByteArray msg(suppressed_message(l->suppressed, l->fmt));
+            push(QtDebugMsg, l->context, msg.constData(), msg.size());
+        }
+        l->fmt = fmt;
+        l->context = ctx;
+        l->start = now_ms;
+        l->count = 0;
+        l->suppressed = 0;
+    }
+    if (++l->count <= kLogBurst)
+        return true;
+    ++l->suppressed;
+    return false;
+}
+
+void LogRing::takeSuppressed(qint64 now_ms, qint64 time, QList<LogItem> *items)
+{
+    QMutexLocker lock(&limits_mutex);
+    Q_UNUSED(lock);
+    for (int i = 0; i < kLogLimits; ++i) {
+        Limit &l = limits[i];
+        if (l.suppressed <= 0 || (now_ms >= 0 && now_ms - l.start < kLogWindow))
+            continue;
+        LogItem item;
+        item.time = time;
+        item.type = QtDebugMsg;
+        item.context = l.context;
+        item.text = suppressed_message(l.suppressed, l.fmt);
+        item.ring = this;
+        items->append(item);
+        l.suppressed = 0;
+    }
+}
+
+void LogRing::push(QtMsgType type, const LogContext &ctx, const char *text, int size)
+{
+    LogRecord r;
+    r.time = logBackend()->timer.nsecsElapsed();
+    r.type = type;
+    r.context = ctx;
+    if (size < kLogTextSize) {
+        r.size = size;
+        memcpy(r.text, text, size);
+    } else {
+        r.size = -1;
+        r.long_text = QByteArray(text, size);
+    }
+    if (!records.push_back(r))
+        dropped.ref();
+}
+
+static void output_message(QtMsgType type, const LogContext& c, const QString& text)
+{
+    QString qmsg(gQtAVLogTag);
+    qmsg += text;
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+    Q_UNUSED(c);
+    qt_message_output(type, qmsg.toUtf8().constData());
+#else
+    QMessageLogContext ctx(c.file, c.line, c.function, c.category);
+    qt_message_output(type, ctx, qmsg);
+#endif
+}
+
+static void output_repeated(LogRing *r)
+{
+    if (r->repeated <= 0)
+        return;
+    output_message(QtDebugMsg, LogContext(), QString::fromLatin1("(last message repeated %1 times)").arg(r->repeated));
+    r->repeated = 0;
+}
+
+void LogBackend::drain()
+{
+    QMutexLocker lock(&drain_mutex);
+    Q_UNUSED(lock);
+    rings_mutex.lock();
+    const QList<LogRing*> rs(rings);
+    rings_mutex.unlock();
+    QList<LogItem> items;
+    QList<LogRing*> finished;
+    const qint64 now_ms = timer.elapsed();
+    foreach (LogRing *r, rs) {
+        const bool done = !!atomic_load_acquire(r->finished);
+        if (done)
+            finished.append(r);
+        while (!r->records.empty()) {
+            LogRecord &rec = r->records.front();
+            LogItem item;
+            item.time = rec.time;
+            item.type = rec.type;
+            item.context = rec.context;
+            item.text = rec.size < 0 ? rec.long_text : QByteArray(rec.text, rec.size);
+            item.ring = r;
+            rec.long_text.clear();
+            r->records.pop_front();
+            items.append(item);
+        }
+        const int dropped = r->dropped.fetchAndStoreRelaxed(0);
+        if (dropped > 0) {
+            LogItem item;
+            item.time = timer.nsecsElapsed();
+            item.type = QtWarningMsg;
+            item.text = "(" + QByteArray::number(dropped) + " messages dropped)";
+            item.ring = r;
+            items.append(item);
+        }
+        r->takeSuppressed(done ? -1 : now_ms, timer.nsecsElapsed(), &items);
+    }
+    qStableSort(items);
+    foreach (const LogItem &item, items) {
+        LogRing *r = item.ring;
+        if (item.text == r->last_text) {
+            r->repeated++;
+            continue;
+        }
+        output_repeated(r);
+        r->last_text = item.text;
+        output_message(item.type, item.context, QString::fromUtf8(item.text));
+    }
+    foreach (LogRing *r, rs) {
+        output_repeated(r);
+    }
+    if (finished.isEmpty())
+        return;
+    QMutexLocker rlock(&rings_mutex);
+    Q_UNUSED(rlock);
+    foreach (LogRing *r, finished) {
+        rings.removeAll(r);
+        delete r;
+    }
+}
+
+void LogWriter::run()
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    while (!stop) {
+        cond.wait(&mutex, kLogInterval);
+        mutex.unlock();
+        logBackend()->drain();
+        mutex.lock();
+    }
+}
+
+/*!
+ * \brief log_async
+ * \return false if the message should be output synchronously
+ */
+static bool log_async(QtMsgType type, const LogContext& ctx, const char* fmt, va_list ap)
+{
+    LogBackend *b = logBackend();
+    if (type == QtFatalMsg) {
+        b->stop(); // output the queued messages first
+        return false;
+    }
+    if (!b->isEnabled())
+        return false;
+    LogRing *r = b->localRing();
+    if (fmt && !r->allow(fmt, ctx, b->timer.elapsed()))
+        return true;
+    char buf[kLogMaxSize];
+    int size = 0;
+    if (fmt) {
+        size = qvsnprintf(buf, sizeof(buf), fmt, ap);
+        if (size < 0 || size >= (int)sizeof(buf)) { // truncated
+            buf[sizeof(buf) - 1] = 0;
+            size = qstrlen(buf);
+        }
+    }
+    r->push(type, ctx, buf, size);
+    return true;
+}
+
+#ifndef QT_NO_DEBUG_STREAM
+static bool log_async(QtMsgType type, const LogContext& ctx, const QString& msg)
+{
+    LogBackend *b = logBackend();
+    if (!b->isEnabled())
+        return false;
+    const QByteArray text(msg.toUtf8());
+    b->localRing()->push(type, ctx, text.constData(), text.size());
+    return true;
+}
+
+// QDebug writes to text, the message is queued when the last QtAVDebug copy is destroyed
+struct LogText {
+    QString text;
+};
+class AsyncDebug : private LogText, public QDebug
+{
+public:
+    AsyncDebug(QtMsgType t, const LogContext& c) : LogText(), QDebug(&text), type(t), context(c) {}
+    QString message() const {
+        QString s(text);
+        while (s.endsWith(QLatin1Char(' ')))
+            s.chop(1);
+        return s;
+    }
+    const QtMsgType type;
+    const LogContext context;
+};
+
+static void queue_async_debug(QDebug *d)
+{
+    AsyncDebug *ad = static_cast<AsyncDebug*>(d);
+    const QtMsgType type = ad->type;
+    const LogContext ctx(ad->context);
+    const QString msg(ad->message());
+    delete ad;
+    if (!log_async(type, ctx, msg)) // stopped
+        output_message(type, ctx, msg);
+}
+#endif //QT_NO_DEBUG_STREAM
+} //namespace
+
+static void log_helper(QtMsgType msgType, const QMessageLogger *qlog, const LogContext& c, const char* msg, va_list ap) {
+    if (log_async(msgType, c, msg, ap))
+        return;
     QString qmsg(gQtAVLogTag);
     if (msg)
         qmsg += QString().vsprintf(msg, ap);
@@ -82,7 +513,7 @@ void Logger::debug(const char *msg, ...) const
     va_list ap;
     va_start(ap, msg);
     // can not use ctx.debug() <<... because QT_NO_DEBUG_STREAM maybe defined
-    log_helper(QtDebugMsg, &ctx, msg, ap);
+    log_helper(QtDebugMsg, &ctx, LogContext(file, line, function, category), msg, ap);
     va_end(ap);
 }
 
@@ -97,7 +528,7 @@ void Logger::warning(const char *msg, ...) const
         return;
     va_list ap;
     va_start(ap, msg);
-    log_helper(QtWarningMsg, &ctx, msg, ap);
+    log_helper(QtWarningMsg, &ctx, LogContext(file, line, function, category), msg, ap);
     va_end(ap);
 }
 
@@ -112,7 +543,7 @@ void Logger::critical(const char *msg, ...) const
         return;
     va_list ap;
     va_start(ap, msg);
-    log_helper(QtCriticalMsg, &ctx, msg, ap);
+    log_helper(QtCriticalMsg, &ctx, LogContext(file, line, function, category), msg, ap);
     va_end(ap);
 }
 
@@ -130,7 +561,7 @@ void Logger::fatal(const char *msg, ...) const Q_DECL_NOTHROW
     if (v > (int)LogOff) {
         va_list ap;
         va_start(ap, msg);
-        log_helper(QtFatalMsg, &ctx, msg, ap);
+        log_helper(QtFatalMsg, &ctx, LogContext(file, line, function, category), msg, ap);
         va_end(ap);
     }
     abort();
@@ -162,7 +593,7 @@ QtAVDebug Logger::debug() const
     const int v = (int)logLevel();
     if (v <= (int)LogOff)
         return d;
-    if (v <= (int)LogDebug || v >= (int)LogAll)
+    if ((v <= (int)LogDebug || v >= (int)LogAll) && !d.setAsync(file, line, function, category))
         d.setQDebug(new QDebug(ctx.debug()));
     return d; //ref > 0
 }
@@ -173,7 +604,7 @@ QtAVDebug Logger::warning() const
     const int v = (int)logLevel();
     if (v <= (int)LogOff)
         return d;
-    if (v <= (int)LogWarning || v >= (int)LogAll)
+    if ((v <= (int)LogWarning || v >= (int)LogAll) && !d.setAsync(file, line, function, category))
         d.setQDebug(new QDebug(ctx.warning()));
     return d;
 }
@@ -184,7 +615,7 @@ QtAVDebug Logger::critical() const
     const int v = (int)logLevel();
     if (v <= (int)LogOff)
         return d;
-    if (v <= (int)LogCritical || v >= (int)LogAll)
+    if ((v <= (int)LogCritical || v >= (int)LogAll) && !d.setAsync(file, line, function, category))
         d.setQDebug(new QDebug(ctx.critical()));
     return d;
 }
@@ -250,6 +681,22 @@ QtAVDebug::~QtAVDebug()
 {
 }
 
+bool QtAVDebug::setAsync(const char *file, int line, const char *function, const char *category)
+{
+#ifndef QT_NO_DEBUG_STREAM
+    if (!logBackend()->isEnabled())
+        return false;
+    dbg = QSharedPointer<QDebug>(new AsyncDebug(type, LogContext(file, line, function, category)), queue_async_debug);
+    return true;
+#else
+    Q_UNUSED(file);
+    Q_UNUSED(line);
+    Q_UNUSED(function);
+    Q_UNUSED(category);
+    return false;
+#endif //QT_NO_DEBUG_STREAM
+}
+
 void QtAVDebug::setQDebug(QDebug *d)
 {
     dbg = QSharedPointer<QDebug>(d);
@@ -33,6 +33,9 @@
   Environment var
   QTAV_LOG_TAG: prefix the value to log message
   QTAV_LOG_LEVEL: set log level, can be "off", "debug", "warning", "critical", "fatal", "all"
+  QTAV_LOG_ASYNC: 1 to queue messages and output them in a writer thread, with floods of a message rate limited.
+  By default messages are output in the calling thread
+  Define QTAV_NO_DEBUG_LOG (qmake CONFIG+=no_debug_log) to remove qDebug calls at compile time
  */
 
 #include <QtDebug> //always include
@@ -71,6 +74,13 @@ public:
     QtAVDebug(QtMsgType t = QtDebugMsg, QDebug *d = 0);
     ~QtAVDebug();
     void setQDebug(QDebug* d);
+    /*!
+     * \brief setAsync
+     * Log to the asynchronous backend. The message is queued when the last copy is destroyed.
+     * file, line, function and category are passed to the message handler in QMessageLogContext
+     * \return false if the backend is disabled
+     */
+    bool setAsync(const char *file, int line, const char *function, const char *category);
     // QDebug api
     inline QtAVDebug &space() {
         if (dbg)
@@ -127,7 +137,8 @@ private:
 class Logger {
     Q_DISABLE_COPY(Logger)
 public:Q_DECL_CONSTEXPR Logger(const char *file = "unknown", int line = 0, const char *function = "unknown", const char *category = "default")
-        : ctx(file, line, function, category) {}
+        : ctx(file, line, function, category)
+        , file(file), line(line), function(function), category(category) {}
     void debug(const char *msg, ...) const Q_ATTRIBUTE_FORMAT_PRINTF(2, 3);
     void noDebug(const char *, ...) const Q_ATTRIBUTE_FORMAT_PRINTF(2, 3)
     {}
@@ -146,7 +157,7 @@ public:Q_DECL_CONSTEXPR Logger(const char *file = "unknown", int line = 0, const
     QtAVDebug warning() const;
     QtAVDebug critical() const;
     //QtAVDebug fatal() const;
-    QNoDebug noDebug() const Q_DECL_NOTHROW;
+    QNoDebug noDebug() const Q_DECL_NOTHROW { return QNoDebug();}
 #endif // QT_NO_DEBUG_STREAM
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
 public: //public can typedef outside
@@ -177,6 +188,11 @@ private:
 private:
     QMessageLogger ctx;
 #endif
+    // for the asynchronous backend. QMessageLogger::context is private
+    const char *file;
+    int line;
+    const char *function;
+    const char *category;
 };
 //simple way
 #if 0
@@ -208,6 +224,10 @@ QNoDebug debug(const char *msg, ...); /* print debug message */
 #undef qDebug
 inline QNoDebug qDebug() { return QNoDebug(); }
 #define qDebug QT_NO_QDEBUG_MACRO
+#elif defined(QTAV_NO_DEBUG_LOG)
+// the arguments are still compiled but never evaluated
+#undef qDebug
+#define qDebug while (false) QtAV::Internal::Logger().noDebug
 #else
 inline QtAVDebug qDebug() { return QtAVDebug(QtDebugMsg); }
 #define qDebug QtAV::Internal::Logger(__FILE__, __LINE__, Q_FUNC_INFO).debug
@@ -0,0 +1,323 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "utils/Tracer.h"
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QThreadStorage>
+#include <QtCore/QWaitCondition>
+#include "utils/Logger.h"
+
+namespace QtAV {
+namespace {
+static const int kRingSize = 1 << 14;
+static const int kWriteInterval = 100; // ms
+
+struct TraceEvent
+{
+    const char* name;
+    qint64 time; // ns since start()
+    qreal pts;
+    char phase;
+    bool has_pts;
+};
+
+class TraceRing
+{
+public:
+    TraceRing(int id, const QByteArray& name)
+        : events(kRingSize)
+        , tid(id)
+        , thread_name(name)
+        , named(false)
+    {}
+    spsc_ring<TraceEvent> events; // the owner thread is the producer, the writer is the consumer
+    const int tid;
+    const QByteArray thread_name;
+    bool named; // thread_name metadata is written
+    QAtomicInt dropped;
+    QAtomicInt finished; // the owner thread exited, no more events
+};
+
+// owned by QThreadStorage. the ring is deleted by the writer after all events are written
+class TraceRingRef
+{
+public:
+    explicit TraceRingRef(TraceRing *r) : ring(r) {}
+    ~TraceRingRef() { atomic_store_release(ring->finished, 1);}
+    TraceRing *ring;
+};
+
+class TraceWriter : public QThread
+{
+public:
+    TraceWriter() : stop(false) {}
+    void run() Q_DECL_OVERRIDE;
+    QMutex mutex;
+    QWaitCondition cond;
+    bool stop;
+};
+
+static QByteArray escaped(const QByteArray& s)
+{
+    QByteArray r;
+    r.reserve(s.size());
+    for (int i = 0; i < s.size(); ++i) {
+        const char c = s.at(i);
+        if (c == '"' || c == '\\')
+            r.append('\\');
+        if ((uchar)c >= 0x20)
+            r.append(c);
+    }
+    return r;
+}
+
+/*
+ * Never deleted, threads may record events at exit. The rings live until they are drained.
+ * drain_mutex serializes the consumers of the rings (writer thread, flush() and stop()) and the file.
+ */
+class TraceState
+{
+public:
+    TraceState() : pid(0), next_tid(1), first(true), drain_ok(false) {}
+    bool open(const QString& fileName) {
+        QMutexLocker lock(&drain_mutex);
+        Q_UNUSED(lock);
+        file.setFileName(fileName);
+        if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+            qWarning("Tracer: can not open '%s': %s", fileName.toUtf8().constData(), file.errorString().toUtf8().constData());
+            return false;
+        }
+        // JSON array format. the trailing ']' is optional, so a trace of a crashed process is still loadable
+        file.write("[\n");
+        rings_mutex.lock();
+        foreach (TraceRing *r, rings) {
+            r->named = false;
+        }
+        rings_mutex.unlock();
+        pid = QCoreApplication::applicationPid();
+        first = true;
+        drain_ok = true;
+        timer.start();
+        return true;
+    }
+    void close() {
+        QMutexLocker lock(&drain_mutex);
+        Q_UNUSED(lock);
+        drain_ok = false;
+        if (!file.isOpen())
+            return;
+        file.write("\n]\n");
+        file.close();
+        qDebug("Tracer: trace is written to '%s'", file.fileName().toUtf8().constData());
+    }
+    TraceRing* localRing() {
+        if (local.hasLocalData())
+            return local.localData()->ring;
+        QByteArray name;
+        QThread *t = QThread::currentThread();
+        if (QCoreApplication::instance() && t == QCoreApplication::instance()->thread())
+            name = "main";
+        else if (t)
+            name = t->objectName().isEmpty() ? QByteArray(t->metaObject()->className()) : t->objectName().toUtf8();
+        QMutexLocker lock(&rings_mutex);
+        Q_UNUSED(lock);
+        TraceRing *r = new TraceRing(next_tid++, name);
+        rings.append(r);
+        local.setLocalData(new TraceRingRef(r));
+        return r;
+    }
+    void drain() {
+        QMutexLocker lock(&drain_mutex);
+        Q_UNUSED(lock);
+        rings_mutex.lock();
+        const QList<TraceRing*> rs(rings);
+        rings_mutex.unlock();
+        QByteArray out;
+        char buf[128];
+        foreach (TraceRing *r, rs) {
+            const bool finished = !!atomic_load_acquire(r->finished);
+            if (drain_ok && !r->named && !r->events.empty()) {
+                r->named = true;
+                out += first ? "" : ",\n";
+                first = false;
+                qsnprintf(buf, sizeof(buf), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lld,\"tid\":%d,\"args\":{\"name\":\"", pid, r->tid);
+                out += buf;
+                out += escaped(r->thread_name);
+                out += "\"}}";
+            }
+            while (!r->events.empty()) {
+                const TraceEvent &e = r->events.front();
+                if (drain_ok) {
+                    out += first ? "" : ",\n";
+                    first = false;
+                    out += "{\"name\":\"";
+                    out += e.name;
+                    qsnprintf(buf, sizeof(buf), "\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%lld,\"tid\":%d", e.phase, double(e.time)/1000.0, pid, r->tid);
+                    out += buf;
+                    if (e.phase == 'i')
+                        out += ",\"s\":\"t\"";
+                    if (e.has_pts) {
+                        qsnprintf(buf, sizeof(buf), ",\"args\":{\"pts\":%.6f}", e.pts);
+                        out += buf;
+                    }
+                    out += "}";
+                }
+                r->events.pop_front();
+            }
+            const int dropped = r->dropped.fetchAndStoreRelaxed(0);
+            if (dropped > 0)
+                qWarning("Tracer: %d events of thread %d (%s) are dropped", dropped, r->tid, r->thread_name.constData());
+            if (finished) {
+                QMutexLocker rlock(&rings_mutex);
+                Q_UNUSED(rlock);
+                rings.removeAll(r);
+                delete r;
+            }
+        }
+        if (drain_ok && !out.isEmpty()) {
+            file.write(out);
+            file.flush();
+        }
+    }
+    QElapsedTimer timer;
+    qint64 pid;
+    TraceWriter writer;
+private:
+    QMutex rings_mutex;
+    QList<TraceRing*> rings;
+    int next_tid;
+    QThreadStorage<TraceRingRef*> local;
+    QMutex drain_mutex;
+    QFile file;
+    bool first;
+    bool drain_ok; // false: events are discarded
+};
+
+static TraceState* state()
+{
+    static TraceState *s = new TraceState();
+    return s;
+}
+
+void TraceWriter::run()
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    while (!stop) {
+        cond.wait(&mutex, kWriteInterval);
+        mutex.unlock();
+        state()->drain();
+        mutex.lock();
+    }
+}
+
+static void stopTracer()
+{
+    Tracer::stop();
+}
+
+// write the file if the process exits without QCoreApplication
+class TraceFinalizer
+{
+public:
+    ~TraceFinalizer() { Tracer::stop();}
+};
+
+static QAtomicInt sStarted;
+
+// the file is opened and the writer is started at the first event, not while loading the library
+static bool autoStart()
+{
+    if (atomic_load_acquire(sStarted)) // start() was called
+        return true;
+    return Tracer::start(QString::fromLocal8Bit(qgetenv("QTAV_TRACE")));
+}
+} //namespace
+
+// QTAV_TRACE enables recording, the first event starts the trace
+QAtomicInt Tracer::s_enabled(!qgetenv("QTAV_TRACE").isEmpty());
+static TraceFinalizer sTraceFinalizer;
+
+bool Tracer::start(const QString &fileName)
+{
+    atomic_store_release(sStarted, 1);
+    stop();
+    TraceState *s = state();
+    // events recorded before are discarded
+    s->drain();
+    if (!s->open(fileName))
+        return false;
+    s->writer.stop = false;
+    s->writer.start();
+    atomic_store_release(s_enabled, 1);
+    static bool post_routine = false;
+    if (!post_routine && QCoreApplication::instance()) {
+        post_routine = true;
+        qAddPostRoutine(stopTracer);
+    }
+    return true;
+}
+
+void Tracer::stop()
+{
+    if (!atomic_load_acquire(s_enabled))
+        return;
+    atomic_store_release(s_enabled, 0);
+    TraceState *s = state();
+    if (!s->writer.isRunning())
+        return;
+    s->writer.mutex.lock();
+    s->writer.stop = true;
+    s->writer.cond.wakeAll();
+    s->writer.mutex.unlock();
+    s->writer.wait();
+    s->drain();
+    s->close();
+}
+
+void Tracer::flush()
+{
+    if (isEnabled())
+        state()->drain();
+}
+
+void Tracer::record(char phase, const char *name, qreal pts, bool hasPts)
+{
+    static const bool started = autoStart();
+    if (!started)
+        return;
+    TraceState *s = state();
+    TraceEvent e;
+    e.name = name;
+    e.time = s->timer.nsecsElapsed();
+    e.pts = pts;
+    e.phase = phase;
+    e.has_pts = hasPts;
+    TraceRing *r = s->localRing();
+    if (!r->events.push_back(e))
+        r->dropped.ref();
+}
+} //namespace QtAV
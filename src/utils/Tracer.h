@@ -0,0 +1,109 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_TRACER_H
+#define QTAV_TRACER_H
+
+#include <QtCore/QString>
+#include "utils/spsc_ring.h" // atomic helpers
+
+namespace QtAV {
+/*!
+ * \brief The Tracer class
+ * Records begin/end/instant events of the playback pipeline with the thread and pts, and writes them
+ * as Chrome trace event JSON, which can be loaded by chrome://tracing or https://ui.perfetto.dev
+ * Set environment var QTAV_TRACE to the output file path to trace the whole process, or call start()/stop().
+ * Every thread records to its own lock-free ring, a writer thread appends the rings to the file every 100ms.
+ * If a ring is full, the event is dropped and counted. If tracing is disabled, recording an event is a flag check.
+ * Event names are not copied, use string literals.
+ */
+class Tracer
+{
+public:
+    static bool isEnabled() { return !!atomic_load_relaxed(s_enabled);}
+    /*!
+     * \brief start
+     * Stop the current trace if any and start to record to a new file.
+     * \return false if the file can not be opened
+     */
+    static bool start(const QString& fileName);
+    /// write all recorded events and close the file. called at exit automatically
+    static void stop();
+    /// write the recorded events now
+    static void flush();
+
+    static void begin(const char* name) {
+        if (isEnabled())
+            record('B', name, 0, false);
+    }
+    static void begin(const char* name, qreal pts) {
+        if (isEnabled())
+            record('B', name, pts, true);
+    }
+    static void end(const char* name) {
+        if (isEnabled())
+            record('E', name, 0, false);
+    }
+    // the pts is merged into the args of the begin event, e.g. the pts of a packet known after reading
+    static void end(const char* name, qreal pts) {
+        if (isEnabled())
+            record('E', name, pts, true);
+    }
+    static void instant(const char* name) {
+        if (isEnabled())
+            record('i', name, 0, false);
+    }
+    static void instant(const char* name, qreal pts) {
+        if (isEnabled())
+            record('i', name, pts, true);
+    }
+private:
+    static void record(char phase, const char* name, qreal pts, bool hasPts);
+    static QAtomicInt s_enabled;
+};
+
+/*!
+ * \brief The TraceScope class
+ * Records a begin event on construction and the end event on stop() or destruction.
+ */
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name) : m_name(Tracer::isEnabled() ? name : 0) {
+        if (m_name)
+            Tracer::begin(m_name);
+    }
+    TraceScope(const char* name, qreal pts) : m_name(Tracer::isEnabled() ? name : 0) {
+        if (m_name)
+            Tracer::begin(m_name, pts);
+    }
+    ~TraceScope() { stop();}
+    void stop() {
+        if (!m_name)
+            return;
+        Tracer::end(m_name);
+        m_name = 0;
+    }
+private:
+    const char* m_name;
+};
+} //namespace QtAV
+#endif // QTAV_TRACER_H
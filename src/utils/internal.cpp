@@ -80,6 +80,15 @@ QString appDataDir()
 #endif // 5.0.0
 }
 
+QString appCacheDir()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+    return QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#else
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#endif
+}
+
 QString appFontsDir()
 {
 #if 0 //qt may return an read only path, for example OSX /System/Library/Fonts
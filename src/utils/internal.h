@@ -40,6 +40,8 @@ namespace Path {
  * \return
  */
 QString appDataDir();
+// writable cache dir. QStandardPaths::CacheLocation
+QString appCacheDir();
 // writable font dir. it's fontsDir() if writable or appFontsDir()/fonts
 /*!
  * \brief appFontsDir
@@ -0,0 +1,118 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_SPSC_RING_H
+#define QTAV_SPSC_RING_H
+
+#include <cassert>
+#include <vector>
+#include <QtCore/QAtomicInt>
+
+namespace QtAV {
+// Qt4 has no loadAcquire()/storeRelease()
+inline int atomic_load_acquire(const QAtomicInt &a) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    return a.loadAcquire();
+#else
+    return const_cast<QAtomicInt&>(a).fetchAndAddAcquire(0);
+#endif
+}
+inline int atomic_load_relaxed(const QAtomicInt &a) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    return a.load();
+#else
+    return a;
+#endif
+}
+inline void atomic_store_release(QAtomicInt &a, int v) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    a.storeRelease(v);
+#else
+    a.fetchAndStoreRelease(v);
+#endif
+}
+
+/*!
+ * \brief The spsc_ring class
+ * A bounded lock-free ring for exactly one producer thread and one consumer thread.
+ * Producer: push_back(), back(), full(), reserve(). Consumer: front(), pop_front().
+ * size() and empty() can be called from any thread, the result may be outdated.
+ * pop_front() does not reset the slot, the consumer must release resources hold by front() itself if needed.
+ * Indices are free running and wrap around, so capacity is always a power of 2.
+ */
+template<typename T>
+class spsc_ring {
+public:
+    explicit spsc_ring(int capacity = 1024, const T& t = T()) : m_0(0), m_1(0) {
+        int c = 1;
+        while (c < capacity)
+            c <<= 1;
+        m_data = std::vector<T>(c, t);
+        m_mask = c - 1;
+    }
+    size_t capacity() const { return m_data.size();}
+    size_t size() const { return (unsigned)atomic_load_acquire(m_1) - (unsigned)atomic_load_acquire(m_0);}
+    bool empty() const { return size() == 0;}
+    bool full() const { return size() >= capacity();}
+    // producer. return false if no free slot
+    bool push_back(const T &t) {
+        const unsigned i = (unsigned)atomic_load_relaxed(m_1);
+        if (i - (unsigned)atomic_load_acquire(m_0) >= capacity())
+            return false;
+        m_data[i & m_mask] = t;
+        // ordered: a parked consumer is checked after publishing. see PacketBuffer
+        m_1.fetchAndStoreOrdered(int(i + 1));
+        return true;
+    }
+    T &back() { assert(!empty()); return m_data[((unsigned)atomic_load_relaxed(m_1) - 1) & m_mask];}
+    // consumer
+    T &front() { assert(!empty()); return m_data[(unsigned)atomic_load_relaxed(m_0) & m_mask];}
+    // peek from any thread. the slot is always valid memory but the value may be outdated if the ring is changed
+    const T &back() const { return m_data[((unsigned)atomic_load_acquire(m_1) - 1) & m_mask];}
+    const T &front() const { return m_data[(unsigned)atomic_load_acquire(m_0) & m_mask];}
+    void pop_front() {
+        assert(!empty());
+        m_0.fetchAndStoreOrdered(int((unsigned)atomic_load_relaxed(m_0) + 1));
+    }
+    /*!
+     * Grow to at least capacity slots. Indices are not changed, so size() and empty() from other threads are still valid.
+     * Called by the producer. The caller must exclude the consumer and the const peeks while the slots are moved.
+     */
+    void reserve(int capacity) {
+        size_t c = m_data.size();
+        if (size_t(capacity) <= c)
+            return;
+        while (c < size_t(capacity))
+            c <<= 1;
+        std::vector<T> data(c);
+        const unsigned end = (unsigned)atomic_load_relaxed(m_1);
+        for (unsigned i = (unsigned)atomic_load_relaxed(m_0); i != end; ++i)
+            data[i & (c - 1)] = m_data[i & m_mask];
+        m_data.swap(data);
+        m_mask = unsigned(c - 1);
+    }
+private:
+    QAtomicInt m_0, m_1; // read index (consumer), write index (producer)
+    unsigned m_mask;
+    std::vector<T> m_data;
+};
+} //namespace QtAV
+#endif // QTAV_SPSC_RING_H
@@ -0,0 +1,163 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * BlockingQueue checks: takeUpTo() order and limits, and that each side wakes the other side only when it can
+ * continue: a consumer blocked on empty queue is woken when the threshold is reached, a producer blocked on
+ * full queue is woken by take()/takeUpTo(), and setBlocking(false) wakes both. putMany() of a batch larger than the
+ * free capacity waits for room and keeps the order.
+ * usage: blockingqueue
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QThread>
+#include "utils/BlockingQueue.h"
+#include <stdio.h>
+
+using namespace QtAV;
+
+typedef BlockingQueue<int> Queue;
+
+class Taker : public QThread
+{
+public:
+    Taker(Queue *q) : queue(q), value(-1) {}
+    Queue *queue;
+    int value;
+protected:
+    void run() { value = queue->take();}
+};
+
+class Putter : public QThread
+{
+public:
+    Putter(Queue *q, int n) : queue(q), count(n) {}
+    Queue *queue;
+    int count;
+protected:
+    void run() {
+        for (int i = 0; i < count; ++i)
+            queue->put(i);
+    }
+};
+
+class BatchPutter : public QThread
+{
+public:
+    BatchPutter(Queue *q, int n) : queue(q) {
+        for (int i = 0; i < n; ++i)
+            batch.append(i);
+    }
+    Queue *queue;
+    QList<int> batch;
+protected:
+    void run() { queue->putMany(batch);}
+};
+
+static bool check(bool ok, const char* what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    return ok;
+}
+
+// true if the thread is still blocked after ms
+static bool blocked(QThread *t, int ms = 100)
+{
+    return !t->wait(ms);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    bool ok = true;
+    {
+        Queue q;
+        q.setCapacity(8);
+        q.setThreshold(1);
+        for (int i = 0; i < 5; ++i)
+            q.put(i);
+        const QList<int> a3(q.takeUpTo(3));
+        const QList<int> rest(q.takeUpTo(100));
+        ok &= check(a3.size() == 3 && a3.at(0) == 0 && a3.at(2) == 2, "takeUpTo(3) takes the first 3 elements");
+        ok &= check(rest.size() == 2 && rest.at(0) == 3 && rest.at(1) == 4 && q.isEmpty(), "takeUpTo(n) takes the rest");
+        q.blockEmpty(false);
+        ok &= check(q.takeUpTo(4).isEmpty(), "takeUpTo() of an empty non-blocking queue is empty");
+    }
+    {
+        // consumer is not woken before the threshold
+        Queue q;
+        q.setCapacity(8);
+        q.setThreshold(3);
+        Taker t(&q);
+        t.start();
+        q.put(10);
+        q.put(11);
+        ok &= check(blocked(&t), "take() waits until the threshold");
+        q.put(12);
+        ok &= check(!blocked(&t, 3000) && t.value == 10, "put() wakes take() at the threshold");
+    }
+    {
+        // producer blocked on full queue is woken by a consumer, not by another put
+        Queue q;
+        q.setCapacity(4);
+        q.setThreshold(2);
+        Putter p(&q, 6);
+        p.start();
+        ok &= check(blocked(&p) && q.size() == 4, "put() waits on a full queue");
+        const QList<int> ts(q.takeUpTo(4));
+        ok &= check(!blocked(&p, 3000) && ts.size() == 4 && q.size() == 2, "takeUpTo() wakes a full producer");
+    }
+    {
+        // batch of 10 into a queue with room for 4
+        Queue q;
+        q.setCapacity(4);
+        q.setThreshold(2);
+        BatchPutter p(&q, 10);
+        p.start();
+        ok &= check(blocked(&p) && q.size() == 4, "putMany() waits when the queue is full");
+        QList<int> ts(q.takeUpTo(4));
+        ok &= check(blocked(&p) && q.size() == 4, "putMany() fills the room and waits for the rest");
+        ts += q.takeUpTo(4);
+        ok &= check(!blocked(&p, 3000) && q.size() == 2, "putMany() returns when all are enqueued");
+        ts += q.takeUpTo(4);
+        ok &= check(ts == p.batch, "putMany() keeps the order");
+        q.blockFull(false);
+        q.putMany(p.batch);
+        ok &= check(q.size() == 10, "putMany() does not wait if blockFull(false)");
+    }
+    {
+        Queue q;
+        q.setCapacity(2);
+        q.setThreshold(1);
+        q.put(0);
+        q.put(1);
+        Putter p(&q, 1);
+        p.start();
+        Queue empty;
+        Taker t(&empty);
+        t.start();
+        ok &= check(blocked(&p) && blocked(&t), "put() on full and take() on empty queues wait");
+        q.setBlocking(false);
+        empty.setBlocking(false);
+        ok &= check(!blocked(&p, 3000) && !blocked(&t, 3000) && q.size() == 3, "setBlocking(false) wakes both sides");
+    }
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return !ok;
+}
@@ -0,0 +1,140 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * CommandSlots checks: post() coalesces (latest value wins), add() counts every request, pending bits, and the same
+ * with producer threads racing with the consumer: posted values are never taken out of order and the last one is
+ * always taken, no add() is lost.
+ * usage: commandslots [-n posts]
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include "utils/CommandSlots.h"
+#include <stdio.h>
+
+using namespace QtAV;
+
+enum { Post = 0, Add = 1, Other = 2, NbTypes };
+typedef CommandSlots<NbTypes> Slots;
+
+class Poster : public QThread
+{
+public:
+    Poster(Slots *s, int n) : slots(s), count(n) {}
+protected:
+    void run() {
+        for (int i = 0; i < count; ++i)
+            slots->post(Post, i);
+    }
+private:
+    Slots *slots;
+    int count;
+};
+
+class Adder : public QThread
+{
+public:
+    Adder(Slots *s, int n) : slots(s), count(n) {}
+protected:
+    void run() {
+        for (int i = 0; i < count; ++i)
+            slots->add(Add);
+    }
+private:
+    Slots *slots;
+    int count;
+};
+
+static bool check(bool ok, const char* what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    int n = 1000000;
+    const int idx = a.arguments().indexOf(QLatin1String("-n"));
+    if (idx > 0)
+        n = a.arguments().at(idx + 1).toInt();
+    bool ok = true;
+    {
+        Slots s;
+        ok &= check(s.isEmpty() && s.takePending() == 0 && s.take(Post) == Slots::kNoValue, "empty");
+        s.post(Post, 1);
+        s.post(Post, 2);
+        s.post(Post, 3);
+        s.add(Add);
+        s.add(Add);
+        ok &= check(s.takePending() == ((1 << Post) | (1 << Add)) && s.isEmpty(), "pending bits of posted types only");
+        ok &= check(s.take(Post) == 3 && s.take(Post) == Slots::kNoValue, "latest value wins, taken once");
+        ok &= check(s.take(Add) == 2, "add() is counted");
+        s.post(Other, 0);
+        s.clear();
+        ok &= check(s.isEmpty() && s.take(Other) == Slots::kNoValue, "clear");
+    }
+    {
+        Slots s;
+        Poster poster(&s, n);
+        QList<Adder*> adders;
+        for (int i = 0; i < 4; ++i)
+            adders.append(new Adder(&s, n/4));
+        poster.start();
+        foreach (Adder* t, adders) {
+            t->start();
+        }
+        int last = -1, taken = 0, added = 0;
+        bool ordered = true;
+        bool running = true;
+        while (running || !s.isEmpty()) {
+            running = poster.isRunning();
+            foreach (Adder* t, adders) {
+                running |= t->isRunning();
+            }
+            const int pending = s.takePending();
+            if (pending & (1 << Post)) {
+                const int v = s.take(Post);
+                if (v != Slots::kNoValue) { // may be taken with a previous pending bit
+                    ordered &= v > last;
+                    last = v;
+                    ++taken;
+                }
+            }
+            if (pending & (1 << Add)) {
+                const int v = s.take(Add);
+                if (v != Slots::kNoValue)
+                    added += v;
+            }
+        }
+        poster.wait();
+        foreach (Adder* t, adders) {
+            t->wait();
+        }
+        qDeleteAll(adders);
+        printf("%d posts coalesced to %d takes\n", n, taken);
+        ok &= check(ordered && last == n - 1, "concurrent post(): in order and the latest is taken");
+        ok &= check(added == (n/4)*4, "concurrent add(): no request is lost");
+    }
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return !ok;
+}
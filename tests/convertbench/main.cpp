@@ -0,0 +1,119 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * VideoFrame::to() throughput. The benchmark runs itself twice, with QTAV_CONVERTER_CACHE=0 (a new converter for
+ * each call) and with the default converter cache, then prints conversions per second for each target size.
+ * usage: convertbench [-s WxH] [-n conversions] [-fmt yuv420p] [-to rgb32]
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QProcess>
+#include <QtCore/QProcessEnvironment>
+#include <QtCore/QStringList>
+#include <QtAV/VideoFrame.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace QtAV;
+
+static int runChild(const VideoFrame& src, const VideoFormat& fmt, int n)
+{
+    const QSize sizes[] = { src.size(), src.size()/2, QSize(160, 90) };
+    for (size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        for (int k = 0; k < n; ++k) {
+            const VideoFrame f(src.to(fmt, sizes[i]));
+            if (!f.isValid()) {
+                printf("conversion failed\n");
+                return 1;
+            }
+        }
+        const qint64 elapsed = qMax<qint64>(1, timer.elapsed());
+        printf("  => %dx%d: %8.1f conversions/s\n", sizes[i].width(), sizes[i].height(), n*1000.0/elapsed);
+    }
+    return 0;
+}
+
+static bool runProcess(const QString& name, const QString& cache)
+{
+    QStringList args(QCoreApplication::arguments().mid(1));
+    args << QString::fromLatin1("-child");
+    QProcessEnvironment env(QProcessEnvironment::systemEnvironment());
+    if (cache.isEmpty())
+        env.remove(QString::fromLatin1("QTAV_CONVERTER_CACHE"));
+    else
+        env.insert(QString::fromLatin1("QTAV_CONVERTER_CACHE"), cache);
+    QProcess p;
+    p.setProcessEnvironment(env);
+    p.setProcessChannelMode(QProcess::ForwardedChannels);
+    printf("%s\n", qPrintable(name));
+    fflush(stdout);
+    p.start(QCoreApplication::applicationFilePath(), args);
+    if (!p.waitForFinished(-1) || p.exitCode() != 0) {
+        printf("%s run failed\n", qPrintable(name));
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication a(argc, argv);
+    int w = 1920, h = 1080;
+    int idx = a.arguments().indexOf(QLatin1String("-s"));
+    if (idx > 0) {
+        const QStringList wh = a.arguments().at(idx+1).split(QLatin1Char('x'));
+        if (wh.size() == 2) {
+            w = wh.at(0).toInt();
+            h = wh.at(1).toInt();
+        }
+    }
+    int n = 200;
+    idx = a.arguments().indexOf(QLatin1String("-n"));
+    if (idx > 0)
+        n = a.arguments().at(idx+1).toInt();
+    VideoFormat fmt(VideoFormat::Format_YUV420P);
+    idx = a.arguments().indexOf(QLatin1String("-fmt"));
+    if (idx > 0)
+        fmt = VideoFormat(a.arguments().at(idx+1));
+    VideoFormat fmt_out(VideoFormat::Format_RGB32);
+    idx = a.arguments().indexOf(QLatin1String("-to"));
+    if (idx > 0)
+        fmt_out = VideoFormat(a.arguments().at(idx+1));
+    VideoFrame src(w, h, fmt);
+    if (src.allocate() <= 0) {
+        printf("invalid frame %dx%d %s\n", w, h, qPrintable(fmt.name()));
+        return 1;
+    }
+    for (int i = 0; i < src.planeCount(); ++i)
+        memset(src.bits(i), 0x80, src.bytesPerLine(i)*src.planeHeight(i));
+    if (a.arguments().contains(QLatin1String("-child")))
+        return runChild(src, fmt_out, n);
+    printf("%dx%d %s => %s, %d conversions\n", w, h, qPrintable(fmt.name()), qPrintable(fmt_out.name()), n);
+    fflush(stdout);
+    if (!runProcess(QString::fromLatin1("no cache (QTAV_CONVERTER_CACHE=0)"), QString::fromLatin1("0")))
+        return 1;
+    if (!runProcess(QString::fromLatin1("converter cache"), QString()))
+        return 1;
+    return 0;
+}
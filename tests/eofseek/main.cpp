@@ -0,0 +1,151 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * Seek after the demuxer reached the end, and idle cost of a paused player.
+ * The player seeks near the end and pauses, so the demux thread is at eof and a/v threads are paused. Then
+ * 1. count the context switches of all threads in the process for some seconds (linux only), i.e. idle wakeups/s
+ * 2. seek again and again, measure the time from seek() to seekFinished()
+ * Audio goes to the null backend, no video renderer.
+ * usage: eofseek -f file [-n seeks] [-t idle_seconds]
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFile>
+#include <QtCore/QStringList>
+#include <QtCore/QTimer>
+#include <QtCore/QVector>
+#include <QtAV/AVPlayer.h>
+#include <QtAV/AudioOutput.h>
+#include <algorithm>
+#include <stdio.h>
+
+using namespace QtAV;
+
+// voluntary + nonvoluntary context switches of all threads. -1 if not supported
+static qint64 contextSwitches()
+{
+    QDir dir(QString::fromLatin1("/proc/self/task"));
+    if (!dir.exists())
+        return -1;
+    qint64 n = 0;
+    foreach (const QString& tid, dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QFile f(dir.absoluteFilePath(tid) + QString::fromLatin1("/status"));
+        if (!f.open(QIODevice::ReadOnly))
+            continue;
+        foreach (const QByteArray& line, f.readAll().split('\n')) {
+            if (line.endsWith("ctxt_switches:") || !line.contains("ctxt_switches:"))
+                continue;
+            n += line.mid(line.indexOf(':') + 1).trimmed().toLongLong();
+        }
+    }
+    return n;
+}
+
+// run the event loop until signal is emitted or timeout. return elapsed ms, -1 if timeout
+static qint64 waitFor(QObject *obj, const char* signal, int timeout)
+{
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    QObject::connect(&timer, SIGNAL(timeout()), &loop, SLOT(quit()));
+    QObject::connect(obj, signal, &loop, SLOT(quit()));
+    QElapsedTimer t;
+    t.start();
+    timer.start(timeout);
+    loop.exec();
+    return timer.isActive() ? t.elapsed() : -1;
+}
+
+static void sleepEventLoop(int ms)
+{
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, SLOT(quit()));
+    loop.exec();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QString file;
+    int seeks = 20;
+    int idle = 5;
+    int idx = a.arguments().indexOf(QLatin1String("-f"));
+    if (idx > 0)
+        file = a.arguments().at(idx + 1);
+    idx = a.arguments().indexOf(QLatin1String("-n"));
+    if (idx > 0)
+        seeks = a.arguments().at(idx + 1).toInt();
+    idx = a.arguments().indexOf(QLatin1String("-t"));
+    if (idx > 0)
+        idle = a.arguments().at(idx + 1).toInt();
+    if (file.isEmpty()) {
+        fprintf(stderr, "usage: %s -f file [-n seeks] [-t idle_seconds]\n", argv[0]);
+        return 1;
+    }
+    AVPlayer player;
+    player.audio()->setBackends(QStringList() << QString::fromLatin1("null"));
+    player.setFile(file);
+    player.play();
+    if (waitFor(&player, SIGNAL(started()), 5000) < 0) {
+        fprintf(stderr, "Failed to play %s\n", file.toUtf8().constData());
+        return 1;
+    }
+    const qint64 duration = player.duration();
+    // the rest packets are less than the buffer, so demux thread reads to the end at once
+    const qint64 tail = qMin<qint64>(1000, duration/2);
+    player.seek(duration - tail);
+    waitFor(&player, SIGNAL(seekFinished()), 3000);
+    player.pause(true);
+    sleepEventLoop(500);
+
+    const qint64 cs0 = contextSwitches();
+    sleepEventLoop(idle*1000);
+    const qint64 cs1 = contextSwitches();
+    if (cs0 < 0)
+        printf("idle wakeups: not supported on this platform\n");
+    else
+        printf("idle wakeups: %.1f/s in %ds (including the main thread timer)\n", qreal(cs1 - cs0)/qreal(idle), idle);
+
+    QVector<qint64> latency;
+    int timeouts = 0;
+    for (int i = 0; i < seeks; ++i) {
+        // demux thread reaches the end again after each seek
+        player.seek(duration - tail + qint64(i%4)*tail/8);
+        const qint64 ms = waitFor(&player, SIGNAL(seekFinished()), 3000);
+        if (ms < 0)
+            timeouts++;
+        else
+            latency.append(ms);
+        sleepEventLoop(200);
+    }
+    std::sort(latency.begin(), latency.end());
+    if (latency.isEmpty()) {
+        printf("seek after eof: all %d seeks timed out\n", seeks);
+    } else {
+        printf("seek after eof: %d seeks, timeout: %d, latency min: %lldms, p50: %lldms, p95: %lldms, max: %lldms\n"
+               , latency.size(), timeouts, latency.first(), latency.at(latency.size()/2), latency.at(latency.size()*95/100), latency.last());
+    }
+    player.stop();
+    return timeouts > 0;
+}
@@ -40,6 +40,8 @@ public:
         view->widget()->resize(400, 300);
         view->widget()->show();
         connect(&extractor, SIGNAL(frameExtracted(QtAV::VideoFrame)), this, SLOT(onVideoFrameExtracted(QtAV::VideoFrame)));
+        connect(&extractor, SIGNAL(batchFrameExtracted(QtAV::VideoFrame,qint64)), this, SLOT(onBatchFrameExtracted(QtAV::VideoFrame,qint64)));
+        connect(&extractor, SIGNAL(batchFinished()), this, SLOT(onBatchFinished()));
     }
     void setParameters(qint64 msec, int count) {
         pos = msec;
@@ -59,6 +61,16 @@ public:
         timer.start();
         extractor.setPosition(pos);
     }
+    void startBatch(const QString& file, bool async, const QSize& size) {
+        extractor.setAsync(async);
+        extractor.setSource(file);
+        QList<qint64> positions;
+        for (int i = 0; i < nb; ++i)
+            positions.append(pos + i*1000);
+        startTimer(20);
+        timer.start();
+        extractor.extractBatch(positions, size);
+    }
 
 public Q_SLOTS:
     void onVideoFrameExtracted(const QtAV::VideoFrame& frame) {
@@ -72,6 +84,15 @@ public Q_SLOTS:
         }
         extractor.setPosition(pos + extracted*1000);
     }
+    void onBatchFrameExtracted(const QtAV::VideoFrame& frame, qint64 position) {
+        view->receive(frame);
+        frame.toImage().save(QString::fromLatin1("batch_%1.png").arg(position));
+        qDebug("frame %dx%d @%f for %lld", frame.width(), frame.height(), frame.timestamp(), position);
+        ++extracted;
+    }
+    void onBatchFinished() {
+        qDebug("batch finished. %d/%d frames. elapsed: %lld.", extracted, nb, timer.elapsed());
+    }
 protected:
     void timerEvent(QTimerEvent *) {
         qApp->processEvents(); // avoid ui blocking if async is not used
@@ -91,7 +112,7 @@ int main(int argc, char** argv)
     QApplication a(argc, argv);
     int idx = a.arguments().indexOf(QLatin1String("-f"));
     if (idx < 0) {
-        qDebug("-f file -t sec -n count -asyc");
+        qDebug("-f file -t sec -n count -asyc -batch [-w width] [-h height]");
         return -1;
     }
     QString file = a.arguments().at(idx+1);
@@ -104,11 +125,19 @@ int main(int argc, char** argv)
     if (idx > 0)
         n = a.arguments().at(idx+1).toInt();
     bool async = a.arguments().contains(QString::fromLatin1("-async"));
-
+    QSize size;
+    idx = a.arguments().indexOf(QLatin1String("-w"));
+    if (idx > 0)
+        size.setWidth(a.arguments().at(idx+1).toInt());
+    idx = a.arguments().indexOf(QLatin1String("-h"));
+    if (idx > 0)
+        size.setHeight(a.arguments().at(idx+1).toInt());
 
     VideoFrameObserver obs;
     obs.setParameters(t*1000, n);
-    if (async)
+    if (a.arguments().contains(QString::fromLatin1("-batch")))
+        obs.startBatch(file, async, size);
+    else if (async)
         obs.startAsync(file);
     else
         obs.start(file);
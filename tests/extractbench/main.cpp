@@ -0,0 +1,144 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * Thumbnail benchmark: extract n frames evenly spread over the file with VideoFrameExtractor::extractBatch(), once
+ * for each worker count 1, 2, 4, ... j, and print thumbnails per second. Every run uses a new extractor, so the
+ * time to open the demuxers and decoders is included. ThumbnailCache is disabled for these runs. Then extract
+ * the same frames twice with ThumbnailCache (and its disk tier if -disk) and print the cache counters.
+ * usage: extractbench -f file [-n count] [-j max_workers] [-w width] [-h height] [-disk]
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtAV/AVDemuxer.h>
+#include <QtAV/ThumbnailCache.h>
+#include <QtAV/VideoFrameExtractor.h>
+#include <stdio.h>
+
+using namespace QtAV;
+
+class Counter : public QObject
+{
+    Q_OBJECT
+public:
+    Counter() : count(0) {}
+    QAtomicInt count;
+public Q_SLOTS:
+    // called in worker threads
+    void onFrame(const QtAV::VideoFrame& frame, qint64) {
+        if (frame.isValid())
+            count.ref();
+    }
+};
+
+// return elapsed ms
+static qint64 runBatch(const QString& file, const QList<qint64>& positions, const QSize& size, int workers, int *frames)
+{
+    Counter counter;
+    VideoFrameExtractor extractor;
+    QObject::connect(&extractor, SIGNAL(batchFrameExtracted(QtAV::VideoFrame,qint64)), &counter, SLOT(onFrame(QtAV::VideoFrame,qint64)), Qt::DirectConnection);
+    QEventLoop loop;
+    QObject::connect(&extractor, SIGNAL(batchFinished()), &loop, SLOT(quit()), Qt::QueuedConnection);
+    // async: setSource() releases resources in the extract thread, a batch in this thread would race with it
+    extractor.setAsync(true);
+    extractor.setSource(file);
+    extractor.setWorkers(workers);
+    QElapsedTimer timer;
+    timer.start();
+    extractor.extractBatch(positions, size);
+    loop.exec();
+    *frames = counter.count.fetchAndAddRelaxed(0);
+    return qMax<qint64>(timer.elapsed(), 1);
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication a(argc, argv);
+    int idx = a.arguments().indexOf(QLatin1String("-f"));
+    if (idx < 0) {
+        printf("usage: extractbench -f file [-n count] [-j max_workers] [-w width] [-h height] [-disk]\n");
+        return -1;
+    }
+    const QString file = a.arguments().at(idx+1);
+    int n = 100;
+    idx = a.arguments().indexOf(QLatin1String("-n"));
+    if (idx > 0)
+        n = a.arguments().at(idx+1).toInt();
+    int max_workers = QThread::idealThreadCount();
+    idx = a.arguments().indexOf(QLatin1String("-j"));
+    if (idx > 0)
+        max_workers = a.arguments().at(idx+1).toInt();
+    QSize size(160, 0);
+    idx = a.arguments().indexOf(QLatin1String("-w"));
+    if (idx > 0)
+        size.setWidth(a.arguments().at(idx+1).toInt());
+    idx = a.arguments().indexOf(QLatin1String("-h"));
+    if (idx > 0)
+        size.setHeight(a.arguments().at(idx+1).toInt());
+
+    AVDemuxer demuxer;
+    demuxer.setMedia(file);
+    if (!demuxer.load() || demuxer.duration() <= 0) {
+        printf("can not load %s\n", qPrintable(file));
+        return -1;
+    }
+    const qint64 duration = demuxer.duration();
+    demuxer.unload();
+    QList<qint64> positions;
+    for (int i = 0; i < n; ++i)
+        positions.append(duration*i/n);
+
+    printf("%d thumbnails %dx%d, duration %lldms\n", n, size.width(), size.height(), duration);
+    printf("workers  frames  elapsed(ms)  thumbnails/s  speedup\n");
+    QList<int> workers;
+    for (int j = 1; j < max_workers; j *= 2)
+        workers.append(j);
+    workers.append(qMax(max_workers, 1));
+    ThumbnailCache &cache = ThumbnailCache::instance();
+    const qint64 cache_bytes = cache.maxBytes();
+    cache.setMaxBytes(0); // measure decoding
+    double base = 0;
+    foreach (int j, workers) {
+        int frames = 0;
+        const qint64 elapsed = runBatch(file, positions, size, j, &frames);
+        const double rate = frames*1000.0/elapsed;
+        if (j == 1)
+            base = rate;
+        printf("%7d  %6d  %11lld  %12.1f  %7.2f\n", j, frames, elapsed, rate, base > 0 ? rate/base : 0.0);
+    }
+    // the same thumbnails again, the 2nd run is served by ThumbnailCache
+    cache.setMaxBytes(cache_bytes);
+    cache.setDiskCacheEnabled(a.arguments().contains(QLatin1String("-disk")));
+    printf("ThumbnailCache (disk: %d)\n", cache.isDiskCacheEnabled());
+    printf("run  frames  elapsed(ms)  hits  disk_hits  misses\n");
+    for (int i = 0; i < 2; ++i) {
+        cache.resetCounters();
+        int frames = 0;
+        const qint64 elapsed = runBatch(file, positions, size, 1, &frames);
+        printf("%3d  %6d  %11lld  %4lld  %9lld  %6lld\n", i, frames, elapsed, cache.hits(), cache.diskHits(), cache.misses());
+    }
+    return 0;
+}
+
+#include "main.moc"
@@ -0,0 +1,10 @@
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = framedrop
+QT -= gui
+
+PROJECTROOT = $$PWD/../..
+include($$PROJECTROOT/src/libQtAV.pri)
+preparePaths($$OUT_PWD/../../out)
+# FrameDropController is not exported
+SOURCES += main.cpp $$PROJECTROOT/src/FrameDropController.cpp
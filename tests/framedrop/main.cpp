@@ -0,0 +1,171 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * FrameDropController with synthetic cost traces. Each trace gives decode cost for every decode mode and frame type,
+ * filter and render cost. A frame is decoded when it is due or immediately if late, so the lateness of the next frame
+ * is max(0, lateness + cost - frame interval), and a discarded packet costs nothing. Costs have +-10% deterministic noise.
+ * usage: framedrop [-n frames] [-v]
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QStringList>
+#include <stdio.h>
+#include "FrameDropController.h"
+
+using namespace QtAV;
+
+struct Trace {
+    const char *name;
+    qreal fps;
+    qreal decode[FrameDropController::NbDecodeModes][2]; // [mode][key frame]
+    qreal filter, render;
+    bool pipelined;
+    int gop;
+    qreal lateness; // initial
+};
+
+struct Result {
+    Result() : frames(0), rendered(0), waited(0), max_lateness(0), mean_lateness(0), last_lateness(0) {
+        for (int i = 0; i < FrameDropController::NbDecodeModes; ++i)
+            modes[i] = 0;
+    }
+    int frames, rendered, waited; // waited: packets discarded while waiting for a key frame
+    qreal max_lateness, mean_lateness; // of the 2nd half
+    qreal last_lateness;
+    int modes[FrameDropController::NbDecodeModes]; // decode mode of the 2nd half
+};
+
+static const char* kActionName[] = { "Render", "SkipLoopFilter", "SkipRender", "SkipNonRef", "WaitKeyFrame" };
+
+static Result simulate(const Trace& t, int frames, bool verbose)
+{
+    FrameDropController c;
+    c.setFrameRate(t.fps);
+    c.setPipelined(t.pipelined);
+    const qreal dt = 1.0/t.fps;
+    quint32 seed = 1;
+    qreal late = t.lateness;
+    bool wait_key = false;
+    Result r;
+    r.frames = frames;
+    int nb_late = 0;
+    for (int i = 0; i < frames; ++i) {
+        const bool key = i % t.gop == 0;
+        const bool second_half = i >= frames/2;
+        if (wait_key && !key) {
+            ++r.waited;
+            late = qMax<qreal>(0, late - dt);
+            continue;
+        }
+        wait_key = false;
+        const FrameDropController::Action a = c.decide(late, key);
+        if (verbose)
+            printf("%d%s lateness: %.4f => %s, mode %d\n", i, key ? "k" : "", late, kActionName[a], c.decodeMode());
+        if (a == FrameDropController::WaitKeyFrame) {
+            wait_key = true;
+            ++r.waited;
+            late = qMax<qreal>(0, late - dt);
+            continue;
+        }
+        seed = seed*1103515245u + 12345u;
+        const qreal noise = 0.9 + 0.2*qreal((seed >> 16) & 0x7fff)/qreal(0x7fff);
+        const qreal dec = t.decode[c.decodeMode()][key]*noise;
+        c.addDecodeCost(key, dec);
+        qreal cost = dec;
+        if (a != FrameDropController::SkipRender) {
+            c.addFilterCost(t.filter*noise);
+            c.addRenderCost(t.render*noise);
+            const qreal present = (t.filter + t.render)*noise;
+            cost = t.pipelined ? qMax(dec, present) : dec + present;
+            ++r.rendered;
+        }
+        if (second_half) {
+            r.modes[c.decodeMode()]++;
+            r.max_lateness = qMax(r.max_lateness, late);
+            r.mean_lateness += late;
+            ++nb_late;
+        }
+        late = qMax<qreal>(0, late + cost - dt);
+    }
+    if (nb_late > 0)
+        r.mean_lateness /= qreal(nb_late);
+    r.last_lateness = late;
+    return r;
+}
+
+static int gFailed = 0;
+static void check(const Trace& t, const Result& r, bool ok, const char* expect)
+{
+    if (!ok)
+        ++gFailed;
+    printf("%s %s: rendered %d/%d, waited %d, lateness mean %.4f max %.4f last %.4f, modes %d/%d/%d. expect %s\n"
+           , ok ? "PASS" : "FAIL", t.name, r.rendered, r.frames, r.waited, r.mean_lateness, r.max_lateness, r.last_lateness
+           , r.modes[0], r.modes[1], r.modes[2], expect);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    int n = 1200;
+    int i = a.arguments().indexOf(QLatin1String("-n"));
+    if (i > 0 && i + 1 < argc)
+        n = a.arguments().at(i + 1).toInt();
+    const bool verbose = a.arguments().contains(QLatin1String("-v"));
+
+    //                  name            fps   decode all,     no loop filter,  ref only          filter render pipe gop late
+    const Trace fast = {"fast",        25.0, {{0.010, 0.020}, {0.008, 0.016}, {0.005, 0.020}}, 0.005, 0.005, false, 12, 0};
+    Result r = simulate(fast, n, verbose);
+    check(fast, r, r.rendered == n && r.max_lateness <= 0.04, "all rendered, never late");
+
+    const Trace slow_render = {"slow render", 30.0, {{0.012, 0.020}, {0.010, 0.016}, {0.006, 0.020}}, 0.004, 0.030, false, 15, 0};
+    r = simulate(slow_render, n, verbose);
+    check(slow_render, r, r.rendered > n/3 && r.rendered < n && r.waited == 0 && r.mean_lateness < 0.1
+          && r.modes[FrameDropController::DecodeAll] > r.modes[FrameDropController::DecodeRefOnly], "skip rendering some frames, full decoding");
+
+    const Trace slow_decode = {"slow decode", 25.0, {{0.046, 0.060}, {0.030, 0.045}, {0.022, 0.060}}, 0.002, 0.002, false, 25, 0};
+    r = simulate(slow_decode, n, verbose);
+    check(slow_decode, r, r.rendered > n*9/10 && r.mean_lateness < 0.1
+          && r.modes[FrameDropController::DecodeNoLoopFilter] > n/4, "skip loop filter most of the time");
+
+    const Trace pipelined = {"pipelined", 25.0, {{0.030, 0.035}, {0.022, 0.026}, {0.015, 0.035}}, 0.005, 0.025, true, 12, 0};
+    r = simulate(pipelined, n, verbose);
+    check(pipelined, r, r.rendered == n && r.max_lateness <= 0.04, "all rendered because decoding overlaps rendering");
+    Trace serial = pipelined;
+    serial.name = "serial";
+    serial.pipelined = false;
+    r = simulate(serial, n, verbose);
+    check(serial, r, r.rendered < n && r.mean_lateness < 0.1, "the same costs without the pipeline drop frames");
+
+    const Trace hfr = {"120fps", 120.0, {{0.006, 0.010}, {0.005, 0.008}, {0.003, 0.010}}, 0.001, 0.003, false, 120, 0};
+    r = simulate(hfr, n, verbose);
+    check(hfr, r, r.rendered > n/2 && r.rendered < n && r.mean_lateness < 0.05, "thresholds scale with fps");
+
+    const Trace too_late = {"too late", 25.0, {{0.020, 0.030}, {0.016, 0.024}, {0.010, 0.030}}, 0.004, 0.004, false, 50, 3.0};
+    r = simulate(too_late, n, verbose);
+    check(too_late, r, r.waited > 0 && r.waited < 50 && r.last_lateness < 0.04, "wait for the next key frame then recover");
+
+    const Trace overload = {"overload", 25.0, {{0.060, 0.080}, {0.052, 0.070}, {0.045, 0.080}}, 0.002, 0.002, false, 25, 0};
+    r = simulate(overload, n, verbose);
+    check(overload, r, r.waited > 0 && r.max_lateness <= 2.1, "lateness is bounded by waiting for key frames");
+
+    printf("%s\n", gFailed ? "FAILED" : "ALL PASSED");
+    return gFailed ? 1 : 0;
+}
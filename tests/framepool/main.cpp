@@ -0,0 +1,95 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * FrameBufferPool benchmark: clone() and allocate() frames of the given size, keeping the last few frames alive
+ * like a renderer queue, with the pool disabled and enabled. Prints frames per second, hit rate and resident bytes.
+ * usage: framepool [-s WxH] [-n frames] [-q queued_frames] [-fmt yuv420p]
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QQueue>
+#include <QtCore/QStringList>
+#include <QtAV/FrameBufferPool.h>
+#include <QtAV/VideoFrame.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace QtAV;
+
+static void run(const char* name, bool pool, const VideoFrame& src, int n, int queued)
+{
+    FrameBufferPool &p = FrameBufferPool::instance();
+    p.clear();
+    p.setMaxFreeBytes(pool ? 256*1024*1024 : 0);
+    p.resetStatistics();
+    QQueue<VideoFrame> frames;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < n; ++i) {
+        VideoFrame f(src.clone());
+        frames.enqueue(f);
+        VideoFrame a(src.width(), src.height(), src.format());
+        a.allocate();
+        memset(a.bits(0), i, a.bytesPerLine(0)*a.planeHeight(0)); // touch the pages
+        frames.enqueue(a);
+        while (frames.size() > queued)
+            frames.dequeue();
+    }
+    const qint64 elapsed = qMax<qint64>(1, timer.elapsed());
+    printf("%-8s %6.1f frames/s  hit rate %5.1f%%  resident %lld KB\n", name, 2.0*n*1000.0/elapsed
+           , p.hitRate()*100.0, p.residentBytes()/1024);
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication a(argc, argv);
+    int w = 3840, h = 2160;
+    int idx = a.arguments().indexOf(QLatin1String("-s"));
+    if (idx > 0) {
+        const QStringList wh = a.arguments().at(idx+1).split(QLatin1Char('x'));
+        if (wh.size() == 2) {
+            w = wh.at(0).toInt();
+            h = wh.at(1).toInt();
+        }
+    }
+    int n = 500;
+    idx = a.arguments().indexOf(QLatin1String("-n"));
+    if (idx > 0)
+        n = a.arguments().at(idx+1).toInt();
+    int queued = 4;
+    idx = a.arguments().indexOf(QLatin1String("-q"));
+    if (idx > 0)
+        queued = a.arguments().at(idx+1).toInt();
+    VideoFormat fmt(VideoFormat::Format_YUV420P);
+    idx = a.arguments().indexOf(QLatin1String("-fmt"));
+    if (idx > 0)
+        fmt = VideoFormat(a.arguments().at(idx+1));
+    VideoFrame src(w, h, fmt);
+    if (src.allocate() <= 0) {
+        printf("invalid frame %dx%d %s\n", w, h, qPrintable(fmt.name()));
+        return 1;
+    }
+    printf("%dx%d %s, %d frames, %d queued\n", w, h, qPrintable(fmt.name()), n, queued);
+    run("heap", false, src, n, queued);
+    run("pool", true, src, n, queued);
+    return 0;
+}
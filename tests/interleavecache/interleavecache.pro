@@ -0,0 +1,10 @@
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = interleavecache
+
+PROJECTROOT = $$PWD/../..
+include($$PROJECTROOT/src/libQtAV.pri)
+preparePaths($$OUT_PWD/../../out)
+
+# InterleaveCache and PacketBuffer are not exported
+SOURCES += main.cpp $$PROJECTROOT/src/InterleaveCache.cpp $$PROJECTROOT/src/PacketBuffer.cpp
@@ -0,0 +1,115 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * InterleaveCache checks with badly interleaved streams, e.g. 40 video packets then 40 audio packets.
+ * Queues are non-blocking so the demuxer side runs in 1 thread: a cached packet is a put() that would block.
+ * 1. video packets are cached only while the audio queue is not enough
+ * 2. once audio is enough, the cache is flushed and the next packets bypass it
+ * 3. packets of each stream are taken in the demuxed order
+ * 4. a blocking queue stops blocking if too many packets are cached while the other stream is starving (hangs if not)
+ * usage: interleavecache
+ */
+#include <QtCore/QCoreApplication>
+#include "InterleaveCache.h"
+#include "PacketBuffer.h"
+#include <stdio.h>
+
+using namespace QtAV;
+
+static const int kBufferValue = 8; // full at 12 packets
+
+static bool check(bool ok, const char* what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    return ok;
+}
+
+static Packet createPacket(int index)
+{
+    Packet pkt;
+    pkt.pts = qreal(index)/25.0;
+    pkt.data = QByteArray(16, char(index));
+    return pkt;
+}
+
+static void setupQueue(PacketBuffer *q)
+{
+    q->setBufferMode(BufferPackets);
+    q->setBufferValue(kBufferValue);
+    q->blockFull(false);
+    q->blockEmpty(false);
+}
+
+// take n packets, return false if not in order
+static bool takeInOrder(PacketBuffer *q, int n, int *next)
+{
+    bool ok = true;
+    for (int i = 0; i < n; ++i) {
+        const Packet pkt(q->take());
+        ok &= qFuzzyCompare(pkt.pts + 1.0, qreal(*next)/25.0 + 1.0);
+        ++*next;
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    bool ok = true;
+    PacketBuffer aq, vq;
+    setupQueue(&aq);
+    setupQueue(&vq);
+    InterleaveCache vcache, acache;
+    int v = 0, va = 0, a_next = 0, v_next = 0;
+    // vvvv...: audio is starving, video is cached after the queue is full
+    int cached = 0;
+    for (int i = 0; i < 40; ++i)
+        cached += vcache.put(&vq, createPacket(v++), &aq);
+    ok &= check(vq.size() == 12 && vcache.size() == 28 && cached == 28, "video is cached when full while audio is starving");
+    // consumer takes some video. cached packets are moved first, the new one is cached behind them
+    ok &= check(takeInOrder(&vq, 4, &v_next), "video order before flush");
+    vcache.put(&vq, createPacket(v++), &aq);
+    ok &= check(vq.size() == 12 && vcache.size() == 25, "cached packets are moved before new packets");
+    // aaaa...: audio becomes enough
+    for (int i = 0; i < kBufferValue; ++i)
+        acache.put(&aq, createPacket(va++), &vq);
+    ok &= check(acache.isEmpty() && aq.isEnough(), "audio is not cached while its queue has room");
+    // the next video packet flushes the cache and bypasses it
+    ok &= check(!vcache.put(&vq, createPacket(v++), &aq) && vcache.isEmpty(), "cache is flushed when audio is no longer starving");
+    ok &= check(!vcache.put(&vq, createPacket(v++), &aq) && vcache.isEmpty(), "cache is bypassed after flush");
+    ok &= check(vq.size() == v - v_next && takeInOrder(&vq, vq.size(), &v_next), "video order after flush");
+    ok &= check(takeInOrder(&aq, aq.size(), &a_next) && a_next == va, "audio order");
+    // audio starving again for a long time. at most 1024 packets are cached, then they are flushed without blocking
+    aq.clear();
+    vq.blockFull(true);
+    int max_size = 0, flushes = 0;
+    for (int i = 0; i < 2000; ++i) {
+        const int size = vcache.size();
+        if (!vcache.put(&vq, createPacket(v++), &aq) && size > 0)
+            ++flushes;
+        max_size = qMax(max_size, vcache.size());
+    }
+    ok &= check(max_size == 1024 && flushes == 1, "cache size is limited");
+    ok &= check(vq.size() + vcache.size() == v - v_next && takeInOrder(&vq, vq.size(), &v_next), "video order after the limit");
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return !ok;
+}
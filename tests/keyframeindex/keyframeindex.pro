@@ -0,0 +1,11 @@
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = keyframeindex
+
+PROJECTROOT = $$PWD/../..
+include($$PROJECTROOT/src/libQtAV.pri)
+preparePaths($$OUT_PWD/../../out)
+
+# KeyFrameIndex and getLocalPath() are not exported
+SOURCES += main.cpp $$PROJECTROOT/src/KeyFrameIndex.cpp $$PROJECTROOT/src/utils/internal.cpp
+LIBS *= -L$$[QT_INSTALL_LIBS] -lavcodec -lavformat -lavutil
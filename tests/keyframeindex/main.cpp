@@ -0,0 +1,126 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * KeyFrameIndex checks without a demuxer. Packets are fed as the demuxer reads them: every 40ms, a key frame every 1s.
+ * 1. find() returns the nearest key frame only inside an indexed segment, not in a gap between segments
+ * 2. overlapped or adjacent segments are merged
+ * 3. not persistent by default: no cache file
+ * 4. a persistent index is saved and loaded back, and the media path is not in the cache file
+ * usage: keyframeindex
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QTemporaryFile>
+#include "KeyFrameIndex.h"
+#include <stdio.h>
+
+using namespace QtAV;
+
+static bool check(bool ok, const char* what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    return ok;
+}
+
+// a new segment of packets in [start, end) ms. byte position is pts*10
+static void feed(KeyFrameIndex *index, qint64 start, qint64 end)
+{
+    index->beginSegment();
+    for (qint64 pts = start; pts < end; pts += 40)
+        index->addPacket(pts, pts*10, pts % 1000 == 0);
+}
+
+// the key frame found for pts, -1 if not found
+static qint64 keyFrame(const KeyFrameIndex& index, qint64 pts)
+{
+    KeyFrameIndex::Entry e;
+    if (!index.find(pts, &e))
+        return -1;
+    if (e.pos != e.pts*10)
+        return -2;
+    return e.pts;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    bool ok = true;
+    QTemporaryFile media;
+    if (!media.open()) {
+        printf("can not create a temporary file\n");
+        return 1;
+    }
+    media.write(QByteArray(1024, 'x'));
+    media.flush();
+    const QString path(QFileInfo(media).absoluteFilePath());
+
+    KeyFrameIndex index;
+    ok &= check(index.setFile(path), "setFile() local file");
+    ok &= check(!index.setFile(path + QStringLiteral(".none")) && !index.isValid(), "setFile() missing file");
+    index.setFile(path);
+    ok &= check(!index.find(0, 0), "find() in empty index");
+    feed(&index, 0, 2000);
+    feed(&index, 5000, 7000);
+    ok &= check(keyFrame(index, 1500) == 1000, "find() in segment 1");
+    ok &= check(keyFrame(index, 6500) == 6000, "find() in segment 2");
+    ok &= check(keyFrame(index, 3000) == -1, "find() in a gap");
+    ok &= check(keyFrame(index, 7500) == -1, "find() after the last segment");
+    feed(&index, 2000, 5520); // overlaps segment 2
+    ok &= check(keyFrame(index, 3500) == 3000, "find() in a merged segment");
+    ok &= check(keyFrame(index, 5900) == 5000, "find() in an overlapped segment");
+    ok &= check(keyFrame(index, 1980) == -1, "find() in a 40ms gap");
+    feed(&index, 1000, 2500); // covers the gap
+    ok &= check(keyFrame(index, 1980) == 1000, "find() after the gap is indexed");
+    ok &= check(index.size() == 7, "key frames are unique");
+    ok &= check(index.cacheFile().isEmpty() && index.save(), "not persistent by default");
+
+    KeyFrameIndex saved;
+    saved.setPersistent(true);
+    saved.setFile(path);
+    const QString cache(saved.cacheFile());
+    feed(&saved, 0, 3000);
+    feed(&saved, 5000, 6000);
+    ok &= check(!cache.isEmpty() && saved.save() && QFile::exists(cache), "save()");
+    QFile f(cache);
+    f.open(QIODevice::ReadOnly);
+    QByteArray plain_path;
+    QDataStream ds(&plain_path, QIODevice::WriteOnly);
+    ds << path;
+    const QByteArray data(f.readAll());
+    f.close();
+    ok &= check(!data.isEmpty() && !data.contains(plain_path) && !data.contains(path.toUtf8()), "media path is not saved");
+
+    KeyFrameIndex loaded;
+    loaded.setPersistent(true);
+    loaded.setFile(path);
+    ok &= check(loaded.size() == saved.size() && loaded.size() == 4, "load() key frames");
+    ok &= check(keyFrame(loaded, 2500) == 2000 && keyFrame(loaded, 5500) == 5000, "find() in loaded segments");
+    ok &= check(keyFrame(loaded, 4000) == -1, "find() in a gap of loaded segments");
+    media.write("y");
+    media.flush();
+    loaded.setFile(path);
+    ok &= check(loaded.size() == 0, "cache is not loaded if the file changed");
+    QFile::remove(cache);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,466 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * Reproducible decode/convert/resample benchmark. Synthetic clips are encoded with the FFmpeg encoders into a work
+ * directory once (-regen to encode again), then every clip is demuxed and decoded, and the per call time of each
+ * stage is written as JSON with percentiles, so results of different commits can be compared.
+ * video: h264, hevc, mpeg2 and vp9 at several sizes. stages: readFrame, decode (decode() + frame()) and ImageConverter
+ *   conversions to BGRA with FFmpeg and SIMD converters, at the same size and half size.
+ * audio: aac and opus. stages: readFrame, decode, AudioResampler to s16 44.1kHz and AudioOutput software volume.
+ * An encoder not in the FFmpeg build is reported as skipped.
+ * usage: mediabench [-d workdir] [-n frames] [-s 640x360,1280x720,1920x1080] [-c h264,hevc,mpeg2,vp9,aac,opus]
+ *                   [-o result.json] [-regen]
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+#include <QtAV/AVDemuxer.h>
+#include <QtAV/AVMuxer.h>
+#include <QtAV/AudioDecoder.h>
+#include <QtAV/AudioEncoder.h>
+#include <QtAV/AudioOutput.h>
+#include <QtAV/AudioResampler.h>
+#include <QtAV/AudioResamplerTypes.h>
+#include <QtAV/VideoDecoder.h>
+#include <QtAV/VideoEncoder.h>
+#include <QtAV/version.h>
+#include "ImageConverter.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+using namespace QtAV;
+
+struct CodecInfo {
+    const char* name; // clip prefix and -c value
+    const char* encoder;
+    bool video;
+    int frame_size; // audio samples per encoded frame
+};
+static const CodecInfo kCodecs[] = {
+    { "h264", "libx264", true, 0 },
+    { "hevc", "libx265", true, 0 },
+    { "mpeg2", "mpeg2video", true, 0 },
+    { "vp9", "libvpx-vp9", true, 0 },
+    { "aac", "aac", false, 1024 },
+    { "opus", "libopus", false, 960 },
+};
+static const int kFps = 25;
+static const int kSampleRate = 48000;
+static const double kPi = 3.14159265358979323846;
+static const int kMaxErrors = 100; // consecutive read or eof decode errors
+
+// per call times in ns
+class Samples
+{
+public:
+    explicit Samples(const char* name) : m_name(name) {}
+    void add(qint64 ns) { m_ns.append(ns);}
+    int count() const { return m_ns.size();}
+    QByteArray json() {
+        std::sort(m_ns.begin(), m_ns.end());
+        qint64 total = 0;
+        foreach (qint64 v, m_ns) {
+            total += v;
+        }
+        char buf[512];
+        qsnprintf(buf, sizeof(buf), "\"%s\": {\"count\": %d, \"total_ms\": %.3f, \"per_second\": %.1f, \"mean_us\": %.1f"
+                  ", \"p50_us\": %.1f, \"p90_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f}"
+                  , m_name, count(), double(total)/1e6, total > 0 ? double(count())*1e9/double(total) : 0.0
+                  , count() > 0 ? double(total)/double(count())/1e3 : 0.0
+                  , percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0));
+        return buf;
+    }
+private:
+    // nearest rank, in us
+    double percentile(double p) const {
+        if (m_ns.isEmpty())
+            return 0;
+        const int i = qBound(0, int(ceil(p*m_ns.size())) - 1, m_ns.size() - 1);
+        return double(m_ns.at(i))/1e3;
+    }
+    const char* m_name;
+    QVector<qint64> m_ns;
+};
+
+static QByteArray stagesJson(QList<Samples*>& stages)
+{
+    QByteArray s("\"stages\": {");
+    for (int i = 0; i < stages.size(); ++i) {
+        if (i > 0)
+            s += ", ";
+        s += stages[i]->json();
+    }
+    s += "}";
+    qDeleteAll(stages);
+    stages.clear();
+    return s;
+}
+
+// moving smooth pattern, every frame is different
+static VideoFrame createVideoFrame(int w, int h, int index)
+{
+    VideoFrame f(w, h, VideoFormat(VideoFormat::Format_YUV420P));
+    if (f.allocate() <= 0)
+        return VideoFrame();
+    for (int p = 0; p < 3; ++p) {
+        const int s = p == 0 ? 1 : 2;
+        for (int y = 0; y < f.planeHeight(p); ++y) {
+            quint8 *d = f.bits(p) + y*f.bytesPerLine(p);
+            for (int x = 0; x < f.effectiveBytesPerLine(p); ++x) {
+                const double px = x*s + index*4, py = y*s + index*2;
+                double v = 0;
+                if (p == 0)
+                    v = 128.0 + 100.0*sin(px/37.0)*cos(py/29.0);
+                else if (p == 1)
+                    v = 128.0 + 60.0*sin((px + py)/53.0);
+                else
+                    v = 128.0 + 60.0*cos((px - py)/41.0);
+                d[x] = (quint8)qBound(0, int(v + 0.5), 255);
+            }
+        }
+    }
+    f.setTimestamp(qreal(index)/qreal(kFps));
+    return f;
+}
+
+static bool encodeVideo(const CodecInfo& c, int w, int h, int frames, const QString& file)
+{
+    QScopedPointer<VideoEncoder> venc(VideoEncoder::create("FFmpeg"));
+    venc->setCodecName(QString::fromLatin1(c.encoder));
+    venc->setWidth(w);
+    venc->setHeight(h);
+    venc->setFrameRate(kFps);
+    venc->setPixelFormat(VideoFormat::Format_YUV420P);
+    venc->setBitRate(w*h*3);
+    QVariantHash opt;
+    if (!qstrcmp(c.name, "h264") || !qstrcmp(c.name, "hevc"))
+        opt[QString::fromLatin1("preset")] = QString::fromLatin1("ultrafast");
+    else if (!qstrcmp(c.name, "vp9")) {
+        opt[QString::fromLatin1("deadline")] = QString::fromLatin1("realtime");
+        opt[QString::fromLatin1("cpu-used")] = 8;
+    }
+    if (!opt.isEmpty()) {
+        QVariantHash avcodec;
+        avcodec[QString::fromLatin1("avcodec")] = opt;
+        venc->setOptions(avcodec);
+    }
+    if (!venc->open())
+        return false;
+    AVMuxer mux;
+    mux.setMedia(file);
+    mux.copyProperties(venc.data());
+    if (!mux.open())
+        return false;
+    for (int i = 0; i < frames; ++i) {
+        if (venc->encode(createVideoFrame(w, h, i)))
+            mux.writeVideo(venc->encoded());
+    }
+    while (venc->encode()) // delayed frames
+        mux.writeVideo(venc->encoded());
+    mux.close();
+    venc->close();
+    return true;
+}
+
+static bool encodeAudio(const CodecInfo& c, int seconds, const QString& file)
+{
+    QScopedPointer<AudioEncoder> aenc(AudioEncoder::create("FFmpeg"));
+    aenc->setCodecName(QString::fromLatin1(c.encoder));
+    aenc->setBitRate(128000);
+    AudioFormat fmt; // the encoder selects a supported sample format
+    fmt.setSampleRate(kSampleRate);
+    fmt.setChannels(2);
+    aenc->setAudioFormat(fmt);
+    QVariantHash opt, avcodec;
+    opt[QString::fromLatin1("strict")] = QString::fromLatin1("experimental"); // aac in old FFmpeg
+    avcodec[QString::fromLatin1("avcodec")] = opt;
+    aenc->setOptions(avcodec);
+    if (!aenc->open())
+        return false;
+    AVMuxer mux;
+    mux.setMedia(file);
+    mux.copyProperties(aenc.data());
+    if (!mux.open())
+        return false;
+    AudioFormat src;
+    src.setSampleFormat(AudioFormat::SampleFormat_Float);
+    src.setSampleRate(kSampleRate);
+    src.setChannels(2);
+    const int nb_frames = seconds*kSampleRate/c.frame_size;
+    for (int i = 0; i < nb_frames; ++i) {
+        QByteArray data(c.frame_size*src.bytesPerFrame(), 0);
+        float *s = (float*)data.data();
+        for (int k = 0; k < c.frame_size; ++k) {
+            const double t = double(i*c.frame_size + k)/double(kSampleRate);
+            s[2*k] = float(0.5*sin(2.0*kPi*440.0*t));
+            s[2*k+1] = float(0.5*sin(2.0*kPi*660.0*t));
+        }
+        AudioFrame frame(data, src);
+        frame.setTimestamp(double(i*c.frame_size)/double(kSampleRate));
+        if (aenc->encode(frame.to(aenc->audioFormat())))
+            mux.writeAudio(aenc->encoded());
+    }
+    while (aenc->encode())
+        mux.writeAudio(aenc->encoded());
+    mux.close();
+    aenc->close();
+    return true;
+}
+
+static bool convert(ImageConverter *c, const VideoFrame& f, const QSize& s)
+{
+    c->setInFormat(f.pixelFormatFFmpeg());
+    c->setOutFormat(VideoFormat::pixelFormatToFFmpeg(VideoFormat::Format_BGRA32));
+    c->setInSize(f.width(), f.height());
+    c->setOutSize(s.width(), s.height());
+    const quint8 *src[] = { f.constBits(0), f.constBits(1), f.constBits(2), f.constBits(3) };
+    const int stride[] = { f.bytesPerLine(0), f.bytesPerLine(1), f.bytesPerLine(2), f.bytesPerLine(3) };
+    return c->convert(src, stride);
+}
+
+static QByteArray benchVideo(const QString& file)
+{
+    AVDemuxer demux;
+    demux.setMedia(file);
+    if (!demux.load())
+        return "\"error\": \"load\"";
+    QScopedPointer<VideoDecoder> dec(VideoDecoder::create("FFmpeg"));
+    dec->setCodecContext(demux.videoCodecContext());
+    if (!dec->open())
+        return "\"error\": \"decoder\"";
+    QScopedPointer<ImageConverter> ff(ImageConverter::create(ImageConverterId_FF));
+    QScopedPointer<ImageConverter> simd(ImageConverter::create(ImageConverterId_SIMD));
+    Samples *read = new Samples("readFrame");
+    Samples *decode = new Samples("decode");
+    Samples *conv_ff = new Samples("convert_ff_bgra");
+    Samples *conv_ff_half = new Samples("convert_ff_bgra_half");
+    Samples *conv_simd = new Samples("convert_simd_bgra");
+    Samples *conv_simd_half = new Samples("convert_simd_bgra_half");
+    QList<Samples*> stages;
+    stages << read << decode << conv_ff << conv_ff_half << conv_simd << conv_simd_half;
+    const int vstream = demux.videoStream();
+    QElapsedTimer timer;
+    bool eof = false;
+    int errors = 0;
+    int nb_frames = 0;
+    while (true) {
+        Packet pkt;
+        if (!eof) {
+            timer.start();
+            const bool ok = demux.readFrame();
+            if (ok)
+                read->add(timer.nsecsElapsed());
+            errors = ok ? 0 : errors + 1;
+            eof = !ok && (demux.atEnd() || errors > kMaxErrors);
+            if (!ok && !eof)
+                continue;
+            if (ok) {
+                if (demux.stream() != vstream)
+                    continue;
+                pkt = demux.packet();
+            }
+        }
+        if (eof)
+            pkt = Packet::createEOF();
+        timer.start();
+        bool ok = dec->decode(pkt);
+        VideoFrame frame;
+        if (ok)
+            frame = dec->frame();
+        decode->add(timer.nsecsElapsed());
+        if (eof && (!ok || (!frame.isValid() && ++errors > kMaxErrors)))
+            break;
+        if (!frame.isValid())
+            continue;
+        ++nb_frames;
+        const QSize size(frame.width(), frame.height());
+        const QSize half(size/2);
+        ImageConverter* convs[] = { ff.data(), ff.data(), simd.data(), simd.data() };
+        Samples* samples[] = { conv_ff, conv_ff_half, conv_simd, conv_simd_half };
+        for (int i = 0; i < 4; ++i) {
+            if (!convs[i])
+                continue;
+            timer.start();
+            if (convert(convs[i], frame, i & 1 ? half : size))
+                samples[i]->add(timer.nsecsElapsed());
+        }
+    }
+    return QByteArray("\"frames\": ") + QByteArray::number(nb_frames) + ", " + stagesJson(stages);
+}
+
+static QByteArray benchAudio(const QString& file)
+{
+    AVDemuxer demux;
+    demux.setMedia(file);
+    if (!demux.load())
+        return "\"error\": \"load\"";
+    QScopedPointer<AudioDecoder> dec(AudioDecoder::create("FFmpeg"));
+    dec->setCodecContext(demux.audioCodecContext());
+    if (!dec->open())
+        return "\"error\": \"decoder\"";
+    QScopedPointer<AudioResampler> resampler(AudioResampler::create(AudioResamplerId_FF));
+    AudioFormat out;
+    out.setSampleFormat(AudioFormat::SampleFormat_Signed16);
+    out.setSampleRate(44100);
+    out.setChannels(2);
+    // not opened, play() only scales the samples and updates the buffer queue
+    AudioOutput ao;
+    ao.setBackends(QStringList() << QString::fromLatin1("null"));
+    ao.setAudioFormat(out);
+    ao.setVolume(0.5);
+    Samples *read = new Samples("readFrame");
+    Samples *decode = new Samples("decode");
+    Samples *resample = new Samples("resample_s16_44100");
+    Samples *volume = new Samples("volume_s16");
+    QList<Samples*> stages;
+    stages << read << decode << resample << volume;
+    const int astream = demux.audioStream();
+    QElapsedTimer timer;
+    int errors = 0;
+    while (true) {
+        timer.start();
+        const bool ok = demux.readFrame();
+        if (!ok) {
+            if (demux.atEnd() || ++errors > kMaxErrors)
+                break;
+            continue;
+        }
+        errors = 0;
+        read->add(timer.nsecsElapsed());
+        if (demux.stream() != astream)
+            continue;
+        const Packet pkt(demux.packet());
+        timer.start();
+        AudioFrame frame;
+        if (dec->decode(pkt))
+            frame = dec->frame();
+        decode->add(timer.nsecsElapsed());
+        if (!frame.isValid() || !resampler)
+            continue;
+        const quint8 *planes[8] = { 0 };
+        for (int i = 0; i < qMin(frame.planeCount(), 8); ++i)
+            planes[i] = frame.constBits(i);
+        timer.start();
+        resampler->setInAudioFormat(frame.format());
+        resampler->setOutAudioFormat(out);
+        resampler->setInSampesPerChannel(frame.samplesPerChannel());
+        if (!resampler->convert(planes))
+            continue;
+        const QByteArray data(resampler->outData());
+        resample->add(timer.nsecsElapsed());
+        timer.start();
+        ao.play(data);
+        volume->add(timer.nsecsElapsed());
+    }
+    return QByteArray("\"frames\": ") + QByteArray::number(decode->count()) + ", " + stagesJson(stages);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QString dir = QDir::temp().filePath(QString::fromLatin1("qtav_mediabench"));
+    int idx = a.arguments().indexOf(QLatin1String("-d"));
+    if (idx > 0)
+        dir = a.arguments().at(idx + 1);
+    int frames = 100;
+    idx = a.arguments().indexOf(QLatin1String("-n"));
+    if (idx > 0)
+        frames = a.arguments().at(idx + 1).toInt();
+    QList<QSize> sizes;
+    sizes << QSize(640, 360) << QSize(1280, 720) << QSize(1920, 1080);
+    idx = a.arguments().indexOf(QLatin1String("-s"));
+    if (idx > 0) {
+        sizes.clear();
+        foreach (const QString& s, a.arguments().at(idx + 1).split(QLatin1Char(','))) {
+            const QStringList wh = s.split(QLatin1Char('x'));
+            if (wh.size() == 2)
+                sizes << QSize(wh.at(0).toInt(), wh.at(1).toInt());
+        }
+    }
+    QStringList codecs;
+    idx = a.arguments().indexOf(QLatin1String("-c"));
+    if (idx > 0)
+        codecs = a.arguments().at(idx + 1).split(QLatin1Char(','));
+    QString out_file;
+    idx = a.arguments().indexOf(QLatin1String("-o"));
+    if (idx > 0)
+        out_file = a.arguments().at(idx + 1);
+    const bool regen = a.arguments().contains(QLatin1String("-regen"));
+    QDir().mkpath(dir);
+
+    QList<QByteArray> results;
+    for (size_t i = 0; i < sizeof(kCodecs)/sizeof(kCodecs[0]); ++i) {
+        const CodecInfo &c = kCodecs[i];
+        if (!codecs.isEmpty() && !codecs.contains(QString::fromLatin1(c.name)))
+            continue;
+        const int nb_sizes = c.video ? sizes.size() : 1;
+        for (int k = 0; k < nb_sizes; ++k) {
+            QString clip;
+            if (c.video)
+                clip = QString::fromLatin1("%1_%2x%3_%4f").arg(QString::fromLatin1(c.name)).arg(sizes[k].width()).arg(sizes[k].height()).arg(frames);
+            else
+                clip = QString::fromLatin1("%1_%2s").arg(QString::fromLatin1(c.name)).arg(frames/kFps);
+            const QString file = QDir(dir).filePath(clip + QString::fromLatin1(".mkv"));
+            fprintf(stderr, "%s\n", qPrintable(clip));
+            QByteArray r = "{\"clip\": \"" + clip.toUtf8() + "\", \"encoder\": \"" + c.encoder + "\", ";
+            if (regen || QFileInfo(file).size() <= 0) {
+                const bool ok = c.video ? encodeVideo(c, sizes[k].width(), sizes[k].height(), frames, file)
+                                        : encodeAudio(c, qMax(1, frames/kFps), file);
+                if (!ok) {
+                    QFile::remove(file);
+                    fprintf(stderr, "  %s is not available, skipped\n", c.encoder);
+                    results.append(r + "\"skipped\": true}");
+                    continue;
+                }
+            }
+            r += c.video ? benchVideo(file) : benchAudio(file);
+            results.append(r + "}");
+            fprintf(stderr, "  %s\n", results.last().constData());
+        }
+    }
+    QByteArray json("{\"version\": \"" QTAV_VERSION_STR "\", \"date\": \"");
+    json += QDateTime::currentDateTime().toString(Qt::ISODate).toUtf8();
+    json += "\", \"frames\": " + QByteArray::number(frames) + ", \"clips\": [\n";
+    for (int i = 0; i < results.size(); ++i) {
+        json += "  " + results.at(i);
+        json += i + 1 < results.size() ? ",\n" : "\n";
+    }
+    json += "]}\n";
+    if (out_file.isEmpty()) {
+        printf("%s", json.constData());
+        return 0;
+    }
+    QFile f(out_file);
+    if (!f.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+        fprintf(stderr, "can not write %s\n", qPrintable(out_file));
+        return 1;
+    }
+    f.write(json);
+    return 0;
+}
@@ -0,0 +1,157 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * Contention benchmark: 1 producer (demux thread) and 1 consumer (AVThread) move packets through
+ * PacketBuffer (lock-free ring) and BlockingQueue<Packet> (locked queue used by the old PacketBuffer).
+ * Then checks that put() does not block when more packets than the initial ring slots are queued.
+ * usage: packetbuffer [-n packets] [-v bufferValue] [-work consumer_spin_loops]
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QQueue>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include "PacketBuffer.h"
+#include "utils/BlockingQueue.h"
+#include <QtDebug>
+
+using namespace QtAV;
+
+static volatile int gSink = 0;
+static void doWork(int loops)
+{
+    for (int i = 0; i < loops; ++i)
+        gSink += i;
+}
+
+template<class Q>
+class Producer : public QThread
+{
+public:
+    Producer(Q *q, int n) : queue(q), count(n) {}
+protected:
+    void run() {
+        const QByteArray data(4096, 'x');
+        for (int i = 0; i < count; ++i) {
+            Packet pkt;
+            pkt.pts = qreal(i)/60.0;
+            pkt.data = data;
+            queue->put(pkt);
+        }
+        queue->blockEmpty(false); // EOF
+    }
+private:
+    Q *queue;
+    int count;
+};
+
+template<class Q>
+class Consumer : public QThread
+{
+public:
+    Consumer(Q *q, int n, int w) : queue(q), count(n), work(w), empty(0) {}
+    int emptyTakes() const { return empty;}
+protected:
+    void run() {
+        int taken = 0;
+        while (taken < count) {
+            const Packet pkt = queue->take();
+            if (pkt.data.isEmpty()) {
+                ++empty;
+                continue;
+            }
+            ++taken;
+            doWork(work);
+        }
+    }
+private:
+    Q *queue;
+    int count, work, empty;
+};
+
+template<class Q>
+static void bench(const char* name, Q *q, int n, int work)
+{
+    Producer<Q> p(q, n);
+    Consumer<Q> c(q, n, work);
+    QElapsedTimer timer;
+    timer.start();
+    c.start();
+    p.start();
+    p.wait();
+    c.wait();
+    const qint64 ms = qMax<qint64>(1, timer.elapsed());
+    printf("%-14s %d packets in %lld ms, %.0f packets/s, empty takes: %d\n", name, n, ms, qreal(n)*1000.0/qreal(ms), c.emptyTakes());
+    fflush(0);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    int n = 2000000;
+    int value = 32;
+    int work = 0;
+    int idx = a.arguments().indexOf(QLatin1String("-n"));
+    if (idx > 0)
+        n = a.arguments().at(idx + 1).toInt();
+    idx = a.arguments().indexOf(QLatin1String("-v"));
+    if (idx > 0)
+        value = a.arguments().at(idx + 1).toInt();
+    idx = a.arguments().indexOf(QLatin1String("-work"));
+    if (idx > 0)
+        work = a.arguments().at(idx + 1).toInt();
+    printf("buffer value: %d packets, consumer work: %d\n", value, work);
+
+    BlockingQueue<Packet> bq;
+    bq.setCapacity(int(qreal(value)*1.5));
+    bq.setThreshold(value);
+    bench("BlockingQueue", &bq, n, work);
+
+    PacketBuffer pb;
+    pb.setBufferMode(BufferPackets);
+    pb.setBufferValue(value);
+    bench("PacketBuffer", &pb, n, work);
+
+    // no consumer. the ring must grow instead of waiting for free slots
+    bool ok = true;
+    PacketBuffer large;
+    large.setBufferMode(BufferPackets);
+    large.setBufferValue(10000);
+    large.blockFull(false);
+    Producer<PacketBuffer> p(&large, 20000);
+    p.start();
+    if (!p.wait(10000)) {
+        printf("FAIL: put() blocked with blockFull(false), queued: %d\n", large.size());
+        large.clear(); // wakes the producer
+        p.wait();
+        return 1;
+    }
+    ok &= large.size() == 20000;
+    printf("queued without consumer: %d, buffered: %lld\n", large.size(), large.buffered());
+    large.setBufferMode(BufferTime);
+    // pts step is 1/60s
+    ok &= qAbs(large.buffered() - 19999LL*1000LL/60LL) <= 1;
+    for (int i = 0; i < 20000 && ok; ++i)
+        ok &= qFuzzyCompare(large.take().pts + 1.0, qreal(i)/60.0 + 1.0);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return !ok;
+}
@@ -0,0 +1,10 @@
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = packetbuffer
+QT -= gui
+
+PROJECTROOT = $$PWD/../..
+include($$PROJECTROOT/src/libQtAV.pri)
+preparePaths($$OUT_PWD/../../out)
+# PacketBuffer is not exported
+SOURCES += main.cpp $$PROJECTROOT/src/PacketBuffer.cpp
@@ -0,0 +1,425 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * End-to-end AVPlayer benchmark without devices, so it runs on a headless box. The normal demux, decode and output
+ * threads are used. Video frames go to a renderer that only counts them.
+ * fast: audio is disabled ("null" backend) and video clock is forced with a very high frame rate, i.e. as fast as possible
+ * realtime: audio goes to the "dummy" backend which consumes the data in real time, so audio clock and a/v sync work
+ * Results for each mode: time to first frame, delivered fps and frames, dropped frames (frames expected by the timestamp
+ * range minus delivered), a/v drift (|video pts - master clock| when a frame is delivered, realtime only) and seek latency
+ * (seek() to the first frame at the target). Without -f, a synthetic mpeg4 + aac clip is encoded into the work directory.
+ * usage: playerbench [-f file] [-d workdir] [-m fast,realtime] [-t realtime_seconds] [-n seeks] [-o result.json] [-regen]
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutex>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QStringList>
+#include <QtCore/QTimer>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+#include <QtAV/AVClock.h>
+#include <QtAV/AVMuxer.h>
+#include <QtAV/AVPlayer.h>
+#include <QtAV/AudioEncoder.h>
+#include <QtAV/AudioOutput.h>
+#include <QtAV/VideoEncoder.h>
+#include <QtAV/VideoRenderer.h>
+#include <QtAV/version.h>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+using namespace QtAV;
+
+static const int kFps = 25;
+static const int kSampleRate = 48000;
+static const int kAudioFrameSize = 1024; // aac
+static const double kPi = 3.14159265358979323846;
+static const qreal kFastFps = 10000; // force_dt is 0, frames are not delayed
+static const int kTimeout = 5000; // ms, first frame and seeks
+
+static QByteArray number(qreal v)
+{
+    return QByteArray::number(v, 'f', 3);
+}
+
+// nearest rank percentiles
+static QByteArray percentilesJson(QVector<qreal> v)
+{
+    if (v.isEmpty())
+        return "{\"count\": 0}";
+    std::sort(v.begin(), v.end());
+    qreal sum = 0;
+    foreach (qreal x, v) {
+        sum += x;
+    }
+    const qreal p[] = { 0.5, 0.9, 0.99, 1.0 };
+    const char* names[] = { "p50", "p90", "p99", "max" };
+    QByteArray s = "{\"count\": " + QByteArray::number(v.size()) + ", \"mean\": " + number(sum/qreal(v.size()));
+    for (int i = 0; i < 4; ++i) {
+        const int k = qBound(0, int(ceil(p[i]*v.size())) - 1, v.size() - 1);
+        s += ", \"" + QByteArray(names[i]) + "\": " + number(v.at(k));
+    }
+    return s + "}";
+}
+
+static VideoFrame createVideoFrame(int w, int h, int index)
+{
+    VideoFrame f(w, h, VideoFormat(VideoFormat::Format_YUV420P));
+    if (f.allocate() <= 0)
+        return VideoFrame();
+    for (int p = 0; p < 3; ++p) {
+        for (int y = 0; y < f.planeHeight(p); ++y) {
+            quint8 *d = f.bits(p) + y*f.bytesPerLine(p);
+            for (int x = 0; x < f.effectiveBytesPerLine(p); ++x)
+                d[x] = p == 0 ? (quint8)((x + y + index*4) & 0xff) : (quint8)(128 + ((x*p + index) & 0x3f));
+        }
+    }
+    f.setTimestamp(qreal(index)/qreal(kFps));
+    return f;
+}
+
+// mpeg4 and aac encoders are always built in FFmpeg
+static bool encodeClip(const QString& file, int w, int h, int seconds)
+{
+    QScopedPointer<VideoEncoder> venc(VideoEncoder::create("FFmpeg"));
+    venc->setCodecName(QString::fromLatin1("mpeg4"));
+    venc->setWidth(w);
+    venc->setHeight(h);
+    venc->setFrameRate(kFps);
+    venc->setPixelFormat(VideoFormat::Format_YUV420P);
+    venc->setBitRate(w*h*3);
+    if (!venc->open())
+        return false;
+    QScopedPointer<AudioEncoder> aenc(AudioEncoder::create("FFmpeg"));
+    aenc->setCodecName(QString::fromLatin1("aac"));
+    aenc->setBitRate(128000);
+    AudioFormat afmt;
+    afmt.setSampleRate(kSampleRate);
+    afmt.setChannels(2);
+    aenc->setAudioFormat(afmt);
+    QVariantHash opt, avcodec;
+    opt[QString::fromLatin1("strict")] = QString::fromLatin1("experimental"); // aac in old FFmpeg
+    avcodec[QString::fromLatin1("avcodec")] = opt;
+    aenc->setOptions(avcodec);
+    if (!aenc->open())
+        return false;
+    AVMuxer mux;
+    mux.setMedia(file);
+    mux.copyProperties(venc.data());
+    mux.copyProperties(aenc.data());
+    if (!mux.open())
+        return false;
+    AudioFormat src;
+    src.setSampleFormat(AudioFormat::SampleFormat_Float);
+    src.setSampleRate(kSampleRate);
+    src.setChannels(2);
+    int audio_frames = 0;
+    for (int i = 0; i < seconds*kFps; ++i) {
+        if (venc->encode(createVideoFrame(w, h, i)))
+            mux.writeVideo(venc->encoded());
+        // audio up to the next video frame. the muxer interleaves packets
+        while (qint64(audio_frames)*kAudioFrameSize*kFps < qint64(i + 1)*kSampleRate) {
+            QByteArray data(kAudioFrameSize*src.bytesPerFrame(), 0);
+            float *s = (float*)data.data();
+            for (int k = 0; k < kAudioFrameSize; ++k) {
+                const double t = double(audio_frames*kAudioFrameSize + k)/double(kSampleRate);
+                s[2*k] = s[2*k+1] = float(0.5*sin(2.0*kPi*440.0*t));
+            }
+            AudioFrame frame(data, src);
+            frame.setTimestamp(double(audio_frames*kAudioFrameSize)/double(kSampleRate));
+            if (aenc->encode(frame.to(aenc->audioFormat())))
+                mux.writeAudio(aenc->encoded());
+            ++audio_frames;
+        }
+    }
+    while (venc->encode())
+        mux.writeVideo(venc->encoded());
+    while (aenc->encode())
+        mux.writeAudio(aenc->encoded());
+    mux.close();
+    venc->close();
+    aenc->close();
+    return true;
+}
+
+// counts delivered frames. receiveFrame() is called in video thread
+class CountingRenderer : public VideoRenderer
+{
+public:
+    CountingRenderer(const QElapsedTimer *timer)
+        : m_timer(timer)
+        , m_clock(0)
+        , m_from(0)
+        , m_to(0)
+        , m_matched(-1)
+    {
+        resetCounters();
+    }
+    VideoRendererId id() const Q_DECL_OVERRIDE { return 0x7fffffff;} // not registered
+    bool isSupported(VideoFormat::PixelFormat) const Q_DECL_OVERRIDE { return true;}
+    // start a counting period. drift is recorded if clock is not null
+    void startCounting(AVClock *clock) {
+        QMutexLocker lock(&m_mutex);
+        resetCounters();
+        m_clock = clock;
+    }
+    // the next wait() returns when a frame with pts in [from, to] is delivered
+    void expect(qreal from, qreal to) {
+        QMutexLocker lock(&m_mutex);
+        m_from = from;
+        m_to = to;
+        m_matched = -1;
+    }
+    // process events until the expected frame. return the delivery time in ns of the timer, -1 if timeout
+    qint64 wait(int timeout) {
+        QElapsedTimer t;
+        t.start();
+        while (t.elapsed() < timeout) {
+            QCoreApplication::processEvents();
+            QMutexLocker lock(&m_mutex);
+            if (m_matched >= 0)
+                return m_matched;
+            m_cond.wait(&m_mutex, 2);
+        }
+        return -1;
+    }
+    int count() const { QMutexLocker lock(&m_mutex); return m_count;}
+    // wall time between the first and the last frame, in s
+    qreal seconds() const { QMutexLocker lock(&m_mutex); return qreal(m_last_ns - m_first_ns)/1e9;}
+    qreal ptsRange() const { QMutexLocker lock(&m_mutex); return m_count > 0 ? m_last_pts - m_first_pts : 0;}
+    QVector<qreal> drift() const { QMutexLocker lock(&m_mutex); return m_drift_ms;}
+protected:
+    bool receiveFrame(const VideoFrame& frame) Q_DECL_OVERRIDE {
+        const qint64 now = m_timer->nsecsElapsed();
+        const qreal pts = frame.timestamp();
+        QMutexLocker lock(&m_mutex);
+        if (m_count == 0) {
+            m_first_ns = now;
+            m_first_pts = pts;
+        }
+        ++m_count;
+        m_last_ns = now;
+        m_last_pts = pts;
+        if (m_clock)
+            m_drift_ms.append(qAbs(pts - m_clock->value())*1000.0);
+        if (m_matched < 0 && pts >= m_from && pts <= m_to) {
+            m_matched = now;
+            m_cond.wakeAll();
+        }
+        return true;
+    }
+    void drawFrame() Q_DECL_OVERRIDE {}
+private:
+    void resetCounters() {
+        m_count = 0;
+        m_first_ns = m_last_ns = 0;
+        m_first_pts = m_last_pts = 0;
+        m_drift_ms.clear();
+    }
+    const QElapsedTimer *m_timer;
+    mutable QMutex m_mutex;
+    QWaitCondition m_cond;
+    AVClock *m_clock;
+    qreal m_from, m_to;
+    qint64 m_matched;
+    int m_count;
+    qint64 m_first_ns, m_last_ns;
+    qreal m_first_pts, m_last_pts;
+    QVector<qreal> m_drift_ms;
+};
+
+// run the event loop until signal is emitted or timeout. return elapsed ms, -1 if timeout
+static qint64 waitFor(QObject *obj, const char* signal, int timeout)
+{
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    QObject::connect(&timer, SIGNAL(timeout()), &loop, SLOT(quit()));
+    QObject::connect(obj, signal, &loop, SLOT(quit()));
+    QElapsedTimer t;
+    t.start();
+    timer.start(timeout);
+    loop.exec();
+    return timer.isActive() ? t.elapsed() : -1;
+}
+
+// play and wait for the first frame. return time to first frame in ms, -1 if timeout
+static qreal startPlayback(AVPlayer *player, CountingRenderer *renderer, const QElapsedTimer& timer)
+{
+    renderer->expect(-1e9, 1e9);
+    const qint64 t0 = timer.nsecsElapsed();
+    player->play();
+    const qint64 t = renderer->wait(kTimeout);
+    return t < 0 ? -1 : qreal(t - t0)/1e6;
+}
+
+// ok is false if no frame is delivered or a seek times out
+static QByteArray runMode(const QString& file, bool realtime, int seconds, int seeks, bool *ok)
+{
+    *ok = false;
+    QElapsedTimer timer;
+    timer.start();
+    CountingRenderer renderer(&timer);
+    AVPlayer player;
+    player.addVideoRenderer(&renderer);
+    player.setSeekType(AccurateSeek);
+    if (realtime) {
+        player.audio()->setBackends(QStringList() << QString::fromLatin1("dummy"));
+    } else {
+        player.audio()->setBackends(QStringList() << QString::fromLatin1("null"));
+        player.setFrameRate(kFastFps);
+    }
+    player.setFile(file);
+    const qreal ttff = startPlayback(&player, &renderer, timer);
+    if (ttff < 0) {
+        player.stop();
+        return "\"error\": \"no frame\"";
+    }
+    QByteArray r = "\"time_to_first_frame_ms\": " + number(ttff);
+    const qint64 duration = player.duration();
+    const qreal fps = player.statistics().video.frame_rate;
+    // playback: fast mode plays to the end, realtime mode plays the given seconds
+    renderer.startCounting(realtime ? player.masterClock() : 0);
+    if (player.isPlaying())
+        waitFor(&player, SIGNAL(stopped()), realtime ? seconds*1000 : 600*1000);
+    const int frames = renderer.count();
+    const qreal elapsed = renderer.seconds();
+    const int expected = fps > 0 ? qRound(renderer.ptsRange()*fps) + 1 : frames;
+    r += ", \"frames\": " + QByteArray::number(frames);
+    r += ", \"expected_frames\": " + QByteArray::number(expected);
+    r += ", \"dropped_frames\": " + QByteArray::number(qMax(0, expected - frames));
+    r += ", \"seconds\": " + number(elapsed);
+    r += ", \"fps\": " + number(elapsed > 0 ? qreal(frames - 1)/elapsed : 0);
+    if (realtime)
+        r += ", \"drift_ms\": " + percentilesJson(renderer.drift());
+    // seeks. accurate seek delivers the frame at the target first
+    renderer.startCounting(0);
+    QVector<qreal> latency;
+    int timeouts = 0;
+    for (int i = 0; i < seeks && duration > 0; ++i) {
+        // fast mode may reach the end between seeks
+        if (!player.isPlaying() && startPlayback(&player, &renderer, timer) < 0) {
+            timeouts++;
+            break;
+        }
+        const qreal x = qreal(i)*0.618034;
+        const qint64 pos = qint64((0.1 + 0.8*(x - floor(x)))*qreal(duration)); // spread in [0.1, 0.9)
+        const qreal frame_time = fps > 0 ? 1.0/fps : 0.1;
+        renderer.expect(qreal(pos)/1000.0 - frame_time, qreal(pos)/1000.0 + 0.5);
+        const qint64 t0 = timer.nsecsElapsed();
+        player.seek(pos);
+        const qint64 t = renderer.wait(kTimeout);
+        if (t < 0)
+            timeouts++;
+        else
+            latency.append(qreal(t - t0)/1e6);
+    }
+    r += ", \"seek_ms\": " + percentilesJson(latency);
+    r += ", \"seek_timeouts\": " + QByteArray::number(timeouts);
+    player.stop();
+    *ok = timeouts == 0;
+    return r;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QString file;
+    int idx = a.arguments().indexOf(QLatin1String("-f"));
+    if (idx > 0)
+        file = a.arguments().at(idx + 1);
+    QString dir = QDir::temp().filePath(QString::fromLatin1("qtav_playerbench"));
+    idx = a.arguments().indexOf(QLatin1String("-d"));
+    if (idx > 0)
+        dir = a.arguments().at(idx + 1);
+    QStringList modes;
+    modes << QString::fromLatin1("fast") << QString::fromLatin1("realtime");
+    idx = a.arguments().indexOf(QLatin1String("-m"));
+    if (idx > 0)
+        modes = a.arguments().at(idx + 1).split(QLatin1Char(','));
+    int seconds = 10;
+    idx = a.arguments().indexOf(QLatin1String("-t"));
+    if (idx > 0)
+        seconds = a.arguments().at(idx + 1).toInt();
+    int seeks = 10;
+    idx = a.arguments().indexOf(QLatin1String("-n"));
+    if (idx > 0)
+        seeks = a.arguments().at(idx + 1).toInt();
+    QString out_file;
+    idx = a.arguments().indexOf(QLatin1String("-o"));
+    if (idx > 0)
+        out_file = a.arguments().at(idx + 1);
+    if (file.isEmpty()) {
+        QDir().mkpath(dir);
+        file = QDir(dir).filePath(QString::fromLatin1("mpeg4_aac_640x360_30s.mkv"));
+        if (a.arguments().contains(QLatin1String("-regen")) || QFileInfo(file).size() <= 0) {
+            fprintf(stderr, "encoding %s\n", qPrintable(file));
+            if (!encodeClip(file, 640, 360, 30)) {
+                QFile::remove(file);
+                fprintf(stderr, "failed to encode the clip. use -f file\n");
+                return 1;
+            }
+        }
+    }
+
+    bool ok = true;
+    QList<QByteArray> results;
+    foreach (const QString& mode, modes) {
+        if (mode != QLatin1String("fast") && mode != QLatin1String("realtime")) {
+            fprintf(stderr, "unknown mode %s\n", qPrintable(mode));
+            continue;
+        }
+        fprintf(stderr, "%s\n", qPrintable(mode));
+        bool mode_ok = false;
+        const QByteArray r = "\"" + mode.toUtf8() + "\": {" + runMode(file, mode == QLatin1String("realtime"), seconds, seeks, &mode_ok) + "}";
+        ok &= mode_ok;
+        results.append(r);
+        fprintf(stderr, "  %s\n", r.constData());
+    }
+    QByteArray json("{\"version\": \"" QTAV_VERSION_STR "\", \"date\": \"");
+    json += QDateTime::currentDateTime().toString(Qt::ISODate).toUtf8();
+    json += "\", \"file\": \"" + QFileInfo(file).fileName().toUtf8() + "\", \"modes\": {\n";
+    for (int i = 0; i < results.size(); ++i) {
+        json += "  " + results.at(i);
+        json += i + 1 < results.size() ? ",\n" : "\n";
+    }
+    json += "}}\n";
+    if (out_file.isEmpty()) {
+        printf("%s", json.constData());
+    } else {
+        QFile f(out_file);
+        if (!f.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+            fprintf(stderr, "can not write %s\n", qPrintable(out_file));
+            return 1;
+        }
+        f.write(json);
+    }
+    fprintf(stderr, "%s\n", ok ? "PASS" : "FAIL"); // stdout is the json
+    return !ok;
+}
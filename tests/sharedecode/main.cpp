@@ -0,0 +1,180 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * Video wall benchmark: N AVPlayers play the same file in real time (repeated), audio disabled, video frames go to
+ * renderers that only record the arrival time. The normal demux and video threads are used, so this measures the
+ * shipped decoding path. Run once with all video threads decoding freely and once with the shared decoding gate
+ * (setSharedDecoding()), then compare delivered fps, dropped frames and jitter of frame intervals.
+ * The gate only bounds how many decoders run at the same time. Every player still owns its threads, the thread count
+ * of the process is printed too.
+ * usage: sharedecode -f file [-n players] [-j shared_threads] [-t seconds] [-vd decoder]
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QMutex>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtCore/QTimer>
+#include <QtCore/QVector>
+#include <QtAV/AVPlayer.h>
+#include <QtAV/AudioOutput.h>
+#include <QtAV/VideoDecoder.h>
+#include <QtAV/VideoRenderer.h>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+using namespace QtAV;
+
+// records the interval between delivered frames. receiveFrame() is called in video thread
+class IntervalRenderer : public VideoRenderer
+{
+public:
+    IntervalRenderer(const QElapsedTimer *timer) : m_timer(timer), m_last_ns(-1) {}
+    VideoRendererId id() const Q_DECL_OVERRIDE { return 0x7fffffff;} // not registered
+    bool isSupported(VideoFormat::PixelFormat) const Q_DECL_OVERRIDE { return true;}
+    // intervals in ms
+    QVector<qreal> intervals() const { QMutexLocker lock(&m_mutex); return m_intervals;}
+protected:
+    bool receiveFrame(const VideoFrame&) Q_DECL_OVERRIDE {
+        const qint64 now = m_timer->nsecsElapsed();
+        QMutexLocker lock(&m_mutex);
+        if (m_last_ns >= 0)
+            m_intervals.append(qreal(now - m_last_ns)/1e6);
+        m_last_ns = now;
+        return true;
+    }
+    void drawFrame() Q_DECL_OVERRIDE {}
+private:
+    const QElapsedTimer *m_timer;
+    mutable QMutex m_mutex;
+    qint64 m_last_ns;
+    QVector<qreal> m_intervals;
+};
+
+static void sleepEventLoop(int ms)
+{
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, SLOT(quit()));
+    loop.exec();
+}
+
+static int threadCount()
+{
+    QDir dir(QString::fromLatin1("/proc/self/task"));
+    return dir.exists() ? dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot).size() : -1;
+}
+
+static qreal percentile(const QVector<qreal>& sorted, qreal p)
+{
+    if (sorted.isEmpty())
+        return 0;
+    return sorted.at(qBound(0, int(ceil(p*sorted.size())) - 1, sorted.size() - 1));
+}
+
+static void runWall(const QString& file, const QString& decoder, int players, int seconds, int shared)
+{
+    setSharedDecoding(shared);
+    QElapsedTimer timer;
+    timer.start();
+    QList<AVPlayer*> wall;
+    QList<IntervalRenderer*> renderers;
+    for (int i = 0; i < players; ++i) {
+        AVPlayer *player = new AVPlayer();
+        IntervalRenderer *renderer = new IntervalRenderer(&timer);
+        player->addVideoRenderer(renderer);
+        player->audio()->setBackends(QStringList() << QString::fromLatin1("null")); // video clock, paced by frame rate
+        player->setPriority(QVector<VideoDecoderId>() << VideoDecoder::id(decoder.toLatin1().constData()));
+        player->setRepeat(-1);
+        player->setFile(file);
+        wall.append(player);
+        renderers.append(renderer);
+    }
+    foreach (AVPlayer *p, wall) {
+        p->play();
+    }
+    sleepEventLoop(seconds*1000/2);
+    const int threads = threadCount();
+    sleepEventLoop(seconds*1000 - seconds*1000/2);
+    qreal fps = 0;
+    foreach (AVPlayer *p, wall) {
+        fps = qMax(fps, p->statistics().video.frame_rate);
+        p->stop();
+    }
+    if (fps <= 0)
+        fps = 25;
+    const qreal interval = 1000.0/fps;
+    int frames = 0, dropped = 0;
+    QVector<qreal> jitter;
+    foreach (IntervalRenderer *r, renderers) {
+        const QVector<qreal> intervals(r->intervals());
+        qreal elapsed = 0;
+        foreach (qreal v, intervals) {
+            elapsed += v;
+            jitter.append(qAbs(v - interval));
+        }
+        frames += intervals.size() + (intervals.isEmpty() ? 0 : 1);
+        // frames expected in the time between the first and the last frame
+        dropped += qMax(0, qRound(elapsed/interval) - intervals.size());
+    }
+    qDeleteAll(wall);
+    qDeleteAll(renderers);
+    std::sort(jitter.begin(), jitter.end());
+    printf("shared threads: %2d, %d players, %d threads in process, total %.1f fps, dropped: %d, jitter p50: %.1fms, p95: %.1fms, max: %.1fms\n"
+           , sharedDecoding(), players, threads, qreal(frames)/qreal(seconds), dropped
+           , percentile(jitter, 0.5), percentile(jitter, 0.95), percentile(jitter, 1.0));
+    fflush(0);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QString file;
+    QString decoder = QString::fromLatin1("FFmpeg");
+    int players = 16;
+    int shared = QThread::idealThreadCount();
+    int seconds = 10;
+    int idx = a.arguments().indexOf(QLatin1String("-f"));
+    if (idx > 0)
+        file = a.arguments().at(idx + 1);
+    idx = a.arguments().indexOf(QLatin1String("-n"));
+    if (idx > 0)
+        players = a.arguments().at(idx + 1).toInt();
+    idx = a.arguments().indexOf(QLatin1String("-j"));
+    if (idx > 0)
+        shared = a.arguments().at(idx + 1).toInt();
+    idx = a.arguments().indexOf(QLatin1String("-t"));
+    if (idx > 0)
+        seconds = a.arguments().at(idx + 1).toInt();
+    idx = a.arguments().indexOf(QLatin1String("-vd"));
+    if (idx > 0)
+        decoder = a.arguments().at(idx + 1);
+    if (file.isEmpty()) {
+        fprintf(stderr, "usage: %s -f file [-n players] [-j shared_threads] [-t seconds] [-vd decoder]\n", argv[0]);
+        return 1;
+    }
+    runWall(file, decoder, players, seconds, 0);
+    runWall(file, decoder, players, seconds, shared > 0 ? shared : -1);
+    return 0;
+}
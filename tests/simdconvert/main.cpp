@@ -0,0 +1,226 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * ImageConverterSIMD: compare the output with ImageConverterFF (swscale) for every supported format, output order and
+ * scale ratio, then print conversions per second of both converters. QTAV_SIMD=sse2 tests the sse2 kernels on an avx2
+ * cpu. An unsupported conversion must be the same as FF because it is converted by FF. eq at the same size (the eq pass)
+ * and of the fused pass is checked against the SIMD result without eq: brightness 0.2 and contrast 1.5 give
+ * clip(1.5*rgb + 51). Conversions per second of eq at the same size are printed for FF and SIMD.
+ * usage: simdconvert [-n conversions] [-s WxH] [-nobench]
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QStringList>
+#include <QtAV/VideoFrame.h>
+#include "ImageConverter.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace QtAV;
+
+// smooth content, so the results of different scale filters are close
+static VideoFrame createFrame(int w, int h, VideoFormat::PixelFormat pixfmt)
+{
+    VideoFrame f(w, h, VideoFormat(pixfmt));
+    if (f.allocate() <= 0)
+        return VideoFrame();
+    const VideoFormat fmt(f.format());
+    for (int p = 0; p < fmt.planeCount(); ++p) {
+        const int sx = p == 0 ? 1 : w/fmt.chromaWidth(w);
+        const int sy = p == 0 ? 1 : h/fmt.chromaHeight(h);
+        for (int y = 0; y < f.planeHeight(p); ++y) {
+            quint8 *d = f.bits(p) + y*f.bytesPerLine(p);
+            for (int i = 0; i < f.effectiveBytesPerLine(p); ++i) {
+                int c = p; // 0: y, 1: u, 2: v
+                int x = i;
+                if (fmt.planeCount() == 2 && p == 1) { // nv12
+                    c = 1 + (i & 1);
+                    x = i/2;
+                }
+                const double px = x*sx, py = y*sy;
+                double v = 0;
+                if (c == 0)
+                    v = 128.0 + 100.0*sin(px/37.0)*cos(py/29.0);
+                else if (c == 1)
+                    v = 128.0 + 60.0*sin((px + py)/53.0);
+                else
+                    v = 128.0 + 60.0*cos((px - py)/41.0);
+                d[i] = (quint8)qBound(0, int(v + 0.5), 255);
+            }
+        }
+    }
+    return f;
+}
+
+static bool convert(ImageConverter *c, const VideoFrame& f, int fmt_out, const QSize& s)
+{
+    c->setInFormat(f.pixelFormatFFmpeg());
+    c->setOutFormat(fmt_out);
+    c->setInSize(f.width(), f.height());
+    c->setOutSize(s.width(), s.height());
+    const quint8 *src[] = { f.constBits(0), f.constBits(1), f.constBits(2), f.constBits(3) };
+    const int stride[] = { f.bytesPerLine(0), f.bytesPerLine(1), f.bytesPerLine(2), f.bytesPerLine(3) };
+    return c->convert(src, stride);
+}
+
+// rgb channels of 4 bytes per pixel images
+static void compare(ImageConverter *a, ImageConverter *b, const QSize& s, int bpp, double *mean, int *max_diff)
+{
+    const quint8 *pa = a->outPlanes().at(0), *pb = b->outPlanes().at(0);
+    const int la = a->outLineSizes().at(0), lb = b->outLineSizes().at(0);
+    qint64 sum = 0;
+    *max_diff = 0;
+    for (int y = 0; y < s.height(); ++y) {
+        for (int x = 0; x < s.width()*bpp; ++x) {
+            if (bpp == 4 && (x & 3) == 3)
+                continue;
+            const int d = qAbs(int(pa[y*la + x]) - int(pb[y*lb + x]));
+            sum += d;
+            *max_diff = qMax(*max_diff, d);
+        }
+    }
+    *mean = double(sum)/double(s.width()*s.height()*qMin(bpp, 3));
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication a(argc, argv);
+    int n = 100;
+    int idx = a.arguments().indexOf(QLatin1String("-n"));
+    if (idx > 0)
+        n = a.arguments().at(idx+1).toInt();
+    QList<QSize> sizes;
+    sizes << QSize(1920, 1080) << QSize(638, 358); // 638: not a multiple of the vector width
+    idx = a.arguments().indexOf(QLatin1String("-s"));
+    if (idx > 0) {
+        const QStringList wh = a.arguments().at(idx+1).split(QLatin1Char('x'));
+        if (wh.size() == 2)
+            sizes = QList<QSize>() << QSize(wh.at(0).toInt(), wh.at(1).toInt());
+    }
+    const bool bench = !a.arguments().contains(QLatin1String("-nobench"));
+    const VideoFormat::PixelFormat in[] = { VideoFormat::Format_YUV420P, VideoFormat::Format_NV12, VideoFormat::Format_YUV422P };
+    const VideoFormat::PixelFormat out[] = { VideoFormat::Format_BGRA32, VideoFormat::Format_RGBA32 };
+    QScopedPointer<ImageConverter> ff(ImageConverter::create(ImageConverterId_FF));
+    QScopedPointer<ImageConverter> simd(ImageConverter::create(ImageConverterId_SIMD));
+    QScopedPointer<ImageConverter> simd_eq(ImageConverter::create(ImageConverterId_SIMD));
+    if (!ff || !simd || !simd_eq) {
+        printf("converter is not registered\n");
+        return 1;
+    }
+    int failed = 0;
+    foreach (const QSize& size, sizes) {
+        for (size_t i = 0; i < sizeof(in)/sizeof(in[0]); ++i) {
+            const VideoFrame f(createFrame(size.width(), size.height(), in[i]));
+            for (size_t j = 0; j < sizeof(out)/sizeof(out[0]); ++j) {
+                const int fmt_out = VideoFormat::pixelFormatToFFmpeg(out[j]);
+                // the last one is the fused bilinear pass
+                const QSize out_sizes[] = { size, size/2, size*2, QSize(size.width()*2/3, size.height()*3/4) };
+                for (int k = 0; k < 4; ++k) {
+                    const QSize& s = out_sizes[k];
+                    if (!convert(ff.data(), f, fmt_out, s) || !convert(simd.data(), f, fmt_out, s)) {
+                        printf("conversion error\n");
+                        return 1;
+                    }
+                    double mean = 0;
+                    int max_diff = 0;
+                    compare(ff.data(), simd.data(), s, 4, &mean, &max_diff);
+                    // the same size is the same math with a different rounding. scaled: box/nearest/bilinear vs fast bilinear
+                    const bool ok = k == 0 ? (mean <= 1.0 && max_diff <= 6) : (mean <= 2.0 && max_diff <= 16);
+                    failed += !ok;
+                    printf("%s %dx%d %s => %s %dx%d: mean diff %.3f, max diff %d %s\n", ok ? "PASS" : "FAIL"
+                           , size.width(), size.height(), qPrintable(f.format().name()), qPrintable(VideoFormat(out[j]).name())
+                           , s.width(), s.height(), mean, max_diff, ok ? "" : "<==");
+                    if (!bench)
+                        continue;
+                    QElapsedTimer timer;
+                    timer.start();
+                    for (int c = 0; c < n; ++c)
+                        convert(ff.data(), f, fmt_out, s);
+                    const qint64 t_ff = qMax<qint64>(1, timer.restart());
+                    for (int c = 0; c < n; ++c)
+                        convert(simd.data(), f, fmt_out, s);
+                    const qint64 t_simd = qMax<qint64>(1, timer.elapsed());
+                    printf("     FFmpeg %8.1f/s, SIMD %8.1f/s, x%.2f\n", n*1000.0/t_ff, n*1000.0/t_simd, double(t_ff)/double(t_simd));
+                }
+            }
+        }
+        const VideoFrame f(createFrame(size.width(), size.height(), VideoFormat::Format_YUV420P));
+        const int bgra = VideoFormat::pixelFormatToFFmpeg(VideoFormat::Format_BGRA32);
+        // the same size: eq pass of the kernel output. scaled: the fused pass. the reference is the simd result without eq
+        const QSize eq_sizes[] = { size, QSize(size.width()*2/3, size.height()*3/4) };
+        for (int k = 0; k < 2; ++k) {
+            const QSize& s = eq_sizes[k];
+            convert(simd.data(), f, bgra, s);
+            simd_eq->setBrightness(20);
+            simd_eq->setContrast(50);
+            convert(simd_eq.data(), f, bgra, s);
+            const quint8 *pa = simd->outPlanes().at(0), *pb = simd_eq->outPlanes().at(0);
+            const int la = simd->outLineSizes().at(0), lb = simd_eq->outLineSizes().at(0);
+            int max_diff = 0;
+            for (int y = 0; y < s.height(); ++y) {
+                for (int x = 0; x < s.width()*4; ++x) {
+                    // alpha, or clipped in the reference
+                    if ((x & 3) == 3 || pa[y*la + x] == 0 || pa[y*la + x] == 255)
+                        continue;
+                    const int expected = qBound(0, int(1.5*pa[y*la + x] + 51.0 + 0.5), 255);
+                    max_diff = qMax(max_diff, qAbs(expected - int(pb[y*lb + x])));
+                }
+            }
+            // no rounding difference in the eq pass
+            const bool ok = max_diff <= (k == 0 ? 1 : 4);
+            failed += !ok;
+            printf("%s %dx%d => %dx%d eq: max diff %d\n", ok ? "PASS" : "FAIL", size.width(), size.height(), s.width(), s.height(), max_diff);
+            if (!bench || k != 0)
+                continue;
+            ff->setBrightness(20);
+            ff->setContrast(50);
+            QElapsedTimer timer;
+            timer.start();
+            for (int c = 0; c < n; ++c)
+                convert(ff.data(), f, bgra, s);
+            const qint64 t_ff = qMax<qint64>(1, timer.restart());
+            for (int c = 0; c < n; ++c)
+                convert(simd_eq.data(), f, bgra, s);
+            const qint64 t_simd = qMax<qint64>(1, timer.restart());
+            for (int c = 0; c < n; ++c)
+                convert(simd.data(), f, bgra, s);
+            const qint64 t_simd_noeq = qMax<qint64>(1, timer.elapsed());
+            ff->setBrightness(0);
+            ff->setContrast(0);
+            printf("     eq 1:1: FFmpeg %8.1f/s, SIMD %8.1f/s, x%.2f. SIMD without eq %8.1f/s\n", n*1000.0/t_ff, n*1000.0/t_simd
+                   , double(t_ff)/double(t_simd), n*1000.0/t_simd_noeq);
+        }
+        // fallback: rgb24 is not supported by the simd kernels
+        const int rgb24 = VideoFormat::pixelFormatToFFmpeg(VideoFormat::Format_RGB24);
+        convert(ff.data(), f, rgb24, size);
+        convert(simd.data(), f, rgb24, size);
+        double mean = 0;
+        int max_diff = 0;
+        compare(ff.data(), simd.data(), size, 3, &mean, &max_diff);
+        failed += max_diff != 0;
+        printf("%s %dx%d fallback to FFmpeg: max diff %d\n", max_diff == 0 ? "PASS" : "FAIL", size.width(), size.height(), max_diff);
+    }
+    printf("%d failed\n", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * ImageConverterFF band conversion: the output of setThreads(0) (auto) must be the same as setThreads(1), and so must
+ * setThreads(n) without scaling. The height 1078 is not a multiple of the band counts, so the last band is different,
+ * and the band edges are aligned to chroma rows. Then conversions per second of 1 thread and auto are printed.
+ * usage: sliceconvert [-n conversions]
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtAV/VideoFrame.h>
+#include "ImageConverter.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace QtAV;
+
+static bool check(bool ok, const char* what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    return ok;
+}
+
+// every row is different, so a band written to a wrong row is detected
+static VideoFrame createFrame(int w, int h, VideoFormat::PixelFormat pixfmt)
+{
+    VideoFrame f(w, h, VideoFormat(pixfmt));
+    if (f.allocate() <= 0)
+        return VideoFrame();
+    for (int p = 0; p < f.planeCount(); ++p) {
+        for (int y = 0; y < f.planeHeight(p); ++y) {
+            quint8 *d = f.bits(p) + y*f.bytesPerLine(p);
+            for (int x = 0; x < f.effectiveBytesPerLine(p); ++x)
+                d[x] = quint8(x*7 + y*13 + p*50 + ((x*y) >> 5));
+        }
+    }
+    return f;
+}
+
+static bool convert(ImageConverter *c, const VideoFrame& f, int fmt_out, const QSize& s)
+{
+    c->setInFormat(f.pixelFormatFFmpeg());
+    c->setOutFormat(fmt_out);
+    c->setInSize(f.width(), f.height());
+    c->setOutSize(s.width(), s.height());
+    const quint8 *src[] = { f.constBits(0), f.constBits(1), f.constBits(2), f.constBits(3) };
+    const int stride[] = { f.bytesPerLine(0), f.bytesPerLine(1), f.bytesPerLine(2), f.bytesPerLine(3) };
+    return c->convert(src, stride);
+}
+
+// 4 bytes per pixel
+static bool sameOutput(ImageConverter *a, ImageConverter *b, const QSize& s)
+{
+    const quint8 *pa = a->outPlanes().at(0), *pb = b->outPlanes().at(0);
+    const int la = a->outLineSizes().at(0), lb = b->outLineSizes().at(0);
+    for (int y = 0; y < s.height(); ++y) {
+        if (memcmp(pa + y*la, pb + y*lb, s.width()*4)) {
+            printf("row %d is different\n", y);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication a(argc, argv);
+    int n = 50;
+    const int idx = a.arguments().indexOf(QLatin1String("-n"));
+    if (idx > 0)
+        n = a.arguments().at(idx+1).toInt();
+    printf("idealThreadCount: %d\n", QThread::idealThreadCount());
+    const QSize size(1920, 1078);
+    const QSize out_sizes[] = { size, QSize(1280, size.height()) };
+    const VideoFormat::PixelFormat in[] = { VideoFormat::Format_YUV420P, VideoFormat::Format_NV12 };
+    const int bgra = VideoFormat::pixelFormatToFFmpeg(VideoFormat::Format_BGRA32);
+    const int threads[] = { 0, 3, 4, 7 };
+    QScopedPointer<ImageConverter> single(ImageConverter::create(ImageConverterId_FF));
+    QScopedPointer<ImageConverter> banded(ImageConverter::create(ImageConverterId_FF));
+    if (!single || !banded) {
+        printf("converter is not registered\n");
+        return 1;
+    }
+    single->setThreads(1);
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(in)/sizeof(in[0]); ++i) {
+        const VideoFrame f(createFrame(size.width(), size.height(), in[i]));
+        for (size_t k = 0; k < sizeof(out_sizes)/sizeof(out_sizes[0]); ++k) {
+            const QSize& s = out_sizes[k];
+            if (!convert(single.data(), f, bgra, s)) {
+                printf("conversion error\n");
+                return 1;
+            }
+            for (size_t t = 0; t < sizeof(threads)/sizeof(threads[0]); ++t) {
+                // n bands of a scaled picture may differ near the band edges
+                if (s != size && threads[t] != 0)
+                    continue;
+                banded->setThreads(threads[t]);
+                const QByteArray what = QString::fromLatin1("%1 %2x%3 => bgra %4x%5, threads %6 == 1")
+                        .arg(f.format().name()).arg(size.width()).arg(size.height())
+                        .arg(s.width()).arg(s.height()).arg(threads[t]).toLatin1();
+                ok &= check(convert(banded.data(), f, bgra, s) && sameOutput(single.data(), banded.data(), s), what.constData());
+            }
+            banded->setThreads(0);
+            QElapsedTimer timer;
+            timer.start();
+            for (int c = 0; c < n; ++c)
+                convert(single.data(), f, bgra, s);
+            const qint64 t_single = qMax<qint64>(1, timer.restart());
+            for (int c = 0; c < n; ++c)
+                convert(banded.data(), f, bgra, s);
+            const qint64 t_auto = qMax<qint64>(1, timer.elapsed());
+            printf("     1 thread %8.1f/s, auto %8.1f/s, x%.2f\n", n*1000.0/t_single, n*1000.0/t_auto, double(t_single)/double(t_auto));
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * Statistics::Histogram and StageTimer: several threads add samples to the same histogram without locking, then
+ * count, sum, max and percentiles are checked. Then the cost of a StageTimer scope is measured with timings
+ * disabled and enabled.
+ * usage: stagetiming [-t threads] [-n samples_per_thread]
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtAV/Statistics.h>
+#include "StageTimer.h"
+#include <stdio.h>
+
+using namespace QtAV;
+
+static const int kRange = 5000; // samples are i%kRange
+
+class Adder : public QThread
+{
+public:
+    Adder(Statistics::Histogram *h, int n) : m_h(h), m_n(n) {}
+protected:
+    void run() {
+        for (int i = 0; i < m_n; ++i)
+            m_h->add(i % kRange);
+    }
+private:
+    Statistics::Histogram *m_h;
+    int m_n;
+};
+
+static volatile int gSink = 0;
+static qreal scopeCost(Statistics *s, int n)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < n; ++i) {
+        StageTimer t(s, Statistics::VideoDecode);
+        gSink += i;
+    }
+    return qreal(timer.nsecsElapsed())/qreal(n);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    int nb_threads = 4;
+    int i = a.arguments().indexOf(QLatin1String("-t"));
+    if (i > 0)
+        nb_threads = a.arguments().at(i + 1).toInt();
+    int n = 250000 - 250000 % kRange;
+    i = a.arguments().indexOf(QLatin1String("-n"));
+    if (i > 0)
+        n = a.arguments().at(i + 1).toInt()/kRange*kRange;
+
+    Statistics s;
+    s.timings.setEnabled(true);
+    Statistics::Histogram &h = s.timings.stage(Statistics::VideoDecode);
+    QList<Adder*> adders;
+    for (int t = 0; t < nb_threads; ++t)
+        adders.append(new Adder(&h, n));
+    foreach (Adder *t, adders)
+        t->start();
+    foreach (Adder *t, adders)
+        t->wait();
+    qDeleteAll(adders);
+    const qint64 count = qint64(nb_threads)*n;
+    const qint64 sum = count/kRange*(qint64(kRange)*(kRange - 1)/2);
+    const qint64 p50 = h.percentile(0.5), p99 = h.percentile(0.99);
+    bool ok = h.count() == count && h.sum() == sum && h.max() == kRange - 1
+            && p50 >= kRange/2 - 1 && p50 <= kRange/2*5/4 && p99 >= kRange*99/100 - 1 && p99 <= kRange - 1;
+    printf("%s %d threads: count %d/%lld, sum %lld/%lld, max %lld, mean %.1f, p50 %lld, p99 %lld\n", ok ? "PASS" : "FAIL"
+           , nb_threads, h.count(), count, h.sum(), sum, h.max(), h.mean(), p50, p99);
+    int failed = ok ? 0 : 1;
+
+    Statistics copy(s);
+    s.reset();
+    ok = copy.timings.stage(Statistics::VideoDecode).count() == 0 && copy.timings.isEnabled();
+    printf("%s reset is shared by copies and keeps timings enabled\n", ok ? "PASS" : "FAIL");
+    failed += ok ? 0 : 1;
+
+    const int loops = 10000000;
+    s.timings.setEnabled(false);
+    printf("StageTimer scope: disabled %.2f ns", scopeCost(&s, loops));
+    s.timings.setEnabled(true);
+    printf(", enabled %.2f ns\n", scopeCost(&s, loops));
+    return failed;
+}
@@ -0,0 +1,77 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * Generate seek preview sprite sheets and the WebVTT index, and print the time used.
+ * usage: storyboard -f file [-i interval_ms] [-w tile_width] [-h tile_height] [-c columns] [-r rows] [-o dir] [-fmt jpg]
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QStringList>
+#include <QtAV/StoryboardGenerator.h>
+#include <stdio.h>
+
+using namespace QtAV;
+
+int main(int argc, char** argv)
+{
+    QCoreApplication a(argc, argv);
+    int idx = a.arguments().indexOf(QLatin1String("-f"));
+    if (idx < 0) {
+        printf("usage: storyboard -f file [-i interval_ms] [-w tile_width] [-h tile_height] [-c columns] [-r rows] [-o dir] [-fmt jpg]\n");
+        return -1;
+    }
+    StoryboardGenerator sb;
+    sb.setSource(a.arguments().at(idx+1));
+    idx = a.arguments().indexOf(QLatin1String("-i"));
+    if (idx > 0)
+        sb.setInterval(a.arguments().at(idx+1).toLongLong());
+    QSize size(sb.tileSize());
+    idx = a.arguments().indexOf(QLatin1String("-w"));
+    if (idx > 0)
+        size.setWidth(a.arguments().at(idx+1).toInt());
+    idx = a.arguments().indexOf(QLatin1String("-h"));
+    if (idx > 0)
+        size.setHeight(a.arguments().at(idx+1).toInt());
+    sb.setTileSize(size);
+    idx = a.arguments().indexOf(QLatin1String("-c"));
+    if (idx > 0)
+        sb.setColumns(a.arguments().at(idx+1).toInt());
+    idx = a.arguments().indexOf(QLatin1String("-r"));
+    if (idx > 0)
+        sb.setRows(a.arguments().at(idx+1).toInt());
+    idx = a.arguments().indexOf(QLatin1String("-o"));
+    if (idx > 0)
+        sb.setOutputDir(a.arguments().at(idx+1));
+    idx = a.arguments().indexOf(QLatin1String("-fmt"));
+    if (idx > 0)
+        sb.setImageFormat(a.arguments().at(idx+1));
+    QElapsedTimer timer;
+    timer.start();
+    if (!sb.generate()) {
+        printf("failed: %s\n", qPrintable(sb.errorString()));
+        return 1;
+    }
+    printf("%lld ms\n", timer.elapsed());
+    foreach (const QString& f, sb.files())
+        printf("%s\n", qPrintable(f));
+    return 0;
+}
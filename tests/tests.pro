@@ -2,8 +2,26 @@ TEMPLATE = subdirs
 
 SUBDIRS += \
     ao \
+    blockingqueue \
+    commandslots \
+    convertbench \
     decoder \
-    subtitle
+    eofseek \
+    extractbench \
+    framedrop \
+    framepool \
+    interleavecache \
+    keyframeindex \
+    mediabench \
+    packetbuffer \
+    playerbench \
+    sharedecode \
+    simdconvert \
+    sliceconvert \
+    stagetiming \
+    storyboard \
+    subtitle \
+    tracer
 
 !no-widgets {
   SUBDIRS += \
@@ -0,0 +1,136 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2014-2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * Tracer: several threads record nested begin/end pairs and instant events, then the trace file is checked:
+ * it's a JSON array, every thread has a name and the same number of begin and end events. Then the cost of
+ * a TraceScope is measured with tracing disabled and enabled.
+ * usage: tracer [-t threads] [-n pairs_per_thread] [-o trace.json]
+ * The output file can be opened in chrome://tracing or https://ui.perfetto.dev
+ */
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include "utils/Tracer.h"
+#include <stdio.h>
+
+using namespace QtAV;
+
+class Recorder : public QThread
+{
+public:
+    explicit Recorder(int n) : m_n(n) {}
+protected:
+    void run() {
+        for (int i = 0; i < m_n; ++i) {
+            TraceScope outer("outer", qreal(i)/25.0);
+            Tracer::begin("inner");
+            Tracer::end("inner", qreal(i)/25.0);
+            if (i % 100 == 0) {
+                Tracer::instant("tick", qreal(i)/25.0);
+                msleep(1); // let the writer drain the ring
+            }
+        }
+    }
+private:
+    int m_n;
+};
+
+static volatile int gSink = 0;
+static qreal scopeCost(int n)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < n; ++i) {
+        TraceScope t("cost");
+        gSink = gSink + i;
+        if (Tracer::isEnabled() && i % 1000 == 0)
+            Tracer::flush();
+    }
+    return qreal(timer.nsecsElapsed())/qreal(n);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    int nb_threads = 4;
+    int n = 2000;
+    QString file = QDir::temp().filePath(QString::fromLatin1("qtav_tracer_test.json"));
+    int i = a.arguments().indexOf(QLatin1String("-t"));
+    if (i > 0)
+        nb_threads = a.arguments().at(i+1).toInt();
+    i = a.arguments().indexOf(QLatin1String("-n"));
+    if (i > 0)
+        n = a.arguments().at(i+1).toInt();
+    i = a.arguments().indexOf(QLatin1String("-o"));
+    if (i > 0)
+        file = a.arguments().at(i+1);
+
+    const qreal disabled_ns = scopeCost(1000000);
+    if (!Tracer::start(file)) {
+        printf("FAIL: can not open %s\n", file.toUtf8().constData());
+        return 1;
+    }
+    QList<Recorder*> threads;
+    for (int t = 0; t < nb_threads; ++t) {
+        threads.append(new Recorder(n));
+        threads.last()->start();
+    }
+    foreach (Recorder *t, threads) {
+        t->wait();
+    }
+    qDeleteAll(threads);
+    Tracer::stop();
+
+    QFile f(file);
+    if (!f.open(QIODevice::ReadOnly)) {
+        printf("FAIL: can not read %s\n", file.toUtf8().constData());
+        return 1;
+    }
+    const QByteArray json = f.readAll().trimmed();
+    f.close();
+    bool ok = json.startsWith('[') && json.endsWith(']');
+    const int names = json.count("\"thread_name\"");
+    const int begins = json.count("\"ph\":\"B\"");
+    const int ends = json.count("\"ph\":\"E\"");
+    const int instants = json.count("\"ph\":\"i\"");
+    const int ticks = (n + 99)/100;
+    printf("threads: %d, thread names: %d, begin: %d, end: %d, instant: %d\n", nb_threads, names, begins, ends, instants);
+    ok = ok && names == nb_threads
+            && begins == 2*n*nb_threads && ends == begins
+            && instants == ticks*nb_threads;
+    // no event after stop()
+    Tracer::instant("after stop");
+    f.open(QIODevice::ReadOnly);
+    ok = ok && !f.readAll().contains("after stop");
+    f.close();
+    printf("%s: trace file %s\n", ok ? "PASS" : "FAIL", file.toUtf8().constData());
+
+    // a separate trace, so the counts above are exact
+    Tracer::start(QDir::temp().filePath(QString::fromLatin1("qtav_tracer_cost.json")));
+    const qreal traced_ns = scopeCost(1000000);
+    Tracer::stop();
+    printf("TraceScope cost: disabled %.1fns, enabled %.1fns\n", disabled_ns, traced_ns);
+    return ok ? 0 : 1;
+}